@@ -38,9 +38,11 @@
 #include "drivers/system.h"
 #include "drivers/compass.h"
 #include "drivers/accgyro.h"
+#include "drivers/gyro_sync.h"
 
 #include "fc/rate_profile.h"
 #include "fc/rc_controls.h"
+#include "fc/rc_latency.h"
 
 #include "sensors/sensors.h"
 #include "sensors/boardalignment.h"
@@ -77,15 +79,39 @@
 #define DEFAULT_BLACKBOX_DEVICE BLACKBOX_DEVICE_SERIAL
 #endif
 
-PG_REGISTER_WITH_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig, PG_BLACKBOX_CONFIG, 0);
+PG_REGISTER_WITH_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig, PG_BLACKBOX_CONFIG, 2);
 
 PG_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig,
         .device = DEFAULT_BLACKBOX_DEVICE,
         .rate_num = 1,
         .rate_denom = 1,
+        .gyro_logging = 0,
+        .predictor = BLACKBOX_PREDICTOR_AVERAGE,
 );
 
 #define BLACKBOX_I_INTERVAL 32
+#define BLACKBOX_GYRO_I_INTERVAL 32
+// Must be a power of 2
+#define BLACKBOX_GYRO_RING_SIZE 32
+/*
+ * Worst case size of a gyro frame: the frame character, iteration and time as 5-byte VBs and six 16-bit values,
+ * each of which takes at most 3 bytes as a signed VB.
+ */
+#define BLACKBOX_GYRO_FRAME_MAX_BYTES (1 + 5 + 5 + 6 * 3)
+
+/*
+ * Adaptive predictor bookkeeping, see FLIGHT_LOG_FIELD_PREDICTOR_ADAPTIVE. The error clamp keeps the decayed cost
+ * within 16 bits: it settles at no more than (MAX_ERROR << DECAY_SHIFT).
+ */
+#define BLACKBOX_ADAPTIVE_CANDIDATE_COUNT 3
+#define BLACKBOX_ADAPTIVE_COST_DECAY_SHIFT 4
+#define BLACKBOX_ADAPTIVE_MAX_ERROR 4095
+
+/*
+ * Fields marked with this P-predictor use the predictor selected by blackbox_predictor, which is substituted when the
+ * header is written.
+ */
+#define PREDICTOR_NOISY 0xFF
 #define BLACKBOX_SHUTDOWN_TIMEOUT_MILLIS 200
 #define SLOW_FRAME_INTERVAL 4096
 
@@ -107,6 +133,13 @@ static const char blackboxHeader[] =
     "H Data version:2\n"
     "H I interval:" STR(BLACKBOX_I_INTERVAL) "\n";
 
+// In order of preference when the adaptive predictor finds them equally good:
+static const FlightLogFieldPredictor blackboxAdaptiveCandidates[BLACKBOX_ADAPTIVE_CANDIDATE_COUNT] = {
+    FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2,
+    FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE,
+    FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS
+};
+
 static const char* const blackboxFieldHeaderNames[] = {
     "name",
     "signed",
@@ -205,26 +238,29 @@ static const blackboxDeltaFieldDefinition_t blackboxMainFields[] = {
 #endif
     {"rssi",       -1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_8SVB), FLIGHT_LOG_FIELD_CONDITION_RSSI},
 
-    /* Gyros and accelerometers base their P-predictions on the average of the previous 2 frames to reduce noise impact */
-    {"gyroADC",   0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"gyroADC",   1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"gyroADC",   2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"accSmooth",  0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"accSmooth",  1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"accSmooth",  2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    /* Gyros, accelerometers and motors base their P-predictions on the last 2 frames, see blackbox_predictor */
+    {"gyroADC",   0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroADC",   1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroADC",   2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"accSmooth",  0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"accSmooth",  1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"accSmooth",  2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
     /* Motors only rarely drops under minthrottle (when stick falls below mincommand), so predict minthrottle for it and use *unsigned* encoding (which is large for negative numbers but more compact for positive ones): */
-    {"motor",      0, UNSIGNED, .Ipredict = PREDICT(MINTHROTTLE), .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(AVERAGE_2), .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_1)},
-    /* Subsequent motors base their I-frame values on the first one, P-frame values on the average of last two frames: */
-    {"motor",      1, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_2)},
-    {"motor",      2, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_3)},
-    {"motor",      3, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_4)},
-    {"motor",      4, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_5)},
-    {"motor",      5, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_6)},
-    {"motor",      6, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_7)},
-    {"motor",      7, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_8)},
+    {"motor",      0, UNSIGNED, .Ipredict = PREDICT(MINTHROTTLE), .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICTOR_NOISY,    .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_1)},
+    /* Subsequent motors base their I-frame values on the first one, P-frame values on the last two frames: */
+    {"motor",      1, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_2)},
+    {"motor",      2, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_3)},
+    {"motor",      3, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_4)},
+    {"motor",      4, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_5)},
+    {"motor",      5, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_6)},
+    {"motor",      6, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_7)},
+    {"motor",      7, UNSIGNED, .Ipredict = PREDICT(MOTOR_0), .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICTOR_NOISY,        .Pencode = ENCODING(SIGNED_VB), CONDITION(AT_LEAST_MOTORS_8)},
 
     /* Tricopter tail servo */
-    {"servo",      5, UNSIGNED, .Ipredict = PREDICT(1500),    .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(TRICOPTER)}
+    {"servo",      5, UNSIGNED, .Ipredict = PREDICT(1500),    .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(TRICOPTER)},
+
+    /* Latest RC frame to motor output latency in us, only changes when a new RX frame reached the motors */
+    {"rcLatency",  -1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)}
 };
 
 #ifdef GPS
@@ -246,6 +282,24 @@ static const blackboxSimpleFieldDefinition_t blackboxGpsHFields[] = {
 };
 #endif
 
+/*
+ * Gyro-only frames logged at the full loop rate when blackbox_gyro_logging is on. "R" frames are keyframes, "r" frames
+ * are deltas. An "r" frame always directly follows the previous loop iteration; after a dropped sample (or every
+ * BLACKBOX_GYRO_I_INTERVAL frames) an "R" frame is written instead.
+ */
+static const blackboxDeltaFieldDefinition_t blackboxGyroFields[] = {
+    {"loopIteration",-1, UNSIGNED, .Ipredict = PREDICT(0),     .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(INC),           .Pencode = FLIGHT_LOG_FIELD_ENCODING_NULL, CONDITION(ALWAYS)},
+    {"time",       -1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(STRAIGHT_LINE), .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    /* The unfiltered gyro is mostly noise, so the best we can do is predict the last value */
+    {"gyroRaw",     0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroRaw",     1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroRaw",     2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    /* The filtered gyro is smooth at the loop rate, so a straight line through the last two samples fits it well */
+    {"gyroADC",     0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(STRAIGHT_LINE), .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroADC",     1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(STRAIGHT_LINE), .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"gyroADC",     2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(STRAIGHT_LINE), .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)}
+};
+
 // Rarely-updated fields
 static const blackboxSimpleFieldDefinition_t blackboxSlowFields[] = {
     {"flightModeFlags",       -1, UNSIGNED, PREDICT(0),      ENCODING(UNSIGNED_VB)},
@@ -265,6 +319,7 @@ typedef enum BlackboxState {
     BLACKBOX_STATE_SEND_GPS_H_HEADER,
     BLACKBOX_STATE_SEND_GPS_G_HEADER,
     BLACKBOX_STATE_SEND_SLOW_HEADER,
+    BLACKBOX_STATE_SEND_GYRO_HEADER,
     BLACKBOX_STATE_SEND_SYSINFO,
     BLACKBOX_STATE_PAUSED,
     BLACKBOX_STATE_RUNNING,
@@ -298,6 +353,7 @@ typedef struct blackboxMainState_s {
     int32_t sonarRaw;
 #endif
     uint16_t rssi;
+    uint16_t rcLatency;
 } blackboxMainState_t;
 
 typedef struct blackboxGpsState_s {
@@ -314,6 +370,18 @@ typedef struct blackboxSlowState_s {
     bool rxFlightChannelsValid;
 } __attribute__((__packed__)) blackboxSlowState_t; // We pack this struct so that padding doesn't interfere with memcmp()
 
+typedef struct blackboxGyroSample_s {
+    uint32_t iteration;
+    uint32_t time;
+    int16_t gyroRaw[XYZ_AXIS_COUNT];
+    int16_t gyroADC[XYZ_AXIS_COUNT];
+} blackboxGyroSample_t;
+
+typedef struct blackboxAdaptivePredictor_s {
+    // Decayed absolute prediction error of each of blackboxAdaptiveCandidates
+    uint16_t cost[BLACKBOX_ADAPTIVE_CANDIDATE_COUNT];
+} blackboxAdaptivePredictor_t;
+
 //From mixer.c:
 extern uint8_t motorCount;
 
@@ -365,6 +433,27 @@ static blackboxMainState_t blackboxHistoryRing[3];
 // These point into blackboxHistoryRing, use them to know where to store history of a given age (0, 1 or 2 generations old)
 static blackboxMainState_t* blackboxHistory[3];
 
+/*
+ * Gyro samples are captured every loop iteration into this ring and drained into "R"/"r" frames only as fast as the
+ * device budget allows, so short stalls of the device are absorbed instead of costing samples.
+ */
+static blackboxGyroSample_t blackboxGyroRing[BLACKBOX_GYRO_RING_SIZE];
+static uint8_t blackboxGyroRingHead, blackboxGyroRingTail;
+static uint16_t blackboxGyroFrameIndex;
+
+// The last two gyro samples written, for the "r" frame predictors
+static blackboxGyroSample_t blackboxGyroHistory[2];
+
+static struct {
+    blackboxAdaptivePredictor_t gyroADC[XYZ_AXIS_COUNT];
+    blackboxAdaptivePredictor_t accSmooth[XYZ_AXIS_COUNT];
+    blackboxAdaptivePredictor_t motor[MAX_SUPPORTED_MOTORS];
+} blackboxAdaptivePredictors;
+
+static blackboxFieldGroupStats_t blackboxFieldGroupStats[BLACKBOX_FIELD_GROUP_COUNT];
+// Value of blackboxBytesWritten at the end of the last field group accounted for
+static uint32_t blackboxFieldGroupMark;
+
 static bool blackboxModeActivationConditionPresent = false;
 
 /**
@@ -380,6 +469,36 @@ static bool blackboxIsOnlyLoggingIntraframes()
     return blackboxConfig()->rate_num == 1 && blackboxConfig()->rate_denom == 32;
 }
 
+/**
+ * Charge the bytes written since the previous call (or since blackboxFieldGroupMark was set at the start of the frame)
+ * to the given field group, along with the in-memory size of the values they encoded.
+ */
+static void blackboxAccountFieldGroup(blackboxFieldGroup_e group, uint32_t rawBytes)
+{
+    blackboxFieldGroupStats[group].rawBytes += rawBytes;
+    blackboxFieldGroupStats[group].encodedBytes += blackboxBytesWritten - blackboxFieldGroupMark;
+
+    blackboxFieldGroupMark = blackboxBytesWritten;
+}
+
+const blackboxFieldGroupStats_t *blackboxGetFieldGroupStats(void)
+{
+    return blackboxFieldGroupStats;
+}
+
+static FlightLogFieldPredictor blackboxNoisyFieldPredictor(void)
+{
+    switch (blackboxConfig()->predictor) {
+        case BLACKBOX_PREDICTOR_LINEAR:
+            return FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE;
+        case BLACKBOX_PREDICTOR_ADAPTIVE:
+            return FLIGHT_LOG_FIELD_PREDICTOR_ADAPTIVE;
+        case BLACKBOX_PREDICTOR_AVERAGE:
+        default:
+            return FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2;
+    }
+}
+
 static bool testBlackboxConditionUncached(FlightLogFieldCondition condition)
 {
     switch (condition) {
@@ -478,6 +597,7 @@ static void blackboxSetState(BlackboxState newState)
         case BLACKBOX_STATE_SEND_GPS_G_HEADER:
         case BLACKBOX_STATE_SEND_GPS_H_HEADER:
         case BLACKBOX_STATE_SEND_SLOW_HEADER:
+        case BLACKBOX_STATE_SEND_GYRO_HEADER:
             xmitState.headerIndex = 0;
             xmitState.u.fieldIndex = -1;
         break;
@@ -500,12 +620,17 @@ static void writeIntraframe(void)
 {
     blackboxMainState_t *blackboxCurrent = blackboxHistory[0];
     int x;
+    int optionalRawBytes = 0;
+
+    blackboxFieldGroupMark = blackboxBytesWritten;
 
     blackboxWrite('I');
 
     blackboxWriteUnsignedVB(blackboxIteration);
     blackboxWriteUnsignedVB(blackboxCurrent->time);
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_FRAME, sizeof(blackboxIteration) + sizeof(blackboxCurrent->time));
+
     blackboxWriteSignedVBArray(blackboxCurrent->axisPID_P, XYZ_AXIS_COUNT);
     blackboxWriteSignedVBArray(blackboxCurrent->axisPID_I, XYZ_AXIS_COUNT);
 
@@ -513,9 +638,12 @@ static void writeIntraframe(void)
     for (x = 0; x < XYZ_AXIS_COUNT; x++) {
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_NONZERO_PID_D_0 + x)) {
             blackboxWriteSignedVB(blackboxCurrent->axisPID_D[x]);
+            optionalRawBytes += sizeof(blackboxCurrent->axisPID_D[x]);
         }
     }
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_PID, sizeof(blackboxCurrent->axisPID_P) + sizeof(blackboxCurrent->axisPID_I) + optionalRawBytes);
+
     // Write roll, pitch and yaw first:
     blackboxWriteSigned16VBArray(blackboxCurrent->rcCommand, 3);
 
@@ -525,6 +653,10 @@ static void writeIntraframe(void)
      */
     blackboxWriteUnsignedVB(blackboxCurrent->rcCommand[THROTTLE] - motorAndServoConfig()->minthrottle);
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_RC, sizeof(blackboxCurrent->rcCommand));
+
+    optionalRawBytes = 0;
+
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_VBAT)) {
         /*
          * Our voltage is expected to decrease over the course of the flight, so store our difference from
@@ -533,37 +665,48 @@ static void writeIntraframe(void)
          * Write 14 bits even if the number is negative (which would otherwise result in 32 bits)
          */
         blackboxWriteUnsignedVB((vbatReference - blackboxCurrent->vbatLatest) & 0x3FFF);
+        optionalRawBytes += sizeof(blackboxCurrent->vbatLatest);
     }
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_AMPERAGE_ADC)) {
         // 12bit value directly from ADC
         blackboxWriteUnsignedVB(blackboxCurrent->amperageLatest);
+        optionalRawBytes += sizeof(blackboxCurrent->amperageLatest);
     }
 
 #ifdef MAG
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_MAG)) {
             blackboxWriteSigned16VBArray(blackboxCurrent->magADC, XYZ_AXIS_COUNT);
+            optionalRawBytes += sizeof(blackboxCurrent->magADC);
         }
 #endif
 
 #ifdef BARO
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_BARO)) {
             blackboxWriteSignedVB(blackboxCurrent->BaroAlt);
+            optionalRawBytes += sizeof(blackboxCurrent->BaroAlt);
         }
 #endif
 
 #ifdef SONAR
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_SONAR)) {
             blackboxWriteSignedVB(blackboxCurrent->sonarRaw);
+            optionalRawBytes += sizeof(blackboxCurrent->sonarRaw);
         }
 #endif
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_RSSI)) {
         blackboxWriteUnsignedVB(blackboxCurrent->rssi);
+        optionalRawBytes += sizeof(blackboxCurrent->rssi);
     }
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_SENSORS, optionalRawBytes);
+
     blackboxWriteSigned16VBArray(blackboxCurrent->gyroADC, XYZ_AXIS_COUNT);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_GYRO, sizeof(blackboxCurrent->gyroADC));
+
     blackboxWriteSigned16VBArray(blackboxCurrent->accSmooth, XYZ_AXIS_COUNT);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_ACC, sizeof(blackboxCurrent->accSmooth));
 
     //Motors can be below minthrottle when disarmed, but that doesn't happen much
     blackboxWriteUnsignedVB(blackboxCurrent->motor[0] - motorAndServoConfig()->minthrottle);
@@ -573,11 +716,23 @@ static void writeIntraframe(void)
         blackboxWriteSignedVB(blackboxCurrent->motor[x] - blackboxCurrent->motor[0]);
     }
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_MOTOR, motorCount * sizeof(blackboxCurrent->motor[0]));
+
+    optionalRawBytes = 0;
+
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_TRICOPTER)) {
         //Assume the tail spends most of its time around the center
         blackboxWriteSignedVB(blackboxCurrent->servo[5] - 1500);
+        optionalRawBytes += sizeof(blackboxCurrent->servo[5]);
     }
 
+    blackboxWriteUnsignedVB(blackboxCurrent->rcLatency);
+
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_OTHER, optionalRawBytes + sizeof(blackboxCurrent->rcLatency));
+
+    // The adaptive predictors start learning again from this keyframe, just like the decoder does
+    memset(&blackboxAdaptivePredictors, 0, sizeof(blackboxAdaptivePredictors));
+
     //Rotate our history buffers:
 
     //The current state becomes the new "before" state
@@ -590,15 +745,68 @@ static void writeIntraframe(void)
     blackboxLoggedAnyFrames = true;
 }
 
-static void blackboxWriteMainStateArrayUsingAveragePredictor(int arrOffsetInHistory, int count)
+static int32_t blackboxPredict(FlightLogFieldPredictor predictor, int32_t prev1, int32_t prev2)
+{
+    switch (predictor) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            return prev1;
+        case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            return 2 * prev1 - prev2;
+        case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+        default:
+            return (prev1 + prev2) / 2;
+    }
+}
+
+/**
+ * Predict the field using whichever candidate has had the smallest recent error, then charge every candidate with the
+ * error it would have made on the actual value. The decoder runs the same bookkeeping on the decoded values, so the
+ * choice never has to be stored in the log.
+ */
+static int32_t blackboxAdaptivePredict(blackboxAdaptivePredictor_t *adaptive, int32_t value, int32_t prev1, int32_t prev2)
+{
+    int best = 0;
+
+    for (int i = 1; i < BLACKBOX_ADAPTIVE_CANDIDATE_COUNT; i++) {
+        if (adaptive->cost[i] < adaptive->cost[best]) {
+            best = i;
+        }
+    }
+
+    const int32_t prediction = blackboxPredict(blackboxAdaptiveCandidates[best], prev1, prev2);
+
+    for (int i = 0; i < BLACKBOX_ADAPTIVE_CANDIDATE_COUNT; i++) {
+        const int32_t error = MIN(ABS(value - blackboxPredict(blackboxAdaptiveCandidates[i], prev1, prev2)), BLACKBOX_ADAPTIVE_MAX_ERROR);
+
+        adaptive->cost[i] = adaptive->cost[i] - (adaptive->cost[i] >> BLACKBOX_ADAPTIVE_COST_DECAY_SHIFT) + error;
+    }
+
+    return prediction;
+}
+
+static void blackboxWriteMainStateArrayUsingNoisyPredictor(int arrOffsetInHistory, int count, blackboxAdaptivePredictor_t *adaptive)
 {
     int16_t *curr  = (int16_t*) ((char*) (blackboxHistory[0]) + arrOffsetInHistory);
     int16_t *prev1 = (int16_t*) ((char*) (blackboxHistory[1]) + arrOffsetInHistory);
     int16_t *prev2 = (int16_t*) ((char*) (blackboxHistory[2]) + arrOffsetInHistory);
 
     for (int i = 0; i < count; i++) {
-        // Predictor is the average of the previous two history states
-        int32_t predictor = (prev1[i] + prev2[i]) / 2;
+        int32_t predictor;
+
+        switch (blackboxConfig()->predictor) {
+            case BLACKBOX_PREDICTOR_LINEAR:
+                // Extrapolate the slope between the previous two history states
+                predictor = blackboxPredict(FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE, prev1[i], prev2[i]);
+            break;
+            case BLACKBOX_PREDICTOR_ADAPTIVE:
+                predictor = blackboxAdaptivePredict(&adaptive[i], curr[i], prev1[i], prev2[i]);
+            break;
+            case BLACKBOX_PREDICTOR_AVERAGE:
+            default:
+                // Predictor is the average of the previous two history states
+                predictor = blackboxPredict(FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2, prev1[i], prev2[i]);
+            break;
+        }
 
         blackboxWriteSignedVB(curr[i] - predictor);
     }
@@ -608,10 +816,13 @@ static void writeInterframe(void)
 {
     int x;
     int32_t deltas[8];
+    int optionalRawBytes = 0;
 
     blackboxMainState_t *blackboxCurrent = blackboxHistory[0];
     blackboxMainState_t *blackboxLast = blackboxHistory[1];
 
+    blackboxFieldGroupMark = blackboxBytesWritten;
+
     blackboxWrite('P');
 
     //No need to store iteration count since its delta is always 1
@@ -622,6 +833,8 @@ static void writeInterframe(void)
      */
     blackboxWriteSignedVB((int32_t) (blackboxHistory[0]->time - 2 * blackboxHistory[1]->time + blackboxHistory[2]->time));
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_FRAME, sizeof(blackboxIteration) + sizeof(blackboxCurrent->time));
+
     arraySubInt32(deltas, blackboxCurrent->axisPID_P, blackboxLast->axisPID_P, XYZ_AXIS_COUNT);
     blackboxWriteSignedVBArray(deltas, XYZ_AXIS_COUNT);
 
@@ -639,9 +852,12 @@ static void writeInterframe(void)
     for (x = 0; x < XYZ_AXIS_COUNT; x++) {
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_NONZERO_PID_D_0 + x)) {
             blackboxWriteSignedVB(blackboxCurrent->axisPID_D[x] - blackboxLast->axisPID_D[x]);
+            optionalRawBytes += sizeof(blackboxCurrent->axisPID_D[x]);
         }
     }
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_PID, sizeof(blackboxCurrent->axisPID_P) + sizeof(blackboxCurrent->axisPID_I) + optionalRawBytes);
+
     /*
      * RC tends to stay the same or fairly small for many frames at a time, so use an encoding that
      * can pack multiple values per byte:
@@ -652,15 +868,21 @@ static void writeInterframe(void)
 
     blackboxWriteTag8_4S16(deltas);
 
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_RC, sizeof(blackboxCurrent->rcCommand));
+
     //Check for sensors that are updated periodically (so deltas are normally zero)
     int optionalFieldCount = 0;
 
+    optionalRawBytes = 0;
+
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_VBAT)) {
         deltas[optionalFieldCount++] = (int32_t) blackboxCurrent->vbatLatest - blackboxLast->vbatLatest;
+        optionalRawBytes += sizeof(blackboxCurrent->vbatLatest);
     }
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_AMPERAGE_ADC)) {
         deltas[optionalFieldCount++] = (int32_t) blackboxCurrent->amperageLatest - blackboxLast->amperageLatest;
+        optionalRawBytes += sizeof(blackboxCurrent->amperageLatest);
     }
 
 #ifdef MAG
@@ -668,36 +890,54 @@ static void writeInterframe(void)
         for (x = 0; x < XYZ_AXIS_COUNT; x++) {
             deltas[optionalFieldCount++] = blackboxCurrent->magADC[x] - blackboxLast->magADC[x];
         }
+        optionalRawBytes += sizeof(blackboxCurrent->magADC);
     }
 #endif
 
 #ifdef BARO
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_BARO)) {
         deltas[optionalFieldCount++] = blackboxCurrent->BaroAlt - blackboxLast->BaroAlt;
+        optionalRawBytes += sizeof(blackboxCurrent->BaroAlt);
     }
 #endif
 
 #ifdef SONAR
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_SONAR)) {
         deltas[optionalFieldCount++] = blackboxCurrent->sonarRaw - blackboxLast->sonarRaw;
+        optionalRawBytes += sizeof(blackboxCurrent->sonarRaw);
     }
 #endif
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_RSSI)) {
         deltas[optionalFieldCount++] = (int32_t) blackboxCurrent->rssi - blackboxLast->rssi;
+        optionalRawBytes += sizeof(blackboxCurrent->rssi);
     }
 
     blackboxWriteTag8_8SVB(deltas, optionalFieldCount);
 
-    //Since gyros, accs and motors are noisy, base their predictions on the average of the history:
-    blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, gyroADC),   XYZ_AXIS_COUNT);
-    blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, accSmooth), XYZ_AXIS_COUNT);
-    blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, motor),     motorCount);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_SENSORS, optionalRawBytes);
+
+    //Since gyros, accs and motors are noisy, base their predictions on the history using the configured predictor:
+    blackboxWriteMainStateArrayUsingNoisyPredictor(offsetof(blackboxMainState_t, gyroADC), XYZ_AXIS_COUNT, blackboxAdaptivePredictors.gyroADC);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_GYRO, sizeof(blackboxCurrent->gyroADC));
+
+    blackboxWriteMainStateArrayUsingNoisyPredictor(offsetof(blackboxMainState_t, accSmooth), XYZ_AXIS_COUNT, blackboxAdaptivePredictors.accSmooth);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_ACC, sizeof(blackboxCurrent->accSmooth));
+
+    blackboxWriteMainStateArrayUsingNoisyPredictor(offsetof(blackboxMainState_t, motor), motorCount, blackboxAdaptivePredictors.motor);
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_MOTOR, motorCount * sizeof(blackboxCurrent->motor[0]));
+
+    optionalRawBytes = 0;
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_TRICOPTER)) {
         blackboxWriteSignedVB(blackboxCurrent->servo[5] - blackboxLast->servo[5]);
+        optionalRawBytes += sizeof(blackboxCurrent->servo[5]);
     }
 
+    blackboxWriteSignedVB((int32_t) blackboxCurrent->rcLatency - blackboxLast->rcLatency);
+
+    blackboxAccountFieldGroup(BLACKBOX_FIELD_GROUP_OTHER, optionalRawBytes + sizeof(blackboxCurrent->rcLatency));
+
     //Rotate our history buffers
     blackboxHistory[2] = blackboxHistory[1];
     blackboxHistory[1] = blackboxHistory[0];
@@ -728,6 +968,102 @@ static void writeSlowFrame(void)
     blackboxSlowFrameIterationTimer = 0;
 }
 
+/**
+ * Write the given gyro sample as an "R" keyframe, or as an "r" frame predicted from blackboxGyroHistory.
+ */
+static void writeGyroFrame(const blackboxGyroSample_t *sample, bool keyframe)
+{
+    const blackboxGyroSample_t *prev1 = &blackboxGyroHistory[0];
+    const blackboxGyroSample_t *prev2 = &blackboxGyroHistory[1];
+    int x;
+
+    if (keyframe) {
+        blackboxWrite('R');
+
+        blackboxWriteUnsignedVB(sample->iteration);
+        blackboxWriteUnsignedVB(sample->time);
+        blackboxWriteSigned16VBArray((int16_t*) sample->gyroRaw, XYZ_AXIS_COUNT);
+        blackboxWriteSigned16VBArray((int16_t*) sample->gyroADC, XYZ_AXIS_COUNT);
+
+        // We have no other history, so the keyframe stands in for both previous samples
+        blackboxGyroHistory[1] = *sample;
+        blackboxGyroFrameIndex = 0;
+    } else {
+        blackboxWrite('r');
+
+        //No need to store iteration count since its delta is always 1
+        blackboxWriteSignedVB((int32_t) (sample->time - 2 * prev1->time + prev2->time));
+
+        for (x = 0; x < XYZ_AXIS_COUNT; x++) {
+            blackboxWriteSignedVB(sample->gyroRaw[x] - prev1->gyroRaw[x]);
+        }
+        for (x = 0; x < XYZ_AXIS_COUNT; x++) {
+            blackboxWriteSignedVB(sample->gyroADC[x] - (2 * prev1->gyroADC[x] - prev2->gyroADC[x]));
+        }
+
+        blackboxGyroHistory[1] = blackboxGyroHistory[0];
+    }
+
+    blackboxGyroHistory[0] = *sample;
+    blackboxGyroFrameIndex++;
+
+    blackboxLoggedAnyFrames = true;
+}
+
+/**
+ * Store this iteration's gyro in the ring. If the ring is full the sample is dropped, and the iteration gap makes the
+ * next frame written a keyframe.
+ */
+static void blackboxCaptureGyroSample(void)
+{
+    const uint8_t nextHead = (blackboxGyroRingHead + 1) & (BLACKBOX_GYRO_RING_SIZE - 1);
+
+    if (nextHead == blackboxGyroRingTail) {
+        return;
+    }
+
+    blackboxGyroSample_t *sample = &blackboxGyroRing[blackboxGyroRingHead];
+
+    sample->iteration = blackboxIteration;
+    sample->time = currentTime;
+
+    for (int i = 0; i < XYZ_AXIS_COUNT; i++) {
+        sample->gyroRaw[i] = gyroADCUnfiltered[i];
+        sample->gyroADC[i] = gyroADC[i];
+    }
+
+    blackboxGyroRingHead = nextHead;
+}
+
+/**
+ * Write as many of the buffered gyro samples as the device can take this iteration. This runs after the main frames
+ * have been committed, so the budget reflects the space they've already used up.
+ */
+static void blackboxLogGyroFrames(void)
+{
+    blackboxReplenishHeaderBudget();
+
+    blackboxBeginFrames();
+
+    while (blackboxGyroRingTail != blackboxGyroRingHead
+            && blackboxDeviceReserveBufferSpace(BLACKBOX_GYRO_FRAME_MAX_BYTES) == BLACKBOX_RESERVE_SUCCESS) {
+        const blackboxGyroSample_t *sample = &blackboxGyroRing[blackboxGyroRingTail];
+        const bool keyframe = blackboxGyroFrameIndex == 0 || blackboxGyroFrameIndex >= BLACKBOX_GYRO_I_INTERVAL
+            || sample->iteration != blackboxGyroHistory[0].iteration + 1;
+        const uint32_t bytesBefore = blackboxBytesWritten;
+
+        writeGyroFrame(sample, keyframe);
+
+        blackboxHeaderBudget -= blackboxBytesWritten - bytesBefore;
+
+        blackboxFieldGroupStats[BLACKBOX_FIELD_GROUP_GYRO_FRAMES].rawBytes += sizeof(*sample);
+        blackboxFieldGroupStats[BLACKBOX_FIELD_GROUP_GYRO_FRAMES].encodedBytes += blackboxBytesWritten - bytesBefore;
+        blackboxGyroRingTail = (blackboxGyroRingTail + 1) & (BLACKBOX_GYRO_RING_SIZE - 1);
+    }
+
+    blackboxCommitFrames();
+}
+
 /**
  * Load rarely-changing values from the FC into the given structure
  */
@@ -851,6 +1187,12 @@ void startBlackbox(void)
         blackboxPFrameIndex = 0;
         blackboxIFrameIndex = 0;
 
+        blackboxGyroRingHead = 0;
+        blackboxGyroRingTail = 0;
+        blackboxGyroFrameIndex = 0;
+
+        memset(blackboxFieldGroupStats, 0, sizeof(blackboxFieldGroupStats));
+
         /*
          * Record the beeper's current idea of the last arming beep time, so that we can detect it changing when
          * it finally plays the beep for this arming event.
@@ -979,6 +1321,7 @@ static void loadMainState(void)
 #endif
 
     blackboxCurrent->rssi = rssi;
+    blackboxCurrent->rcLatency = MIN(rcLatencyGetStats()->lastUs, 0xFFFF);
 
 #ifdef USE_SERVOS
     //Tail servo for tricopters
@@ -1086,7 +1429,13 @@ static bool sendFieldDefinition(char mainFrameChar, char deltaFrameChar, const v
                 }
             } else {
                 //The other headers are integers
-                blackboxPrintf("%d", def->arr[xmitState.headerIndex - 1]);
+                int value = def->arr[xmitState.headerIndex - 1];
+
+                if (value == PREDICTOR_NOISY) {
+                    value = blackboxNoisyFieldPredictor();
+                }
+
+                blackboxPrintf("%d", value);
             }
         }
     }
@@ -1164,6 +1513,77 @@ static bool blackboxWriteSysinfo()
                 blackboxPrintfHeaderLine("currentMeter:%d,%d", batteryConfig()->currentMeterOffset, batteryConfig()->currentMeterScale);
             }
         break;
+        /*
+         * Everything below describes the configuration the logged inputs were processed with, so that a log can be
+         * replayed through the IMU, PID controller and mixer offline and the outputs compared against the logged ones.
+         */
+        case 14:
+            blackboxPrintfHeaderLine("looptime:%u", targetLooptime);
+        break;
+        case 15:
+            blackboxPrintfHeaderLine("gyro_sync:%d,%d", imuConfig()->gyroSync, imuConfig()->gyroSyncDenominator);
+        break;
+        case 16:
+            blackboxPrintfHeaderLine("gyro_lpf:%d,%d", gyroConfig()->gyro_lpf, gyroConfig()->soft_gyro_lpf_hz);
+        break;
+        case 17:
+            blackboxPrintfHeaderLine("pidController:%d", pidProfile()->pidController);
+        break;
+        case 18:
+            blackboxPrintfHeaderLine("rollPID:%d,%d,%d", pidProfile()->P8[PIDROLL], pidProfile()->I8[PIDROLL], pidProfile()->D8[PIDROLL]);
+        break;
+        case 19:
+            blackboxPrintfHeaderLine("pitchPID:%d,%d,%d", pidProfile()->P8[PIDPITCH], pidProfile()->I8[PIDPITCH], pidProfile()->D8[PIDPITCH]);
+        break;
+        case 20:
+            blackboxPrintfHeaderLine("yawPID:%d,%d,%d", pidProfile()->P8[PIDYAW], pidProfile()->I8[PIDYAW], pidProfile()->D8[PIDYAW]);
+        break;
+        case 21:
+            blackboxPrintfHeaderLine("levelPID:%d,%d,%d", pidProfile()->P8[PIDLEVEL], pidProfile()->I8[PIDLEVEL], pidProfile()->D8[PIDLEVEL]);
+        break;
+        case 22:
+            blackboxPrintfHeaderLine("pidFilters:%d,%d,%d,%d", pidProfile()->dterm_lpf, pidProfile()->yaw_lpf,
+                pidProfile()->yaw_p_limit, pidProfile()->deltaMethod);
+        break;
+        case 23:
+            blackboxPrintfHeaderLine("rcExpo:%d,%d", controlRateProfiles(getCurrentProfile())->rcExpo8,
+                controlRateProfiles(getCurrentProfile())->rcYawExpo8);
+        break;
+        case 24:
+            blackboxPrintfHeaderLine("rates:%d,%d,%d", controlRateProfiles(getCurrentProfile())->rates[ROLL],
+                controlRateProfiles(getCurrentProfile())->rates[PITCH], controlRateProfiles(getCurrentProfile())->rates[YAW]);
+        break;
+        case 25:
+            blackboxPrintfHeaderLine("tpa:%d,%d", controlRateProfiles(getCurrentProfile())->dynThrPID,
+                controlRateProfiles(getCurrentProfile())->tpa_breakpoint);
+        break;
+        case 26:
+            blackboxPrintfHeaderLine("mixer:%d,%d,%d", mixerConfig()->mixerMode, mixerConfig()->pid_at_min_throttle,
+                mixerConfig()->yaw_motor_direction);
+        break;
+        case 27:
+            blackboxPrintfHeaderLine("dcm:%d,%d", imuConfig()->dcm_kp, imuConfig()->dcm_ki);
+        break;
+        case 28:
+            blackboxPrintfHeaderLine("thrCurve:%d,%d", controlRateProfiles(getCurrentProfile())->thrMid8,
+                controlRateProfiles(getCurrentProfile())->thrExpo8);
+        break;
+        case 29:
+            blackboxPrintfHeaderLine("rc:%d,%d,%d,%d,%d", rxConfig()->midrc, rxConfig()->mincheck,
+                rcControlsConfig()->deadband, rcControlsConfig()->yaw_deadband, rcControlsConfig()->yaw_control_direction);
+        break;
+        case 30:
+            blackboxPrintfHeaderLine("features:0x%x", featureMask());
+        break;
+        case 31:
+            blackboxPrintfHeaderLine("mincommand:%d", motorAndServoConfig()->mincommand);
+        break;
+        case 32:
+            blackboxPrintfHeaderLine("yaw_jump_prevention_limit:%d", mixerConfig()->yaw_jump_prevention_limit);
+        break;
+        case 33:
+            blackboxPrintfHeaderLine("angle:%d,%d", imuConfig()->max_angle_inclination, imuConfig()->small_angle);
+        break;
         default:
             return true;
     }
@@ -1263,6 +1683,13 @@ static void blackboxAdvanceIterationTimers()
 // Called once every FC loop in order to log the current state
 static void blackboxLogIteration()
 {
+    if (blackboxConfig()->gyro_logging) {
+        blackboxCaptureGyroSample();
+    }
+
+    // All frames of this iteration are encoded in RAM and go to the device in one write
+    blackboxBeginFrames();
+
     // Write a keyframe every BLACKBOX_I_INTERVAL frames so we can resynchronise upon missing frames
     if (blackboxShouldLogIFrame()) {
         /*
@@ -1309,6 +1736,12 @@ static void blackboxLogIteration()
 #endif
     }
 
+    blackboxCommitFrames();
+
+    if (blackboxConfig()->gyro_logging) {
+        blackboxLogGyroFrames();
+    }
+
     //Flush every iteration so that our runtime variance is minimized
     blackboxDeviceFlush();
 }
@@ -1382,6 +1815,17 @@ void handleBlackbox(void)
             //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
             if (!sendFieldDefinition('S', 0, blackboxSlowFields, blackboxSlowFields + 1, ARRAY_LENGTH(blackboxSlowFields),
                     NULL, NULL)) {
+                if (blackboxConfig()->gyro_logging) {
+                    blackboxSetState(BLACKBOX_STATE_SEND_GYRO_HEADER);
+                } else {
+                    blackboxSetState(BLACKBOX_STATE_SEND_SYSINFO);
+                }
+            }
+        break;
+        case BLACKBOX_STATE_SEND_GYRO_HEADER:
+            //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
+            if (!sendFieldDefinition('R', 'r', blackboxGyroFields, blackboxGyroFields + 1, ARRAY_LENGTH(blackboxGyroFields),
+                    &blackboxGyroFields[0].condition, &blackboxGyroFields[1].condition)) {
                 blackboxSetState(BLACKBOX_STATE_SEND_SYSINFO);
             }
         break;
@@ -19,12 +19,39 @@
 
 #include "blackbox/blackbox_fielddefs.h"
 
+typedef enum {
+    BLACKBOX_PREDICTOR_AVERAGE = 0,
+    BLACKBOX_PREDICTOR_LINEAR,
+    BLACKBOX_PREDICTOR_ADAPTIVE
+} blackboxPredictor_e;
+
 typedef struct blackboxConfig_s {
     uint8_t rate_num;
     uint8_t rate_denom;
     uint8_t device;
+    uint8_t gyro_logging;       // log raw and filtered gyro at the full loop rate in their own frames
+    uint8_t predictor;          // P-frame predictor for gyro, acc and motors, see blackboxPredictor_e
 } blackboxConfig_t;
 
+// Groups of main frame fields, so the space each takes up in the log can be tracked separately
+typedef enum {
+    BLACKBOX_FIELD_GROUP_FRAME = 0,     // frame type, iteration and time
+    BLACKBOX_FIELD_GROUP_PID,
+    BLACKBOX_FIELD_GROUP_RC,
+    BLACKBOX_FIELD_GROUP_SENSORS,       // vbat, amperage, mag, baro, sonar and rssi
+    BLACKBOX_FIELD_GROUP_GYRO,
+    BLACKBOX_FIELD_GROUP_ACC,
+    BLACKBOX_FIELD_GROUP_MOTOR,
+    BLACKBOX_FIELD_GROUP_OTHER,         // tail servo and rc latency
+    BLACKBOX_FIELD_GROUP_GYRO_FRAMES,   // the full-rate gyro frames
+    BLACKBOX_FIELD_GROUP_COUNT
+} blackboxFieldGroup_e;
+
+typedef struct blackboxFieldGroupStats_s {
+    uint32_t rawBytes;                  // in-memory size of the values logged
+    uint32_t encodedBytes;              // what they took up in the log
+} blackboxFieldGroupStats_t;
+
 PG_DECLARE(blackboxConfig_t, blackboxConfig);
 
 void blackboxLogEvent(FlightLogEvent event, flightLogEventData_t *data);
@@ -35,3 +62,5 @@ void startBlackbox(void);
 void finishBlackbox(void);
 
 bool blackboxMayEditConfig();
+
+const blackboxFieldGroupStats_t *blackboxGetFieldGroupStats(void);
@@ -82,7 +82,15 @@ typedef enum FlightLogFieldPredictor {
     FLIGHT_LOG_FIELD_PREDICTOR_VBATREF        = 9,
 
     //Predict the last time value written in the main stream
-    FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME = 10
+    FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME = 10,
+
+    /*
+     * Per field, predict with whichever of AVERAGE_2, STRAIGHT_LINE and PREVIOUS has the lowest cost (the earlier one
+     * in that list on a tie). After each value every candidate's cost becomes cost - (cost >> 4) + min(|error|, 4095),
+     * where error is what that candidate would have mispredicted by. Costs start at zero on every I frame, so a
+     * decoder can repeat the selection from the values it has already decoded.
+     */
+    FLIGHT_LOG_FIELD_PREDICTOR_ADAPTIVE       = 11
 
 } FlightLogFieldPredictor;
 
@@ -59,6 +59,9 @@ static uint8_t blackboxMaxHeaderBytesPerIteration;
 // How many bytes can we write *this* iteration without overflowing transmit buffers or overstressing the OpenLog?
 int32_t blackboxHeaderBudget;
 
+// Running count of every byte handed to blackboxWrite*(), used to measure how large an encoded frame was
+uint32_t blackboxBytesWritten;
+
 static serialPort_t *blackboxPort = NULL;
 static portSharing_e blackboxPortSharing;
 
@@ -82,8 +85,97 @@ static struct {
 
 #endif
 
+/*
+ * Frames are encoded into this buffer between blackboxBeginFrames() and blackboxCommitFrames() and handed to the
+ * device in a single call, instead of dispatching every byte to the device separately. It only has to hold one
+ * logging iteration, if that overflows the buffer is committed early and encoding carries on.
+ */
+#define BLACKBOX_STAGING_BUFFER_SIZE 256
+
+static uint8_t blackboxStagingBuffer[BLACKBOX_STAGING_BUFFER_SIZE];
+static int blackboxStagingLength = 0;
+static bool blackboxStagingActive = false;
+
+static void blackboxDeviceWrite(const uint8_t *data, int length)
+{
+    switch (blackboxConfig()->device) {
+#ifdef USE_FLASHFS
+        case BLACKBOX_DEVICE_FLASH:
+            flashfsWrite(data, length, false); // Write asynchronously
+        break;
+#endif
+#ifdef USE_SDCARD
+        case BLACKBOX_DEVICE_SDCARD:
+            afatfs_fwrite(blackboxSDCard.logFile, data, length); // Ignore failures due to buffers filling up
+        break;
+#endif
+        case BLACKBOX_DEVICE_SERIAL:
+        default:
+            serialWriteBuf(blackboxPort, (uint8_t*) data, length);
+        break;
+    }
+}
+
+static void blackboxFlushStaging(void)
+{
+    if (blackboxStagingLength > 0) {
+        blackboxDeviceWrite(blackboxStagingBuffer, blackboxStagingLength);
+        blackboxStagingLength = 0;
+    }
+}
+
+/**
+ * Start collecting written bytes in the staging buffer rather than sending them to the device.
+ */
+void blackboxBeginFrames(void)
+{
+    blackboxStagingActive = true;
+}
+
+/**
+ * Hand everything written since blackboxBeginFrames() to the device and go back to writing directly.
+ */
+void blackboxCommitFrames(void)
+{
+    blackboxFlushStaging();
+    blackboxStagingActive = false;
+}
+
+static void blackboxWriteBuf(const uint8_t *data, int length)
+{
+    blackboxBytesWritten += length;
+
+    if (!blackboxStagingActive) {
+        blackboxDeviceWrite(data, length);
+        return;
+    }
+
+    while (length > 0) {
+        if (blackboxStagingLength == BLACKBOX_STAGING_BUFFER_SIZE) {
+            blackboxFlushStaging();
+        }
+
+        const int chunk = MIN(length, BLACKBOX_STAGING_BUFFER_SIZE - blackboxStagingLength);
+
+        memcpy(blackboxStagingBuffer + blackboxStagingLength, data, chunk);
+        blackboxStagingLength += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
 void blackboxWrite(uint8_t value)
 {
+    blackboxBytesWritten++;
+
+    if (blackboxStagingActive) {
+        if (blackboxStagingLength == BLACKBOX_STAGING_BUFFER_SIZE) {
+            blackboxFlushStaging();
+        }
+        blackboxStagingBuffer[blackboxStagingLength++] = value;
+        return;
+    }
+
     switch (blackboxConfig()->device) {
 #ifdef USE_FLASHFS
         case BLACKBOX_DEVICE_FLASH:
@@ -153,36 +245,9 @@ void blackboxPrintfHeaderLine(const char *fmt, ...)
 // Print the null-terminated string 's' to the blackbox device and return the number of bytes written
 int blackboxPrint(const char *s)
 {
-    int length;
-    const uint8_t *pos;
-
-    switch (blackboxConfig()->device) {
-
-#ifdef USE_FLASHFS
-        case BLACKBOX_DEVICE_FLASH:
-            length = strlen(s);
-            flashfsWrite((const uint8_t*) s, length, false); // Write asynchronously
-        break;
-#endif
-
-#ifdef USE_SDCARD
-        case BLACKBOX_DEVICE_SDCARD:
-            length = strlen(s);
-            afatfs_fwrite(blackboxSDCard.logFile, (const uint8_t*) s, length); // Ignore failures due to buffers filling up
-        break;
-#endif
-
-        case BLACKBOX_DEVICE_SERIAL:
-        default:
-            pos = (uint8_t*) s;
-            while (*pos) {
-                serialWrite(blackboxPort, *pos);
-                pos++;
-            }
+    const int length = strlen(s);
 
-            length = pos - (uint8_t*) s;
-        break;
-    }
+    blackboxWriteBuf((const uint8_t*) s, length);
 
     return length;
 }
@@ -507,7 +572,7 @@ void blackboxDeviceFlush(void)
          * devices will progressively write in the background without Blackbox calling anything.
          */
         case BLACKBOX_DEVICE_FLASH:
-            flashfsFlushAsync();
+            flashfsFlushPagesAsync();
         break;
 #endif
 
@@ -599,6 +664,8 @@ bool blackboxDeviceOpen(void)
                 return false;
             }
 
+            flashfsResetStats();
+
             blackboxMaxHeaderBytesPerIteration = BLACKBOX_TARGET_HEADER_BUDGET_PER_ITERATION;
 
             return true;
@@ -782,6 +849,11 @@ static bool blackboxSDCardBeginLog()
 bool blackboxDeviceBeginLog(void)
 {
     switch (blackboxConfig()->device) {
+#ifdef USE_FLASHFS
+        case BLACKBOX_DEVICE_FLASH:
+            flashfsLogBegin();
+            return true;
+#endif
 #ifdef USE_SDCARD
         case BLACKBOX_DEVICE_SDCARD:
             return blackboxSDCardBeginLog();
@@ -806,6 +878,12 @@ bool blackboxDeviceEndLog(bool retainLog)
 #endif
 
     switch (blackboxConfig()->device) {
+#ifdef USE_FLASHFS
+        case BLACKBOX_DEVICE_FLASH:
+            // Flash can't discard the log, but it still needs a directory entry
+            flashfsLogEnd();
+            return true;
+#endif
 #ifdef USE_SDCARD
         case BLACKBOX_DEVICE_SDCARD:
             // Keep retrying until the close operation queues
@@ -49,9 +49,13 @@ typedef enum {
 #define BLACKBOX_TARGET_HEADER_BUDGET_PER_ITERATION 64
 
 extern int32_t blackboxHeaderBudget;
+extern uint32_t blackboxBytesWritten;
 
 void blackboxWrite(uint8_t value);
 
+void blackboxBeginFrames(void);
+void blackboxCommitFrames(void);
+
 int blackboxPrintf(const char *fmt, ...);
 void blackboxPrintfHeaderLine(const char *fmt, ...);
 int blackboxPrint(const char *s);
@@ -0,0 +1,145 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/lz4.h"
+
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5   // The last 5 bytes of a block are always literals
+#define LZ4_MATCH_LIMIT     12  // and the last match must start at least 12 bytes before the end
+#define LZ4_MAX_OFFSET      0xFFFF
+#define LZ4_RUN_MASK        15
+
+static uint32_t lz4Read32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+
+    return value;
+}
+
+static unsigned lz4Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+// Write the continuation bytes of a literal or match length which didn't fit in the token
+static uint8_t *lz4WriteLength(uint8_t *op, int length)
+{
+    for (length -= LZ4_RUN_MASK; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = length;
+
+    return op;
+}
+
+static int lz4SequenceBytes(int literalLength)
+{
+    return 1 + (literalLength >= LZ4_RUN_MASK ? (literalLength - LZ4_RUN_MASK) / 255 + 1 : 0) + literalLength;
+}
+
+/**
+ * Compress srcLength bytes from src into dst.
+ *
+ * Returns the compressed length, or 0 if it wouldn't fit in dstCapacity (send the block uncompressed instead).
+ */
+int lz4CompressBlock(const uint8_t *src, int srcLength, uint8_t *dst, int dstCapacity, uint16_t *hashTable)
+{
+    uint8_t *op = dst;
+    const uint8_t *opEnd = dst + dstCapacity;
+    const int matchLimit = srcLength - LZ4_MATCH_LIMIT;
+    const int matchEndLimit = srcLength - LZ4_LAST_LITERALS;
+    int anchor = 0;
+    int i = 0;
+
+    memset(hashTable, 0, LZ4_HASH_TABLE_SIZE * sizeof(*hashTable));
+
+    while (i <= matchLimit) {
+        const uint32_t sequence = lz4Read32(src + i);
+        const unsigned hash = lz4Hash(sequence);
+        const int candidate = hashTable[hash];
+
+        hashTable[hash] = i;
+
+        if (candidate >= i || i - candidate > LZ4_MAX_OFFSET || lz4Read32(src + candidate) != sequence) {
+            i++;
+            continue;
+        }
+
+        int matchLength = LZ4_MIN_MATCH;
+
+        while (i + matchLength < matchEndLimit && src[candidate + matchLength] == src[i + matchLength]) {
+            matchLength++;
+        }
+
+        const int literalLength = i - anchor;
+        const int matchExtra = matchLength - LZ4_MIN_MATCH;
+
+        // Token, literals, offset and the worst case for the match length bytes
+        if (op + lz4SequenceBytes(literalLength) + 2 + matchExtra / 255 + 1 > opEnd) {
+            return 0;
+        }
+
+        uint8_t *token = op++;
+
+        if (literalLength >= LZ4_RUN_MASK) {
+            *token = LZ4_RUN_MASK << 4;
+            op = lz4WriteLength(op, literalLength);
+        } else {
+            *token = literalLength << 4;
+        }
+
+        memcpy(op, src + anchor, literalLength);
+        op += literalLength;
+
+        *op++ = (i - candidate) & 0xFF;
+        *op++ = (i - candidate) >> 8;
+
+        if (matchExtra >= LZ4_RUN_MASK) {
+            *token |= LZ4_RUN_MASK;
+            op = lz4WriteLength(op, matchExtra);
+        } else {
+            *token |= matchExtra;
+        }
+
+        i += matchLength;
+        anchor = i;
+    }
+
+    // The rest of the block is literals
+    const int literalLength = srcLength - anchor;
+
+    if (op + lz4SequenceBytes(literalLength) > opEnd) {
+        return 0;
+    }
+
+    if (literalLength >= LZ4_RUN_MASK) {
+        *op++ = LZ4_RUN_MASK << 4;
+        op = lz4WriteLength(op, literalLength);
+    } else {
+        *op++ = literalLength << 4;
+    }
+
+    memcpy(op, src + anchor, literalLength);
+    op += literalLength;
+
+    return op - dst;
+}
@@ -0,0 +1,29 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Compressor for the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), so that any
+ * stock LZ4 decoder can unpack the output. It is a small, greedy encoder intended for blocks of a few hundred bytes.
+ */
+
+#define LZ4_HASH_LOG 8
+#define LZ4_HASH_TABLE_SIZE (1 << LZ4_HASH_LOG)
+
+// Blocks must be shorter than 64kB. The caller provides the hash table so the compressor needs no static RAM.
+int lz4CompressBlock(const uint8_t *src, int srcLength, uint8_t *dst, int dstCapacity, uint16_t *hashTable);
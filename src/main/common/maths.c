@@ -288,3 +288,63 @@ void arraySubInt32(int32_t *dest, int32_t *array1, int32_t *array2, int count)
         dest[i] = array1[i] - array2[i];
     }
 }
+
+// Barometric altitude in cm, 4433000 * (1 - (pressure / referencePressure) ^ 0.190295), without powf().
+// Pressure ratios 0.25..1.25 (about 11 km above to 1.8 km below the reference) are split into
+// 32 segments, each a cubic expanded around the segment centre. Against the double precision
+// formula the error stays below 2 cm over the whole table and below 0.3 cm for ratios above 0.5,
+// which is under the float resolution of powf() near ratio 1. Ratios outside the table fall back to powf().
+#define BARO_ALTITUDE_RATIO_MIN     0.25f
+#define BARO_ALTITUDE_RATIO_MAX     1.25f
+#define BARO_ALTITUDE_SEGMENTS      32
+#define BARO_ALTITUDE_SEGMENT_WIDTH ((BARO_ALTITUDE_RATIO_MAX - BARO_ALTITUDE_RATIO_MIN) / BARO_ALTITUDE_SEGMENTS)
+
+// 1 - r^0.190295 = c0 + c1 t + c2 t^2 + c3 t^3, t = r - segment centre
+static const float baroAltitudeSegments[BARO_ALTITUDE_SEGMENTS][4] = {
+    { 2.229637866e-01f, -5.566723999e-01f, 8.484525658e-01f, -1.926837773e+00f },
+    { 2.063419998e-01f, -5.087297655e-01f, 6.937617428e-01f, -1.409688808e+00f },
+    { 1.910816217e-01f, -4.691295171e-01f, 5.788289762e-01f, -1.064136830e+00f },
+    { 1.769561381e-01f, -4.358153230e-01f, 4.909660468e-01f, -8.241193829e-01f },
+    { 1.637926591e-01f, -4.073627544e-01f, 4.221998836e-01f, -6.519955117e-01f },
+    { 1.514560344e-01f, -3.827524123e-01f, 3.673084942e-01f, -5.252108789e-01f },
+    { 1.398384826e-01f, -3.612346173e-01f, 3.227514216e-01f, -4.296716222e-01f },
+    { 1.288525787e-01f, -3.422451583e-01f, 2.860568938e-01f, -3.562519336e-01f },
+    { 1.184263677e-01f, -3.253508933e-01f, 2.554552679e-01f, -2.988597499e-01f },
+    { 1.084998710e-01f, -3.102135169e-01f, 2.296515983e-01f, -2.533190984e-01f },
+    { 9.902253444e-02f, -2.965647685e-01f, 2.076799792e-01f, -2.167002503e-01f },
+    { 8.995132592e-02f, -2.841890666e-01f, 1.888076374e-01f, -1.869052311e-01f },
+    { 8.124929390e-02f, -2.729110878e-01f, 1.724702223e-01f, -1.624040188e-01f },
+    { 7.288445793e-02f, -2.625867194e-01f, 1.582271848e-01f, -1.420624012e-01f },
+    { 6.482894309e-02f, -2.530963574e-01f, 1.457304079e-01f, -1.250271041e-01f },
+    { 5.705829647e-02f, -2.443398692e-01f, 1.347017626e-01f, -1.106475816e-01f },
+    { 4.955094131e-02f, -2.362327558e-01f, 1.249167958e-01f, -9.842179041e-02f },
+    { 4.228773668e-02f, -2.287031908e-01f, 1.161927009e-01f, -8.795796573e-02f },
+    { 3.525161894e-02f, -2.216897125e-01f, 1.083793320e-01f, -7.894726805e-02f },
+    { 2.842730742e-02f, -2.151394043e-01f, 1.013524080e-01f, -7.114393584e-02f },
+    { 2.180106082e-02f, -2.090064473e-01f, 9.500831743e-02f, -6.435070020e-02f },
+    { 1.536047421e-02f, -2.032509598e-01f, 8.926010489e-02f, -5.840793966e-02f },
+    { 9.094308698e-03f, -1.978380575e-01f, 8.403434194e-02f, -5.318552788e-02f },
+    { 2.992347566e-03f, -1.927370882e-01f, 7.926866490e-02f, -4.857664312e-02f },
+    { -2.954725799e-03f, -1.879210039e-01f, 7.490982224e-02f, -4.449302313e-02f },
+    { -8.755432191e-03f, -1.833658412e-01f, 7.091211387e-02f, -4.086129577e-02f },
+    { -1.441758604e-02f, -1.790502906e-01f, 6.723613474e-02f, -3.762011802e-02f },
+    { -1.994837254e-02f, -1.749553357e-01f, 6.384775666e-02f, -3.471792811e-02f },
+    { -2.535441443e-02f, -1.710639503e-01f, 6.071729791e-02f, -3.211116643e-02f },
+    { -3.064183013e-02f, -1.673608423e-01f, 5.781884195e-02f, -2.976285792e-02f },
+    { -3.581628435e-02f, -1.638322367e-01f, 5.512967533e-02f, -2.764147507e-02f },
+    { -4.088303263e-02f, -1.604656905e-01f, 5.262982154e-02f, -2.572002057e-02f },
+};
+
+float pressureToAltitude(const float pressure, const float referencePressure)
+{
+    const float ratio = pressure / referencePressure;
+    if (!(ratio >= BARO_ALTITUDE_RATIO_MIN && ratio < BARO_ALTITUDE_RATIO_MAX)) {
+        return (1.0f - powf(ratio, 0.190295f)) * 4433000.0f;
+    }
+
+    const int segment = (int)((ratio - BARO_ALTITUDE_RATIO_MIN) * (1.0f / BARO_ALTITUDE_SEGMENT_WIDTH));
+    const float t = ratio - (BARO_ALTITUDE_RATIO_MIN + (segment + 0.5f) * BARO_ALTITUDE_SEGMENT_WIDTH);
+    const float *c = baroAltitudeSegments[segment];
+
+    return (((c[3] * t + c[2]) * t + c[1]) * t + c[0]) * 4433000.0f;
+}
@@ -103,3 +103,5 @@ float acos_approx(float x);
 #endif
 
 void arraySubInt32(int32_t *dest, int32_t *array1, int32_t *array2, int count);
+
+float pressureToAltitude(const float pressure, const float referencePressure);
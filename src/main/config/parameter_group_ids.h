@@ -62,9 +62,11 @@
 #define PG_CHANNEL_RANGE_CONFIG 44
 #define PG_MODE_COLOR_CONFIG 45
 #define PG_SPECIAL_COLOR_CONFIG 46
+#define PG_ALTITUDE_ESTIMATOR_CONFIG 47
 
 // Driver configuration
 #define PG_DRIVER_PWM_RX_CONFIG 100
+#define PG_MINIFLOW_CONFIG 101
 
 // OSD configuration (subject to change)
 #define PG_OSD_FONT_CONFIG 32768
@@ -0,0 +1,129 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <platform.h>
+
+#ifdef NRF
+
+#include "drivers/bus_i2c.h"
+#include "drivers/system.h"
+#include "drivers/nrf2401.h"
+#include "drivers/coprocessor_328p.h"
+
+typedef struct coprocessorFrame_s {
+    package_328p package;
+    uint8_t sequence;           // 0 = no frame
+    uint32_t receivedAt;
+} coprocessorFrame_t;
+
+// written by taskCoprocessor(), RX processing only copies the front buffer
+static coprocessorFrame_t coprocessorFrames[2];
+static volatile uint8_t coprocessorFrontIndex = 0;
+static uint8_t coprocessorSequence = 0;
+static uint8_t coprocessorConsumedSequence = 0;
+static coprocessorStats_t coprocessorStats;
+
+uint8_t coprocessorChecksum(const uint8_t *frame)
+{
+    uint8_t checksum = COPROCESSOR_CHECKSUM_SEED;
+
+    for (int i = 0; i < COPROCESSOR_FRAME_SIZE - 1; i++) {
+        checksum ^= frame[i];
+    }
+    return checksum;
+}
+
+bool coprocessorDecodeFrame(const uint8_t *frame, package_328p *dst)
+{
+    if (frame[1] > sizeof(dst->data) || coprocessorChecksum(frame) != frame[COPROCESSOR_FRAME_SIZE - 1]) {
+        return false;
+    }
+
+    dst->cmd = frame[0];
+    dst->length = frame[1];
+    memset(dst->data, 0, sizeof(dst->data));
+    memcpy(dst->data, &frame[2], dst->length);
+    return true;
+}
+
+/*
+ * Hands each frame over once, returns true when dst holds a frame that wasn't returned before. Between frames dst
+ * keeps the last one, so state like MOTOR_P stays in effect, until it is older than COPROCESSOR_FRAME_TIMEOUT_US
+ * and dst falls back to COPROCESSOR_CMD_NONE.
+ */
+bool coprocessorGetFrame(package_328p *dst)
+{
+    const coprocessorFrame_t *frame = &coprocessorFrames[coprocessorFrontIndex];
+
+    if (frame->sequence == 0 || micros() - frame->receivedAt >= COPROCESSOR_FRAME_TIMEOUT_US) {
+        dst->cmd = COPROCESSOR_CMD_NONE;
+        dst->length = 0;
+        return false;
+    }
+    if (frame->sequence == coprocessorConsumedSequence) {
+        return false;
+    }
+
+    coprocessorConsumedSequence = frame->sequence;
+    *dst = frame->package;
+    return true;
+}
+
+const coprocessorStats_t *coprocessorGetStats(void)
+{
+    return &coprocessorStats;
+}
+
+void taskCoprocessor(void)
+{
+    uint8_t frame[COPROCESSOR_FRAME_SIZE];
+
+    if (!(mspData.mspCmd & OFFLINE)) {
+        coprocessorFrames[coprocessorFrontIndex].sequence = 0;
+        return;
+    }
+
+    if (!i2cRead(COPROCESSOR_I2C_ADDRESS, COPROCESSOR_REG_FRAME, COPROCESSOR_FRAME_SIZE, frame)) {
+        coprocessorStats.i2cErrors++;
+        return;
+    }
+
+    const uint8_t backIndex = coprocessorFrontIndex ^ 1;
+    coprocessorFrame_t *back = &coprocessorFrames[backIndex];
+    if (!coprocessorDecodeFrame(frame, &back->package)) {
+        coprocessorStats.corrupt++;
+        return;
+    }
+    if (++coprocessorSequence == 0) {
+        coprocessorSequence = 1;
+    }
+    back->sequence = coprocessorSequence;
+    back->receivedAt = micros();
+    coprocessorFrontIndex = backIndex;
+    coprocessorStats.frames++;
+
+    // the co-processor is idle, hand it the key pressed on the controller
+    if (back->package.cmd == COPROCESSOR_CMD_NONE && t_mspData.key != 0) {
+        i2cWrite(COPROCESSOR_I2C_ADDRESS, COPROCESSOR_REG_KEY, t_mspData.key);
+    }
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Block read from the ATmega328p co-processor in offline mode, a single I2C transaction of
+ * COPROCESSOR_FRAME_SIZE bytes from register COPROCESSOR_REG_FRAME:
+ *
+ *   0      cmd (enum _CMD), 255 when the co-processor has nothing to send
+ *   1      length of the valid data bytes, 0-4
+ *   2-5    data
+ *   6      checksum, XOR of bytes 0-5 seeded with COPROCESSOR_CHECKSUM_SEED
+ */
+
+#define COPROCESSOR_I2C_ADDRESS     0x08
+#define COPROCESSOR_REG_FRAME       0xff
+#define COPROCESSOR_REG_KEY         0x00
+#define COPROCESSOR_FRAME_SIZE      7
+#define COPROCESSOR_CHECKSUM_SEED   0x5A
+#define COPROCESSOR_CMD_NONE        255
+
+// A frame not followed by a newer one within this time no longer counts, the 328p is polled at 60Hz
+#define COPROCESSOR_FRAME_TIMEOUT_US 100000
+
+typedef struct coprocessorStats_s {
+    uint32_t frames;
+    uint32_t corrupt;       // bad length or checksum
+    uint32_t i2cErrors;
+} coprocessorStats_t;
+
+uint8_t coprocessorChecksum(const uint8_t *frame);
+bool coprocessorDecodeFrame(const uint8_t *frame, package_328p *dst);
+bool coprocessorGetFrame(package_328p *dst);
+const coprocessorStats_t *coprocessorGetStats(void);
+void taskCoprocessor(void);
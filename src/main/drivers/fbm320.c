@@ -11,6 +11,7 @@
 #include "common/maths.h"
 #include "build/debug.h"
 #include "fc/fc_tasks.h"
+#include "scheduler/scheduler.h"
 #include "drivers/fbm320.h"
 
 struct Sensor FB;
@@ -63,14 +64,15 @@ bool fbm320_init(void)
 	if(whoami == 0x42) {
 		read_offset();
 		start_temperature();				 
-		delay(3);																					
+		delay(FBM320_TEMPERATURE_CONVERSION_US / 1000 + 1);
 		FB.UT = Read_data();
 		start_pressure();					 
-		delay(10);																				
+		delay(FBM320_PRESSURE_CONVERSION_US / 1000 + 1);
 		FB.UP = Read_data();															
 		calculate_real_pressure(FB.UP, FB.UT);
 		FB.Reff_P = FB.RP;
 		FB.calibrate_finished = true;
+		start_temperature();//taskFbm320() picks the result up on its first run
 		return true;
 	}
 	else {
@@ -80,56 +82,79 @@ bool fbm320_init(void)
 }
 
 #define SCALE 0.5
+
+//pressure samples come every FBM320_PRESSURE_SAMPLE_US on average, one slot in FBM320_PRESSURE_PER_TEMPERATURE + 1 reads temperature
+#define FBM320_PRESSURE_SAMPLE_US	((FBM320_PRESSURE_PER_TEMPERATURE * (FBM320_PRESSURE_CONVERSION_US + FBM320_CONVERSION_MARGIN_US) \
+									+ FBM320_TEMPERATURE_CONVERSION_US + FBM320_CONVERSION_MARGIN_US) / FBM320_PRESSURE_PER_TEMPERATURE)
+//FB.Altitude lags the newest conversion by the group delay of the filters, in pressure samples: median of 3 (1),
+//mean of SAMPLE_COUNT_MAX - 1 ((SAMPLE_COUNT_MAX - 2) / 2) and the SCALE low pass ((1 - SCALE) / SCALE),
+//plus the read coming half a conversion after the middle of it
+#define FBM320_FILTER_DELAY_US		((uint32_t)((1 + (SAMPLE_COUNT_MAX - 2) / 2.0 + (1 - SCALE) / SCALE) * FBM320_PRESSURE_SAMPLE_US) \
+									+ FBM320_PRESSURE_CONVERSION_US / 2 + FBM320_CONVERSION_MARGIN_US)
+
 static uint32_t baroPressureSum;
+static bool temperaturePending = false;
+
+//every run collects the conversion started by the previous run and starts the next one,
+//the task period follows the conversion time of what is in progress
 void taskFbm320(void)
 {
 	static float alt;
-	static char state = 0;
-	switch(state) {
-		case 0:	FB.UP = Read_data();
-				start_temperature();
-				state = 1;
-				break;
-		case 1: FB.UT = Read_data();
-				start_pressure();
-				calculate_real_pressure(FB.UP, FB.UT);
-				baroPressureSum = recalculateBarometerTotal(SAMPLE_COUNT_MAX, baroPressureSum, FB.RP);
-				alt = Rel_Altitude(baroPressureSum/(SAMPLE_COUNT_MAX-1),FB.Reff_P) * 100;//unit:cm
-				FB.Altitude = SCALE*alt + (1-SCALE)*FB.Altitude;
-				//debug[0] = FB.Altitude;
-				state = 0;
-				break;
-		default:break;
+	static uint8_t pressureSamples = 0;
+
+	if(temperaturePending) {
+		FB.UT = Read_data();
+	}
+	else {
+		FB.UP = Read_data();
+		calculate_real_pressure(FB.UP, FB.UT);
+		baroPressureSum = recalculateBarometerTotal(SAMPLE_COUNT_MAX, baroPressureSum, FB.RP);
+		alt = Rel_Altitude(baroPressureSum/(SAMPLE_COUNT_MAX-1),FB.Reff_P) * 100;//unit:cm
+		FB.Altitude = SCALE*alt + (1-SCALE)*FB.Altitude;
+		FB.sampledAt = micros() - FBM320_FILTER_DELAY_US;//when the filtered altitude was current, the altitude estimator projects it forward from there
+		//debug[0] = FB.Altitude;
+		pressureSamples++;
+	}
+
+	//temperature drifts slowly, most slots go to pressure
+	if(pressureSamples >= FBM320_PRESSURE_PER_TEMPERATURE) {
+		pressureSamples = 0;
+		start_temperature();
+		rescheduleTask(TASK_SELF, FBM320_TEMPERATURE_CONVERSION_US + FBM320_CONVERSION_MARGIN_US);
+	}
+	else {
+		start_pressure();
+		rescheduleTask(TASK_SELF, FBM320_PRESSURE_CONVERSION_US + FBM320_CONVERSION_MARGIN_US);
 	}
 }
 
 void start_temperature(void)
 {
-	i2cWrite(FMTISensorAdd_I2C,0xf4, 0x2e);
+	i2cWrite(FMTISensorAdd_I2C,FBM320_REG_CONFIG,FBM320_CMD_TEMPERATURE);
+	temperaturePending = true;
 }
 void start_pressure(void)
 {
-	i2cWrite(FMTISensorAdd_I2C,0xf4, 0xf4);
+	i2cWrite(FMTISensorAdd_I2C,FBM320_REG_CONFIG,FBM320_CMD_PRESSURE);
+	temperaturePending = false;
 }
 
+//24 bit result, MSB/CSB/LSB in one burst
 uint32_t Read_data(void)
 {
 	uint8_t buf[3];
-	i2cRead(FMTISensorAdd_I2C,0xf6,1,&buf[0]);
-	i2cRead(FMTISensorAdd_I2C,0xf7,1,&buf[1]);
-	i2cRead(FMTISensorAdd_I2C,0xf7,1,&buf[2]);
+	i2cRead(FMTISensorAdd_I2C,FBM320_REG_DATA_MSB,3,buf);
 	return ((uint32_t)buf[0] << 16) | ((uint16_t)buf[1] << 8) | buf[2];
 }
 
 //sensor offset R0~R9 and calibrate coefficient C0~C12
 void read_offset(void)										
 {
-	uint8_t buf[2];
+	uint8_t buf[18];
 	uint16_t R[10]={0};
+	i2cRead(FMTISensorAdd_I2C,0xaa,18,buf);//R0~R8 are contiguous from 0xaa
 	for(uint8_t i = 0;i < 9;i++) {
-		i2cRead(FMTISensorAdd_I2C,(0xaa+i*2),1,&buf[0]);
-		i2cRead(FMTISensorAdd_I2C,(0xab+i*2),1,&buf[1]);
-		R[i] = ((uint8_t) buf[0] << 8) | buf[1];
+		R[i] = ((uint8_t) buf[i*2] << 8) | buf[i*2+1];
 	}
 	i2cRead(FMTISensorAdd_I2C,0xa4,1,&buf[0]);
 	i2cRead(FMTISensorAdd_I2C,0xf1,1,&buf[1]);
@@ -189,7 +214,7 @@ void calculate_real_pressure(int32_t UP, int32_t UT)
 //Calculate relative altitude unit :m
 float Rel_Altitude(int32_t Press, int32_t Ref_P)										
 {
-	return 44330 * (1 - pow(((float)Press / (float)Ref_P), (1/5.255)));
+	return pressureToAltitude(Press, Ref_P) * 0.01f;
 }
 
 //Calculate absolute altitude unit:mm
@@ -12,6 +12,27 @@
 #define FMTISensorAdd_SPI	0x0
 #define FMTISensorAdd_I2C	0x6C | SDO_Addr
 
+#define FBM320_REG_CONFIG		0xf4
+#define FBM320_REG_DATA_MSB		0xf6	//0xf6~0xf8, 24 bit
+
+#define FBM320_CMD_TEMPERATURE	0x2e
+#define FBM320_CMD_OSR_1024		0x34
+#define FBM320_CMD_OSR_2048		0x74
+#define FBM320_CMD_OSR_4096		0xb4
+#define FBM320_CMD_OSR_8192		0xf4
+#define FBM320_CMD_PRESSURE		FBM320_CMD_OSR_8192
+
+//datasheet conversion times, us
+#define FBM320_TEMPERATURE_CONVERSION_US	2500
+#define FBM320_OSR_1024_CONVERSION_US		2500
+#define FBM320_OSR_2048_CONVERSION_US		3700
+#define FBM320_OSR_4096_CONVERSION_US		6000
+#define FBM320_OSR_8192_CONVERSION_US		10000
+#define FBM320_PRESSURE_CONVERSION_US		FBM320_OSR_8192_CONVERSION_US
+#define FBM320_CONVERSION_MARGIN_US			500
+
+#define FBM320_PRESSURE_PER_TEMPERATURE		8	//pressure conversions between two temperature conversions
+
 
 struct Sensor
 {
@@ -23,6 +44,7 @@ struct Sensor
 	int32_t RT;
 	int32_t Reff_P;
 	int32_t Altitude;
+	uint32_t sampledAt;		//micros() that Altitude corresponds to, the newest read minus the filter delay
 	uint32_t C4, C5, C7;
 };
 extern struct Sensor FB;
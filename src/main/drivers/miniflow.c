@@ -5,36 +5,54 @@
 #include <math.h>
 #include "common/maths.h"
 #include "common/axis.h"
+#include "common/utils.h"
 #include <platform.h>
 #include "config/parameter_group.h"
+#include "config/parameter_group_ids.h"
+#include "config/config_reset.h"
 #include "drivers/sensor.h"
 #include "drivers/accgyro.h"
 #include "sensors/sensors.h"
 #include "sensors/acceleration.h"
 #include "flight/imu.h"
+#include "flight/flow_estimator.h"
 #include "drivers/dma.h"
 #include "drivers/system.h"
 #include "drivers/serial.h"
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
-#include "c05/miniflow.h"
+#include "drivers/miniflow.h"
 #include "build/debug.h"
 #include "flight/altitudehold.h"
 #include "rx/rx.h"
-#include "c05/rxdata.h"
+#include "fc/rc_controls.h"
+#include "fc/runtime_config.h"
 #include "flight/pid.h"
 
 
 
 #define ROLL 0
 #define PITCH 1
-#define LENGTH 10
 
 #define POS_CALC_OUT_MAX 	30.0f   
 #define POS_CALC_OUT_MIN 	-30.0f
 #define POS_CONTROL_LIMIT_MAX 	30.0f
 #define POS_CONTROL_LIMIT_MIN 	-30.0f
 
+#define FLOW_ACC_NOISE			50.0f	//cm/s^2，加速度过程噪声
+#define FLOW_VEL_NOISE			8.0f	//cm/s，光流速度测量噪声
+#define FLOW_HEIGHT_MIN			30.0f	//cm，高度估计的有效范围
+#define FLOW_HEIGHT_MAX			300.0f
+#define FLOW_DT_NOMINAL			0.04f	//s，光流板25Hz输出
+#define FLOW_DT_MIN				0.005f	//s，两帧间隔的限幅
+#define FLOW_DT_MAX				0.2f
+#define FLOW_COMMAND_TIMEOUT_US	200000	//us，flow_cmd超过这个时间没有更新就不再叠加到rcCommand
+//光流与姿态、加速度的符号关系：光流x 前-后+ 跟随pitch，光流y 右-左+ 跟随roll
+#define FLOW_ROTATION_SIGN_X	1.0f
+#define FLOW_ROTATION_SIGN_Y	1.0f
+#define FLOW_ACC_SIGN_X			-1.0f
+#define FLOW_ACC_SIGN_Y			-1.0f
+
 _PID_arg_st pos_pid_para;
 _PID_arg_st vec_pid_para;
 
@@ -51,175 +69,259 @@ float pos_x, pos_y;
 float test_filter_x, test_filter_y;
 float speed_x, speed_y;
 float sum_flow_x, sum_flow_y;
-float disx,disy,setx,sety;
 float pos_pid_out_x, pos_pid_out_y;
 float	position_err_x, position_err_y;
 int16_t flow_cmd[3] = {0,0,0};
 
-uint8_t uart_flag = 0;
-uint8_t flow_buffer[LENGTH+1];
 static serialPort_t *flowPort;
-
-static int32_t MedianFilter_x(int32_t newSonarReading);
-static int32_t MedianFilter_y(int32_t newSonarReading);
+static miniflowParser_t flowParser;
+static miniflowFrame_t flowFrames[2];
+static uint8_t flowFrontIndex = 0;
+static bool flowFrameReady = false;
+static miniflowStats_t flowStats;
+static flowEstimator_t flowEstimator;
+static uint32_t flowLastFrameAt = 0;
+static uint8_t pos_flag = 0;		//外环每两帧运行一次
+static uint32_t flowCommandAt = 0;	//Flow_Duty()最近一次更新flow_cmd的时间，0表示没有有效输出
+static int16_t flowLastPitch, flowLastRoll;	//上一帧的姿态(0.1deg)，用于姿态补偿
+
+PG_REGISTER_WITH_RESET_TEMPLATE(miniflowConfig_t, miniflowConfig, PG_MINIFLOW_CONFIG, 0);
+
+PG_RESET_TEMPLATE(miniflowConfig_t, miniflowConfig,
+	.angle_rate_hz = 120,
+);
+
+static void flow_Reset(void);
+static void flow_Acc(float acc[FLOW_AXIS_COUNT]);
 
 void Miniflow_init(void)
 {
 	PID_para_init();
-	flowPort = uartOpen(USART3,Receive_Data,115200,MODE_RXTX,SERIAL_NOT_INVERTED);
+	flowEstimatorInit(&flowEstimator, FLOW_ACC_NOISE, FLOW_VEL_NOISE, POS_CONTROL_LIMIT_MAX);
+	miniflowParserReset(&flowParser);
+	flowPort = uartOpen(USART3,NULL,115200,MODE_RXTX,SERIAL_NOT_INVERTED);//no rx callback, bytes are buffered in the uart rx ring
 }
 
-
-//120HZ LOOP
-void taskminiFlow(void)
-{	
-	static uint8_t loop_20hz;
-	loop_20hz++;
-	Send_Angle();
-	if(loop_20hz == 5)
-	{	
-		loop_20hz = 0;
-		if(pControlFlag->altHoldFlag && pFlightData->position.z > 10)
+//drain the uart rx ring, every complete frame goes to the back buffer and is then published
+void miniflowProcessRx(void)
+{
+	while(serialRxBytesWaiting(flowPort))
+	{
+		switch(miniflowParseByte(&flowParser, serialRead(flowPort)))
 		{
-			Flow_Duty(0.05);
-			if((rcData[0]<1450) || (rcData[0]>1550) || (rcData[1]<1450) || (rcData[1]>1550))//有摇杆操作时，定点各个数据清零
+			case MINIFLOW_PARSE_FRAME:
 			{
-				flow_cmd[ROLL] = 0;
-				flow_cmd[PITCH] = 0;
-				sum_flow_x = 0;       
-				sum_flow_y = 0;		
-				pos_x = 0;
-				pos_y = 0;
-				PID_Value_reset(&pos_pid_value_x);
-				PID_Value_reset(&pos_pid_value_y);
-				PID_Value_reset(&vec_pid_value_x);
-				PID_Value_reset(&vec_pid_value_y);	
+				const uint8_t back = flowFrontIndex ^ 1;
+				memcpy(flowFrames[back].payload, flowParser.payload, MINIFLOW_PAYLOAD_LENGTH);
+				flowFrames[back].receivedAt = micros();
+				flowFrontIndex = back;
+				if(flowFrameReady)	flowStats.dropped++;
+				flowFrameReady = true;
+				flowStats.frames++;
+				break;
 			}
+			case MINIFLOW_PARSE_CORRUPT:
+				flowStats.corrupt++;
+				break;
+			default:
+				break;
 		}
-		else 
+	}
+}
+
+//copies the newest frame, false if there was none since the last call
+bool miniflowGetFrame(miniflowFrame_t *frame)
+{
+	if(!flowFrameReady)	return false;
+	*frame = flowFrames[flowFrontIndex];
+	flowFrameReady = false;
+	return true;
+}
+
+const miniflowStats_t *miniflowGetStats(void)
+{
+	return &flowStats;
+}
+
+
+//scheduler check: drain the uart rx ring, the task only runs once a validated frame is waiting
+bool taskMiniflowCheck(uint32_t currentDeltaTime)
+{
+	UNUSED(currentDeltaTime);
+	miniflowProcessRx();
+	return flowFrameReady;
+}
+
+static void miniflowUpdateTiming(uint32_t processTime, uint32_t latency)
+{
+	flowStats.processTimeAverage = (flowStats.processTimeAverage * 31 + processTime) / 32;
+	flowStats.processTimeMax = MAX(flowStats.processTimeMax, processTime);
+	flowStats.latencyAverage = (flowStats.latencyAverage * 31 + latency) / 32;
+	flowStats.latencyMax = MAX(flowStats.latencyMax, latency);
+}
+
+//runs once per flow frame
+void taskMiniflow(void)
+{	
+	const uint32_t started_at = micros();
+	miniflowFrame_t frame;
+	if(!miniflowGetFrame(&frame))	return;
+
+	//原定点条件 altHoldFlag && position.z > 10：定高打开且估计高度超过10cm
+	if(FLIGHT_MODE(BARO_MODE) && altitudeHoldGetEstimatedAltitude() > 10)
+	{
+		Flow_Duty(&frame);
+		flowCommandAt = frame.receivedAt;
+		if((rcData[0]<1450) || (rcData[0]>1550) || (rcData[1]<1450) || (rcData[1]>1550))//有摇杆操作时，定点各个数据清零
 		{
-			flow_cmd[ROLL] = 0;
-			flow_cmd[PITCH] = 0;
-			sum_flow_x = 0;       
-			sum_flow_y = 0;		
-			pos_x = 0;
-			pos_y = 0;
-			PID_Value_reset(&pos_pid_value_x);
-			PID_Value_reset(&pos_pid_value_y);
-			PID_Value_reset(&vec_pid_value_x);
-			PID_Value_reset(&vec_pid_value_y);
+			flow_Reset();
 		}
+	}
+	else 
+	{
+		flow_Reset();
+	}
+
+	const uint32_t now = micros();
+	miniflowUpdateTiming(now - started_at, now - frame.receivedAt);//处理时间，光流帧到flow_cmd的延时
 
 debug[2] = flow_cmd[PITCH];
 debug[3] = flow_cmd[ROLL];
-//debug[2] = pScratchData->position.x;
-//debug[3] = pScratchData->position.y;
+}
+
+//定点输出叠加到横滚/俯仰的rcCommand，在rcCommand平滑之后、pid_controller之前调用
+//flow_cmd是角度模式下的倾角指令，光流帧中断超过FLOW_COMMAND_TIMEOUT_US时不再叠加旧的输出
+void miniflowApplyHold(void)
+{
+	if(!flowCommandAt || !FLIGHT_MODE(ANGLE_MODE))	return;
+	if(micros() - flowCommandAt > FLOW_COMMAND_TIMEOUT_US)	return;
+	rcCommand[ROLL] += flow_cmd[ROLL];
+	rcCommand[PITCH] += flow_cmd[PITCH];
+}
+
+//time driven, the period follows miniflow_angle_rate
+void taskMiniflowUplink(void)
+{
+	Send_Angle();
+}
+
+//定点数据清零，估计器从当前位置重新开始
+static void flow_Reset(void)
+{
+	flow_cmd[ROLL] = 0;
+	flow_cmd[PITCH] = 0;
+	sum_flow_x = 0;       
+	sum_flow_y = 0;		
+	pos_x = 0;
+	pos_y = 0;
+	flowLastFrameAt = 0;
+	flowCommandAt = 0;
+	pos_flag = 0;
+	pos_pid_out_x = 0;
+	pos_pid_out_y = 0;
+	flowLastPitch = attitude.values.pitch;//重新开始定点时从当前姿态补偿，不用停用前的旧值
+	flowLastRoll = attitude.values.roll;
+	flowEstimatorReset(&flowEstimator);
+	PID_Value_reset(&pos_pid_value_x);
+	PID_Value_reset(&pos_pid_value_y);
+	PID_Value_reset(&vec_pid_value_x);
+	PID_Value_reset(&vec_pid_value_y);
+}
+
+//imu累加的地理坐标系加速度(NED)，按航向旋转到机头坐标系，cm/s^2
+static void flow_Acc(float acc[FLOW_AXIS_COUNT])
+{
+	float acc_n = 0, acc_e = 0;
+	if(accSumCount)
+	{
+		acc_n = (float)accSum[X] / (float)accSumCount * accVelScale * 1e6f;
+		acc_e = (float)accSum[Y] / (float)accSumCount * accVelScale * 1e6f;
 	}
+	const float yaw = attitude.values.yaw * 0.1f * RAD;
+	const float cos_yaw = cos_approx(yaw);
+	const float sin_yaw = sin_approx(yaw);
+	acc[FLOW_AXIS_X] = FLOW_ACC_SIGN_X * (acc_n * cos_yaw + acc_e * sin_yaw);
+	acc[FLOW_AXIS_Y] = FLOW_ACC_SIGN_Y * (-acc_n * sin_yaw + acc_e * cos_yaw);
 }
 
-void Flow_Duty(float dT)
+void Flow_Duty(const miniflowFrame_t *frame)
 {
-	static uint8_t pos_flag = 0;
-	if(1 == uart_flag)//如果接收完成，则转换更新数据
+	pos_flag++;				
+
+	//两帧实际间隔，代替固定的0.05/0.04
+	float dT = FLOW_DT_NOMINAL;
+	if(flowLastFrameAt)	dT = constrainf((frame->receivedAt - flowLastFrameAt) * 1e-6f, FLOW_DT_MIN, FLOW_DT_MAX);
+	flowLastFrameAt = frame->receivedAt;
+
+	//卡尔曼滤波：加速度预测，光流速度更新
+	float acc[FLOW_AXIS_COUNT];
+	float vel[FLOW_AXIS_COUNT];
+	flow_Acc(acc);
+	flowEstimatorPredict(&flowEstimator, acc, dT);
+	if(flow_Decode(frame->payload, dT, vel))
 	{
-		uart_flag = 0;
-		pos_flag++;				
-			
-		flow_Decode(flow_buffer);
-			
-		test_filter_y = flow_dat.y*25.0f;
-		test_filter_x = flow_dat.x*25.0f;
-		LPF_1_(3.0f,dT,test_filter_y,speed_y);//pid控制中，如果使用了d，需要选择对速度进行低通滤波，否则飞机会抖动较大
-		LPF_1_(3.0f,dT,test_filter_x,speed_x);   
-//pFlightData->position.x = speed_x;
-//pFlightData->position.y = speed_y;
-		speed_y = constrainf(speed_y,-25.0f,25.0f);//30//右-左+
-		speed_x = constrainf(speed_x,-25.0f,25.0f);//前-后+
-
-		if(fabs(pScratchData->position.y - disx) > 0)//执行路径移动时应该清除PID的积分项
-		{
-			disx -= speed_x*0.05f;//往y为+ 35~=50cm 
-			if(pScratchData->position.y - disx > 5)	setx = 25;//set speed
-			else if(pScratchData->position.y - disx < -5) setx = -25;	
-			else 
-			{
-				pScratchData->position.y = 0;
-				setx = 0;
-				disx = 0;
-			}
-		}
+		flowEstimatorUpdate(&flowEstimator, vel, 255.0f / flow_dat.qual);//质量越低，测量噪声越大
+	}
+
+	test_filter_x = flow_dat.x;
+	test_filter_y = flow_dat.y;
+	speed_y = constrainf(flowEstimator.axis[FLOW_AXIS_Y].vel,-25.0f,25.0f);//30//右-左+
+	speed_x = constrainf(flowEstimator.axis[FLOW_AXIS_X].vel,-25.0f,25.0f);//前-后+
 
-		if(fabs(pScratchData->position.x - disy) > 0)
-		{
-			disy -= speed_y*0.05f;//往x为+ 35~=50cm 
-			if(pScratchData->position.x - disy > 5)	sety = 25;//set speed
-			else if(pScratchData->position.x - disy < -5) sety = -25;	
-			else
-			{
-				pScratchData->position.x = 0;
-				sety = 0;
-				disy = 0;
-			}
-		}
-//debug[0] = disx;
-//debug[1] = disy;
 /*
-	static float vel_x, vel_y;
-	float dt;
-	float vel_acc_x, vel_acc_y;
-	float acc_tmp_x, acc_tmp_y;
-		//加速度数据融合(加速度双重积分的数据滞后，实际飞行效果变差)
+static float vel_x, vel_y;
+float dt;
+float vel_acc_x, vel_acc_y;
+float acc_tmp_x, acc_tmp_y;
+	//加速度数据融合(加速度双重积分的数据滞后，实际飞行效果变差)
     	dt = accTimeSum * 1e-6f;
     	if (accSumCount) 
-		{
-			acc_tmp_x = (float)accSum[0] / (float)accSumCount;//pitch
-			acc_tmp_y = (float)accSum[1] / (float)accSumCount;//roll
-		}
+	{
+		acc_tmp_x = (float)accSum[0] / (float)accSumCount;//pitch
+		acc_tmp_y = (float)accSum[1] / (float)accSumCount;//roll
+	}
     	else {acc_tmp_x = 0; acc_tmp_y = 0;}
     
     	vel_acc_x = acc_tmp_x * accVelScale * (float)accTimeSum;
-		vel_acc_y = acc_tmp_y * accVelScale * (float)accTimeSum;
+	vel_acc_y = acc_tmp_y * accVelScale * (float)accTimeSum;
 
-		pos_x += (vel_acc_x * 0.5f) * dt + vel_x * dt;                  
-		pos_y += (vel_acc_y * 0.5f) * dt + vel_y * dt;                                               
+	pos_x += (vel_acc_x * 0.5f) * dt + vel_x * dt;                  
+	pos_y += (vel_acc_y * 0.5f) * dt + vel_y * dt;                                               
     	pos_x = pos_x * 0.5f + sum_flow_x * 0.5f;                                                                   
     	pos_y = pos_y * 0.5f + sum_flow_y * 0.5f;  
-		pos_x = constrainf(pos_x,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
-		pos_y = constrainf(pos_y,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
+	pos_x = constrainf(pos_x,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
+	pos_y = constrainf(pos_y,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
 //debug[2] = pos_y;
 
     	vel_x += vel_acc_x;
-		vel_y += vel_acc_y;
-		vel_x = vel_x * 0.5f + speed_x * 0.5f;
-		vel_y = vel_y * 0.5f + speed_y * 0.5f;
-		vel_y = constrainf(vel_y,-30.0f,30.0f);
-		vel_x = constrainf(vel_x,-30.0f,30.0f);
+	vel_y += vel_acc_y;
+	vel_x = vel_x * 0.5f + speed_x * 0.5f;
+	vel_y = vel_y * 0.5f + speed_y * 0.5f;
+	vel_y = constrainf(vel_y,-30.0f,30.0f);
+	vel_x = constrainf(vel_x,-30.0f,30.0f);
 debug[2] = speed_y;
 debug[3] = vel_y;
 */
-		//speed_x += setx;
-		//speed_y += sety;
-		sum_flow_y += (speed_y + sety)*0.04f;
-		sum_flow_x += (speed_x + setx)*0.04f;//位移 cm
-		sum_flow_y = constrainf(sum_flow_y,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
-		sum_flow_x = constrainf(sum_flow_x,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
-
-		if(2 == pos_flag)//光流每更新两次执行一次外环，也就是说，位置环的控制周期要大于速度环的控制周期，输出为期望速度
-		{
-			pos_flag = 0;
-			pos_pid_out_y = PID_calculate(dT,0.0f,0.0f,sum_flow_y,&pos_pid_para,&pos_pid_value_y, POS_CALC_OUT_MAX);
-			pos_pid_out_x = PID_calculate(dT,0.0f,0.0f,sum_flow_x,&pos_pid_para,&pos_pid_value_x, POS_CALC_OUT_MAX);
+	sum_flow_y = flowEstimator.axis[FLOW_AXIS_Y].pos;
+	sum_flow_x = flowEstimator.axis[FLOW_AXIS_X].pos;//位移 cm
+	sum_flow_y = constrainf(sum_flow_y,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
+	sum_flow_x = constrainf(sum_flow_x,POS_CONTROL_LIMIT_MIN,POS_CONTROL_LIMIT_MAX);
 
-			pos_pid_out_y = constrainf(pos_pid_out_y*15.0f,POS_CALC_OUT_MIN,POS_CALC_OUT_MAX);
-			pos_pid_out_x = constrainf(pos_pid_out_x*15.0f,POS_CALC_OUT_MIN,POS_CALC_OUT_MAX);
+	if(2 == pos_flag)//光流每更新两次执行一次外环，也就是说，位置环的控制周期要大于速度环的控制周期，输出为期望速度
+	{
+		pos_flag = 0;
+		pos_pid_out_y = PID_calculate(dT,0.0f,0.0f,sum_flow_y,&pos_pid_para,&pos_pid_value_y, POS_CALC_OUT_MAX);
+		pos_pid_out_x = PID_calculate(dT,0.0f,0.0f,sum_flow_x,&pos_pid_para,&pos_pid_value_x, POS_CALC_OUT_MAX);
 
-			if((pos_pid_out_x < 4.0f) && (pos_pid_out_x > -4.0f)) pos_pid_out_x = 0;
-			if((pos_pid_out_y < 4.0f) && (pos_pid_out_y > -4.0f)) pos_pid_out_y = 0;
-		}
+		pos_pid_out_y = constrainf(pos_pid_out_y*15.0f,POS_CALC_OUT_MIN,POS_CALC_OUT_MAX);
+		pos_pid_out_x = constrainf(pos_pid_out_x*15.0f,POS_CALC_OUT_MIN,POS_CALC_OUT_MAX);
+
+		if((pos_pid_out_x < 4.0f) && (pos_pid_out_x > -4.0f)) pos_pid_out_x = 0;
+		if((pos_pid_out_y < 4.0f) && (pos_pid_out_y > -4.0f)) pos_pid_out_y = 0;
+	}
 
-	}		
-	flow_cmd[ROLL] = PID_calculate(dT,0.0f,pos_pid_out_y,speed_y + sety,&vec_pid_para,&vec_pid_value_y,15.0f)*7.0f;//速度环
-	flow_cmd[PITCH] = PID_calculate(dT,0.0f,pos_pid_out_x,speed_x + setx,&vec_pid_para,&vec_pid_value_x,15.0f)*7.0f;
+	flow_cmd[ROLL] = PID_calculate(dT,0.0f,pos_pid_out_y,speed_y,&vec_pid_para,&vec_pid_value_y,15.0f)*7.0f;//速度环
+	flow_cmd[PITCH] = PID_calculate(dT,0.0f,pos_pid_out_x,speed_x,&vec_pid_para,&vec_pid_value_x,15.0f)*7.0f;
 
 	flow_cmd[ROLL] = -constrain(flow_cmd[ROLL],-35,35);//35
 	flow_cmd[PITCH] = -constrain(flow_cmd[PITCH],-35,35);
@@ -256,53 +358,6 @@ float PID_calculate(float T, float in_ff, float expect, float feedback, _PID_arg
 	return (out);
 }
 
-#define DISTANCE_SAMPLES_MEDIAN 3
-
-static int32_t MedianFilter_x(int32_t newSonarReading)
-{
-    static int32_t sonarFilterSamples[DISTANCE_SAMPLES_MEDIAN];
-    static int currentFilterSampleIndex = 0;
-    static bool medianFilterReady = false;
-    int nextSampleIndex;
- 
-    nextSampleIndex = (currentFilterSampleIndex + 1);
-    if (nextSampleIndex == DISTANCE_SAMPLES_MEDIAN) {
-        nextSampleIndex = 0;
-        medianFilterReady = true;
-    }
-
-    sonarFilterSamples[currentFilterSampleIndex] = newSonarReading;
-    currentFilterSampleIndex = nextSampleIndex;
-    
-    if (medianFilterReady)
-        return quickMedianFilter3(sonarFilterSamples);
-    else
-        return newSonarReading;
-}
-
-static int32_t MedianFilter_y(int32_t newSonarReading)
-{
-    static int32_t sonarFilterSamples[DISTANCE_SAMPLES_MEDIAN];
-    static int currentFilterSampleIndex = 0;
-    static bool medianFilterReady = false;
-    int nextSampleIndex;
- 
-    nextSampleIndex = (currentFilterSampleIndex + 1);
-    if (nextSampleIndex == DISTANCE_SAMPLES_MEDIAN) {
-        nextSampleIndex = 0;
-        medianFilterReady = true;
-    }
-
-    sonarFilterSamples[currentFilterSampleIndex] = newSonarReading;
-    currentFilterSampleIndex = nextSampleIndex;
-    
-    if (medianFilterReady)
-        return quickMedianFilter3(sonarFilterSamples);
-    else
-        return newSonarReading;
-}
-
-
 void PID_para_init(void)
 {
 	pos_pid_para.kp = pidProfile()->P8[PIDPOSR]/1000.0f;
@@ -330,64 +385,33 @@ void PID_Value_reset(_PID_val_st *pid_val)
 }
 
 
-void Receive_Data(uint16_t data)
-{
-	static uint8_t count = 0,i = 0;
+//光流积分(1e-4 rad)减去两帧间的姿态变化，乘以高度除以帧间隔得到速度 cm/s
+//质量为0的帧不作为测量，返回false
+bool flow_Decode(const uint8_t* f_buf, float dT, float vel[FLOW_AXIS_COUNT])
+{	
+	const float rot_x = (attitude.values.pitch - flowLastPitch) * 0.1f * RAD;
+	const float rot_y = (attitude.values.roll - flowLastRoll) * 0.1f * RAD;
+	flowLastPitch = attitude.values.pitch;
+	flowLastRoll = attitude.values.roll;
 
-	switch(count)
-	{
-		case 0: if(data == 0xFE)
-				{
-					count = 1;
-					uart_flag = 0;
-				}
-				break;
-		case 1: if(data == 0x0A)
-					count = 2;
-				else 
-					count = 0;
-				break;
-		case 2: if(i < LENGTH)	
-					flow_buffer[i++] = data;
-				else 
-				{
-					if(data == (flow_buffer[0]^flow_buffer[1]^flow_buffer[2]^flow_buffer[3]^flow_buffer[4]^ \
-												flow_buffer[5]^flow_buffer[6]^flow_buffer[7]^flow_buffer[8]^flow_buffer[9]))
-						uart_flag = 1;			
-
-					i = 0;
-					count = 0;
-				}
-				break;
-		default:count = 0;i = 0;break;
-	}
-}
+	const float height = constrainf(altitudeHoldGetEstimatedAltitude(), FLOW_HEIGHT_MIN, FLOW_HEIGHT_MAX);//cm 
 
+	flow_dat.qual = f_buf[8];
+	flow_dat.dt = lrintf(dT * 1000.0f);
+	if(f_buf[8] == 0)	return false;
 
-void flow_Decode(const uint8_t* f_buf)
-{	
-	uint16_t height = altitudeHoldGetEstimatedAltitude();//cm 
-	if(height < 80) height = 100;
-	else if(height < 130) height = 160;
-			else height = 220; 
+	flow_data_frame.pixel_flow_x_integral = f_buf[0] + (f_buf[1]<<8);
+	flow_data_frame.pixel_flow_y_integral = f_buf[2] + (f_buf[3]<<8);
 
-	if(f_buf[8]!= 0)
-	{
-  		flow_data_frame.pixel_flow_x_integral = f_buf[0] + (f_buf[1]<<8);
-  		flow_data_frame.pixel_flow_y_integral = f_buf[2] + (f_buf[3]<<8);
- 	}
-
-	flow_data_frame.pixel_flow_x_integral = MedianFilter_x(flow_data_frame.pixel_flow_x_integral);
-	flow_data_frame.pixel_flow_y_integral = MedianFilter_y(flow_data_frame.pixel_flow_y_integral);	
-	//deadband
-	if((flow_data_frame.pixel_flow_x_integral < 24) && (flow_data_frame.pixel_flow_x_integral > -24)) flow_data_frame.pixel_flow_x_integral = 0;//raw = 28
-	if((flow_data_frame.pixel_flow_y_integral < 24) && (flow_data_frame.pixel_flow_y_integral > -24)) flow_data_frame.pixel_flow_y_integral = 0;	
-
-	flow_dat.x = flow_data_frame.pixel_flow_x_integral*height/10000.0f;
-	flow_dat.y = flow_data_frame.pixel_flow_y_integral*height/10000.0f;
+	flow_dat.x = (flow_data_frame.pixel_flow_x_integral/10000.0f - FLOW_ROTATION_SIGN_X*rot_x)*height/dT;
+	flow_dat.y = (flow_data_frame.pixel_flow_y_integral/10000.0f - FLOW_ROTATION_SIGN_Y*rot_y)*height/dT;
+	vel[FLOW_AXIS_X] = flow_dat.x;
+	vel[FLOW_AXIS_Y] = flow_dat.y;
+	return true;
 }
 
 
+//the angle frame only goes out when the tx ring can take all of it, the uart never blocks the task
 void Send_Angle(void)
 {
 	static uint8_t DATA[8] = {0x4A,0,0,0,0,0,0};
@@ -398,7 +422,11 @@ void Send_Angle(void)
 	DATA[6] = angle.yaw;
 	DATA[7] = angle.yaw>>8;
 	DATA[1] = DATA[2]^DATA[3]^DATA[4]^DATA[5]^DATA[6]^DATA[7];
-	serialWriteBuf(flowPort,DATA,8);
+	if(serialTxBytesFree(flowPort) < sizeof(DATA))
+	{
+		flowStats.uplinkSkipped++;
+		return;
+	}
+	serialWriteBuf(flowPort,DATA,sizeof(DATA));
+	flowStats.uplinkSent++;
 }
-
-
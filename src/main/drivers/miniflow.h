@@ -1,6 +1,9 @@
 #ifndef _miniflow_H
 #define _miniflow_H
 
+#include "config/parameter_group.h"
+#include "drivers/miniflow_parser.h"
+
 #define LPF_1_(hz,t,in,out) ((out) += ( 1 / ( 1 + 1 / ( (hz) *3.14f *(t) ) ) ) *( (in) - (out) ))	//一阶低通滤波
 #define safe_div(numerator,denominator,safe_value) ( (denominator == 0)? (safe_value) : ((numerator)/(denominator)) )
 
@@ -22,6 +25,30 @@ struct flow_float{
 };
 extern struct flow_float flow_dat;
 
+//complete frame, double buffered between miniflowProcessRx() and Flow_Duty()
+typedef struct miniflowFrame_s {
+	uint8_t payload[MINIFLOW_PAYLOAD_LENGTH];
+	uint32_t receivedAt;	//micros() when the checksum byte was parsed
+} miniflowFrame_t;
+
+typedef struct miniflowStats_s {
+	uint32_t frames;
+	uint32_t dropped;		//overwritten before Flow_Duty() took them
+	uint32_t corrupt;		//checksum mismatch
+	uint32_t processTimeAverage;	//us, taskMiniflow() per frame
+	uint32_t processTimeMax;
+	uint32_t latencyAverage;		//us, frame parsed -> flow_cmd updated
+	uint32_t latencyMax;
+	uint32_t uplinkSent;
+	uint32_t uplinkSkipped;		//tx ring had no room for a whole angle frame
+} miniflowStats_t;
+
+typedef struct miniflowConfig_s {
+	uint8_t angle_rate_hz;		//angle uplink to the flow board
+} miniflowConfig_t;
+
+PG_DECLARE(miniflowConfig_t, miniflowConfig);
+
 extern float exp_rol_flow,exp_pit_flow;
 
 typedef struct
@@ -60,12 +87,15 @@ extern struct angle_data angle;
 extern int16_t flow_cmd[3];
 
 void Miniflow_init(void);
-void Receive_Data(uint16_t data);
-void flow_Decode(const unsigned char* f_buf);
+void miniflowProcessRx(void);
+bool miniflowGetFrame(miniflowFrame_t *frame);
+const miniflowStats_t *miniflowGetStats(void);
+void miniflowApplyHold(void);
+bool flow_Decode(const unsigned char* f_buf, float dT, float vel[2]);
 void PID_para_init(void);
 void PID_Value_reset(_PID_val_st *pid_val);
 void Send_Angle(void);
-void Flow_Duty(float dT);
+void Flow_Duty(const miniflowFrame_t *frame);
 float PID_calculate(float T, float in_ff, float expect, float feedback, _PID_arg_st *pid_arg, _PID_val_st *pid_val, float inte_lim);
 
 #endif
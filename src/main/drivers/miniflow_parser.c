@@ -0,0 +1,51 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "drivers/miniflow_parser.h"
+
+enum {
+	MINIFLOW_WAIT_HEADER_1 = 0,
+	MINIFLOW_WAIT_HEADER_2,
+	MINIFLOW_WAIT_PAYLOAD,
+	MINIFLOW_WAIT_CHECKSUM,
+};
+
+void miniflowParserReset(miniflowParser_t *parser)
+{
+	memset(parser, 0, sizeof(*parser));
+}
+
+//frame sync and checksum, runs in task context on bytes taken from the uart rx ring
+miniflowParseResult_e miniflowParseByte(miniflowParser_t *parser, uint8_t c)
+{
+	switch(parser->state)
+	{
+		case MINIFLOW_WAIT_HEADER_1:
+				if(c == MINIFLOW_HEADER_1)
+					parser->state = MINIFLOW_WAIT_HEADER_2;
+				break;
+		case MINIFLOW_WAIT_HEADER_2:
+				if(c == MINIFLOW_HEADER_2)
+				{
+					parser->state = MINIFLOW_WAIT_PAYLOAD;
+					parser->index = 0;
+					parser->checksum = 0;
+				}
+				else if(c != MINIFLOW_HEADER_1)//0xFE 0xFE 0x0A still syncs
+					parser->state = MINIFLOW_WAIT_HEADER_1;
+				break;
+		case MINIFLOW_WAIT_PAYLOAD:
+				parser->payload[parser->index++] = c;
+				parser->checksum ^= c;
+				if(parser->index == MINIFLOW_PAYLOAD_LENGTH)
+					parser->state = MINIFLOW_WAIT_CHECKSUM;
+				break;
+		case MINIFLOW_WAIT_CHECKSUM:
+				parser->state = MINIFLOW_WAIT_HEADER_1;
+				return c == parser->checksum ? MINIFLOW_PARSE_FRAME : MINIFLOW_PARSE_CORRUPT;
+		default:
+				miniflowParserReset(parser);
+				break;
+	}
+	return MINIFLOW_PARSE_NONE;
+}
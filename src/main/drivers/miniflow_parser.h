@@ -0,0 +1,25 @@
+#ifndef _miniflow_parser_H
+#define _miniflow_parser_H
+
+//miniflow -> fc: 0xFE 0x0A payload[10] xor(payload)
+#define MINIFLOW_HEADER_1		0xFE
+#define MINIFLOW_HEADER_2		0x0A
+#define MINIFLOW_PAYLOAD_LENGTH	10
+
+typedef enum {
+	MINIFLOW_PARSE_NONE = 0,	//byte consumed, no frame yet
+	MINIFLOW_PARSE_FRAME,		//checksum ok, payload holds a complete frame
+	MINIFLOW_PARSE_CORRUPT,		//checksum mismatch, frame discarded
+} miniflowParseResult_e;
+
+typedef struct miniflowParser_s {
+	uint8_t state;
+	uint8_t index;
+	uint8_t checksum;
+	uint8_t payload[MINIFLOW_PAYLOAD_LENGTH];
+} miniflowParser_t;
+
+void miniflowParserReset(miniflowParser_t *parser);
+miniflowParseResult_e miniflowParseByte(miniflowParser_t *parser, uint8_t c);
+
+#endif
@@ -11,9 +11,17 @@
 #include "bus_i2c.h"
 #include "system.h"
 #include "gpio.h"
+#include "io.h"
+#include "exti.h"
+#include "nvic.h"
 #include "sound_beeper.h"
 #include "io/beeper.h"
 #include "build/debug.h"
+#include "common/utils.h"
+#include "fc/rc_latency.h"
+#include "rx/nrf_packet.h"
+#include "drivers/coprocessor_328p.h"
+#include "telemetry/nrf_telemetry.h"
 
 golbal_flag flag = {"EMT",VerSion,0,0,0,0,0,0,0,0,true};
 package_328p msp_328p;
@@ -26,6 +34,21 @@ uint8_t  TX_ADDRESS[RX_ADR_WIDTH]= {0x11,0xff,0xff,0xff,0xff};//tx_address
 uint8_t  RXDATA[RX_PLOAD_WIDTH];//rx_data
 uint8_t  RX_ADDRESS[RX_ADR_WIDTH]= {0x11,0xff,0xff,0xff,0xff};//rx_address
 
+// 10 retransmits at 500us + 86us (SETUP_RETR 0x1a) plus air time
+#define NRF_TX_TIMEOUT_US	8000
+
+static IO_t nrfIrqIO;
+static extiCallbackRec_t nrfIrqCallbackRec;
+static nrfIrqCallbackPtr nrfIrqCallback = NULL;
+static volatile bool nrfIrqPending = false;
+static volatile uint32_t nrfIrqAt;
+static nrfTxState_e nrfTxState = NRF_TX_IDLE;
+static uint32_t nrfTxStartedAt;
+static nrfLinkStats_t nrfLinkStats;
+static nrfLinkMode_e nrfLinkMode = NRF_LINK_TURNAROUND;
+static nrfSequenceTracker_t nrfSequence;
+static uint16_t nrfAuxChannels[NRF_PACKET_CHANNEL_COUNT - NRF_PACKET_STICK_COUNT];//0 = not sent
+
 
 static inline void send_328p_buf(uint8_t len, uint8_t *buf)
 {
@@ -63,15 +86,158 @@ static inline void NRF_Read_Buf(uint8_t reg, uint8_t *data, uint8_t length)
 }
 
 
+static void nrfIrqHandler(extiCallbackRec_t *cb)
+{
+	UNUSED(cb);
+	// SPI2 may be in use by the task we interrupted, the STATUS register is read from nrfTxUpdate()/nrf_rx()
+	nrfIrqAt = micros();
+	nrfIrqPending = true;
+	if(nrfIrqCallback)
+		nrfIrqCallback();
+}
+
+// Queues the next telemetry frame, it goes out with the ACK of the next packet received on pipe 0
+static void nrfLoadAckPayload(void)
+{
+	uint8_t fifo;
+	uint8_t frame[NRF_TELEMETRY_MAX_FRAME_SIZE];
+
+	NRF_Read_Buf(FIFO_STATUS,&fifo,1);
+	if(!(fifo & FIFO_TX_EMPTY)){//上一帧还没有被ACK带走
+		nrfLinkStats.ackPending++;
+		return;
+	}
+
+	const uint8_t length = nrfTelemetryBuildFrame(frame, nrfTelemetryNextFrame());
+	NRF_Write_Buf(W_ACK_PAYLOAD - 0x20,frame,length);//通道0
+	nrfLinkStats.ackPayloads++;
+}
+
+static void nrfEnableAckPayload(void)
+{
+	uint8_t feature;
+
+	NRF_Write_Reg(FEATURE,EN_DPL | EN_ACK_PAY);
+	NRF_Read_Buf(FEATURE,&feature,1);
+	if(feature == 0){//nRF24L01 (non +) keeps FEATURE locked until ACTIVATE
+		NRF_Write_Reg(ACTIVATE - 0x20,0x73);
+		NRF_Write_Reg(FEATURE,EN_DPL | EN_ACK_PAY);
+	}
+	NRF_Write_Reg(DYNPD,0x01);//通道0动态数据长度
+	NRF_Write_Reg(FLUSH_TX - 0X20,0xff);
+	nrfLoadAckPayload();
+}
+
+// Reads the payload at the top of the RX FIFO into RXDATA
+static bool nrfReadPayload(void)
+{
+	uint8_t width = RX_PLOAD_WIDTH;
+
+	if(nrfLinkMode == NRF_LINK_ACK_PAYLOAD)
+		NRF_Read_Buf(R_RX_PL_WID,&width,1);//动态数据长度
+
+	if(width > RX_PLOAD_WIDTH){//invalid length, the datasheet requires flushing the RX FIFO
+		NRF_Write_Reg(FLUSH_RX - 0x20,0xff);
+		return false;
+	}
+
+	memset(RXDATA + width,0,RX_PLOAD_WIDTH - width);
+	NRF_Read_Buf(RD_RX_PLOAD,RXDATA,width);// read receive payload from RX_FIFO buffer
+	return true;
+}
+
+// Validates RXDATA and unpacks it into pkg, binary packets are told apart from legacy "$M<" ones by the version byte
+static bool nrfDecodePayload(dataPackage *pkg)
+{
+	nrfPacket_t packet;
+	uint8_t lost;
+
+	if(RXDATA[0] == NRF_PACKET_VERSION){
+		if(nrfPacketDecode(RXDATA, &packet) != NRF_PACKET_OK){
+			nrfLinkStats.corrupt++;
+			return false;
+		}
+		switch(nrfSequenceUpdate(&nrfSequence, packet.sequence, &lost)){
+			case NRF_SEQUENCE_DUPLICATE:	nrfLinkStats.duplicates++;	return false;
+			case NRF_SEQUENCE_LATE:			nrfLinkStats.late++;		return false;
+			default:break;
+		}
+
+		memcpy(pkg->checkCode,"$M<",sizeof(pkg->checkCode));//rx_data_process() only uses packages carrying the check code
+		pkg->mspCmd = packet.cmd;
+		for(uint8_t i = 0;i < NRF_PACKET_STICK_COUNT;i++)	pkg->motor[i] = packet.channels[i];
+		pkg->led = packet.led;
+		pkg->led_rgb = packet.ledRgb;
+		pkg->beep = packet.beep;
+		pkg->key = packet.key;
+		memcpy(nrfAuxChannels,&packet.channels[NRF_PACKET_STICK_COUNT],sizeof(nrfAuxChannels));
+	}
+	else{
+		if(memcmp(RXDATA,"$M<",4)){
+			nrfLinkStats.corrupt++;
+			return false;
+		}
+		nrfSequenceUpdate(&nrfSequence, nrfSequence.lastSequence + 1, &lost);//legacy packets carry no sequence number
+		memcpy(pkg,RXDATA,sizeof(*pkg));
+	}
+
+	nrfLinkStats.rxPackets++;
+	nrfLinkStats.lost += lost;
+	return true;
+}
+
+
+// Empties the RX FIFO (3 deep) in one go, every payload updates the statistics but only the newest valid one is kept in pkg
+static bool nrfDrainRxFifo(dataPackage *pkg)
+{
+	uint8_t sta, fifo;
+	bool received = false;
+
+	NRF_Read_Buf(NRFRegSTATUS, &sta, 1);
+	//clear every flag that is set, not just RX_DR, otherwise IRQ stays low and never gives another falling edge
+	//a payload arriving after this sets RX_DR again, so nothing is left in the FIFO unnoticed
+	if(sta & (RX_OK | TX_OK | MAX_TX))
+		NRF_Write_Reg(NRFRegSTATUS, sta & (RX_OK | TX_OK | MAX_TX));
+	if(!(sta & (1<<RX_DR)))	return false;
+
+	for(uint8_t i = 0;i < 3;i++){
+		NRF_Read_Buf(FIFO_STATUS,&fifo,1);
+		if(fifo & FIFO_RX_EMPTY)	break;
+		if(nrfReadPayload() && nrfDecodePayload(pkg))
+			received = true;
+	}
+
+	if(received && nrfLinkMode == NRF_LINK_ACK_PAYLOAD)
+		nrfLoadAckPayload();
+	return received;
+}
+
+// True when the IRQ line reports a received payload, costs a GPIO read instead of an SPI transaction
+bool nrfRxFramePending(void)
+{
+	return nrfTxState == NRF_TX_IDLE && (nrfIrqPending || !IORead(nrfIrqIO));
+}
+
+void nrfSetIrqCallback(nrfIrqCallbackPtr callback)
+{
+	nrfIrqCallback = callback;
+}
+
+
 /****************NRF24L01_Receive*********************/
 bool nrf_rx(void)
 {
-    uint8_t sta;
     static uint8_t count,flag;
-    NRF_Read_Buf(NRFRegSTATUS, &sta, 1);
-    if(sta & (1<<RX_DR)){
-        NRF_Read_Buf(RD_RX_PLOAD,RXDATA,RX_PLOAD_WIDTH);// read receive payload from RX_FIFO buffer
-		memcpy(&t_mspData,RXDATA,sizeof(t_mspData));
+
+	if(nrfTxState != NRF_TX_IDLE)	return count < 60 && !nrfSequenceLinkDegraded(&nrfSequence);//telemetry still in flight, radio is not listening
+
+	const bool pending = nrfRxFramePending();
+	const uint32_t frameAt = nrfIrqPending ? nrfIrqAt : micros();
+	nrfIrqPending = false;
+
+	// the IRQ line stays low while RX_DR is set, so SPI2 is left alone when nothing arrived
+    if(pending && nrfDrainRxFifo(&t_mspData)){
+		rcLatencyFrameReceived(frameAt);
 		if(!(t_mspData.mspCmd & OFFLINE))
 			mspData = t_mspData;
 		else if(!(mspData.mspCmd & OFFLINE)){
@@ -81,7 +247,6 @@ bool nrf_rx(void)
 				mspData.motor[YA ] = 1500;
 				mspData.motor[THR] = 1000;
 			 }
-		NRF_Write_Reg(NRFRegSTATUS, sta);//清除nrf的中断标志位
 		count = 0;
 		if(flag == 0)
 			flag = 1;
@@ -89,6 +254,12 @@ bool nrf_rx(void)
 
 	if(count > 60){//判断2.4G数据是否丢失
 		count = 60;
+		nrfSequenceReset(&nrfSequence);//link quality drops to 0
+	}
+
+	//nothing for 60 updates, or packets still arrive but too many sequence numbers are missing
+	if(count >= 60 || nrfSequenceLinkDegraded(&nrfSequence)){
+		memset(nrfAuxChannels,0,sizeof(nrfAuxChannels));//stop replaying the last aux values, rx.c applies the rxfail values
 		if(flag == 1) beeper(3);//rc_lost_beep
 		return false;
 	}else return true;
@@ -132,16 +303,8 @@ void rx_data_process(int16_t *buf)
 		//offline process
 		if(mspData.mspCmd & OFFLINE){
 			LED_A_ON;
-			i2cRead(0x08,0xff,1, &msp_328p.cmd);//debug[0] = msp_328p.cmd;
-			i2cRead(0x08,0xff,1, &msp_328p.length);//debug[1] = msp_328p.length;
-			for(uint8_t i = 0;i < msp_328p.length;i++)	
-				i2cRead(0x08,0xff,1, &msp_328p.data[i]);
-			//debug[2] = msp_328p.data[0];
-
-			if(msp_328p.cmd == 255 && t_mspData.key != 0)
-					i2cWrite(0x08,0,t_mspData.key);
-		
-			switch(msp_328p.cmd){  
+			//each frame read by taskCoprocessor() is applied once, msp_328p keeps it until it expires
+			if(coprocessorGetFrame(&msp_328p)) switch(msp_328p.cmd){  
 				case ARM_P:mspData.mspCmd |= ARM;break;
 				case ARM_OFF:mspData.mspCmd &= ~ARM;break;
 				case CAL_P:mspData.mspCmd |= CALIBRATION;break;
@@ -170,6 +333,8 @@ void rx_data_process(int16_t *buf)
 		for(uint8_t i = 0;i<4;i++)	mspData.motor[i] = bound(mspData.motor[i],1950,1000);
 		if(!((mspData.mspCmd & MOTOR) || (msp_328p.cmd == MOTOR_P)))//当要控制电机的时候，不把motor[]的值传给rcData
 			for(uint8_t i = 0;i<4;i++)	buf[i] = mspData.motor[i];
+		for(uint8_t i = 0;i < ARRAYLEN(nrfAuxChannels);i++)//aux channels from binary packets
+			if(nrfAuxChannels[i])	buf[NRF_PACKET_STICK_COUNT + i] = bound(nrfAuxChannels[i],2000,1000);
 
 		//just for beeper
 		if(mspData.mspCmd & OFFLINE || mspData.mspCmd & ONLINE){
@@ -196,30 +361,81 @@ void rx_data_process(int16_t *buf)
 
 
 /****************NRF24L01_TX*********************/
+// Loads the telemetry payload and starts the transmission, completion is handled by nrfTxUpdate()
 void nrf_tx(void)
 {
-	bool a = true;
-	uint8_t sta;
+	if(nrfTxState != NRF_TX_IDLE)	return;
 
 	flag.cmd = mspData.mspCmd;
 	flag.key = mspData.key;
 	memcpy(TXData,&flag,sizeof(flag));
-	
+
 	SPI_CE_L();
+	NRF_Write_Reg(NRFRegSTATUS,RX_OK | TX_OK | MAX_TX);//清除旧的中断标志，保证IRQ有下降沿
 	NRF_Write_Buf(WR_TX_PLOAD - 0x20,TXData,TX_PLOAD_WIDTH);//写数据到TX BUF  32个字节
+	nrfIrqPending = false;
+	nrfTxStartedAt = micros();
+	nrfTxState = NRF_TX_IN_FLIGHT;
  	SPI_CE_H();//启动发送
-	flag.yaw1 = 0;
-	//while(GPIO_ReadInputDataBit(GPIOB, GPIO_Pin_0));
+}
 
-	while(GPIO_ReadInputDataBit(GPIOB, GPIO_Pin_0) && a){
-		delayMicroseconds(10);
-		flag.yaw1++;
-		if(flag.yaw1 > 700)a = false;
-	}
+// Called from updateRx() on every scheduler pass, TASK_RX is never signal driven on NRF targets so the timeout is
+// caught in time. Touches the SPI bus only once the IRQ line fired or the transmission timed out.
+void nrfTxUpdate(uint32_t currentTime)
+{
+	uint8_t sta, observe;
+
+	if(nrfTxState == NRF_TX_IDLE)	return;
+	if(!nrfIrqPending && (int32_t)(currentTime - nrfTxStartedAt) < NRF_TX_TIMEOUT_US)	return;
 
-	NRF_Read_Buf(NRFRegSTATUS,&sta,1); //读取状态寄存器的值	   
+	NRF_Read_Buf(NRFRegSTATUS,&sta,1); //读取状态寄存器的值
+	NRF_Read_Buf(OBSERVE_TX,&observe,1);
 	NRF_Write_Reg(NRFRegSTATUS,sta); //清除TX_DS或MAX_RT中断标志
-	if(sta & MAX_TX)NRF_Write_Reg(FLUSH_TX - 0X20,0xff);//达到最大重发次数，清除TX FIFO寄存器
+
+	nrfLinkStats.retransmits += observe & 0x0f;
+	if(sta & TX_OK)
+		nrfLinkStats.sent++;
+	else if(sta & MAX_TX)
+		nrfLinkStats.failed++;
+	else
+		nrfLinkStats.timeouts++;
+
+	if(!(sta & TX_OK))	NRF_Write_Reg(FLUSH_TX - 0X20,0xff);//发送失败，清除TX FIFO寄存器
+
+	SetRX_Mode();
+	nrfIrqPending = false;
+	nrfTxState = NRF_TX_IDLE;
+}
+
+nrfTxState_e nrfGetTxState(void)
+{
+	return nrfTxState;
+}
+
+// Must be set before NRF24L01_INIT(), the controller has to use the same mode
+void nrfSetLinkMode(nrfLinkMode_e mode)
+{
+	nrfLinkMode = mode;
+}
+
+nrfLinkMode_e nrfGetLinkMode(void)
+{
+	return nrfLinkMode;
+}
+
+const nrfLinkStats_t *nrfGetLinkStats(void)
+{
+	return &nrfLinkStats;
+}
+
+uint8_t nrfGetLinkQuality(void)
+{
+	return nrfSequenceLinkQuality(&nrfSequence);
+}
+
+void nrfResetLinkStats(void)
+{
+	memset(&nrfLinkStats, 0, sizeof(nrfLinkStats));
 }
 
 
@@ -234,10 +450,9 @@ bool NRF24L01_INIT(void)
 			NRF_Read_Buf(NRFRegSTATUS, &sta, 1);
 			delay(10);
 		}
-		if(sta & (1<<RX_DR)){
-	        NRF_Read_Buf(RD_RX_PLOAD,RXDATA,RX_PLOAD_WIDTH);// read receive payload from RX_FIFO buffer 
-			memcpy(&mspData,RXDATA,sizeof(mspData));
+		if((sta & (1<<RX_DR)) && nrfReadPayload()){
 			NRF_Write_Reg(NRFRegSTATUS, sta);//清除nrf的中断标志位
+			memcpy(&mspData,RXDATA,sizeof(mspData));
 			if(mspData.mspCmd & NEWADDRESS){
 				RX_ADDRESS[0] = mspData.motor[2];
 				RX_ADDRESS[1] = mspData.motor[2] >> 8;
@@ -300,7 +515,9 @@ void SetRX_Mode(void)
   	NRF_Write_Reg(RF_CH,40);	 //设置RF通信频率		  
   	NRF_Write_Reg(RX_PW_P0,RX_PLOAD_WIDTH);//选择通道0的有效数据宽度 	    
   	NRF_Write_Reg(RF_SETUP,0x0f);   //设置TX发射参数,0db增益,2Mbps,低噪声增益开启   
-  	NRF_Write_Reg(CONFIG, 0x0f);    //配置基本工作模式的参数;PWR_UP,EN_CRC,16BIT_CRC,接收模式 
+  	NRF_Write_Reg(CONFIG, 0x0f | MASK_TX_DS | MASK_MAX_RT);    //配置基本工作模式的参数;PWR_UP,EN_CRC,16BIT_CRC,接收模式,只有RX_DR拉低IRQ(ACK payload发出时会置TX_DS)
+	if(nrfLinkMode == NRF_LINK_ACK_PAYLOAD)
+		nrfEnableAckPayload();
 	SPI_CE_H();
 
 } 
@@ -332,6 +549,11 @@ void nrf24l01HardwareInit(void)
 	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_GPIOB, ENABLE);
 	gpioInit(GPIOB,&IRQPIN);
 
+	nrfIrqIO = IOGetByTag(IO_TAG(PB0));//IRQ is active low
+	EXTIHandlerInit(&nrfIrqCallbackRec, nrfIrqHandler);
+	EXTIConfig(nrfIrqIO, &nrfIrqCallbackRec, NVIC_PRIO_NRF_IRQ_EXTI, EXTI_Trigger_Falling);
+	EXTIEnable(nrfIrqIO, true);
+
 
 	gpio_config_t CE;//nrf24l01 pins
 
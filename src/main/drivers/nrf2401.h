@@ -16,6 +16,9 @@
 #define FLUSH_TX        0xE1 	// 冲洗发送 FIFO指令
 #define FLUSH_RX        0xE2  	// 冲洗接收 FIFO指令
 #define REUSE_TX_PL     0xE3  	// 定义重复装载数据指令
+#define R_RX_PL_WID     0x60  	// 读取RX FIFO顶部数据长度(动态长度)
+#define W_ACK_PAYLOAD   0xA8  	// 写ACK附带数据(低3位为通道号)
+#define ACTIVATE        0x50  	// 激活FEATURE/DYNPD寄存器(nRF24L01非+版本)
 #define NOP             0xFF  	// 保留
 //*************************************SPI(nRF24L01)寄存器地址**************
 #define CONFIG          0x00  // 配置收发状态，CRC校验模式以及收发状态响应方式
@@ -42,6 +45,8 @@
 #define RX_PW_P4        0x15  // 接收频道4接收数据长度
 #define RX_PW_P5        0x16  // 接收频道5接收数据长度
 #define FIFO_STATUS     0x17  // FIFO栈入栈出状态寄存器设置
+#define DYNPD           0x1C  // 动态数据长度使能
+#define FEATURE         0x1D  // 特性寄存器
 
 #define RX_DR			6	  //中断标志
 #define TX_DS			5
@@ -49,6 +54,13 @@
 #define MAX_TX  		0x10  //达到最大发送次数中断
 #define TX_OK   		0x20  //TX发送完成中断
 #define RX_OK   		0x40  //接收到数据中断
+#define FIFO_TX_FULL	0x20  //FIFO_STATUS
+#define FIFO_TX_EMPTY	0x10
+#define FIFO_RX_EMPTY	0x01
+#define MASK_TX_DS		0x20  //CONFIG，屏蔽TX_DS对IRQ引脚的作用
+#define MASK_MAX_RT		0x10  //CONFIG，屏蔽MAX_RT对IRQ引脚的作用
+#define EN_DPL			0x04  //FEATURE
+#define EN_ACK_PAY		0x02
 //************************************************************************
 #define beep_off	1
 #define beep_s		2
@@ -117,6 +129,7 @@ typedef struct _dataPackage
 	uint8_t key;
 }dataPackage;
 extern dataPackage mspData;
+extern dataPackage t_mspData;
 
 //328 data
 typedef struct _328p
@@ -162,6 +175,30 @@ extern golbal_flag flag;
 #define SPI_CSN_H()  GPIO_SetBits(GPIOB, GPIO_Pin_12)//NSS/CSN
 #define SPI_CSN_L()  GPIO_ResetBits(GPIOB, GPIO_Pin_12)
 
+typedef enum {
+	NRF_LINK_TURNAROUND = 0,	// telemetry sent from PTX mode every 5th rx update
+	NRF_LINK_ACK_PAYLOAD,		// stay in PRX, telemetry rides on the ACK of each received packet
+} nrfLinkMode_e;
+
+typedef enum {
+	NRF_TX_IDLE = 0,
+	NRF_TX_IN_FLIGHT,		// payload loaded, waiting for TX_DS/MAX_RT on the IRQ line
+} nrfTxState_e;
+
+typedef struct nrfLinkStats_s {
+	uint32_t rxPackets;		// accepted command packets
+	uint32_t lost;			// sequence numbers skipped over
+	uint32_t duplicates;
+	uint32_t late;			// older than the last accepted packet
+	uint32_t corrupt;		// bad CRC, version or legacy check code
+	uint32_t sent;			// TX_DS, acknowledged by the controller
+	uint32_t failed;		// MAX_RT, retries exhausted
+	uint32_t timeouts;		// no IRQ within NRF_TX_TIMEOUT_US
+	uint32_t retransmits;	// sum of ARC_CNT over all packets
+	uint32_t ackPayloads;	// telemetry frames loaded with W_ACK_PAYLOAD
+	uint32_t ackPending;	// previous ACK payload not yet taken when a packet arrived
+} nrfLinkStats_t;
+
 #define bound(val,max,min) ((val) > (max)? (max) : (val) < (min)? (min) : (val))
 
 bool NRF24L01_INIT(void);
@@ -169,12 +206,23 @@ bool NRF24L01_Check(void);
 void nrf24l01HardwareInit(void);
 void led_beep_sleep(void);
 
+typedef void (*nrfIrqCallbackPtr)(void);
+
 void rx_data_process(int16_t *buf);
 bool nrf_rx(void);
+bool nrfRxFramePending(void);
+void nrfSetIrqCallback(nrfIrqCallbackPtr callback);
 void SetRX_Mode(void);
 
 void nrf_scheduler(int16_t *buf);
 void nrf_tx(void);
+void nrfTxUpdate(uint32_t currentTime);
+nrfTxState_e nrfGetTxState(void);
+void nrfSetLinkMode(nrfLinkMode_e mode);
+nrfLinkMode_e nrfGetLinkMode(void);
+const nrfLinkStats_t *nrfGetLinkStats(void);
+uint8_t nrfGetLinkQuality(void);
+void nrfResetLinkStats(void);
 void SetTX_Mode(void);
 
 
@@ -85,6 +85,7 @@ static uint16_t captures[PWM_PORTS_OR_PPM_CAPTURE_COUNT];
 static uint8_t ppmFrameCount = 0;
 static uint8_t lastPPMFrameCount = 0;
 static uint8_t ppmCountShift = 0;
+static ppmFrameCallbackPtr ppmFrameCallback = NULL;
 
 typedef struct ppmDevice_s {
     uint8_t  pulseIndex;
@@ -123,6 +124,12 @@ void resetPPMDataReceivedState(void)
     lastPPMFrameCount = ppmFrameCount;
 }
 
+// The callback is invoked from the capture interrupt after every well formed frame
+void ppmSetFrameCallback(ppmFrameCallbackPtr callback)
+{
+    ppmFrameCallback = callback;
+}
+
 #define MIN_CHANNELS_BEFORE_PPM_FRAME_CONSIDERED_VALID 4
 
 void pwmRxInit(void)
@@ -264,6 +271,10 @@ static void ppmEdgeCallback(timerCCHandlerRec_t* cbRec, captureCompare_t capture
                 captures[i] = PPM_RCVR_TIMEOUT;
             }
             ppmFrameCount++;
+
+            if (ppmFrameCallback) {
+                ppmFrameCallback();
+            }
         }
 
         ppmDev.tracking   = true;
@@ -39,6 +39,8 @@ uint16_t pwmRead(uint8_t channel);
 uint16_t ppmRead(uint8_t channel);
 
 bool isPPMDataBeingReceived(void);
+typedef void (*ppmFrameCallbackPtr)(void);
+void ppmSetFrameCallback(ppmFrameCallbackPtr callback);
 void resetPPMDataReceivedState(void);
 
 void pwmRxInit(void);
@@ -102,3 +102,31 @@ void serialEndWrite(serialPort_t *instance)
     if (instance->vTable->endWrite)
         instance->vTable->endWrite(instance);
 }
+
+/*
+ * Feeds buffered receive data through byteCallback. Ports that can detect an idle line (UART RX DMA) only hand over
+ * complete frames and call frameEndCallback after each one; bytes delivered by a receive ISR callback never reach
+ * the buffer so this is a no-op for them.
+ */
+void serialDrainRx(serialPort_t *instance, serialReceiveCallbackPtr byteCallback, serialFrameEndCallbackPtr frameEndCallback)
+{
+    if (instance->vTable->drainRx) {
+        instance->vTable->drainRx(instance, byteCallback, frameEndCallback);
+        return;
+    }
+
+    while (serialRxBytesWaiting(instance)) {
+        byteCallback(serialRead(instance));
+    }
+}
+
+// Returns false if the port cannot detect an idle line, the callback is not installed then.
+bool serialSetIdleCallback(serialPort_t *instance, serialFrameEndCallbackPtr idleCallback)
+{
+    if (!instance->vTable->setIdleCallback) {
+        return false;
+    }
+
+    instance->vTable->setIdleCallback(instance, idleCallback);
+    return true;
+}
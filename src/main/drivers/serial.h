@@ -35,6 +35,7 @@ typedef enum portOptions_t {
 } portOptions_t;
 
 typedef void (*serialReceiveCallbackPtr)(uint16_t data);   // used by serial drivers to return frames to app
+typedef void (*serialFrameEndCallbackPtr)(void);            // used by serialDrainRx() and the idle line interrupt to mark the end of a frame
 
 typedef struct serialPort_s {
 
@@ -78,6 +79,12 @@ struct serialPortVTable {
     // Optional functions used to buffer large writes.
     void (*beginWrite)(serialPort_t *instance);
     void (*endWrite)(serialPort_t *instance);
+
+    // Optional function used to hand received frames to the caller in task context.
+    void (*drainRx)(serialPort_t *instance, serialReceiveCallbackPtr byteCallback, serialFrameEndCallbackPtr frameEndCallback);
+
+    // Optional function used to get notified from interrupt context when the line goes idle after a frame.
+    void (*setIdleCallback)(serialPort_t *instance, serialFrameEndCallbackPtr idleCallback);
 };
 
 void serialWrite(serialPort_t *instance, uint8_t ch);
@@ -95,3 +102,6 @@ uint32_t serialGetBaudRate(serialPort_t *instance);
 void serialWriteBufShim(void *instance, uint8_t *data, int count);
 void serialBeginWrite(serialPort_t *instance);
 void serialEndWrite(serialPort_t *instance);
+
+void serialDrainRx(serialPort_t *instance, serialReceiveCallbackPtr byteCallback, serialFrameEndCallbackPtr frameEndCallback);
+bool serialSetIdleCallback(serialPort_t *instance, serialFrameEndCallbackPtr idleCallback);
@@ -181,6 +181,7 @@ serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback,
         return (serialPort_t *)s;
     }
     s->txDMAEmpty = true;
+    s->idleCallback = NULL;
 
     // common serial initialisation code should move to serialPort::init()
     s->port.rxBufferHead = s->port.rxBufferTail = 0;
@@ -215,6 +216,10 @@ serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback,
             DMA_Cmd(s->rxDMAChannel, ENABLE);
             USART_DMACmd(s->USARTx, USART_DMAReq_Rx, ENABLE);
             s->rxDMAPos = DMA_GetCurrDataCounter(s->rxDMAChannel);
+
+            // The idle line interrupt marks frame boundaries for serialDrainRx()
+            s->rxIdleHead = s->rxIdleTail = 0;
+            USART_ITConfig(s->USARTx, USART_IT_IDLE, ENABLE);
         } else {
             USART_ClearITPendingBit(s->USARTx, USART_IT_RXNE);
             USART_ITConfig(s->USARTx, USART_IT_RXNE, ENABLE);
@@ -364,6 +369,48 @@ uint8_t uartRead(serialPort_t *instance)
     return ch;
 }
 
+void uartDrainRx(serialPort_t *instance, serialReceiveCallbackPtr byteCallback, serialFrameEndCallbackPtr frameEndCallback)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+
+    if (!s->rxDMAChannel) {
+        while (uartTotalRxBytesWaiting(instance)) {
+            byteCallback(uartRead(instance));
+        }
+        return;
+    }
+
+    // Only bytes up to the most recent idle line are handed over, a frame still being received stays in the DMA buffer.
+    const uint8_t idleHead = s->rxIdleHead;
+    if ((uint8_t)(idleHead - s->rxIdleTail) > UART_RX_IDLE_QUEUE_SIZE) {
+        // Too many frames queued up, skip straight to the start of the newest one.
+        s->rxDMAPos = s->rxIdlePos[(idleHead - 2) & (UART_RX_IDLE_QUEUE_SIZE - 1)];
+        s->rxIdleTail = idleHead - 1;
+    }
+
+    while (s->rxIdleTail != idleHead) {
+        const uint32_t frameEndPos = s->rxIdlePos[s->rxIdleTail & (UART_RX_IDLE_QUEUE_SIZE - 1)];
+        while (s->rxDMAPos != frameEndPos) {
+            byteCallback(uartRead(instance));
+        }
+        s->rxIdleTail++;
+
+        if (frameEndCallback) {
+            frameEndCallback();
+        }
+    }
+}
+
+void uartSetIdleCallback(serialPort_t *instance, serialFrameEndCallbackPtr idleCallback)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+
+    s->idleCallback = idleCallback;
+    if (!s->rxDMAChannel) {
+        USART_ITConfig(s->USARTx, USART_IT_IDLE, idleCallback ? ENABLE : DISABLE);
+    }
+}
+
 void uartWrite(serialPort_t *instance, uint8_t ch)
 {
     uartPort_t *s = (uartPort_t *)instance;
@@ -394,5 +441,7 @@ const struct serialPortVTable uartVTable[] = {
         .writeBuf = NULL,
         .beginWrite = NULL,
         .endWrite = NULL,
+        .drainRx = uartDrainRx,
+        .setIdleCallback = uartSetIdleCallback,
     }
 };
@@ -34,6 +34,9 @@
 #define UART5_RX_BUFFER_SIZE    256
 #define UART5_TX_BUFFER_SIZE    256
 
+// Number of idle line events remembered between two serialDrainRx() calls, must be a power of two.
+#define UART_RX_IDLE_QUEUE_SIZE 4
+
 typedef struct {
     serialPort_t port;
 
@@ -46,6 +49,12 @@ typedef struct {
     uint32_t rxDMAPos;
     bool txDMAEmpty;
 
+    // DMA counter at each idle line, i.e. where a frame ends in the RX DMA buffer
+    volatile uint32_t rxIdlePos[UART_RX_IDLE_QUEUE_SIZE];
+    volatile uint8_t rxIdleHead;
+    uint8_t rxIdleTail;
+    serialFrameEndCallbackPtr idleCallback;
+
     uint32_t txDMAPeripheralBaseAddr;
     uint32_t rxDMAPeripheralBaseAddr;
 
@@ -66,3 +75,5 @@ uint8_t uartTotalTxBytesFree(serialPort_t *instance);
 uint8_t uartRead(serialPort_t *instance);
 void uartSetBaudRate(serialPort_t *s, uint32_t baudRate);
 bool isUartTransmitBufferEmpty(serialPort_t *s);
+void uartDrainRx(serialPort_t *instance, serialReceiveCallbackPtr byteCallback, serialFrameEndCallbackPtr frameEndCallback);
+void uartSetIdleCallback(serialPort_t *instance, serialFrameEndCallbackPtr idleCallback);
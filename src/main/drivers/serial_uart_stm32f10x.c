@@ -82,6 +82,19 @@ void usartIrqHandler(uartPort_t *s)
             }
         }
     }
+    if (SR & USART_FLAG_IDLE && (s->rxDMAChannel || s->idleCallback)) {
+        // IDLE is cleared by reading SR followed by DR, a pending byte gets its DR read from DMA or the code above
+        if (!(SR & USART_FLAG_RXNE)) {
+            (void)s->USARTx->DR;
+        }
+        if (s->rxDMAChannel) {
+            s->rxIdlePos[s->rxIdleHead & (UART_RX_IDLE_QUEUE_SIZE - 1)] = s->rxDMAChannel->CNDTR;
+            s->rxIdleHead++;
+        }
+        if (s->idleCallback) {
+            s->idleCallback();
+        }
+    }
     if (SR & USART_FLAG_TXE) {
         if (s->port.txBufferTail != s->port.txBufferHead) {
             s->USARTx->DR = s->port.txBuffer[s->port.txBufferTail++];
@@ -170,8 +183,7 @@ uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t option
     dmaHandlerInit(&uartPort1.dmaTxHandler, UART_TX_DMA_IRQHandler);
     dmaSetHandler(DMA1Channel4Descriptor, &uartPort1.dmaTxHandler, NVIC_PRIO_SERIALUART1_TXDMA);
 
-#ifndef USE_UART1_RX_DMA
-    // RX/TX Interrupt
+    // RX/TX Interrupt, also used for idle line detection when RX is done by DMA
     NVIC_InitTypeDef NVIC_InitStructure;
 
     NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
@@ -179,7 +191,6 @@ uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t option
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(NVIC_PRIO_SERIALUART1);
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
-#endif
 
     return s;
 }
@@ -43,13 +43,20 @@
 #include "serial_uart_stm32f30x.h"
 
 
-// Using RX DMA disables the use of receive callbacks
-//#define USE_UART1_RX_DMA
-//#define USE_UART2_RX_DMA
+// Using RX DMA disables the use of receive callbacks, serial RX decoders drain the DMA buffer via serialDrainRx() instead.
+// USE_UART1_RX_DMA / USE_UART2_RX_DMA are enabled per target in target.h once its DMA channel usage has been checked.
 //#define USE_UART2_TX_DMA
 //#define USE_UART3_RX_DMA
 //#define USE_UART3_TX_DMA
 
+#if defined(MINIFLOW) && !defined(LED_STRIP) && !defined(TRANSPONDER) // flow board angle uplink, DMA1 channel 2 is taken by the WS2811 strip / transponder otherwise
+#define USE_UART3_TX_DMA
+#endif
+
+#if defined(USE_UART1_RX_DMA) && defined(USE_SDCARD)
+#error "USART1 RX DMA and the SD card TX DMA both use DMA1 channel 5"
+#endif
+
 #ifdef USE_UART1
 static uartPort_t uartPort1;
 #endif
@@ -139,13 +146,11 @@ uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t option
     dmaHandlerInit(&uartPort1.dmaTxHandler, handleUsartTxDma);
     dmaSetHandler(DMA1Channel4Descriptor, &uartPort1.dmaTxHandler, NVIC_PRIO_SERIALUART1_TXDMA);
 
-#ifndef USE_UART1_RX_DMA
     NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_PRIORITY_BASE(NVIC_PRIO_SERIALUART1_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(NVIC_PRIO_SERIALUART1_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
-#endif
 
     return s;
 }
@@ -215,13 +220,11 @@ uartPort_t *serialUART2(uint32_t baudRate, portMode_t mode, portOptions_t option
     dmaSetHandler(DMA1Channel7Descriptor, &uartPort2.dmaTxHandler, NVIC_PRIO_SERIALUART2_TXDMA);
 #endif
 
-#ifndef USE_UART2_RX_DMA
     NVIC_InitStructure.NVIC_IRQChannel = USART2_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_PRIORITY_BASE(NVIC_PRIO_SERIALUART2_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(NVIC_PRIO_SERIALUART2_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
-#endif
 
     return s;
 }
@@ -291,13 +294,11 @@ uartPort_t *serialUART3(uint32_t baudRate, portMode_t mode, portOptions_t option
     dmaSetHandler(DMA1Channel2Descriptor, &uartPort3.dmaTxHandler, NVIC_PRIO_SERIALUART3_TXDMA);
 #endif
 
-#ifndef USE_UART3_RX_DMA
     NVIC_InitStructure.NVIC_IRQChannel = USART3_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = NVIC_PRIORITY_BASE(NVIC_PRIO_SERIALUART3_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = NVIC_PRIORITY_SUB(NVIC_PRIO_SERIALUART3_RXDMA);
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
-#endif
 
     return s;
 }
@@ -329,6 +330,17 @@ void usartIrqHandler(uartPort_t *s)
         }
     }
 
+    if ((s->rxDMAChannel || s->idleCallback) && (ISR & USART_FLAG_IDLE)) {
+        USART_ClearITPendingBit(s->USARTx, USART_IT_IDLE);
+        if (s->rxDMAChannel) {
+            s->rxIdlePos[s->rxIdleHead & (UART_RX_IDLE_QUEUE_SIZE - 1)] = s->rxDMAChannel->CNDTR;
+            s->rxIdleHead++;
+        }
+        if (s->idleCallback) {
+            s->idleCallback();
+        }
+    }
+
     if (ISR & USART_FLAG_ORE)
     {
         USART_ClearITPendingBit (s->USARTx, USART_IT_ORE);
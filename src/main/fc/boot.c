@@ -72,11 +72,16 @@
 #include "drivers/fbm320.h"
 #endif
 
+#ifdef MINIFLOW
+#include "drivers/miniflow.h"
+#endif
+
 #include "rx/rx.h"
 #include "rx/spektrum.h"
 
 #include "fc/rc_controls.h"
 #include "fc/fc_serial.h"
+#include "fc/rc_smoothing.h"
 
 #include "io/serial.h"
 #include "io/flashfs.h"
@@ -573,6 +578,7 @@ void init(void)
     failsafeInit();
 
     rxInit(modeActivationProfile()->modeActivationConditions);
+    rcSmoothingInit();
 
 #ifdef GPS
     if (feature(FEATURE_GPS)) {
@@ -730,6 +736,7 @@ void configureScheduler(void)
 #endif
     setTaskEnabled(TASK_BATTERY, feature(FEATURE_VBAT) || feature(FEATURE_CURRENT_METER));
     setTaskEnabled(TASK_RX, true);
+    setTaskSignalDriven(TASK_RX, rxIsSignalDriven());
 #ifdef GPS
     setTaskEnabled(TASK_GPS, feature(FEATURE_GPS));
 #endif
@@ -770,17 +777,32 @@ void configureScheduler(void)
 #ifdef FBM320
 	setTaskEnabled(TASK_FBM320, true);
 #endif
+#ifdef NRF
+    setTaskEnabled(TASK_COPROCESSOR, true);
+#endif
+#ifdef MINIFLOW
+    setTaskEnabled(TASK_MINIFLOW, true);
+    rescheduleTask(TASK_MINIFLOW_UPLINK, 1000000 / miniflowConfig()->angle_rate_hz);
+    setTaskEnabled(TASK_MINIFLOW_UPLINK, true);
+#endif
+#ifdef USE_FLASHFS
+    setTaskEnabled(TASK_FLASHFS, flashfsGetSize() > 0);
+#endif
 }
 
 int main(void) {
     init();
 
 #ifdef NRF
+	nrfSetLinkMode(rxConfig()->nrf_link_mode);
 	NRF24L01_INIT();
 #endif
 #ifdef FBM320
 	fbm320_init();
 #endif
+#ifdef MINIFLOW
+	Miniflow_init();
+#endif
 
 	configureScheduler();
 
@@ -47,12 +47,18 @@
 #include "drivers/nrf2401.h"
 #endif
 
+#ifdef MINIFLOW
+#include "drivers/miniflow.h"
+#endif
+
 #include "drivers/pwm_output.h"
 
 #include "fc/rc_controls.h"
 #include "fc/rate_profile.h"
 #include "fc/rc_adjustments.h"
 #include "fc/rc_curves.h"
+#include "fc/rc_smoothing.h"
+#include "fc/rc_latency.h"
 #include "fc/fc_serial.h"
 #include "fc/fc_tasks.h"
 
@@ -73,6 +79,7 @@
 #include "io/serial_cli.h"
 #include "io/statusindicator.h"
 #include "io/asyncfatfs/asyncfatfs.h"
+#include "io/flashfs.h"
 #include "io/transponder_ir.h"
 
 #include "msp/msp.h"
@@ -127,7 +134,6 @@ extern uint32_t currentTime;
 extern uint8_t PIDweight[3];
 extern uint8_t dynP8[3], dynI8[3], dynD8[3];
 
-static bool isRXDataNew;
 static pt1Filter_t filteredCycleTimeState;
 uint16_t filteredCycleTime;
 
@@ -625,39 +631,6 @@ void processRx(void)
 
 }
 
-void filterRc(void){
-    static int16_t lastCommand[4] = { 0, 0, 0, 0 };
-    static int16_t deltaRC[4] = { 0, 0, 0, 0 };
-    static int16_t factor, rcInterpolationFactor;
-    uint16_t rxRefreshRate;
-
-    // Set RC refresh rate for sampling and channels to filter
-    initRxRefreshRate(&rxRefreshRate);
-
-    rcInterpolationFactor = rxRefreshRate / filteredCycleTime + 1;
-
-    if (isRXDataNew) {
-        for (int channel=0; channel < 4; channel++) {
-            deltaRC[channel] = rcCommand[channel] -  (lastCommand[channel] - deltaRC[channel] * factor / rcInterpolationFactor);
-            lastCommand[channel] = rcCommand[channel];
-        }
-
-        isRXDataNew = false;
-        factor = rcInterpolationFactor - 1;
-    } else {
-        factor--;
-    }
-
-    // Interpolate steps of rcCommand
-    if (factor > 0) {
-        for (int channel=0; channel < 4; channel++) {
-            rcCommand[channel] = lastCommand[channel] - deltaRC[channel] * factor/rcInterpolationFactor;
-         }
-    } else {
-        factor = 0;
-    }
-}
-
 #if defined(BARO) || defined(SONAR)
 static bool haveUpdatedRcCommandsOnce = false;
 #endif
@@ -678,10 +651,9 @@ void taskMainPidLoop(void)
     imuUpdateGyroAndAttitude();
 
     updateRcCommands(); // this must be called here since applyAltHold directly manipulates rcCommands[]
+    rcLatencyRcCommandUpdated();
 
-    if (rxConfig()->rcSmoothing) {
-        filterRc();
-    }
+    rcSmoothingFilter(rcCommand);
 
 #if defined(BARO) || defined(SONAR)
     haveUpdatedRcCommandsOnce = true;
@@ -711,6 +683,10 @@ void taskMainPidLoop(void)
         }
 	
 	
+#endif
+
+#ifdef MINIFLOW
+    miniflowApplyHold();
 #endif
 
     // If we're armed, at minimum throttle, and we do arming via the
@@ -751,6 +727,7 @@ void taskMainPidLoop(void)
     );
 
     mixTable();
+    rcLatencyMotorsUpdated(micros());
 
 #ifdef USE_SERVOS
     filterServos();
@@ -866,19 +843,35 @@ void taskUpdateBattery(void)
     }
 }
 
+static bool rxUpdatedByCheck = false;
+
 bool taskUpdateRxCheck(uint32_t currentDeltaTime)
 {
     UNUSED(currentDeltaTime);
     updateRx(currentTime);
-    return shouldProcessRx(currentTime);
+    rxUpdatedByCheck = shouldProcessRx(currentTime);
+    return rxUpdatedByCheck;
 }
 
 void taskUpdateRxMain(void)
 {
+    // When the receiver signalled the task directly the scheduler skipped taskUpdateRxCheck()
+    if (!rxUpdatedByCheck) {
+        updateRx(currentTime);
+        if (!shouldProcessRx(currentTime)) {
+            // woken up but nothing was decoded, e.g. a corrupt frame
+            return;
+        }
+    }
+    rxUpdatedByCheck = false;
+
     processRx();
     updateLEDs();
 
-    isRXDataNew = true;
+    if (rxIsFrameReceived()) {
+        // polls that only ran because rxUpdateAt expired are not frames
+        rcSmoothingUpdateRxFrameTime(currentTime);
+    }
 
 #ifdef BARO
     // updateRcCommands() sets rcCommand[], updateAltHoldState depends on valid rcCommand[] data.
@@ -1002,3 +995,10 @@ void taskTransponder(void)
     }
 }
 #endif
+
+#ifdef USE_FLASHFS
+void taskFlashfs(void)
+{
+    flashfsProcess();
+}
+#endif
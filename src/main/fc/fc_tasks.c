@@ -173,9 +173,44 @@ cfTask_t cfTasks[] = {
     [TASK_FBM320] = {
         .taskName = "FBM320",
         .taskFunc = taskFbm320,
-        .desiredPeriod = 1000000 / 50,
+        .desiredPeriod = 1000000 / 50,          // rescheduled to the conversion time after every run
         .staticPriority = TASK_PRIORITY_MEDIUM,
     },
 #endif
 
+#ifdef NRF
+    [TASK_COPROCESSOR] = {
+        .taskName = "328P",
+        .taskFunc = taskCoprocessor,
+        .desiredPeriod = 1000000 / 60,          // same rate the 328p used to be polled from RX processing
+        .staticPriority = TASK_PRIORITY_MEDIUM,
+    },
+#endif
+
+#ifdef MINIFLOW
+    [TASK_MINIFLOW] = {
+        .taskName = "MINIFLOW",
+        .checkFunc = taskMiniflowCheck,
+        .taskFunc = taskMiniflow,
+        .desiredPeriod = 1000000 / 25,          // flow board frame rate, only used to age a pending frame
+        .staticPriority = TASK_PRIORITY_HIGH,
+    },
+
+    [TASK_MINIFLOW_UPLINK] = {
+        .taskName = "FLOWTX",
+        .taskFunc = taskMiniflowUplink,
+        .desiredPeriod = 1000000 / 120,         // rescheduled to miniflow_angle_rate
+        .staticPriority = TASK_PRIORITY_LOW,
+    },
+#endif
+
+#ifdef USE_FLASHFS
+    [TASK_FLASHFS] = {
+        .taskName = "FLASHFS",
+        .taskFunc = taskFlashfs,
+        .desiredPeriod = 1000000 / 100,         // 100 Hz, so small-sector chips can erase as fast as they log
+        .staticPriority = TASK_PRIORITY_LOW,
+    },
+#endif
+
 };
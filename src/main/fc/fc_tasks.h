@@ -59,6 +59,16 @@ typedef enum {
 #ifdef FBM320
 	TASK_FBM320,
 #endif
+#ifdef NRF
+    TASK_COPROCESSOR,
+#endif
+#ifdef MINIFLOW
+    TASK_MINIFLOW,
+    TASK_MINIFLOW_UPLINK,
+#endif
+#ifdef USE_FLASHFS
+    TASK_FLASHFS,
+#endif
 
     /* Count of real tasks */
     TASK_COUNT
@@ -85,3 +95,14 @@ void taskSystem(void);
 #ifdef FBM320
 void taskFbm320(void);
 #endif
+#ifdef NRF
+void taskCoprocessor(void);
+#endif
+#ifdef MINIFLOW
+bool taskMiniflowCheck(uint32_t currentDeltaTime);
+void taskMiniflow(void);
+void taskMiniflowUplink(void);
+#endif
+#ifdef USE_FLASHFS
+void taskFlashfs(void);
+#endif
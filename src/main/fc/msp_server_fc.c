@@ -29,6 +29,7 @@
 #include "common/utils.h"
 #include "common/color.h"
 #include "common/maths.h"
+#include "common/lz4.h"
 #include "common/streambuf.h"
 
 #include "config/parameter_group.h"
@@ -57,6 +58,8 @@
 #include "fc/rate_profile.h"
 #include "fc/rc_controls.h"
 #include "fc/rc_adjustments.h"
+#include "fc/rc_smoothing.h"
+#include "fc/rc_latency.h"
 #include "fc/fc_tasks.h"
 #include "fc/runtime_config.h"
 #include "fc/config.h"
@@ -462,7 +465,8 @@ static void serializeDataflashSummaryReply(mspPacket_t *reply)
     sbufWriteU8(dst, flags);
     sbufWriteU32(dst, geometry->sectors);
     sbufWriteU32(dst, geometry->totalSize);
-    sbufWriteU32(dst, flashfsGetOffset()); // Effectively the current number of bytes stored on the volume
+    // Bytes available to MSP_DATAFLASH_READ, which reads from the oldest intact log onwards
+    sbufWriteU32(dst, flashfsGetUsedSize());
 #else
     sbufWriteU8(dst, 0); // FlashFS is neither ready nor supported
     sbufWriteU32(dst, 0);
@@ -477,10 +481,120 @@ static void serializeDataflashReadReply(mspPacket_t *reply, uint32_t address, in
     sbuf_t *dst = &reply->buf;
     sbufWriteU32(dst, address);
     size = MIN(size, sbufBytesRemaining(dst));    // limit reply to available buffer space
-    // bytesRead will be lower than that requested if we reach end of volume
-    int bytesRead = flashfsReadAbs(address, sbufPtr(dst), size);
+    // bytesRead will be lower than that requested if we reach end of the used space
+    int bytesRead = flashfsReadLinear(address, sbufPtr(dst), size);
     sbufAdvance(dst, bytesRead);
 }
+
+/*
+ * Streaming download: after MSP_DATAFLASH_STREAM, consecutive chunks of the range are pushed to the host as
+ * MSP_DATAFLASH_STREAM_DATA (jumbo) frames without waiting for requests. The host acknowledges what it has received with
+ * MSP_DATAFLASH_STREAM_ACK, and no more than the window it asked for is ever sent ahead of its last acknowledgement.
+ */
+#define DATAFLASH_STREAM_CHUNK_SIZE 512
+#define DATAFLASH_STREAM_HEADER_SIZE 7 // address, raw size, encoding
+#define DATAFLASH_STREAM_MIN_CHUNK_SIZE 64 // Wait for the port to take at least this much rather than sending tiny frames
+#define DATAFLASH_STREAM_DEFAULT_WINDOW 4096
+
+typedef enum {
+    DATAFLASH_ENCODING_NONE = 0,
+    DATAFLASH_ENCODING_LZ4  = 1,    // LZ4 block format, each chunk compressed on its own
+    DATAFLASH_ENCODING_COUNT
+} dataflashEncoding_e;
+
+static struct {
+    bool active;
+    uint8_t encoding;
+    uint16_t window;
+    uint32_t address;       // Next byte to send
+    uint32_t end;
+    uint32_t ackedAddress;
+} dataflashStream;
+
+static uint8_t dataflashStreamFrame[DATAFLASH_STREAM_HEADER_SIZE + DATAFLASH_STREAM_CHUNK_SIZE];
+static uint8_t dataflashStreamChunk[DATAFLASH_STREAM_CHUNK_SIZE];
+static uint16_t dataflashStreamHashTable[LZ4_HASH_TABLE_SIZE];
+static mspPort_t *dataflashStreamPort;
+
+static int mspDataflashStreamNext(mspPacket_t *packet, int maxLength)
+{
+    if (!dataflashStream.active) {
+        return -1;
+    }
+
+    // Reading flash stalls the logger, so arming cuts the stream short: the next frame is the empty one that ends it
+    const bool armed = ARMING_FLAG(ARMED);
+
+    if (armed) {
+        dataflashStream.end = dataflashStream.address;
+    }
+
+    const uint32_t unacked = dataflashStream.address - dataflashStream.ackedAddress;
+
+    if (maxLength < DATAFLASH_STREAM_HEADER_SIZE + DATAFLASH_STREAM_MIN_CHUNK_SIZE || (unacked >= dataflashStream.window && !armed)) {
+        return 0;
+    }
+
+    sbuf_t frame = {
+        .ptr = dataflashStreamFrame,
+        .end = ARRAYEND(dataflashStreamFrame),
+    };
+
+    uint32_t size = MIN(DATAFLASH_STREAM_CHUNK_SIZE, maxLength - DATAFLASH_STREAM_HEADER_SIZE);
+    size = MIN(size, dataflashStream.window - unacked);
+    size = MIN(size, dataflashStream.end - dataflashStream.address);
+
+    uint8_t *payload = dataflashStreamFrame + DATAFLASH_STREAM_HEADER_SIZE;
+    uint8_t encoding = dataflashStream.encoding;
+    int bytesRead = 0;
+    int payloadSize = 0;
+
+    if (size > 0) {
+        bytesRead = flashfsReadLinear(dataflashStream.address, encoding == DATAFLASH_ENCODING_NONE ? payload : dataflashStreamChunk, size);
+    }
+
+    if (bytesRead > 0 && encoding == DATAFLASH_ENCODING_LZ4) {
+        payloadSize = lz4CompressBlock(dataflashStreamChunk, bytesRead, payload, bytesRead - 1, dataflashStreamHashTable);
+
+        if (payloadSize == 0) {
+            // Incompressible, send it as it is
+            encoding = DATAFLASH_ENCODING_NONE;
+            memcpy(payload, dataflashStreamChunk, bytesRead);
+        }
+    }
+    if (encoding == DATAFLASH_ENCODING_NONE) {
+        payloadSize = bytesRead;
+    }
+
+    sbufWriteU32(&frame, dataflashStream.address);
+    sbufWriteU16(&frame, bytesRead);
+    sbufWriteU8(&frame, encoding);
+    sbufAdvance(&frame, payloadSize);
+
+    if (bytesRead <= 0) {
+        // This is the empty frame which marks the end of the stream (or of the volume)
+        dataflashStream.active = false;
+    }
+
+    dataflashStream.address += bytesRead;
+
+    packet->cmd = MSP_DATAFLASH_STREAM_DATA;
+    sbufSwitchToReader(&frame, dataflashStreamFrame);
+    packet->buf = frame;
+
+    return 1;
+}
+
+static void mspDataflashStreamAttach(mspPort_t *msp)
+{
+    // Only one port can stream at a time, a new request takes the stream over
+    if (dataflashStreamPort && dataflashStreamPort != msp) {
+        dataflashStreamPort->streamFn = NULL;
+    }
+
+    dataflashStreamPort = msp;
+    msp->streamFn = dataflashStream.active ? mspDataflashStreamNext : NULL;
+}
 #endif
 
 // return positive for ACK, negative on error, zero for no reply
@@ -548,6 +662,29 @@ int mspServerCommandHandler(mspPacket_t *cmd, mspPacket_t *reply)
             }
             break;
 
+        case MSP_RC_LATENCY: {
+            const rcLatencyStats_t *stats = rcLatencyGetStats();
+            sbufWriteU16(dst, MIN(stats->lastUs, 0xFFFF));
+            sbufWriteU16(dst, MIN(stats->minUs, 0xFFFF));
+            sbufWriteU16(dst, MIN(stats->avgUs, 0xFFFF));
+            sbufWriteU16(dst, MIN(stats->maxUs, 0xFFFF));
+            sbufWriteU32(dst, stats->sampleCount);
+            break;
+        }
+
+#ifdef BLACKBOX
+        case MSP_BLACKBOX_STATS: {
+            const blackboxFieldGroupStats_t *stats = blackboxGetFieldGroupStats();
+            sbufWriteU8(dst, blackboxConfig()->predictor);
+            sbufWriteU8(dst, BLACKBOX_FIELD_GROUP_COUNT);
+            for (int i = 0; i < BLACKBOX_FIELD_GROUP_COUNT; i++) {
+                sbufWriteU32(dst, stats[i].rawBytes);
+                sbufWriteU32(dst, stats[i].encodedBytes);
+            }
+            break;
+        }
+#endif
+
         case MSP_RAW_IMU: {
             // Hack scale due to choice of units for sensor data in multiwii
             unsigned scale_shift = (acc.acc_1G > 1024) ? 3 : 0;
@@ -846,6 +983,10 @@ int mspServerCommandHandler(mspPacket_t *cmd, mspPacket_t *reply)
             sbufWriteU8(dst, rxConfig()->spektrum_sat_bind);
             sbufWriteU16(dst, rxConfig()->rx_min_usec);
             sbufWriteU16(dst, rxConfig()->rx_max_usec);
+            sbufWriteU8(dst, rxConfig()->rcSmoothing);
+            sbufWriteU8(dst, rxConfig()->rcSmoothingCutoffPercent);
+            sbufWriteU16(dst, rcSmoothingGetRxFrameTime());
+            sbufWriteU16(dst, rcSmoothingGetCutoffFrequency());
             break;
 
         case MSP_FAILSAFE_CONFIG:
@@ -1265,6 +1406,57 @@ int mspServerCommandHandler(mspPacket_t *cmd, mspPacket_t *reply)
         case MSP_DATAFLASH_ERASE:
             flashfsEraseCompletely();
             break;
+
+        case MSP_DATAFLASH_STREAM: {
+            // Reading flash stalls the logger, so don't allow downloads in flight
+            if (ARMING_FLAG(ARMED) || len < 9) {
+                return -1;
+            }
+
+            uint32_t address = sbufReadU32(src);
+            uint32_t size = sbufReadU32(src);
+            uint8_t encoding = sbufReadU8(src);
+            uint16_t window = len >= 11 ? sbufReadU16(src) : DATAFLASH_STREAM_DEFAULT_WINDOW;
+
+            if (encoding >= DATAFLASH_ENCODING_COUNT) {
+                encoding = DATAFLASH_ENCODING_NONE;
+            }
+
+            const uint32_t usedSize = flashfsGetUsedSize();
+            address = MIN(address, usedSize);
+
+            dataflashStream.active = size > 0;
+            dataflashStream.encoding = encoding;
+            dataflashStream.window = MAX(window, DATAFLASH_STREAM_MIN_CHUNK_SIZE);
+            dataflashStream.address = address;
+            dataflashStream.ackedAddress = address;
+            dataflashStream.end = address + MIN(size, usedSize - address);
+
+            // Reply with what we'll actually send, the frames start once this reply is out
+            sbufWriteU32(dst, address);
+            sbufWriteU32(dst, dataflashStream.end - address);
+            sbufWriteU8(dst, encoding);
+            sbufWriteU16(dst, DATAFLASH_STREAM_CHUNK_SIZE);
+            sbufWriteU16(dst, dataflashStream.window);
+
+            mspPostProcessFn = mspDataflashStreamAttach;
+            break;
+        }
+
+        case MSP_DATAFLASH_STREAM_ACK: {
+            if (len < 4) {
+                return -1;
+            }
+
+            uint32_t address = sbufReadU32(src);
+
+            // Ignore stale acknowledgements, and ones for data we haven't sent
+            if (dataflashStream.active && address > dataflashStream.ackedAddress && address <= dataflashStream.address) {
+                dataflashStream.ackedAddress = address;
+            }
+
+            return 0;
+        }
 #endif
 
 #ifdef GPS
@@ -1340,7 +1532,7 @@ int mspServerCommandHandler(mspPacket_t *cmd, mspPacket_t *reply)
             break;
 #endif
 
-        case MSP_SET_RX_CONFIG:
+        case MSP_SET_RX_CONFIG: {
             rxConfig()->serialrx_provider = sbufReadU8(src);
             rxConfig()->maxcheck = sbufReadU16(src);
             rxConfig()->midrc = sbufReadU16(src);
@@ -1350,7 +1542,15 @@ int mspServerCommandHandler(mspPacket_t *cmd, mspPacket_t *reply)
                 break;
             rxConfig()->rx_min_usec = sbufReadU16(src);
             rxConfig()->rx_max_usec = sbufReadU16(src);
+            if (sbufBytesRemaining(src) < 2)
+                break;
+            const uint8_t rcSmoothing = sbufReadU8(src);
+            if (rcSmoothing >= RC_SMOOTHING_TYPE_COUNT)
+                return -1;
+            rxConfig()->rcSmoothing = rcSmoothing;
+            rxConfig()->rcSmoothingCutoffPercent = constrain(sbufReadU8(src), RC_SMOOTHING_CUTOFF_PERCENT_MIN, RC_SMOOTHING_CUTOFF_PERCENT_MAX);
             break;
+        }
 
         case MSP_SET_FAILSAFE_CONFIG:
             failsafeConfig()->failsafe_delay = sbufReadU8(src);
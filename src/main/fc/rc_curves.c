@@ -29,72 +29,85 @@
 #include "fc/rc_curves.h"
 
 
-#define PITCH_LOOKUP_LENGTH 7
-#define YAW_LOOKUP_LENGTH 7
-#define THROTTLE_LOOKUP_LENGTH 12
+/*
+ * The curves are sampled at (1 << RC_CURVE_LOOKUP_BITS) + 1 points so that the
+ * per-loop lookup is a shift, a mask and a multiply, no divisions.
+ *
+ * Pitch/roll and yaw inputs are [0;500] and use a step of 2, throttle input is
+ * [0;1000] and uses a step of 4.
+ */
+#define RC_CURVE_LOOKUP_BITS 8
+#define RC_CURVE_LOOKUP_LENGTH ((1 << RC_CURVE_LOOKUP_BITS) + 1)
 
-static int16_t lookupPitchRollRC[PITCH_LOOKUP_LENGTH];      // lookup table for expo & RC rate PITCH+ROLL
-static int16_t lookupYawRC[YAW_LOOKUP_LENGTH];              // lookup table for expo & RC rate YAW
-static int16_t lookupThrottleRC[THROTTLE_LOOKUP_LENGTH];    // lookup table for expo & mid THROTTLE
+#define PITCH_ROLL_LOOKUP_STEP_SHIFT 1
+#define YAW_LOOKUP_STEP_SHIFT 1
+#define THROTTLE_LOOKUP_STEP_SHIFT 2
 
+static int16_t lookupPitchRollRC[RC_CURVE_LOOKUP_LENGTH];   // lookup table for expo & RC rate PITCH+ROLL
+static int16_t lookupYawRC[RC_CURVE_LOOKUP_LENGTH];         // lookup table for expo & RC rate YAW
+static int16_t lookupThrottleRC[RC_CURVE_LOOKUP_LENGTH];    // lookup table for expo & mid THROTTLE
 
-void generatePitchRollCurve(void)
+/*
+ * Same curve as the original 7 point table, ((2500 + expo * (i * i - 25)) * i * rate / 2500),
+ * but evaluated at every table step with i = stick / 100 kept in fixed point.
+ */
+static int16_t calculateExpoCurve(int32_t stick, uint8_t expo, uint8_t rate)
 {
-    for (int i = 0; i < PITCH_LOOKUP_LENGTH; i++) {
-        lookupPitchRollRC[i] = (2500 + currentControlRateProfile->rcExpo8 * (i * i - 25)) * i * (int32_t) currentControlRateProfile->rcRate8 / 2500;
-    }
+    const int64_t shape = 25000000 + (int64_t)expo * (stick * stick - 250000);
+    return shape * stick * rate / 2500000000LL;
 }
 
-/*
 void generatePitchRollCurve(void)
 {
-    for (int i = 0; i < PITCH_LOOKUP_LENGTH; i++) {
-		const int16_t tmp = 10 * i - 50;
-		uint8_t y = 1;
-		if(tmp > 0)		y = 100 - 50;
-		if(tmp < 0)		y = 50;
-		
-        lookupPitchRollRC[i] = 10*50 + tmp*(100 - 80 + (int32_t) 80*(tmp*tmp)/(y*y))/10;
-		lookupPitchRollRC[i] = 1100 + (int32_t)(1900 -1100) * lookupPitchRollRC[i]/1000;
+    for (int i = 0; i < RC_CURVE_LOOKUP_LENGTH; i++) {
+        lookupPitchRollRC[i] = calculateExpoCurve(i << PITCH_ROLL_LOOKUP_STEP_SHIFT, currentControlRateProfile->rcExpo8, currentControlRateProfile->rcRate8);
     }
 }
-*/
 
 void generateYawCurve(void)
 {
-     for (int i = 0; i < YAW_LOOKUP_LENGTH; i++) {
-        lookupYawRC[i] = (2500 + currentControlRateProfile->rcYawExpo8 * (i * i - 25)) * i / 25;
+    // yaw has no rate scaling, the original table used (...) * i / 25 which is a rate of 100
+    for (int i = 0; i < RC_CURVE_LOOKUP_LENGTH; i++) {
+        lookupYawRC[i] = calculateExpoCurve(i << YAW_LOOKUP_STEP_SHIFT, currentControlRateProfile->rcYawExpo8, 100);
     }
 }
 
 void generateThrottleCurve(void)
 {
-    for (int i = 0; i < THROTTLE_LOOKUP_LENGTH; i++) {
-        const int16_t tmp = 10 * i - currentControlRateProfile->thrMid8;
-        uint8_t y = 1;
-        if (tmp > 0)
-            y = 100 - currentControlRateProfile->thrMid8;
+    const int32_t thrMid = 10 * currentControlRateProfile->thrMid8;   // [0;1000]
+    const int32_t thrExpo = currentControlRateProfile->thrExpo8;
+
+    for (int i = 0; i < RC_CURVE_LOOKUP_LENGTH; i++) {
+        const int32_t tmp = (i << THROTTLE_LOOKUP_STEP_SHIFT) - thrMid;
+        int32_t y = 10;
+        if (tmp > 0 && thrMid < 1000)
+            y = 1000 - thrMid;
         if (tmp < 0)
-            y = currentControlRateProfile->thrMid8;
-        lookupThrottleRC[i] = 10 * currentControlRateProfile->thrMid8 + tmp * (100 - currentControlRateProfile->thrExpo8 + (int32_t) currentControlRateProfile->thrExpo8 * (tmp * tmp) / (y * y)) / 10;
-        lookupThrottleRC[i] = motorAndServoConfig()->minthrottle + (int32_t) (motorAndServoConfig()->maxthrottle - motorAndServoConfig()->minthrottle) * lookupThrottleRC[i] / 1000; // [MINTHROTTLE;MAXTHROTTLE]
+            y = thrMid;
+        const int64_t ySquared = (int64_t)y * y;
+        const int32_t curve = thrMid + tmp * ((100 - thrExpo) * ySquared + thrExpo * (int64_t)tmp * tmp) / (100 * ySquared);
+        lookupThrottleRC[i] = motorAndServoConfig()->minthrottle + (int32_t) (motorAndServoConfig()->maxthrottle - motorAndServoConfig()->minthrottle) * curve / 1000; // [MINTHROTTLE;MAXTHROTTLE]
     }
 }
 
+static int16_t rcCurveLookup(const int16_t *lookupTable, int input, int stepShift)
+{
+    const int index = input >> stepShift;
+    const int remainder = input & ((1 << stepShift) - 1);
+    return lookupTable[index] + (((lookupTable[index + 1] - lookupTable[index]) * remainder) >> stepShift);
+}
+
 int16_t rcLookupPitchRoll(int tmp)
 {
-    const int tmp2 = tmp / 100;
-    return lookupPitchRollRC[tmp2] + (tmp - tmp2 * 100) * (lookupPitchRollRC[tmp2 + 1] - lookupPitchRollRC[tmp2]) / 100;
+    return rcCurveLookup(lookupPitchRollRC, tmp, PITCH_ROLL_LOOKUP_STEP_SHIFT);
 }
 
 int16_t rcLookupYaw(int tmp)
 {
-    const int tmp2 = tmp / 100;
-    return lookupYawRC[tmp2] + (tmp - tmp2 * 100) * (lookupYawRC[tmp2 + 1] - lookupYawRC[tmp2]) / 100;
+    return rcCurveLookup(lookupYawRC, tmp, YAW_LOOKUP_STEP_SHIFT);
 }
 
 int16_t rcLookupThrottle(int tmp)
 {
-    const int tmp2 = tmp / 100;
-    return lookupThrottleRC[tmp2] + (tmp - tmp2 * 100) * (lookupThrottleRC[tmp2 + 1] - lookupThrottleRC[tmp2]) / 100;
+    return rcCurveLookup(lookupThrottleRC, tmp, THROTTLE_LOOKUP_STEP_SHIFT);
 }
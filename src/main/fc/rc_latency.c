@@ -0,0 +1,100 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <platform.h>
+
+#include "fc/rc_latency.h"
+
+/*
+ * RC latency follows the time stamp of an RX frame through the stages that consume it:
+ *
+ *   RX frame end (NRF IRQ, UART idle, PPM sync, else decoder poll) -> rcData[] (calculateRxChannelsAndUpdateFailsafe)
+ *   -> rcCommand[] (updateRcCommands) -> motor[] (mixTable)
+ *
+ * Each stage only hands the time stamp on when the previous stage has produced new
+ * data, so a frame is measured exactly once, on the first motor update that used it.
+ * A frame that is superseded before it reached the next stage is not measured.
+ */
+
+static volatile uint32_t rxFrameAt;    // may be set from receiver interrupt context
+static uint32_t rcDataFrameAt;
+static uint32_t rcCommandFrameAt;
+
+static uint64_t latencySum;
+static rcLatencyStats_t stats;
+
+void rcLatencyFrameReceived(uint32_t frameTime)
+{
+    // zero means "nothing pending" at every stage
+    rxFrameAt = frameTime ? frameTime : 1;
+}
+
+void rcLatencyRcDataUpdated(void)
+{
+    if (rxFrameAt) {
+        rcDataFrameAt = rxFrameAt;
+        rxFrameAt = 0;
+    }
+}
+
+void rcLatencyRcCommandUpdated(void)
+{
+    if (rcDataFrameAt) {
+        rcCommandFrameAt = rcDataFrameAt;
+        rcDataFrameAt = 0;
+    }
+}
+
+void rcLatencyMotorsUpdated(uint32_t currentTime)
+{
+    if (!rcCommandFrameAt) {
+        return;
+    }
+
+    const uint32_t latency = currentTime - rcCommandFrameAt;
+    rcCommandFrameAt = 0;
+
+    stats.lastUs = latency;
+    if (stats.sampleCount == 0 || latency < stats.minUs) {
+        stats.minUs = latency;
+    }
+    if (latency > stats.maxUs) {
+        stats.maxUs = latency;
+    }
+
+    latencySum += latency;
+    stats.sampleCount++;
+    stats.avgUs = latencySum / stats.sampleCount;
+}
+
+const rcLatencyStats_t *rcLatencyGetStats(void)
+{
+    return &stats;
+}
+
+void rcLatencyResetStats(void)
+{
+    latencySum = 0;
+    stats.lastUs = 0;
+    stats.minUs = 0;
+    stats.maxUs = 0;
+    stats.avgUs = 0;
+    stats.sampleCount = 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+typedef struct rcLatencyStats_s {
+    uint32_t lastUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t avgUs;
+    uint32_t sampleCount;
+} rcLatencyStats_t;
+
+void rcLatencyFrameReceived(uint32_t frameTime);
+void rcLatencyRcDataUpdated(void);
+void rcLatencyRcCommandUpdated(void);
+void rcLatencyMotorsUpdated(uint32_t currentTime);
+
+const rcLatencyStats_t *rcLatencyGetStats(void);
+void rcLatencyResetStats(void);
@@ -0,0 +1,201 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+#include "common/filter.h"
+
+#include "config/parameter_group.h"
+
+#include "drivers/gyro_sync.h"
+
+#include "rx/rx.h"
+
+#include "fc/rc_smoothing.h"
+
+/*
+ * RC smoothing filters the stick part of rcCommand[] at PID loop rate.
+ *
+ * The RX frame interval is measured from the time stamps of the RX task runs that
+ * delivered new data, averaged over RC_SMOOTHING_FRAME_SAMPLE_COUNT frames.  The filter
+ * cutoff follows the measured frame rate and the coefficients are only recalculated
+ * when the frame rate or the cutoff setting changes, not on every loop.
+ */
+
+#define RC_SMOOTHING_CHANNEL_COUNT 4                // ROLL, PITCH, YAW, THROTTLE
+
+#define RC_SMOOTHING_FRAME_SAMPLE_SHIFT 4
+#define RC_SMOOTHING_FRAME_SAMPLE_COUNT (1 << RC_SMOOTHING_FRAME_SAMPLE_SHIFT)
+#define RC_SMOOTHING_FRAME_TIME_MIN_US 1000         // faster than 1 kHz is noise, not frames
+#define RC_SMOOTHING_FRAME_TIME_MAX_US 50000        // slower than 20 Hz is signal loss, not frames
+#define RC_SMOOTHING_FRAME_TIME_CHANGE_SHIFT 3      // re-tune when the frame time moves by more than 1/8
+
+#define RC_SMOOTHING_CUTOFF_MIN_HZ 1
+#define RC_SMOOTHING_CUTOFF_MAX_HZ 255              // pt1FilterInit() takes a uint8_t cutoff
+
+static uint32_t rxFrameTime;                // measured (or seeded) RX frame interval in us
+static uint32_t lastRxFrameAt;
+static bool lastRxFrameValid;
+static uint32_t rxFrameTimeSum;
+static uint8_t rxFrameTimeSampleCount;
+
+static uint16_t cutoffFrequency;
+static bool coefficientsValid;
+static bool filterStateValid;
+
+// configuration the coefficients and filter state were set up for, to follow cli/msp changes
+static uint8_t activeSmoothingType;
+static uint8_t activeCutoffPercent;
+
+static pt1Filter_t pt1FilterState[RC_SMOOTHING_CHANNEL_COUNT];
+static biquad_t biquadFilterState[RC_SMOOTHING_CHANNEL_COUNT];
+
+void rcSmoothingInit(void)
+{
+    uint16_t rxRefreshRate;
+
+    // the per-protocol guess is only used until the real frame rate has been measured
+    initRxRefreshRate(&rxRefreshRate);
+    rxFrameTime = constrain(rxRefreshRate, RC_SMOOTHING_FRAME_TIME_MIN_US, RC_SMOOTHING_FRAME_TIME_MAX_US);
+
+    lastRxFrameValid = false;
+    rxFrameTimeSum = 0;
+    rxFrameTimeSampleCount = 0;
+    coefficientsValid = false;
+    filterStateValid = false;
+    activeSmoothingType = RC_SMOOTHING_OFF;
+}
+
+void rcSmoothingUpdateRxFrameTime(uint32_t currentTime)
+{
+    const uint32_t frameTime = currentTime - lastRxFrameAt;
+    const bool frameTimeValid = lastRxFrameValid;
+    lastRxFrameAt = currentTime;
+    lastRxFrameValid = true;
+
+    if (!frameTimeValid || frameTime < RC_SMOOTHING_FRAME_TIME_MIN_US || frameTime > RC_SMOOTHING_FRAME_TIME_MAX_US) {
+        // dropout or first frame, start a fresh average
+        rxFrameTimeSum = 0;
+        rxFrameTimeSampleCount = 0;
+        return;
+    }
+
+    rxFrameTimeSum += frameTime;
+    if (++rxFrameTimeSampleCount < RC_SMOOTHING_FRAME_SAMPLE_COUNT) {
+        return;
+    }
+
+    const uint32_t averageFrameTime = rxFrameTimeSum >> RC_SMOOTHING_FRAME_SAMPLE_SHIFT;
+    rxFrameTimeSum = 0;
+    rxFrameTimeSampleCount = 0;
+
+    if ((uint32_t)ABS((int32_t)(averageFrameTime - rxFrameTime)) > (rxFrameTime >> RC_SMOOTHING_FRAME_TIME_CHANGE_SHIFT)) {
+        rxFrameTime = averageFrameTime;
+        coefficientsValid = false;
+    }
+}
+
+static void rcSmoothingUpdateCoefficients(void)
+{
+    // cutoff is a percentage of the frame rate, and must stay below the loop Nyquist frequency
+    const uint32_t frameRateHz = 1000000 / rxFrameTime;
+    const uint32_t loopNyquistHz = 500000 / targetLooptime;
+    activeCutoffPercent = rxConfig()->rcSmoothingCutoffPercent;
+    cutoffFrequency = constrain(frameRateHz * activeCutoffPercent / 100, RC_SMOOTHING_CUTOFF_MIN_HZ, MIN(loopNyquistHz - 1, RC_SMOOTHING_CUTOFF_MAX_HZ));
+
+    const float dT = (float)targetLooptime * 0.000001f;
+
+    for (int channel = 0; channel < RC_SMOOTHING_CHANNEL_COUNT; channel++) {
+        // keep the filter history, only the coefficients change
+        pt1FilterInit(&pt1FilterState[channel], cutoffFrequency, dT);
+
+        const biquad_t previousState = biquadFilterState[channel];
+        BiQuadNewLpf(cutoffFrequency, &biquadFilterState[channel], targetLooptime);
+        biquadFilterState[channel].x1 = previousState.x1;
+        biquadFilterState[channel].x2 = previousState.x2;
+        biquadFilterState[channel].y1 = previousState.y1;
+        biquadFilterState[channel].y2 = previousState.y2;
+    }
+
+    coefficientsValid = true;
+}
+
+static void rcSmoothingResetState(const int16_t *rcCommand)
+{
+    for (int channel = 0; channel < RC_SMOOTHING_CHANNEL_COUNT; channel++) {
+        pt1FilterState[channel].state = rcCommand[channel];
+
+        biquad_t *biquad = &biquadFilterState[channel];
+        biquad->x1 = biquad->x2 = rcCommand[channel];
+        biquad->y1 = biquad->y2 = rcCommand[channel];
+    }
+    filterStateValid = true;
+}
+
+void rcSmoothingFilter(int16_t *rcCommand)
+{
+    const uint8_t smoothingType = rxConfig()->rcSmoothing;
+
+    if (smoothingType == RC_SMOOTHING_OFF) {
+        filterStateValid = false;
+        return;
+    }
+
+    if (smoothingType != activeSmoothingType) {
+        // the other filter's history is stale
+        activeSmoothingType = smoothingType;
+        filterStateValid = false;
+    }
+
+    if (rxConfig()->rcSmoothingCutoffPercent != activeCutoffPercent) {
+        coefficientsValid = false;
+    }
+
+    if (!coefficientsValid) {
+        rcSmoothingUpdateCoefficients();
+    }
+
+    if (!filterStateValid) {
+        // start from the current sticks instead of ramping up from zero
+        rcSmoothingResetState(rcCommand);
+    }
+
+    for (int channel = 0; channel < RC_SMOOTHING_CHANNEL_COUNT; channel++) {
+        float smoothed;
+        if (smoothingType == RC_SMOOTHING_BIQUAD) {
+            smoothed = applyBiQuadFilter(rcCommand[channel], &biquadFilterState[channel]);
+        } else {
+            smoothed = pt1FilterApply(&pt1FilterState[channel], rcCommand[channel]);
+        }
+        rcCommand[channel] = smoothed;
+    }
+}
+
+uint32_t rcSmoothingGetRxFrameTime(void)
+{
+    return rxFrameTime;
+}
+
+uint16_t rcSmoothingGetCutoffFrequency(void)
+{
+    return coefficientsValid ? cutoffFrequency : 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+typedef enum {
+    RC_SMOOTHING_OFF = 0,
+    RC_SMOOTHING_PT1,
+    RC_SMOOTHING_BIQUAD,
+    RC_SMOOTHING_TYPE_COUNT
+} rcSmoothingType_e;
+
+#define RC_SMOOTHING_CUTOFF_PERCENT_MIN 10
+#define RC_SMOOTHING_CUTOFF_PERCENT_MAX 100
+
+void rcSmoothingInit(void);
+void rcSmoothingUpdateRxFrameTime(uint32_t currentTime);
+void rcSmoothingFilter(int16_t *rcCommand);
+
+uint32_t rcSmoothingGetRxFrameTime(void);
+uint16_t rcSmoothingGetCutoffFrequency(void);
@@ -0,0 +1,112 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "flight/altitude_estimator.h"
+
+#define ALT_ESTIMATOR_INITIAL_ALT_VARIANCE      100.0f      // cm^2
+#define ALT_ESTIMATOR_INITIAL_VEL_VARIANCE      100.0f      // (cm/s)^2
+#define ALT_ESTIMATOR_INITIAL_BIAS_VARIANCE     2500.0f     // (cm/s^2)^2
+
+void altitudeEstimatorInit(altitudeEstimator_t *estimator, float accNoise, float biasNoise)
+{
+    estimator->accNoise = accNoise;
+    estimator->biasNoise = biasNoise;
+    altitudeEstimatorReset(estimator, 0.0f);
+}
+
+void altitudeEstimatorReset(altitudeEstimator_t *estimator, float altitude)
+{
+    memset(estimator->x, 0, sizeof(estimator->x));
+    memset(estimator->P, 0, sizeof(estimator->P));
+    estimator->x[ALT_STATE_ALTITUDE] = altitude;
+    estimator->P[ALT_STATE_ALTITUDE][ALT_STATE_ALTITUDE] = ALT_ESTIMATOR_INITIAL_ALT_VARIANCE;
+    estimator->P[ALT_STATE_VELOCITY][ALT_STATE_VELOCITY] = ALT_ESTIMATOR_INITIAL_VEL_VARIANCE;
+    estimator->P[ALT_STATE_ACC_BIAS][ALT_STATE_ACC_BIAS] = ALT_ESTIMATOR_INITIAL_BIAS_VARIANCE;
+}
+
+// x = F x + B acc with F = [1 dT -dT^2/2; 0 1 -dT; 0 0 1], B = [dT^2/2; dT; 0]
+// P = F P F' + B B' accNoise^2 + diag(0, 0, biasNoise^2 dT)
+void altitudeEstimatorPredict(altitudeEstimator_t *estimator, float acc, float dT)
+{
+    float *x = estimator->x;
+    float (*P)[ALT_STATE_COUNT] = estimator->P;
+    const float halfDT2 = 0.5f * dT * dT;
+    const float F[ALT_STATE_COUNT][ALT_STATE_COUNT] = {
+        { 1.0f, dT,   -halfDT2 },
+        { 0.0f, 1.0f, -dT },
+        { 0.0f, 0.0f, 1.0f },
+    };
+    const float B[ALT_STATE_COUNT] = { halfDT2, dT, 0.0f };
+
+    const float correctedAcc = acc - x[ALT_STATE_ACC_BIAS];
+    x[ALT_STATE_ALTITUDE] += x[ALT_STATE_VELOCITY] * dT + correctedAcc * halfDT2;
+    x[ALT_STATE_VELOCITY] += correctedAcc * dT;
+
+    float FP[ALT_STATE_COUNT][ALT_STATE_COUNT];
+    for (int i = 0; i < ALT_STATE_COUNT; i++) {
+        for (int j = 0; j < ALT_STATE_COUNT; j++) {
+            FP[i][j] = F[i][0] * P[0][j] + F[i][1] * P[1][j] + F[i][2] * P[2][j];
+        }
+    }
+
+    const float q = estimator->accNoise * estimator->accNoise;
+    for (int i = 0; i < ALT_STATE_COUNT; i++) {
+        for (int j = i; j < ALT_STATE_COUNT; j++) {
+            P[i][j] = FP[i][0] * F[j][0] + FP[i][1] * F[j][1] + FP[i][2] * F[j][2] + B[i] * B[j] * q;
+            P[j][i] = P[i][j];
+        }
+    }
+    P[ALT_STATE_ACC_BIAS][ALT_STATE_ACC_BIAS] += estimator->biasNoise * estimator->biasNoise * dT;
+}
+
+// altitude measured age seconds ago, compared against the state projected back along the
+// velocity: H = [1 -age 0]
+void altitudeEstimatorCorrect(altitudeEstimator_t *estimator, float altitude, float noise, float age)
+{
+    float *x = estimator->x;
+    float (*P)[ALT_STATE_COUNT] = estimator->P;
+    const float H[ALT_STATE_COUNT] = { 1.0f, -age, 0.0f };
+
+    float PH[ALT_STATE_COUNT];
+    for (int i = 0; i < ALT_STATE_COUNT; i++) {
+        PH[i] = P[i][0] * H[0] + P[i][1] * H[1];
+    }
+
+    const float s = H[0] * PH[0] + H[1] * PH[1] + noise * noise;
+    if (s <= 0.0f) {
+        return;
+    }
+
+    const float innovation = altitude - (x[ALT_STATE_ALTITUDE] - x[ALT_STATE_VELOCITY] * age);
+    float K[ALT_STATE_COUNT];
+    for (int i = 0; i < ALT_STATE_COUNT; i++) {
+        K[i] = PH[i] / s;
+        x[i] += K[i] * innovation;
+    }
+
+    // P = P - K H P, PH' is the row H P since P is symmetric
+    for (int i = 0; i < ALT_STATE_COUNT; i++) {
+        for (int j = i; j < ALT_STATE_COUNT; j++) {
+            P[i][j] -= K[i] * PH[j];
+            P[j][i] = P[i][j];
+        }
+    }
+}
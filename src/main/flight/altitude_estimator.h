@@ -0,0 +1,41 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Vertical Kalman filter with altitude, velocity and accelerometer bias as states.
+// The earth-frame Z acceleration drives the prediction at accelerometer rate, baro and sonar
+// altitudes correct it whenever they arrive.
+
+typedef enum {
+    ALT_STATE_ALTITUDE = 0, // cm
+    ALT_STATE_VELOCITY,     // cm/s
+    ALT_STATE_ACC_BIAS,     // cm/s^2
+    ALT_STATE_COUNT
+} altitudeEstimatorState_e;
+
+typedef struct altitudeEstimator_s {
+    float x[ALT_STATE_COUNT];
+    float P[ALT_STATE_COUNT][ALT_STATE_COUNT];
+    float accNoise;         // cm/s^2, accelerometer process noise
+    float biasNoise;        // cm/s^2 per sqrt(s), accelerometer bias random walk
+} altitudeEstimator_t;
+
+void altitudeEstimatorInit(altitudeEstimator_t *estimator, float accNoise, float biasNoise);
+void altitudeEstimatorReset(altitudeEstimator_t *estimator, float altitude);
+void altitudeEstimatorPredict(altitudeEstimator_t *estimator, float acc, float dT);
+void altitudeEstimatorCorrect(altitudeEstimator_t *estimator, float altitude, float noise, float age);
@@ -31,6 +31,7 @@
 
 #include "config/parameter_group.h"
 #include "config/parameter_group_ids.h"
+#include "config/config_reset.h"
 
 #include "drivers/sensor.h"
 #include "drivers/accgyro.h"
@@ -54,6 +55,7 @@
 #include "flight/imu.h"
 
 #include "flight/altitudehold.h"
+#include "flight/altitude_estimator.h"
 
 #ifdef NRF
 #include "drivers/nrf2401.h"
@@ -84,6 +86,20 @@ PG_RESET_TEMPLATE(airplaneConfig_t, airplaneConfig,
     .fixedwing_althold_dir = 1,
 );
 
+PG_REGISTER_WITH_RESET_TEMPLATE(altitudeEstimatorConfig_t, altitudeEstimatorConfig, PG_ALTITUDE_ESTIMATOR_CONFIG, 0);
+
+PG_RESET_TEMPLATE(altitudeEstimatorConfig_t, altitudeEstimatorConfig,
+    .alt_estimator = ALT_ESTIMATOR_CF,
+    .alt_kf_acc_noise = 50,
+    .alt_kf_baro_noise = 50,
+    .alt_kf_sonar_noise = 5,
+);
+
+#define ALT_KF_BIAS_NOISE 2.0f                  // cm/s^2 per sqrt(s)
+
+static altitudeEstimator_t altEstimator;
+static bool altEstimatorReady = false;          // cleared until the baro is calibrated, the filter then starts at its altitude
+
 // 40hz update rate (20hz LPF on acc)
 #define BARO_UPDATE_FREQUENCY_40HZ (1000 * 25)
 
@@ -283,6 +299,106 @@ int32_t calculateAltHoldThrottleAdjustment(int32_t vel_tmp, float accZ_tmp, floa
     return result;
 }
 
+// called from imuCalculateAcceleration() for every accelerometer sample
+void altitudeEstimatorUpdateAcc(float accZ, float dT)
+{
+    if (altitudeEstimatorConfig()->alt_estimator != ALT_ESTIMATOR_KALMAN || !altEstimatorReady) {
+        return;
+    }
+    altitudeEstimatorPredict(&altEstimator, accZ, dT);
+}
+
+static void calculateEstimatedAltitudeKalman(uint32_t currentTime)
+{
+    static uint32_t lastBaroSampleAt = 0;
+    static float accZ_old = 0.0f;
+    uint32_t baroSampledAt = 0;
+    float accZ_tmp;
+
+#ifdef SONAR
+    static int32_t baroAlt_offset = 0;
+    int32_t sonarAlt;
+#endif
+
+#ifdef BARO
+#ifdef FBM320
+    if (!FB.calibrate_finished) {
+        altEstimatorReady = false;
+        return;
+    }
+    BaroAlt = FB.Altitude;
+    baroSampledAt = FB.sampledAt;
+#else
+    if (!isBaroCalibrationComplete()) {
+        performBaroCalibrationCycle();
+        altEstimatorReady = false;
+        return;
+    }
+    BaroAlt = baroCalculateAltitude();
+    baroSampledAt = baroGetSampleTime();
+#endif
+#else
+    BaroAlt = 0;
+#endif
+
+    if (!altEstimatorReady) {
+        altitudeEstimatorInit(&altEstimator, altitudeEstimatorConfig()->alt_kf_acc_noise, ALT_KF_BIAS_NOISE);
+        altitudeEstimatorReset(&altEstimator, BaroAlt);
+        lastBaroSampleAt = baroSampledAt;
+        altEstimatorReady = true;
+    }
+    // follow cli changes without restarting the filter
+    altEstimator.accNoise = altitudeEstimatorConfig()->alt_kf_acc_noise;
+
+#ifdef SONAR
+    sonarAlt = sonarCalculateAltitude(sonarRead(), getCosTiltAngle());
+    if (sonarAlt > 0 && sonarAlt <= sonarMaxAltWithTiltCm) {
+        // sonar is read here, so its sample is current
+        altitudeEstimatorCorrect(&altEstimator, sonarAlt, altitudeEstimatorConfig()->alt_kf_sonar_noise, 0.0f);
+        if (sonarAlt < sonarCfAltCm) {
+            baroAlt_offset = BaroAlt - sonarAlt;
+        }
+    }
+    BaroAlt -= baroAlt_offset;
+#endif
+
+#ifdef BARO
+    // only fresh baro samples correct the filter, late by the time since they were taken
+    if (baroSampledAt != lastBaroSampleAt) {
+        lastBaroSampleAt = baroSampledAt;
+        altitudeEstimatorCorrect(&altEstimator, BaroAlt, altitudeEstimatorConfig()->alt_kf_baro_noise, (currentTime - baroSampledAt) * 1e-6f);
+    }
+#endif
+
+    // the accSum average only feeds the D term now
+    if (accSumCount) {
+        accZ_tmp = (float)accSum[2] / (float)accSumCount;
+    } else {
+        accZ_tmp = 0;
+    }
+    imuResetAccelerationSum();
+
+    EstAlt = lrintf(altEstimator.x[ALT_STATE_ALTITUDE]);
+    const int32_t vel_tmp = lrintf(altEstimator.x[ALT_STATE_VELOCITY]);
+
+#ifdef DEBUG_ALT_HOLD
+    debug[1] = lrintf(altEstimator.x[ALT_STATE_ACC_BIAS]);
+    debug[2] = vel_tmp;
+    debug[3] = EstAlt;
+#endif
+
+#ifdef NRF
+	flag.height = EstAlt;
+	debug[0] = EstAlt;
+#endif
+
+    vario = applyDeadband(vel_tmp, 5);
+
+    altHoldThrottleAdjustment = calculateAltHoldThrottleAdjustment(vel_tmp, accZ_tmp, accZ_old);
+
+    accZ_old = accZ_tmp;
+}
+
 void calculateEstimatedAltitude(uint32_t currentTime)
 {
     static uint32_t previousTime;
@@ -303,6 +419,12 @@ void calculateEstimatedAltitude(uint32_t currentTime)
     float sonarTransition;
 #endif
 
+    if (altitudeEstimatorConfig()->alt_estimator == ALT_ESTIMATOR_KALMAN) {
+        // the filter tracks fresh samples itself, the 40Hz gate would drop every other task run that comes in early
+        calculateEstimatedAltitudeKalman(currentTime);
+        return;
+    }
+
     dTime = currentTime - previousTime;
     if (dTime < BARO_UPDATE_FREQUENCY_40HZ)
         return;
@@ -32,7 +32,22 @@ typedef struct airplaneConfig_s {
 
 PG_DECLARE(airplaneConfig_t, airplaneConfig);
 
+typedef enum {
+    ALT_ESTIMATOR_CF = 0,                   // baro_cf_alt / baro_cf_vel complementary filter
+    ALT_ESTIMATOR_KALMAN
+} altitudeEstimatorType_e;
+
+typedef struct altitudeEstimatorConfig_s {
+    uint8_t alt_estimator;                  // see altitudeEstimatorType_e
+    uint16_t alt_kf_acc_noise;              // cm/s^2, accelerometer process noise
+    uint16_t alt_kf_baro_noise;             // cm, baro altitude measurement noise
+    uint16_t alt_kf_sonar_noise;            // cm, sonar altitude measurement noise
+} altitudeEstimatorConfig_t;
+
+PG_DECLARE(altitudeEstimatorConfig_t, altitudeEstimatorConfig);
+
 void calculateEstimatedAltitude(uint32_t currentTime);
+void altitudeEstimatorUpdateAcc(float accZ, float dT);
 
 void applyAltHold(void);
 void updateAltHoldState(void);
@@ -0,0 +1,111 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common/maths.h"
+
+#include "flight/flow_estimator.h"
+
+#define FLOW_ESTIMATOR_INITIAL_POS_VARIANCE     1.0f        // cm^2, hold starts at the current position
+#define FLOW_ESTIMATOR_INITIAL_VEL_VARIANCE     2500.0f     // (cm/s)^2
+
+static void flowKalmanReset(flowKalmanAxis_t *axis)
+{
+    memset(axis, 0, sizeof(*axis));
+    axis->P[0][0] = FLOW_ESTIMATOR_INITIAL_POS_VARIANCE;
+    axis->P[1][1] = FLOW_ESTIMATOR_INITIAL_VEL_VARIANCE;
+}
+
+void flowEstimatorInit(flowEstimator_t *estimator, float accNoise, float flowNoise, float posLimit)
+{
+    estimator->accNoise = accNoise;
+    estimator->flowNoise = flowNoise;
+    estimator->posLimit = posLimit;
+    flowEstimatorReset(estimator);
+}
+
+void flowEstimatorReset(flowEstimator_t *estimator)
+{
+    for (int i = 0; i < FLOW_AXIS_COUNT; i++) {
+        flowKalmanReset(&estimator->axis[i]);
+    }
+}
+
+// x = F x + B a, P = F P F' + Q with F = [1 dT; 0 1], B = [dT^2/2; dT] and Q = B B' accNoise^2
+static void flowKalmanPredict(flowKalmanAxis_t *axis, float acc, float dT, float accNoise)
+{
+    const float dT2 = dT * dT;
+    const float q = accNoise * accNoise;
+
+    axis->pos += axis->vel * dT + 0.5f * acc * dT2;
+    axis->vel += acc * dT;
+
+    const float p00 = axis->P[0][0] + dT * (axis->P[1][0] + axis->P[0][1]) + dT2 * axis->P[1][1];
+    const float p01 = axis->P[0][1] + dT * axis->P[1][1];
+    const float p11 = axis->P[1][1];
+
+    axis->P[0][0] = p00 + 0.25f * dT2 * dT2 * q;
+    axis->P[0][1] = p01 + 0.5f * dT2 * dT * q;
+    axis->P[1][0] = axis->P[0][1];
+    axis->P[1][1] = p11 + dT2 * q;
+}
+
+// velocity measurement, H = [0 1]
+static void flowKalmanUpdate(flowKalmanAxis_t *axis, float vel, float r)
+{
+    const float s = axis->P[1][1] + r;
+    if (s <= 0.0f) {
+        return;
+    }
+
+    const float k0 = axis->P[0][1] / s;
+    const float k1 = axis->P[1][1] / s;
+    const float innovation = vel - axis->vel;
+
+    axis->pos += k0 * innovation;
+    axis->vel += k1 * innovation;
+
+    const float p01 = axis->P[0][1];
+    const float p11 = axis->P[1][1];
+
+    axis->P[0][0] -= k0 * p01;
+    axis->P[0][1] -= k0 * p11;
+    axis->P[1][0] = axis->P[0][1];
+    axis->P[1][1] -= k1 * p11;
+}
+
+void flowEstimatorPredict(flowEstimator_t *estimator, const float acc[FLOW_AXIS_COUNT], float dT)
+{
+    for (int i = 0; i < FLOW_AXIS_COUNT; i++) {
+        flowKalmanPredict(&estimator->axis[i], acc[i], dT, estimator->accNoise);
+    }
+}
+
+// qualityScale >= 1 inflates the measurement noise for low quality flow frames
+void flowEstimatorUpdate(flowEstimator_t *estimator, const float vel[FLOW_AXIS_COUNT], float qualityScale)
+{
+    const float r = estimator->flowNoise * estimator->flowNoise * qualityScale;
+
+    for (int i = 0; i < FLOW_AXIS_COUNT; i++) {
+        flowKalmanAxis_t *axis = &estimator->axis[i];
+        flowKalmanUpdate(axis, vel[i], r);
+        axis->pos = constrainf(axis->pos, -estimator->posLimit, estimator->posLimit);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Horizontal position/velocity estimator for optical flow position hold.
+// One constant-acceleration Kalman filter per axis in the heading frame (level, aligned with yaw):
+// the earth-frame accelerometer drives the prediction, gyro-compensated flow scaled by height is the
+// velocity measurement.
+
+typedef enum {
+    FLOW_AXIS_X = 0,        // forward/back, follows pitch
+    FLOW_AXIS_Y,            // left/right, follows roll
+    FLOW_AXIS_COUNT
+} flowAxis_e;
+
+typedef struct flowKalmanAxis_s {
+    float pos;              // cm
+    float vel;              // cm/s
+    float P[2][2];          // state covariance
+} flowKalmanAxis_t;
+
+typedef struct flowEstimator_s {
+    flowKalmanAxis_t axis[FLOW_AXIS_COUNT];
+    float accNoise;         // cm/s^2, accelerometer process noise
+    float flowNoise;        // cm/s, flow velocity measurement noise
+    float posLimit;         // cm, position is held within +-posLimit
+} flowEstimator_t;
+
+void flowEstimatorInit(flowEstimator_t *estimator, float accNoise, float flowNoise, float posLimit);
+void flowEstimatorReset(flowEstimator_t *estimator);
+void flowEstimatorPredict(flowEstimator_t *estimator, const float acc[FLOW_AXIS_COUNT], float dT);
+void flowEstimatorUpdate(flowEstimator_t *estimator, const float vel[FLOW_AXIS_COUNT], float qualityScale);
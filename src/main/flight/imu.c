@@ -51,6 +51,7 @@
 #include "flight/mixer.h"
 #include "flight/pid.h"
 #include "flight/imu.h"
+#include "flight/altitudehold.h"
 
 #include "io/gps.h"
 
@@ -218,6 +219,10 @@ void imuCalculateAcceleration(uint32_t deltaT)
 
     accz_smooth = accz_smooth + (dT / (fc_acc + dT)) * (accel_ned.V.Z - accz_smooth); // low pass filter
 
+#if defined(BARO) || defined(SONAR)
+    altitudeEstimatorUpdateAcc(accz_smooth * accVelScale * 1e6f, dT);  // cm/s^2
+#endif
+
     // apply Deadband to reduce integration drift and vibration influence
     accSum[X] += applyDeadband(lrintf(accel_ned.V.X), accDeadband->xy);
     accSum[Y] += applyDeadband(lrintf(accel_ned.V.Y), accDeadband->xy);
@@ -35,7 +35,10 @@
     #define ONLY_EXPOSE_FOR_TESTING static
 #endif
 
+// Targets with RAM to spare can cache more sectors, so FAT and directory updates don't have to evict file data
+#ifndef AFATFS_NUM_CACHE_SECTORS
 #define AFATFS_NUM_CACHE_SECTORS 8
+#endif
 
 // FAT filesystems are allowed to differ from these parameters, but we choose not to support those weird filesystems:
 #define AFATFS_SECTOR_SIZE  512
@@ -80,6 +83,8 @@
 #define AFATFS_CACHE_DISCARDABLE  8
 // Increase the retain counter of the cache sector to prevent it from being discarded when in the in-sync state
 #define AFATFS_CACHE_RETAIN       16
+// This sector holds FAT or directory entries, so when it's in sync, discard file data in preference to it
+#define AFATFS_CACHE_METADATA     32
 
 // Turn the largest free block on the disk into one contiguous file for efficient fragment-free allocation
 #define AFATFS_USE_FREEFILE
@@ -191,6 +196,18 @@ typedef struct afatfsCacheBlockDescriptor_t {
      * is overridden by the locked and retainCount flags.
      */
     unsigned discardable:1;
+
+    /*
+     * This sector holds FAT or directory entries. These are small, frequently revisited and slow to re-read at a time
+     * we're waiting on them, so they are only evicted when there's no in-sync file data left to evict instead.
+     */
+    unsigned metadata:1;
+
+    /*
+     * Set when a read was issued because somebody asked for this sector (as opposed to reading ahead), so their retry
+     * once it arrives isn't counted as a cache hit.
+     */
+    unsigned demandRead:1;
 } afatfsCacheBlockDescriptor_t;
 
 typedef enum {
@@ -440,6 +457,7 @@ typedef struct afatfs_t {
     uint8_t cache[AFATFS_SECTOR_SIZE * AFATFS_NUM_CACHE_SECTORS];
     afatfsCacheBlockDescriptor_t cacheDescriptor[AFATFS_NUM_CACHE_SECTORS];
     uint32_t cacheTimer;
+    afatfsCacheStats_t cacheStats;
 
     int cacheDirtyEntries; // The number of cache entries in the AFATFS_CACHE_STATE_DIRTY state
     bool cacheFlushInProgress;
@@ -615,6 +633,8 @@ static void afatfs_cacheSectorInit(afatfsCacheBlockDescriptor_t *descriptor, uin
     descriptor->locked = locked;
     descriptor->retainCount = 0;
     descriptor->discardable = 0;
+    descriptor->metadata = 0;
+    descriptor->demandRead = 0;
 }
 
 /**
@@ -723,6 +743,20 @@ static afatfsCacheBlockDescriptor_t* afatfs_findCacheSector(uint32_t sectorIndex
     return NULL;
 }
 
+/**
+ * Returns true if the given sector is in the cache in any state other than empty (including still being read).
+ */
+static bool afatfs_isSectorCached(uint32_t sectorIndex)
+{
+    for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
+        if (afatfs.cacheDescriptor[i].sectorIndex == sectorIndex && afatfs.cacheDescriptor[i].state != AFATFS_CACHE_STATE_EMPTY) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /**
  * Find or allocate a cache sector for the given sector index on disk. Returns a block which matches one of these
  * conditions (in descending order of preference):
@@ -730,11 +764,12 @@ static afatfsCacheBlockDescriptor_t* afatfs_findCacheSector(uint32_t sectorIndex
  * - The requested sector that already exists in the cache
  * - The index of an empty sector
  * - The index of a synced discardable sector
- * - The index of the oldest synced sector
+ * - The index of the least recently used synced file data sector
+ * - The index of the least recently used synced metadata sector (only if allowMetadataEviction)
  *
  * Otherwise it returns -1 to signal failure (cache is full!)
  */
-static int afatfs_allocateCacheSector(uint32_t sectorIndex)
+static int afatfs_allocateCacheSector(uint32_t sectorIndex, bool allowMetadataEviction)
 {
     int allocateIndex;
     int emptyIndex = -1, discardableIndex = -1;
@@ -742,6 +777,9 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
     uint32_t oldestSyncedSectorLastUse = 0xFFFFFFFF;
     int oldestSyncedSectorIndex = -1;
 
+    uint32_t oldestSyncedMetadataLastUse = 0xFFFFFFFF;
+    int oldestSyncedMetadataIndex = -1;
+
     if (
         !afatfs_assert(
             afatfs.numClusters == 0 // We're unable to check sector bounds during startup since we haven't read volume label yet
@@ -776,6 +814,11 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
                 if (!afatfs.cacheDescriptor[i].locked && afatfs.cacheDescriptor[i].retainCount == 0) {
                     if (afatfs.cacheDescriptor[i].discardable) {
                         discardableIndex = i;
+                    } else if (afatfs.cacheDescriptor[i].metadata) {
+                        if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedMetadataLastUse) {
+                            oldestSyncedMetadataLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
+                            oldestSyncedMetadataIndex = i;
+                        }
                     } else if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedSectorLastUse) {
                         // This is older than last block we decided to evict, so evict this one in preference
                         oldestSyncedSectorLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
@@ -794,17 +837,52 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
         allocateIndex = discardableIndex;
     } else if (oldestSyncedSectorIndex > -1) {
         allocateIndex = oldestSyncedSectorIndex;
+    } else if (oldestSyncedMetadataIndex > -1 && allowMetadataEviction) {
+        allocateIndex = oldestSyncedMetadataIndex;
     } else {
         allocateIndex = -1;
     }
 
     if (allocateIndex > -1) {
+        if (allocateIndex != emptyIndex) {
+            afatfs.cacheStats.evictions++;
+        }
+
         afatfs_cacheSectorInit(&afatfs.cacheDescriptor[allocateIndex], sectorIndex, false);
     }
 
     return allocateIndex;
 }
 
+/**
+ * Start reading the given sector into the cache in the background if the card is idle. Only empty slots and in-sync
+ * file data are given up for it. The sector is marked discardable since sequentially-read data isn't read twice.
+ */
+static void afatfs_cacheSectorReadAhead(uint32_t physicalSectorIndex)
+{
+    if (afatfs_isSectorCached(physicalSectorIndex)) {
+        // Already cached or on its way
+        return;
+    }
+
+    if (!sdcard_poll()) {
+        // Don't get in the way of anything the card is already busy with
+        return;
+    }
+
+    int cacheSectorIndex = afatfs_allocateCacheSector(physicalSectorIndex, false);
+
+    if (cacheSectorIndex == -1) {
+        return;
+    }
+
+    if (sdcard_readBlock(physicalSectorIndex, afatfs_cacheSectorGetMemory(cacheSectorIndex), afatfs_sdcardReadComplete, 0)) {
+        afatfs.cacheDescriptor[cacheSectorIndex].state = AFATFS_CACHE_STATE_READING;
+        afatfs.cacheDescriptor[cacheSectorIndex].discardable = 1;
+        afatfs.cacheStats.readAheads++;
+    }
+}
+
 /**
  * Attempt to flush dirty cache pages out to the sdcard, returning true if all flushable data has been flushed.
  */
@@ -902,13 +980,24 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
         return AFATFS_OPERATION_FAILURE;
     }
 
-    int cacheSectorIndex = afatfs_allocateCacheSector(physicalSectorIndex);
+    int cacheSectorIndex = afatfs_allocateCacheSector(physicalSectorIndex, true);
 
     if (cacheSectorIndex == -1) {
         // We don't have enough free cache to service this request right now, try again later
         return AFATFS_OPERATION_IN_PROGRESS;
     }
 
+    if (afatfs.cacheDescriptor[cacheSectorIndex].state != AFATFS_CACHE_STATE_EMPTY
+        && afatfs.cacheDescriptor[cacheSectorIndex].state != AFATFS_CACHE_STATE_READING
+    ) {
+        if (afatfs.cacheDescriptor[cacheSectorIndex].demandRead) {
+            // This is the caller that missed coming back for the sector it had us read
+            afatfs.cacheDescriptor[cacheSectorIndex].demandRead = 0;
+        } else {
+            afatfs.cacheStats.hits++;
+        }
+    }
+
     switch (afatfs.cacheDescriptor[cacheSectorIndex].state) {
         case AFATFS_CACHE_STATE_READING:
             return AFATFS_OPERATION_IN_PROGRESS;
@@ -918,6 +1007,8 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             if ((sectorFlags & AFATFS_CACHE_READ) != 0) {
                 if (sdcard_readBlock(physicalSectorIndex, afatfs_cacheSectorGetMemory(cacheSectorIndex), afatfs_sdcardReadComplete, 0)) {
                     afatfs.cacheDescriptor[cacheSectorIndex].state = AFATFS_CACHE_STATE_READING;
+                    afatfs.cacheDescriptor[cacheSectorIndex].demandRead = 1;
+                    afatfs.cacheStats.misses++;
                 }
                 return AFATFS_OPERATION_IN_PROGRESS;
             }
@@ -952,6 +1043,9 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             if ((sectorFlags & AFATFS_CACHE_RETAIN) != 0) {
                 afatfs.cacheDescriptor[cacheSectorIndex].retainCount++;
             }
+            if ((sectorFlags & AFATFS_CACHE_METADATA) != 0) {
+                afatfs.cacheDescriptor[cacheSectorIndex].metadata = 1;
+            }
 
             *buffer = afatfs_cacheSectorGetMemory(cacheSectorIndex);
 
@@ -1095,7 +1189,7 @@ static afatfsOperationStatus_e afatfs_FATGetNextCluster(int fatIndex, uint32_t c
 
     afatfs_getFATPositionForCluster(cluster, &fatSectorIndex, &fatSectorEntryIndex);
 
-    afatfsOperationStatus_e result = afatfs_cacheSector(afatfs_fatSectorToPhysical(fatIndex, fatSectorIndex), &sector.bytes, AFATFS_CACHE_READ, 0);
+    afatfsOperationStatus_e result = afatfs_cacheSector(afatfs_fatSectorToPhysical(fatIndex, fatSectorIndex), &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_METADATA, 0);
 
     if (result == AFATFS_OPERATION_SUCCESS) {
         if (afatfs.filesystemType == FAT_FILESYSTEM_TYPE_FAT16) {
@@ -1130,7 +1224,7 @@ static afatfsOperationStatus_e afatfs_FATSetNextCluster(uint32_t startCluster, u
 
     fatPhysicalSector = afatfs_fatSectorToPhysical(0, fatSectorIndex);
 
-    result = afatfs_cacheSector(fatPhysicalSector, &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE, 0);
+    result = afatfs_cacheSector(fatPhysicalSector, &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
     if (result == AFATFS_OPERATION_SUCCESS) {
         if (afatfs.filesystemType == FAT_FILESYSTEM_TYPE_FAT16) {
@@ -1436,7 +1530,7 @@ static afatfsOperationStatus_e afatfs_saveDirectoryEntry(afatfsFilePtr_t file, a
         return AFATFS_OPERATION_SUCCESS; // Root directories don't have a directory entry
     }
 
-    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE, 0);
+    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
 #ifdef AFATFS_DEBUG_VERBOSE
     fprintf(stderr, "Saving directory entry to sector %u...\n", file->directoryEntryPos.sectorNumberPhysical);
@@ -1812,10 +1906,16 @@ static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file)
 
         afatfs_assert(physicalSector > 0); // We never read the root sector using files
 
+        uint8_t cacheFlags = AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN;
+
+        if (file->type != AFATFS_FILE_TYPE_NORMAL) {
+            cacheFlags |= AFATFS_CACHE_METADATA;
+        }
+
         afatfsOperationStatus_e status = afatfs_cacheSector(
             physicalSector,
             &result,
-            AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN,
+            cacheFlags,
             0
         );
 
@@ -2216,7 +2316,7 @@ static afatfsOperationStatus_e afatfs_extendSubdirectoryContinue(afatfsFile_t *d
             physicalSector = afatfs_fileGetCursorPhysicalSector(directory);
 
             while (1) {
-                status = afatfs_cacheSector(physicalSector, &sectorBuffer, AFATFS_CACHE_WRITE, 0);
+                status = afatfs_cacheSector(physicalSector, &sectorBuffer, AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
                 if (status != AFATFS_OPERATION_SUCCESS) {
                     return status;
@@ -2629,7 +2729,7 @@ static void afatfs_createFileContinue(afatfsFile_t *file)
                 status = afatfs_cacheSector(
                     file->directoryEntryPos.sectorNumberPhysical,
                     &directorySector,
-                    AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN,
+                    AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN | AFATFS_CACHE_METADATA,
                     0
                 );
 
@@ -3088,6 +3188,33 @@ uint32_t afatfs_fwrite(afatfsFilePtr_t file, const uint8_t *buffer, uint32_t len
     return writtenBytes;
 }
 
+/**
+ * Fetch the sector at the cursor (or the one after it, if we've already got that) in the background, so that a
+ * sequential reader like a log download finds its next sector waiting for it. We don't look past the end of the cursor's
+ * cluster since finding the next cluster would need a FAT lookup.
+ */
+static void afatfs_fileReadAhead(afatfsFilePtr_t file)
+{
+    if (file->type != AFATFS_FILE_TYPE_NORMAL || afatfs_fileIsBusy(file) || afatfs_isEndOfAllocatedFile(file)
+        || file->cursorOffset >= file->logicalSize) {
+        return;
+    }
+
+    uint32_t physicalSector = afatfs_fileGetCursorPhysicalSector(file);
+
+    if (afatfs_isSectorCached(physicalSector)) {
+        uint32_t offsetOfNextSector = (file->cursorOffset & ~((uint32_t) AFATFS_SECTOR_SIZE - 1)) + AFATFS_SECTOR_SIZE;
+
+        if (offsetOfNextSector >= file->logicalSize || afatfs_sectorIndexInCluster(file->cursorOffset) + 1 >= afatfs.sectorsPerCluster) {
+            return;
+        }
+
+        physicalSector++;
+    }
+
+    afatfs_cacheSectorReadAhead(physicalSector);
+}
+
 /**
  * Attempt to read `len` bytes from `file` into the `buffer`.
  *
@@ -3131,7 +3258,7 @@ uint32_t afatfs_fread(afatfsFilePtr_t file, uint8_t *buffer, uint32_t len)
         sectorBuffer = afatfs_fileRetainCursorSectorForRead(file);
         if (!sectorBuffer) {
             // Cache is currently busy
-            return readBytes;
+            break;
         }
 
         memcpy(buffer, sectorBuffer + cursorOffsetInSector, bytesToReadThisSector);
@@ -3154,6 +3281,8 @@ uint32_t afatfs_fread(afatfsFilePtr_t file, uint8_t *buffer, uint32_t len)
         cursorOffsetInSector = 0;
     }
 
+    afatfs_fileReadAhead(file);
+
     return readBytes;
 }
 
@@ -3566,6 +3695,11 @@ afatfsError_e afatfs_getLastError()
     return afatfs.lastError;
 }
 
+const afatfsCacheStats_t *afatfs_getCacheStats()
+{
+    return &afatfs.cacheStats;
+}
+
 void afatfs_init()
 {
     afatfs.filesystemState = AFATFS_FILESYSTEM_STATE_INITIALIZATION;
@@ -44,6 +44,13 @@ typedef enum {
     AFATFS_ERROR_BAD_FILESYSTEM_HEADER = 3
 } afatfsError_e;
 
+typedef struct afatfsCacheStats_t {
+    uint32_t hits;          // Requests served from a sector that was already cached
+    uint32_t misses;        // Requests which had to wait for the sector to be read from the card
+    uint32_t evictions;     // In-sync sectors discarded to make room for another
+    uint32_t readAheads;    // Sectors read in the background ahead of a sequential reader
+} afatfsCacheStats_t;
+
 typedef struct afatfsDirEntryPointer_t {
     uint32_t sectorNumberPhysical;
     int16_t entryIndex;
@@ -90,3 +97,4 @@ bool afatfs_isFull();
 
 afatfsFilesystemState_e afatfs_getFilesystemState();
 afatfsError_e afatfs_getLastError();
+const afatfsCacheStats_t *afatfs_getCacheStats();
@@ -25,6 +25,17 @@
  * Note that bits can only be set to 0 when writing, not back to 1 from 0. You must erase sectors in order
  * to bring bits back to 1 again.
  *
+ * flashfsEraseCompletely() formats the device with a log directory in its first sector. The directory is an append-only
+ * list of 16-byte entries: a header, one entry per log (programmed once when the log opens and again with its length
+ * when it closes, which works since the length field is still erased) and one entry per background erase block, which
+ * is programmed before the erase starts and marked complete afterwards. The
+ * remaining erase blocks form a ring addressed by ever-increasing offsets, so a log is still intact as long as its start
+ * lies within one ring's length of the erase front. A device without a directory is used linearly as before.
+ *
+ * When the directory fills up it is compacted into the other of the first two sectors. The header, which carries a
+ * generation number, is programmed last, so the old directory stays the valid one until the new one is complete, and
+ * it is only erased by the compaction after that.
+ *
  * In future, we can add support for multiple different flash chips by adding a flash device driver vtable
  * and make calls through that, at the moment flashfs just calls m25p16_* routines explicitly.
  */
@@ -33,11 +44,111 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include <platform.h>
+
+#include "common/maths.h"
+
 #include "drivers/flash_m25p16.h"
+#include "drivers/system.h"
 #include "flashfs.h"
 
+#if FLASHFS_WRITE_BUFFER_SIZE >= 2 * M25P16_PAGESIZE
+#define FLASHFS_PAGE_PIPELINE
+#endif
+
 static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
 
+static flashfsStats_t flashfsStats;
+
+#define FLASHFS_DIRECTORY_MAGIC 0x474F4C46 // "FLOG"
+#define FLASHFS_DIRECTORY_VERSION 2
+#define FLASHFS_DIRECTORY_SECTORS 2
+
+#define FLASHFS_NO_SLOT 0 // Slot 0 holds the header, so no log is ever stored there
+#define FLASHFS_LOG_OPEN 0xFFFFFFFF // Length of a log which hasn't been closed (an erased length field)
+#define FLASHFS_NO_ADDRESS 0xFFFFFFFF
+
+#define FLASHFS_ERASE_FLAG_INCOMPLETE 0x01 // Cleared once the erase has finished
+
+#define FLASHFS_PENDING_ENTRIES 4
+
+typedef enum {
+    FLASHFS_ENTRY_HEADER = 'H',
+    FLASHFS_ENTRY_LOG    = 'L',
+    FLASHFS_ENTRY_ERASE  = 'E',
+    FLASHFS_ENTRY_UNLISTED = 'U',
+    FLASHFS_ENTRY_FREE   = 0xFF
+} flashfsEntryType_e;
+
+typedef struct flashfsDirectoryEntry_s {
+    uint8_t type;
+    uint8_t flags;      // Header: format version, erase: FLASHFS_ERASE_FLAG_INCOMPLETE until the erase has finished
+    uint16_t padding;
+    uint32_t address;   // Header: magic, log: start offset, erase: erase front after the erase, unlisted: its start
+    uint32_t length;    // Header: generation, log: length, or FLASHFS_LOG_OPEN
+    uint32_t reserved;
+} flashfsDirectoryEntry_t;
+
+typedef struct flashfsLogRecord_s {
+    flashfsLog_t log;
+    uint16_t slot;
+} flashfsLogRecord_t;
+
+typedef struct flashfsPendingEntry_s {
+    uint32_t address;
+    flashfsDirectoryEntry_t entry;
+} flashfsPendingEntry_t;
+
+typedef enum {
+    FLASHFS_STATE_IDLE,
+    FLASHFS_STATE_ERASING_SECTOR,
+    FLASHFS_STATE_ERASING_DIRECTORY,
+    FLASHFS_STATE_WRITING_DIRECTORY
+} flashfsState_e;
+
+static bool flashfsDirectoryMounted = false;
+static flashfsState_e flashfsState = FLASHFS_STATE_IDLE;
+static bool flashfsFormatPending = false;
+
+// The ring of log sectors, the whole device if there's no directory
+static uint32_t regionStart = 0, regionSize = 0;
+static uint32_t eraseBlockSize = 0;
+
+// The next sector to erase in the erase block that's currently being erased, and the slot which records that erase
+static uint32_t erasingOffset = 0;
+static uint16_t erasingSlot;
+
+/*
+ * Offsets from the tail up to here have been erased. Offsets only ever grow and wrap around the ring when they're
+ * converted to device addresses, which gives us about 2000 complete passes over a 2MB device before they overflow.
+ */
+static uint32_t eraseFront = 0;
+
+static uint16_t directorySlots, nextDirectorySlot;
+
+// The directory in use, and the one a compaction is writing along with its progress
+static uint32_t directoryAddress, rewriteAddress;
+static uint32_t directoryGeneration;
+static uint16_t directoryWriteCursor;
+static int directoryWriteLog;
+static bool unlistedEntryWritten;
+
+// Logs from oldest to newest. If a log is open, it is the last one
+static flashfsLogRecord_t flashfsLogs[FLASHFS_MAX_LOGS];
+static int flashfsLogCount = 0;
+static bool flashfsLogIsOpen = false;
+
+/*
+ * The start of the oldest log which is still intact but was dropped from flashfsLogs to make room for newer ones, or
+ * FLASHFS_NO_ADDRESS. Downloads begin here rather than at the oldest listed log, until the erase front reclaims it.
+ */
+static uint32_t unlistedDataStart = FLASHFS_NO_ADDRESS;
+
+static flashfsPendingEntry_t pendingEntries[FLASHFS_PENDING_ENTRIES];
+static int pendingEntryCount = 0;
+
+static void flashfsBeginDirectoryRewrite();
+
 /* The position of our head and tail in the circular flash write buffer.
  *
  * The head is the index that a byte would be inserted into on writing, while the tail is the index of the
@@ -45,7 +156,7 @@ static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
  *
  * When the circular buffer is empty, head == tail
  */
-static uint8_t bufferHead = 0, bufferTail = 0;
+static uint16_t bufferHead = 0, bufferTail = 0;
 
 // The position of the buffer's tail in the overall flash address space:
 static uint32_t tailAddress = 0;
@@ -65,13 +176,66 @@ static void flashfsSetTailAddress(uint32_t address)
     tailAddress = address;
 }
 
+/**
+ * Convert a flashfs offset into an address on the device.
+ */
+static uint32_t flashfsPhysicalAddress(uint32_t offset)
+{
+    if (offset < regionStart) {
+        return offset;
+    }
+
+    return regionStart + (offset - regionStart) % regionSize;
+}
+
+static void flashfsSetRegion(uint32_t start)
+{
+    regionStart = start;
+    regionSize = flashfsGetSize() - start;
+}
+
+/**
+ * Lay out a formatted volume: the directory lives in one of the first two sectors, the ring of logs starts at the next
+ * erase block.
+ */
+static void flashfsSetDirectoryLayout()
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+    const uint32_t directorySize = FLASHFS_DIRECTORY_SECTORS * geometry->sectorSize;
+
+    eraseBlockSize = MAX(geometry->sectorSize, FLASHFS_ERASE_BLOCK_SIZE);
+    directorySlots = MIN(geometry->sectorSize / sizeof(flashfsDirectoryEntry_t), UINT16_MAX);
+
+    flashfsSetRegion((directorySize + eraseBlockSize - 1) / eraseBlockSize * eraseBlockSize);
+}
+
+/**
+ * Erase the whole device and format it with an empty log directory. The chip erase takes many seconds, flashfsIsReady()
+ * will return true once the directory has been written.
+ */
 void flashfsEraseCompletely()
 {
     m25p16_eraseCompletely();
 
     flashfsClearBuffer();
 
-    flashfsSetTailAddress(0);
+    flashfsLogCount = 0;
+    flashfsLogIsOpen = false;
+    unlistedDataStart = FLASHFS_NO_ADDRESS;
+
+    flashfsSetDirectoryLayout();
+    flashfsSetTailAddress(regionStart);
+
+    // Nothing may be written until the erase completes, then the whole ring is available
+    eraseFront = regionStart;
+
+    // The first directory goes in the first sector
+    directoryAddress = rewriteAddress = 0;
+    directoryGeneration = 0;
+
+    flashfsDirectoryMounted = true;
+    flashfsFormatPending = true;
+    flashfsBeginDirectoryRewrite();
 }
 
 /**
@@ -102,11 +266,11 @@ void flashfsEraseRange(uint32_t start, uint32_t end)
 }
 
 /**
- * Return true if the flash is not currently occupied with an operation.
+ * Return true if the flash is not currently occupied with an operation (including formatting it).
  */
 bool flashfsIsReady()
 {
-    return m25p16_isReady();
+    return !flashfsFormatPending && m25p16_isReady();
 }
 
 uint32_t flashfsGetSize()
@@ -143,6 +307,31 @@ const flashGeometry_t* flashfsGetGeometry()
     return m25p16_getGeometry();
 }
 
+const flashfsStats_t *flashfsGetStats()
+{
+    return &flashfsStats;
+}
+
+void flashfsResetStats()
+{
+    memset(&flashfsStats, 0, sizeof(flashfsStats));
+
+    flashfsStats.resetAt = millis();
+}
+
+/**
+ * The amount of buffered data at which a write should try to flush the buffer through to the flash.
+ */
+static uint32_t flashfsAutoFlushThreshold()
+{
+#ifdef FLASHFS_PAGE_PIPELINE
+    // Wait until the rest of the current page is buffered, so that background programs are always whole pages
+    return M25P16_PAGESIZE - tailAddress % M25P16_PAGESIZE;
+#else
+    return FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN;
+#endif
+}
+
 /**
  * Write the given buffers to flash sequentially at the current tail address, advancing the tail address after
  * each write.
@@ -173,6 +362,7 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
     }
 
     if (!sync && !m25p16_isReady()) {
+        flashfsStats.busyStalls++;
         return 0;
     }
 
@@ -200,7 +390,7 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
             break;
         }
 
-        m25p16_pageProgramBegin(tailAddress);
+        m25p16_pageProgramBegin(flashfsPhysicalAddress(tailAddress));
 
         bytesRemainThisIteration = bytesTotalThisIteration;
 
@@ -229,6 +419,9 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
 
         m25p16_pageProgramFinish();
 
+        flashfsStats.programOperations++;
+        flashfsStats.bytesProgrammed += bytesTotalThisIteration;
+
         bytesTotalRemaining -= bytesTotalThisIteration;
 
         // Advance the cursor in the file system to match the bytes we wrote
@@ -320,6 +513,21 @@ bool flashfsFlushAsync()
     return flashfsBufferIsEmpty();
 }
 
+/**
+ * Housekeeping flush to call regularly while writing. If the buffer is a page pipeline, this only programs the next page
+ * once all of it has been buffered, otherwise it's the same as flashfsFlushAsync().
+ */
+void flashfsFlushPagesAsync()
+{
+#ifdef FLASHFS_PAGE_PIPELINE
+    if (flashfsTransmitBufferUsed() < flashfsAutoFlushThreshold()) {
+        return;
+    }
+#endif
+
+    flashfsFlushAsync();
+}
+
 /**
  * Wait for the flash to become ready and begin flushing any buffered data to flash.
  *
@@ -361,13 +569,18 @@ void flashfsSeekRel(int32_t offset)
  */
 void flashfsWriteByte(uint8_t byte)
 {
+    if (flashfsTransmitBufferUsed() >= FLASHFS_WRITE_BUFFER_USABLE) {
+        flashfsStats.bytesDropped++;
+        return;
+    }
+
     flashWriteBuffer[bufferHead++] = byte;
 
     if (bufferHead >= FLASHFS_WRITE_BUFFER_SIZE) {
         bufferHead = 0;
     }
 
-    if (flashfsTransmitBufferUsed() >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
+    if (flashfsTransmitBufferUsed() >= flashfsAutoFlushThreshold()) {
         flashfsFlushAsync();
     }
 }
@@ -394,7 +607,7 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync)
      * Would writing this data to our buffer cause our buffer to reach the flush threshold? If so try to write through
      * to the flash now
      */
-    if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
+    if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] >= flashfsAutoFlushThreshold()) {
         uint32_t bytesWritten;
 
         // Attempt to write all three buffers through to the flash asynchronously
@@ -424,6 +637,7 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync)
                  * Silently drop the data the user asked to write (i.e. no-op) since we can't buffer it and they
                  * requested async.
                  */
+                flashfsStats.bytesDropped += bufferSizes[2];
             }
 
             return;
@@ -480,17 +694,87 @@ int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
 }
 
 /**
- * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ * Read from the given flashfs offset, wrapping around the end of the ring.
+ */
+static int flashfsReadOffset(uint32_t offset, uint8_t *buffer, unsigned int len)
+{
+    uint32_t address = flashfsPhysicalAddress(offset);
+    uint32_t beforeWrap = flashfsGetSize() - address;
+
+    if (len > beforeWrap) {
+        int bytesRead = m25p16_readBytes(address, buffer, beforeWrap);
+
+        if (bytesRead < (int) beforeWrap) {
+            return bytesRead;
+        }
+
+        return bytesRead + m25p16_readBytes(regionStart, buffer + beforeWrap, len - beforeWrap);
+    }
+
+    return m25p16_readBytes(address, buffer, len);
+}
+
+/**
+ * Get the offset where downloads begin: the oldest log which is still intact, or the oldest data which hasn't been
+ * reclaimed if no log is known. Without a directory this is the start of the device.
+ */
+static uint32_t flashfsGetDataStart()
+{
+    if (unlistedDataStart != FLASHFS_NO_ADDRESS) {
+        return unlistedDataStart;
+    }
+
+    if (flashfsLogCount > 0) {
+        return flashfsLogs[0].log.start;
+    }
+
+    // The block at the erase front holds the oldest data, unless it's being erased right now
+    const uint32_t reclaimedFront = eraseFront + (flashfsState == FLASHFS_STATE_ERASING_SECTOR ? eraseBlockSize : 0);
+
+    return reclaimedFront >= regionStart + regionSize ? reclaimedFront - regionSize : regionStart;
+}
+
+/**
+ * Get the number of bytes a download covers, from the oldest intact log up to the current write position.
+ */
+uint32_t flashfsGetUsedSize()
+{
+    return flashfsGetOffset() - flashfsGetDataStart();
+}
+
+/**
+ * Read from the volume as a download sees it: a single file which starts at the oldest intact log (address 0) and holds
+ * the data in the order it was written, without the directory sector and without a seam where the ring wraps around.
+ *
+ * Returns the number of bytes actually read which may be less than that requested.
+ */
+int flashfsReadLinear(uint32_t address, uint8_t *buffer, unsigned int len)
+{
+    const uint32_t usedSize = flashfsGetUsedSize();
+
+    if (address >= usedSize) {
+        return 0;
+    }
+
+    len = MIN(len, usedSize - address);
+
+    // Since the read could overlap data in our dirty buffers, force a sync to clear those first
+    flashfsFlushSync();
+
+    return flashfsReadOffset(flashfsGetDataStart() + address, buffer, len);
+}
+
+/**
+ * Find the offset of the start of the free space in [start...end) (or end if there is none).
  */
-int flashfsIdentifyStartOfFreeSpace()
+static uint32_t flashfsIdentifyStartOfFreeSpace(uint32_t start, uint32_t end)
 {
     /* Find the start of the free space on the device by examining the beginning of blocks with a binary search,
      * looking for ones that appear to be erased. We can achieve this with good accuracy because an erased block
      * is all bits set to 1, which pretty much never appears in reasonable size substrings of blackbox logs.
      *
-     * To do better we might write a volume header instead, which would mark how much free space remains. But keeping
-     * a header up to date while logging would incur more writes to the flash, which would consume precious write
-     * bandwidth and block more often.
+     * The log directory gives us a good place to start searching from, but it isn't updated while logging (which
+     * would consume precious write bandwidth), so the end of the last log still has to be found this way.
      */
 
     enum {
@@ -510,7 +794,8 @@ int flashfsIdentifyStartOfFreeSpace()
     } testBuffer;
 
     int left = 0; // Smallest block index in the search region
-    int right = flashfsGetSize() / FREE_BLOCK_SIZE; // One past the largest block index in the search region
+    int right = (end - start) / FREE_BLOCK_SIZE; // One past the largest block index in the search region
+    int blockCount = right;
     int mid;
     int result = right;
     int i;
@@ -519,7 +804,7 @@ int flashfsIdentifyStartOfFreeSpace()
     while (left < right) {
         mid = (left + right) / 2;
 
-        if (m25p16_readBytes(mid * FREE_BLOCK_SIZE, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
+        if (flashfsReadOffset(start + mid * FREE_BLOCK_SIZE, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
             // Unexpected timeout from flash, so bail early (reporting the device fuller than it really is)
             break;
         }
@@ -545,7 +830,11 @@ int flashfsIdentifyStartOfFreeSpace()
         }
     }
 
-    return result * FREE_BLOCK_SIZE;
+    if (result == blockCount) {
+        return end;
+    }
+
+    return start + result * FREE_BLOCK_SIZE;
 }
 
 /**
@@ -553,7 +842,452 @@ int flashfsIdentifyStartOfFreeSpace()
  */
 bool flashfsIsEOF()
 {
-    return tailAddress >= flashfsGetSize();
+    return tailAddress >= eraseFront;
+}
+
+bool flashfsHasDirectory()
+{
+    return flashfsDirectoryMounted;
+}
+
+/**
+ * Get the number of bytes that can be written before the device is full (or the background erase has to catch up).
+ */
+uint32_t flashfsGetErasedSpace()
+{
+    uint32_t offset = flashfsGetOffset();
+
+    return offset < eraseFront ? eraseFront - offset : 0;
+}
+
+int flashfsGetLogCount()
+{
+    return flashfsLogCount;
+}
+
+/**
+ * Fetch the log with the given index (0 is the oldest one still on the device). A log which is still open reports the
+ * length written so far.
+ */
+bool flashfsGetLog(int index, flashfsLog_t *log)
+{
+    if (index < 0 || index >= flashfsLogCount) {
+        return false;
+    }
+
+    *log = flashfsLogs[index].log;
+
+    if (log->length == FLASHFS_LOG_OPEN) {
+        log->length = flashfsGetOffset() - log->start;
+    }
+
+    return true;
+}
+
+static void flashfsProgramEntry(uint32_t address, const flashfsDirectoryEntry_t *entry)
+{
+    m25p16_pageProgram(address, (const uint8_t *) entry, sizeof(*entry));
+}
+
+static void flashfsMakeEntry(flashfsDirectoryEntry_t *entry, uint8_t type, uint8_t flags, uint32_t address, uint32_t length)
+{
+    memset(entry, 0xFF, sizeof(*entry));
+
+    entry->type = type;
+    entry->flags = flags;
+    entry->address = address;
+    entry->length = length;
+}
+
+/**
+ * Program the oldest queued directory entry. If sync is false and the flash is busy, do nothing.
+ */
+static void flashfsWritePendingEntry(bool sync)
+{
+    if (pendingEntryCount == 0 || (!sync && !m25p16_isReady())) {
+        return;
+    }
+
+    flashfsProgramEntry(pendingEntries[0].address, &pendingEntries[0].entry);
+
+    pendingEntryCount--;
+    memmove(&pendingEntries[0], &pendingEntries[1], pendingEntryCount * sizeof(pendingEntries[0]));
+}
+
+/**
+ * Queue a directory entry to be programmed in the background, so that callers never wait for a sector erase.
+ */
+static void flashfsQueueEntry(uint16_t slot, uint8_t type, uint8_t flags, uint32_t address, uint32_t length)
+{
+    // While the directory sector is being erased, its contents will be rewritten from our RAM copy instead
+    if (slot == FLASHFS_NO_SLOT || flashfsState == FLASHFS_STATE_ERASING_DIRECTORY) {
+        return;
+    }
+
+    if (pendingEntryCount == FLASHFS_PENDING_ENTRIES) {
+        flashfsWritePendingEntry(true);
+    }
+
+    // Slots handed out while a compaction is writing belong to the new directory
+    pendingEntries[pendingEntryCount].address = (flashfsState == FLASHFS_STATE_WRITING_DIRECTORY ? rewriteAddress : directoryAddress)
+        + slot * sizeof(flashfsDirectoryEntry_t);
+    flashfsMakeEntry(&pendingEntries[pendingEntryCount].entry, type, flags, address, length);
+
+    pendingEntryCount++;
+}
+
+static uint16_t flashfsAllocateSlot()
+{
+    if (flashfsState == FLASHFS_STATE_ERASING_DIRECTORY || flashfsState == FLASHFS_STATE_WRITING_DIRECTORY
+            || nextDirectorySlot >= directorySlots) {
+        // We'll assign a slot when the directory is rewritten (or the directory is full and the log goes unrecorded)
+        return FLASHFS_NO_SLOT;
+    }
+
+    return nextDirectorySlot++;
+}
+
+static void flashfsDropOldestLog()
+{
+    flashfsLogCount--;
+    memmove(&flashfsLogs[0], &flashfsLogs[1], flashfsLogCount * sizeof(flashfsLogs[0]));
+
+    if (flashfsState == FLASHFS_STATE_WRITING_DIRECTORY && directoryWriteLog > 0) {
+        directoryWriteLog--;
+    }
+
+    if (flashfsLogCount == 0) {
+        flashfsLogIsOpen = false;
+    }
+}
+
+/**
+ * Drop the oldest log from the list to make room for a newer one. It stays on the device and in downloads.
+ */
+static void flashfsUnlistOldestLog()
+{
+    if (unlistedDataStart == FLASHFS_NO_ADDRESS) {
+        unlistedDataStart = flashfsLogs[0].log.start;
+    }
+
+    flashfsDropOldestLog();
+}
+
+/**
+ * Forget the data before the given offset, which the erase front has reclaimed.
+ */
+static void flashfsReclaimBefore(uint32_t offset)
+{
+    while (flashfsLogCount > 0 && flashfsLogs[0].log.start < offset) {
+        flashfsDropOldestLog();
+    }
+
+    // Unlisted logs after the reclaimed part are still intact, downloads begin with the remains of the one it cut into
+    if (unlistedDataStart != FLASHFS_NO_ADDRESS && unlistedDataStart < offset) {
+        unlistedDataStart = flashfsLogCount > 0 && offset < flashfsLogs[0].log.start ? offset : FLASHFS_NO_ADDRESS;
+    }
+}
+
+/**
+ * Start a new log at the current offset.
+ */
+void flashfsLogBegin()
+{
+    if (!flashfsDirectoryMounted) {
+        return;
+    }
+
+    flashfsLogEnd();
+
+    if (flashfsLogCount == FLASHFS_MAX_LOGS) {
+        flashfsUnlistOldestLog();
+    }
+
+    flashfsLogRecord_t *record = &flashfsLogs[flashfsLogCount++];
+
+    record->log.start = flashfsGetOffset();
+    record->log.length = FLASHFS_LOG_OPEN;
+    record->slot = flashfsAllocateSlot();
+
+    flashfsLogIsOpen = true;
+
+    flashfsQueueEntry(record->slot, FLASHFS_ENTRY_LOG, 0xFF, record->log.start, FLASHFS_LOG_OPEN);
+}
+
+/**
+ * Close the current log (if any), recording its length in the directory. Data which is still buffered counts as part
+ * of the log.
+ */
+void flashfsLogEnd()
+{
+    if (!flashfsLogIsOpen) {
+        return;
+    }
+
+    flashfsLogRecord_t *record = &flashfsLogs[flashfsLogCount - 1];
+
+    flashfsLogIsOpen = false;
+
+    record->log.length = flashfsGetOffset() - record->log.start;
+
+    flashfsQueueEntry(record->slot, FLASHFS_ENTRY_LOG, 0xFF, record->log.start, record->log.length);
+}
+
+/**
+ * Program the next entry of a freshly erased directory sector from our RAM copy. The header goes last and makes it the
+ * directory in use. Returns true once the whole directory has been written.
+ */
+static bool flashfsContinueDirectoryWrite()
+{
+    flashfsDirectoryEntry_t entry;
+
+    if (directoryWriteCursor == 1) {
+        flashfsMakeEntry(&entry, FLASHFS_ENTRY_ERASE, (uint8_t) ~FLASHFS_ERASE_FLAG_INCOMPLETE, eraseFront, 0xFFFFFFFF);
+    } else if (directoryWriteLog < flashfsLogCount) {
+        flashfsLogRecord_t *record = &flashfsLogs[directoryWriteLog++];
+
+        record->slot = directoryWriteCursor;
+
+        flashfsMakeEntry(&entry, FLASHFS_ENTRY_LOG, 0xFF, record->log.start, record->log.length);
+    } else if (unlistedDataStart != FLASHFS_NO_ADDRESS && !unlistedEntryWritten) {
+        // After the logs, so it also covers a log that was unlisted while they were being written
+        flashfsMakeEntry(&entry, FLASHFS_ENTRY_UNLISTED, 0xFF, unlistedDataStart, 0xFFFFFFFF);
+        unlistedEntryWritten = true;
+    } else {
+        flashfsMakeEntry(&entry, FLASHFS_ENTRY_HEADER, FLASHFS_DIRECTORY_VERSION, FLASHFS_DIRECTORY_MAGIC, directoryGeneration + 1);
+        flashfsProgramEntry(rewriteAddress, &entry);
+
+        directoryAddress = rewriteAddress;
+        directoryGeneration++;
+        nextDirectorySlot = directoryWriteCursor;
+        return true;
+    }
+
+    flashfsProgramEntry(rewriteAddress + directoryWriteCursor * sizeof(entry), &entry);
+    directoryWriteCursor++;
+
+    return false;
+}
+
+/**
+ * Start erasing the sector the directory will be written to, it'll be written from our RAM copy once the erase
+ * completes.
+ */
+static void flashfsBeginDirectoryRewrite()
+{
+    for (int i = 0; i < flashfsLogCount; i++) {
+        flashfsLogs[i].slot = FLASHFS_NO_SLOT;
+    }
+
+    pendingEntryCount = 0;
+
+    flashfsState = FLASHFS_STATE_ERASING_DIRECTORY;
+}
+
+/**
+ * Start erasing the block at the erase front, forgetting the logs stored there.
+ */
+static void flashfsEraseAhead()
+{
+    // The block at the erase front is the one which holds the oldest data in the ring
+    flashfsReclaimBefore(eraseFront + eraseBlockSize - regionSize);
+
+    // Record the erase before starting it, so those logs stay forgotten if we lose power part way through
+    erasingSlot = flashfsAllocateSlot();
+    erasingOffset = eraseFront;
+
+    flashfsQueueEntry(erasingSlot, FLASHFS_ENTRY_ERASE, 0xFF, eraseFront + eraseBlockSize, 0xFFFFFFFF);
+
+    flashfsState = FLASHFS_STATE_ERASING_SECTOR;
+}
+
+/**
+ * Background housekeeping for formatted volumes, call regularly. Keeps sectors erased ahead of the write position and
+ * programs pending directory entries, without ever waiting for the flash to become ready.
+ */
+void flashfsProcess()
+{
+    if (!flashfsDirectoryMounted || !m25p16_isReady()) {
+        return;
+    }
+
+    switch (flashfsState) {
+        case FLASHFS_STATE_ERASING_DIRECTORY:
+            if (flashfsFormatPending) {
+                eraseFront = regionStart + regionSize;
+                flashfsFormatPending = false;
+            }
+
+            directoryWriteCursor = 1;
+            directoryWriteLog = 0;
+            unlistedEntryWritten = false;
+            flashfsState = FLASHFS_STATE_WRITING_DIRECTORY;
+        break;
+
+        case FLASHFS_STATE_WRITING_DIRECTORY:
+            if (flashfsContinueDirectoryWrite()) {
+                flashfsState = FLASHFS_STATE_IDLE;
+            }
+        break;
+
+        case FLASHFS_STATE_ERASING_SECTOR:
+            if (pendingEntryCount > 0) {
+                flashfsWritePendingEntry(false);
+            } else if (erasingOffset < eraseFront + eraseBlockSize) {
+                m25p16_eraseSector(flashfsPhysicalAddress(erasingOffset));
+                erasingOffset += m25p16_getGeometry()->sectorSize;
+            } else {
+                eraseFront += eraseBlockSize;
+
+                flashfsQueueEntry(erasingSlot, FLASHFS_ENTRY_ERASE, (uint8_t) ~FLASHFS_ERASE_FLAG_INCOMPLETE, eraseFront, 0xFFFFFFFF);
+
+                flashfsState = FLASHFS_STATE_IDLE;
+            }
+        break;
+
+        case FLASHFS_STATE_IDLE:
+            if (pendingEntryCount > 0) {
+                flashfsWritePendingEntry(false);
+            } else if (!flashfsLogIsOpen && nextDirectorySlot >= directorySlots / 4 * 3) {
+                // Compact the directory down to the logs we still know about, in the other directory sector
+                rewriteAddress = directoryAddress ? 0 : m25p16_getGeometry()->sectorSize;
+                m25p16_eraseSector(rewriteAddress);
+                flashfsBeginDirectoryRewrite();
+            } else {
+                const uint32_t erasedSpace = eraseFront - tailAddress;
+
+                /*
+                 * Erasing stalls writes for the duration of the erase, so while a log is open we only erase when it's
+                 * about to run out of space. We can't erase the block which the tail is in, and we must be able to
+                 * record the erase, otherwise the logs we erased would still look intact after a reboot.
+                 */
+                if (erasedSpace < (flashfsLogIsOpen ? FLASHFS_ERASE_LOW_WATER_SIZE : FLASHFS_ERASE_AHEAD_SIZE)
+                        && erasedSpace + eraseBlockSize <= regionSize
+                        && nextDirectorySlot < directorySlots) {
+                    flashfsEraseAhead();
+                }
+            }
+        break;
+    }
+}
+
+/**
+ * Check for a complete directory at the given address, returning its generation.
+ */
+static bool flashfsReadDirectoryHeader(uint32_t address, uint32_t *generation)
+{
+    flashfsDirectoryEntry_t header;
+
+    if (m25p16_readBytes(address, (uint8_t *) &header, sizeof(header)) < (int) sizeof(header)
+            || header.type != FLASHFS_ENTRY_HEADER || header.address != FLASHFS_DIRECTORY_MAGIC
+            || header.flags != FLASHFS_DIRECTORY_VERSION) {
+        return false;
+    }
+
+    *generation = header.length;
+
+    return true;
+}
+
+/**
+ * Read the log directory, returns false if the device hasn't been formatted with one.
+ */
+static bool flashfsMountDirectory()
+{
+    enum {
+        ENTRIES_PER_READ = 8
+    };
+
+    flashfsDirectoryEntry_t entries[ENTRIES_PER_READ];
+    uint32_t writtenEnd, reclaimedFront;
+    uint32_t generation;
+    uint16_t slot;
+
+    // Use the newer of the two directories, a compaction which was cut short never got as far as its header
+    const uint32_t sectorSize = m25p16_getGeometry()->sectorSize;
+    bool found = false;
+
+    for (int sector = 0; sector < FLASHFS_DIRECTORY_SECTORS; sector++) {
+        if (flashfsReadDirectoryHeader(sector * sectorSize, &generation)
+                && (!found || (int32_t) (generation - directoryGeneration) > 0)) {
+            directoryAddress = sector * sectorSize;
+            directoryGeneration = generation;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    flashfsSetDirectoryLayout();
+
+    eraseFront = regionStart;
+    reclaimedFront = regionStart;
+    writtenEnd = regionStart;
+    flashfsLogCount = 0;
+    unlistedDataStart = FLASHFS_NO_ADDRESS;
+
+    for (slot = 1; slot < directorySlots; slot++) {
+        flashfsDirectoryEntry_t *entry = &entries[slot % ENTRIES_PER_READ];
+
+        if (slot == 1 || slot % ENTRIES_PER_READ == 0) {
+            m25p16_readBytes(directoryAddress + slot / ENTRIES_PER_READ * sizeof(entries), (uint8_t *) entries, sizeof(entries));
+        }
+
+        if (entry->type == FLASHFS_ENTRY_FREE) {
+            break;
+        }
+
+        switch (entry->type) {
+            case FLASHFS_ENTRY_ERASE:
+                // An unfinished erase destroyed the old logs, but the block will have to be erased again
+                if (!(entry->flags & FLASHFS_ERASE_FLAG_INCOMPLETE)) {
+                    eraseFront = MAX(eraseFront, entry->address);
+                }
+                reclaimedFront = MAX(reclaimedFront, entry->address);
+            break;
+
+            case FLASHFS_ENTRY_UNLISTED:
+                unlistedDataStart = MIN(unlistedDataStart, entry->address);
+            break;
+
+            case FLASHFS_ENTRY_LOG:
+                if (flashfsLogCount == FLASHFS_MAX_LOGS) {
+                    flashfsUnlistOldestLog();
+                }
+
+                flashfsLogs[flashfsLogCount].log.start = entry->address;
+                flashfsLogs[flashfsLogCount].log.length = entry->length;
+                flashfsLogs[flashfsLogCount].slot = slot;
+                flashfsLogCount++;
+
+                writtenEnd = MAX(writtenEnd, entry->address + (entry->length == FLASHFS_LOG_OPEN ? 0 : entry->length));
+            break;
+        }
+    }
+
+    nextDirectorySlot = slot;
+
+    if (reclaimedFront >= regionStart + regionSize) {
+        // Forget logs whose beginning has since been erased
+        flashfsReclaimBefore(reclaimedFront - regionSize);
+
+        writtenEnd = MAX(writtenEnd, reclaimedFront - regionSize);
+    }
+
+    // Logs which were never closed (e.g. because power was lost) and data which isn't in any log may follow
+    flashfsSetTailAddress(flashfsIdentifyStartOfFreeSpace(writtenEnd, eraseFront));
+
+    for (int i = 0; i < flashfsLogCount; i++) {
+        if (flashfsLogs[i].log.length == FLASHFS_LOG_OPEN) {
+            flashfsLogs[i].log.length = (i + 1 < flashfsLogCount ? flashfsLogs[i + 1].log.start : tailAddress) - flashfsLogs[i].log.start;
+        }
+    }
+
+    flashfsDirectoryMounted = true;
+
+    return true;
 }
 
 /**
@@ -561,9 +1295,16 @@ bool flashfsIsEOF()
  */
 void flashfsInit()
 {
+    flashfsResetStats();
+
     // If we have a flash chip present at all
     if (flashfsGetSize() > 0) {
-        // Start the file pointer off at the beginning of free space so caller can start writing immediately
-        flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace());
+        if (!flashfsMountDirectory()) {
+            flashfsSetRegion(0);
+            eraseFront = flashfsGetSize();
+
+            // Start the file pointer off at the beginning of free space so caller can start writing immediately
+            flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace(0, flashfsGetSize()));
+        }
     }
 }
@@ -21,12 +21,60 @@
 
 #include "drivers/flash.h"
 
+/*
+ * Targets with RAM to spare can define a larger buffer. With room for at least two flash pages the buffer becomes a
+ * page pipeline: background flushes only program whole, page-aligned pages, and the next page fills in RAM while the
+ * previous one is still being programmed.
+ */
+#ifndef FLASHFS_WRITE_BUFFER_SIZE
 #define FLASHFS_WRITE_BUFFER_SIZE 128
+#endif
 #define FLASHFS_WRITE_BUFFER_USABLE (FLASHFS_WRITE_BUFFER_SIZE - 1)
 
-// Automatically trigger a flush when this much data is in the buffer
+// Automatically trigger a flush when this much data is in the buffer (if the buffer isn't a page pipeline)
 #define FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN 64
 
+/*
+ * A volume formatted by flashfsEraseCompletely() keeps a directory of logs in one of its first two sectors and uses the
+ * rest of the device as a ring. Sectors ahead of the write position are erased in the background by flashfsProcess(),
+ * reclaiming the oldest logs once the ring wraps around. Only the newest FLASHFS_MAX_LOGS logs are listed, but
+ * downloads still start at the oldest intact one.
+ */
+#ifndef FLASHFS_MAX_LOGS
+#define FLASHFS_MAX_LOGS 16
+#endif
+
+/*
+ * The ring is erased (and each erase recorded in the directory) in blocks of this size or one sector, whichever is
+ * larger, so chips with small sectors don't fill the directory up.
+ */
+#ifndef FLASHFS_ERASE_BLOCK_SIZE
+#define FLASHFS_ERASE_BLOCK_SIZE (64 * 1024)
+#endif
+
+// Keep this much space erased ahead of the write position while no log is open
+#ifndef FLASHFS_ERASE_AHEAD_SIZE
+#define FLASHFS_ERASE_AHEAD_SIZE (256 * 1024)
+#endif
+
+// While a log is open, only erase (stalling writes) once the erased space drops below this
+#ifndef FLASHFS_ERASE_LOW_WATER_SIZE
+#define FLASHFS_ERASE_LOW_WATER_SIZE (64 * 1024)
+#endif
+
+typedef struct flashfsLog_s {
+    uint32_t start;     // flashfs offset of the first byte of the log, see flashfsGetOffset()
+    uint32_t length;
+} flashfsLog_t;
+
+typedef struct flashfsStats_s {
+    uint32_t bytesProgrammed;
+    uint32_t programOperations;
+    uint32_t busyStalls;        // background flushes that found the flash still busy
+    uint32_t bytesDropped;      // asynchronous writes discarded because the buffer was full
+    uint32_t resetAt;           // millis() when the counters were last reset
+} flashfsStats_t;
+
 void flashfsEraseCompletely();
 void flashfsEraseRange(uint32_t start, uint32_t end);
 
@@ -34,7 +82,6 @@ uint32_t flashfsGetSize();
 uint32_t flashfsGetOffset();
 uint32_t flashfsGetWriteBufferFreeSpace();
 uint32_t flashfsGetWriteBufferSize();
-int flashfsIdentifyStartOfFreeSpace();
 const flashGeometry_t* flashfsGetGeometry();
 
 void flashfsSeekAbs(uint32_t offset);
@@ -44,11 +91,26 @@ void flashfsWriteByte(uint8_t byte);
 void flashfsWrite(const uint8_t *data, unsigned int len, bool sync);
 
 int flashfsReadAbs(uint32_t offset, uint8_t *data, unsigned int len);
+int flashfsReadLinear(uint32_t address, uint8_t *data, unsigned int len);
+uint32_t flashfsGetUsedSize();
 
 bool flashfsFlushAsync();
+void flashfsFlushPagesAsync();
 void flashfsFlushSync();
 
+const flashfsStats_t *flashfsGetStats();
+void flashfsResetStats();
+
+bool flashfsHasDirectory();
+uint32_t flashfsGetErasedSpace();
+int flashfsGetLogCount();
+bool flashfsGetLog(int index, flashfsLog_t *log);
+
+void flashfsLogBegin();
+void flashfsLogEnd();
+
 void flashfsInit();
+void flashfsProcess();
 
 bool flashfsIsReady();
 bool flashfsIsEOF();
@@ -129,6 +129,18 @@ serialPortUsage_t *findSerialPortUsageByPort(serialPort_t *serialPort)
     return NULL;
 }
 
+serialPort_t *findOpenSerialPort(serialPortFunction_e function)
+{
+    uint8_t index;
+    for (index = 0; index < SERIAL_PORT_COUNT; index++) {
+        serialPortUsage_t *candidate = &serialPortUsageList[index];
+        if (candidate->function == function) {
+            return candidate->serialPort;
+        }
+    }
+    return NULL;
+}
+
 typedef struct findSerialPortConfigState_s {
     uint8_t lastIndex;
 } findSerialPortConfigState_t;
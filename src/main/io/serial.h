@@ -80,6 +80,7 @@ typedef struct serialPortUsage_s {
 
 serialPort_t *findSharedSerialPort(uint16_t functionMask, serialPortFunction_e sharedWithFunction);
 serialPort_t *findNextSharedSerialPort(uint16_t functionMask, serialPortFunction_e sharedWithFunction);
+serialPort_t *findOpenSerialPort(serialPortFunction_e function);
 
 //
 // configuration
@@ -49,6 +49,12 @@
 #include "drivers/timer.h"
 #include "drivers/pwm_rx.h"
 #include "drivers/sdcard.h"
+#ifdef NRF
+#include "drivers/nrf2401.h"
+#endif
+#ifdef MINIFLOW
+#include "drivers/miniflow.h"
+#endif
 
 #include "drivers/buf_writer.h"
 
@@ -57,6 +63,8 @@
 #include "fc/rc_adjustments.h"
 #include "fc/fc_serial.h"
 #include "fc/fc_tasks.h"
+#include "fc/rc_smoothing.h"
+#include "fc/rc_latency.h"
 
 #include "scheduler/scheduler.h"
 
@@ -119,6 +127,9 @@ static bufWriter_t *cliWriter;
 static uint8_t cliWriteBuffer[sizeof(*cliWriter) + 16];
 
 static void cliAux(char *cmdline);
+#ifdef BLACKBOX
+static void cliBlackbox(char *cmdline);
+#endif
 static void cliRxFail(char *cmdline);
 static void cliAdjustmentRange(char *cmdline);
 static void cliMotorMix(char *cmdline);
@@ -127,9 +138,13 @@ static void cliDump(char *cmdLine);
 static void cliExit(char *cmdline);
 static void cliFeature(char *cmdline);
 static void cliMotor(char *cmdline);
+#ifdef NRF
+static void cliNrf(char *cmdline);
+#endif
 static void cliPlaySound(char *cmdline);
 static void cliProfile(char *cmdline);
 static void cliRateProfile(char *cmdline);
+static void cliRcLatency(char *cmdline);
 static void cliReboot(void);
 static void cliSave(char *cmdline);
 static void cliSerial(char *cmdline);
@@ -256,6 +271,9 @@ typedef struct {
 const clicmd_t cmdTable[] = {
     CLI_COMMAND_DEF("adjrange", "configure adjustment ranges", NULL, cliAdjustmentRange),
     CLI_COMMAND_DEF("aux", "configure modes", NULL, cliAux),
+#ifdef BLACKBOX
+    CLI_COMMAND_DEF("blackbox", "show blackbox compression per field group", NULL, cliBlackbox),
+#endif
 #ifdef LED_STRIP
     CLI_COMMAND_DEF("color", "configure colors", NULL, cliColor),
     CLI_COMMAND_DEF("mode_color", "configure mode and special colors", NULL, cliModeColor),
@@ -294,12 +312,18 @@ const clicmd_t cmdTable[] = {
     CLI_COMMAND_DEF("mmix", "custom motor mixer", NULL, cliMotorMix),
     CLI_COMMAND_DEF("motor",  "get/set motor",
        "<index> [<value>]", cliMotor),
+#ifdef NRF
+    CLI_COMMAND_DEF("nrf", "show nrf24l01 link statistics",
+        "[reset]", cliNrf),
+#endif
     CLI_COMMAND_DEF("play_sound", NULL,
         "[<index>]\r\n", cliPlaySound),
     CLI_COMMAND_DEF("profile", "change profile",
         "[<index>]", cliProfile),
     CLI_COMMAND_DEF("rateprofile", "change rate profile",
         "[<index>]", cliRateProfile),
+    CLI_COMMAND_DEF("rclatency", "show rc frame to motor output latency",
+        "[reset]", cliRcLatency),
     CLI_COMMAND_DEF("rxrange", "configure rx channel ranges", NULL, cliRxRange),
     CLI_COMMAND_DEF("rxfail", "show/set rx failsafe settings", NULL, cliRxFail),
     CLI_COMMAND_DEF("save", "save and reboot", NULL, cliSave),
@@ -373,6 +397,12 @@ static const char * const lookupTableBlackboxDevice[] = {
     "SERIAL", "SPIFLASH", "SDCARD"
 };
 
+#ifdef BLACKBOX
+static const char * const lookupTableBlackboxPredictor[] = {
+    "AVERAGE", "LINEAR", "ADAPTIVE"
+};
+#endif
+
 static const char * const lookupTableSerialRX[] = {
     "SPEK1024",
     "SPEK2048",
@@ -401,6 +431,22 @@ static const char * const lookupTablePidDeltaMethod[] = {
     "MEASUREMENT", "ERROR"
 };
 
+static const char * const lookupTableRcSmoothing[] = {
+    "OFF", "PT1", "BIQUAD"
+};
+
+#ifdef NRF
+static const char * const lookupTableNrfLinkMode[] = {
+    "TURNAROUND", "ACK_PAYLOAD"
+};
+#endif
+
+#if defined(BARO) || defined(SONAR)
+static const char * const lookupTableAltEstimator[] = {
+    "CF", "KALMAN"
+};
+#endif
+
 typedef struct lookupTableEntry_s {
     const char * const *values;
     const uint8_t valueCount;
@@ -416,6 +462,7 @@ typedef enum {
 #endif
 #ifdef BLACKBOX
     TABLE_BLACKBOX_DEVICE,
+    TABLE_BLACKBOX_PREDICTOR,
 #endif
     TABLE_CURRENT_SENSOR,
     TABLE_GIMBAL_MODE,
@@ -424,6 +471,13 @@ typedef enum {
     TABLE_GYRO_FILTER,
     TABLE_GYRO_LPF,
     TABLE_PID_DELTA_METHOD,
+    TABLE_RC_SMOOTHING,
+#ifdef NRF
+    TABLE_NRF_LINK_MODE,
+#endif
+#if defined(BARO) || defined(SONAR)
+    TABLE_ALT_ESTIMATOR,
+#endif
 } lookupTableIndex_e;
 
 static const lookupTableEntry_t lookupTables[] = {
@@ -436,6 +490,7 @@ static const lookupTableEntry_t lookupTables[] = {
 #endif
 #ifdef BLACKBOX
     { lookupTableBlackboxDevice, sizeof(lookupTableBlackboxDevice) / sizeof(char *) },
+    { lookupTableBlackboxPredictor, sizeof(lookupTableBlackboxPredictor) / sizeof(char *) },
 #endif
     { lookupTableCurrentSensor, sizeof(lookupTableCurrentSensor) / sizeof(char *) },
     { lookupTableGimbalMode, sizeof(lookupTableGimbalMode) / sizeof(char *) },
@@ -444,6 +499,13 @@ static const lookupTableEntry_t lookupTables[] = {
     { lookupTableGyroFilter, sizeof(lookupTableGyroFilter) / sizeof(char *) },
     { lookupTableGyroLpf, sizeof(lookupTableGyroLpf) / sizeof(char *) },
     { lookupTablePidDeltaMethod, sizeof(lookupTablePidDeltaMethod) / sizeof(char *) },
+    { lookupTableRcSmoothing, sizeof(lookupTableRcSmoothing) / sizeof(char *) },
+#ifdef NRF
+    { lookupTableNrfLinkMode, sizeof(lookupTableNrfLinkMode) / sizeof(char *) },
+#endif
+#if defined(BARO) || defined(SONAR)
+    { lookupTableAltEstimator, sizeof(lookupTableAltEstimator) / sizeof(char *) },
+#endif
 };
 
 #define VALUE_TYPE_OFFSET 0
@@ -510,7 +572,11 @@ const clivalue_t valueTable[] = {
     { "rssi_channel",               VAR_INT8   | MASTER_VALUE, .config.minmax = { 0,  MAX_SUPPORTED_RC_CHANNEL_COUNT } , PG_RX_CONFIG, offsetof(rxConfig_t, rssi_channel)},
     { "rssi_scale",                 VAR_UINT8  | MASTER_VALUE, .config.minmax = { RSSI_SCALE_MIN,  RSSI_SCALE_MAX } , PG_RX_CONFIG, offsetof(rxConfig_t, rssi_scale)},
     { "rssi_ppm_invert",            VAR_INT8   | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON } , PG_RX_CONFIG, offsetof(rxConfig_t, rssi_ppm_invert)},
-    { "rc_smoothing",               VAR_INT8   | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON } , PG_RX_CONFIG, offsetof(rxConfig_t, rcSmoothing)},
+    { "rc_smoothing",               VAR_INT8   | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_RC_SMOOTHING } , PG_RX_CONFIG, offsetof(rxConfig_t, rcSmoothing)},
+    { "rc_smoothing_cutoff_pct",    VAR_UINT8  | MASTER_VALUE, .config.minmax = { RC_SMOOTHING_CUTOFF_PERCENT_MIN,  RC_SMOOTHING_CUTOFF_PERCENT_MAX } , PG_RX_CONFIG, offsetof(rxConfig_t, rcSmoothingCutoffPercent)},
+#ifdef NRF
+    { "nrf_link_mode",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_NRF_LINK_MODE } , PG_RX_CONFIG, offsetof(rxConfig_t, nrf_link_mode)},
+#endif
     { "rx_min_usec",                VAR_UINT16 | MASTER_VALUE, .config.minmax = { PWM_PULSE_MIN,  PWM_PULSE_MAX } , PG_RX_CONFIG, offsetof(rxConfig_t, rx_min_usec)},
     { "rx_max_usec",                VAR_UINT16 | MASTER_VALUE, .config.minmax = { PWM_PULSE_MIN,  PWM_PULSE_MAX } , PG_RX_CONFIG, offsetof(rxConfig_t, rx_max_usec)},
     { "serialrx_provider",          VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_SERIAL_RX } , PG_RX_CONFIG, offsetof(rxConfig_t, serialrx_provider)},
@@ -539,6 +605,12 @@ const clivalue_t valueTable[] = {
     { "small_angle",                VAR_UINT8  | MASTER_VALUE, .config.minmax = { 0,  180 } , PG_IMU_CONFIG, offsetof(imuConfig_t, small_angle)},
 
     { "fixedwing_althold_dir",      VAR_INT8   | MASTER_VALUE, .config.minmax = { -1,  1 }, PG_AIRPLANE_ALT_HOLD_CONFIG, offsetof( airplaneConfig_t, fixedwing_althold_dir) },
+#if defined(BARO) || defined(SONAR)
+    { "alt_estimator",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_ALT_ESTIMATOR } , PG_ALTITUDE_ESTIMATOR_CONFIG, offsetof(altitudeEstimatorConfig_t, alt_estimator)},
+    { "alt_kf_acc_noise",           VAR_UINT16 | MASTER_VALUE, .config.minmax = { 1,  1000 } , PG_ALTITUDE_ESTIMATOR_CONFIG, offsetof(altitudeEstimatorConfig_t, alt_kf_acc_noise)},
+    { "alt_kf_baro_noise",          VAR_UINT16 | MASTER_VALUE, .config.minmax = { 1,  1000 } , PG_ALTITUDE_ESTIMATOR_CONFIG, offsetof(altitudeEstimatorConfig_t, alt_kf_baro_noise)},
+    { "alt_kf_sonar_noise",         VAR_UINT16 | MASTER_VALUE, .config.minmax = { 1,  1000 } , PG_ALTITUDE_ESTIMATOR_CONFIG, offsetof(altitudeEstimatorConfig_t, alt_kf_sonar_noise)},
+#endif
 
     { "reboot_character",           VAR_UINT8  | MASTER_VALUE, .config.minmax = { 48,  126 } , PG_SERIAL_CONFIG, offsetof(serialConfig_t, reboot_character)},
 
@@ -677,6 +749,10 @@ const clivalue_t valueTable[] = {
     { "mag_declination",            VAR_INT16  | PROFILE_VALUE, .config.minmax = { -18000,  18000 } , PG_COMPASS_CONFIGURATION, offsetof(compassConfig_t, mag_declination)},
 #endif
 
+#ifdef MINIFLOW
+    { "miniflow_angle_rate",        VAR_UINT8  | MASTER_VALUE, .config.minmax = { 10,  200 } , PG_MINIFLOW_CONFIG, offsetof(miniflowConfig_t, angle_rate_hz)},
+#endif
+
     { "pid_controller",             VAR_UINT8  | PROFILE_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_PID_CONTROLLER } , PG_PID_PROFILE, offsetof(pidProfile_t, pidController)},
 
     { "p_pitch",                    VAR_UINT8  | PROFILE_VALUE, .config.minmax = { PID_MIN,  PID_MAX } , PG_PID_PROFILE, offsetof(pidProfile_t, P8[FD_PITCH])},
@@ -722,6 +798,8 @@ const clivalue_t valueTable[] = {
     { "blackbox_rate_num",          VAR_UINT8  | MASTER_VALUE, .config.minmax = { 1,  32 } , PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, rate_num)},
     { "blackbox_rate_denom",        VAR_UINT8  | MASTER_VALUE, .config.minmax = { 1,  32 } , PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, rate_denom)},
     { "blackbox_device",            VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_DEVICE } , PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, device)},
+    { "blackbox_gyro_logging",      VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON } , PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, gyro_logging)},
+    { "blackbox_predictor",         VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_PREDICTOR } , PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, predictor)},
 #endif
 
     { "magzero_x",                  VAR_INT16  | MASTER_VALUE, .config.minmax = { -32768,  32767 } , PG_SENSOR_TRIMS, offsetof(sensorTrims_t, magZero.raw[X])},
@@ -1578,10 +1656,10 @@ static void cliSdInfo(char *cmdline)
 
     switch (afatfs_getFilesystemState()) {
         case AFATFS_FILESYSTEM_STATE_READY:
-            cliPrint("Ready");
+            cliPrint("Ready\r\n");
         break;
         case AFATFS_FILESYSTEM_STATE_INITIALIZATION:
-            cliPrint("Initializing");
+            cliPrint("Initializing\r\n");
         break;
         case AFATFS_FILESYSTEM_STATE_UNKNOWN:
         case AFATFS_FILESYSTEM_STATE_FATAL:
@@ -1603,6 +1681,11 @@ static void cliSdInfo(char *cmdline)
             cliPrint("\r\n");
         break;
     }
+
+    const afatfsCacheStats_t *cacheStats = afatfs_getCacheStats();
+
+    cliPrintf("Cache hits=%u, misses=%u, evictions=%u, readAheads=%u\r\n",
+        cacheStats->hits, cacheStats->misses, cacheStats->evictions, cacheStats->readAheads);
 }
 
 #endif
@@ -1617,6 +1700,23 @@ static void cliFlashInfo(char *cmdline)
 
     cliPrintf("Flash sectors=%u, sectorSize=%u, pagesPerSector=%u, pageSize=%u, totalSize=%u, usedSize=%u\r\n",
             layout->sectors, layout->sectorSize, layout->pagesPerSector, layout->pageSize, layout->totalSize, flashfsGetOffset());
+
+    const flashfsStats_t *stats = flashfsGetStats();
+    uint32_t elapsedMs = millis() - stats->resetAt;
+
+    cliPrintf("Writes bufferSize=%u, programmed=%u, programs=%u, busyStalls=%u, dropped=%u, bytesPerSecond=%u\r\n",
+            FLASHFS_WRITE_BUFFER_SIZE, stats->bytesProgrammed, stats->programOperations, stats->busyStalls, stats->bytesDropped,
+            elapsedMs > 0 ? (uint32_t) ((uint64_t) stats->bytesProgrammed * 1000 / elapsedMs) : 0);
+
+    if (flashfsHasDirectory()) {
+        flashfsLog_t log;
+
+        cliPrintf("Directory logs=%d, erasedSize=%u\r\n", flashfsGetLogCount(), flashfsGetErasedSpace());
+
+        for (int i = 0; flashfsGetLog(i, &log); i++) {
+            cliPrintf("Log %d start=%u, length=%u\r\n", i, log.start, log.length);
+        }
+    }
 }
 
 static void cliFlashErase(char *cmdline)
@@ -1626,8 +1726,10 @@ static void cliFlashErase(char *cmdline)
     cliPrintf("Erasing...\r\n");
     flashfsEraseCompletely();
 
+    // The scheduler doesn't run while we wait, so write the new directory ourselves
     while (!flashfsIsReady()) {
         delay(100);
+        flashfsProcess();
     }
 
     cliPrintf("Done.\r\n");
@@ -2518,8 +2620,70 @@ static void cliStatus(char *cmdline)
 #endif
 
     cliPrintf("Cycle Time: %d, I2C Errors: %d, registry size: %d\r\n", cycleTime, i2cErrorCounter, PG_REGISTRY_SIZE);
+
+    const uint32_t rxFrameTime = rcSmoothingGetRxFrameTime();
+    cliPrintf("RX frame time: %d us (%d Hz), RC smoothing cutoff: %d Hz\r\n", rxFrameTime, rxFrameTime ? 1000000 / rxFrameTime : 0, rcSmoothingGetCutoffFrequency());
+
+    cliRcLatency("");
 }
 
+static void cliRcLatency(char *cmdline)
+{
+    if (strcasecmp(cmdline, "reset") == 0) {
+        rcLatencyResetStats();
+    }
+
+    const rcLatencyStats_t *stats = rcLatencyGetStats();
+    cliPrintf("RC latency: last %d us, min %d us, avg %d us, max %d us, frames %d\r\n",
+        stats->lastUs, stats->minUs, stats->avgUs, stats->maxUs, stats->sampleCount);
+}
+
+#ifdef BLACKBOX
+static void cliBlackbox(char *cmdline)
+{
+    static const char * const fieldGroupNames[BLACKBOX_FIELD_GROUP_COUNT] = {
+        "frame", "pid", "rc", "sensors", "gyro", "acc", "motor", "other", "gyro frames"
+    };
+
+    UNUSED(cmdline);
+
+    const blackboxFieldGroupStats_t *stats = blackboxGetFieldGroupStats();
+
+    cliPrintf("Blackbox predictor: %s\r\n", lookupTableBlackboxPredictor[blackboxConfig()->predictor]);
+
+    for (int i = 0; i < BLACKBOX_FIELD_GROUP_COUNT; i++) {
+        if (stats[i].encodedBytes == 0) {
+            continue;
+        }
+
+        // Compression ratio in hundredths
+        const uint32_t ratio = (uint64_t) stats[i].rawBytes * 100 / stats[i].encodedBytes;
+
+        cliPrintf("%s: raw %u, encoded %u, ratio %u.%02u\r\n", fieldGroupNames[i],
+            stats[i].rawBytes, stats[i].encodedBytes, ratio / 100, ratio % 100);
+    }
+}
+#endif
+
+#ifdef NRF
+static void cliNrf(char *cmdline)
+{
+    if (strcasecmp(cmdline, "reset") == 0) {
+        nrfResetLinkStats();
+    }
+
+    const nrfLinkStats_t *linkStats = nrfGetLinkStats();
+    cliPrintf("NRF link mode: %s, link quality %d%%\r\n",
+        lookupTableNrfLinkMode[nrfGetLinkMode()], nrfGetLinkQuality());
+    cliPrintf("NRF RX: packets %d, lost %d, duplicates %d, late %d, corrupt %d\r\n",
+        linkStats->rxPackets, linkStats->lost, linkStats->duplicates, linkStats->late, linkStats->corrupt);
+    cliPrintf("NRF TX: sent %d, failed %d, timeouts %d, retransmits %d, %s\r\n",
+        linkStats->sent, linkStats->failed, linkStats->timeouts, linkStats->retransmits,
+        nrfGetTxState() == NRF_TX_IDLE ? "idle" : "in flight");
+    cliPrintf("NRF ACK payloads: loaded %d, pending %d\r\n", linkStats->ackPayloads, linkStats->ackPending);
+}
+#endif
+
 #ifndef SKIP_TASK_STATISTICS
 static void cliTasks(char *cmdline)
 {
@@ -2540,6 +2704,13 @@ static void cliTasks(char *cmdline)
                     taskFrequency, maxLoad/10, maxLoad%10, averageLoad/10, averageLoad%10, taskInfo.totalExecutionTime / 1000);
         }
     }
+#ifdef MINIFLOW
+    const miniflowStats_t *flowStats = miniflowGetStats();
+    cliPrintf("Miniflow frames %d, dropped %d, corrupt %d, angle uplink sent %d, skipped %d\r\n",
+            flowStats->frames, flowStats->dropped, flowStats->corrupt, flowStats->uplinkSent, flowStats->uplinkSkipped);
+    cliPrintf("Miniflow process max/avg %d/%d us, flow to flow_cmd latency max/avg %d/%d us\r\n",
+            flowStats->processTimeMax, flowStats->processTimeAverage, flowStats->latencyMax, flowStats->latencyAverage);
+#endif
 }
 #endif
 
@@ -59,7 +59,7 @@
 #define MSP_PROTOCOL_VERSION                0
 
 #define API_VERSION_MAJOR                   1 // increment when major changes are made
-#define API_VERSION_MINOR                   21 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
+#define API_VERSION_MINOR                   26 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
 
 #define API_VERSION_LENGTH                  2
 
@@ -290,6 +290,11 @@
 
 // Additional commands that are not compatible with MultiWii
 #define MSP_STATUS_EX            150    //out message         cycletime, errors_count, CPU load, sensor present etc
+#define MSP_RC_LATENCY           151    //out message         RC frame to motor output latency: last, min, avg, max (us), frame count
+#define MSP_BLACKBOX_STATS       152    //out message         Blackbox predictor and raw/encoded bytes per field group
+#define MSP_DATAFLASH_STREAM     153    //in message          start (or with a zero size, cancel) pushing a range of dataflash as MSP_DATAFLASH_STREAM_DATA
+#define MSP_DATAFLASH_STREAM_ACK 154    //in message          host has consumed the dataflash stream up to this address, no reply
+#define MSP_DATAFLASH_STREAM_DATA 155  //out message          pushed dataflash chunk: address, raw size, encoding, data (zero size ends the stream)
 #define MSP_UID                  160    //out message         Unique device ID
 #define MSP_GPSSVINFO            164    //out message         get Signal Strength (only U-Blox)
 #define MSP_GPSSTATISTICS        166    //out message         get GPS debugging data
@@ -23,6 +23,7 @@
 #include <platform.h>
 #include "target.h"
 
+#include "common/maths.h"
 #include "common/streambuf.h"
 #include "common/utils.h"
 
@@ -140,10 +141,11 @@ void mspSerialEncode(mspPort_t *msp, mspPacket_t *packet)
 {
     serialBeginWrite(msp->port);
     int len = sbufBytesRemaining(&packet->buf);
-    uint8_t hdr[] = {'$', 'M', packet->result < 0 ? '!' : (msp->mode == MSP_MODE_SERVER ? '>' : '<'), len, packet->cmd};
+    uint8_t hdr[] = {'$', 'M', packet->result < 0 ? '!' : (msp->mode == MSP_MODE_SERVER ? '>' : '<'), MIN(len, MSP_JUMBO_FRAME_SIZE_LIMIT), packet->cmd, len & 0xFF, len >> 8};
+    int hdrLen = len >= MSP_JUMBO_FRAME_SIZE_LIMIT ? sizeof(hdr) : sizeof(hdr) - 2;
     uint8_t csum = 0;                                       // initial checksum value
-    serialWriteBuf(msp->port, hdr, sizeof(hdr));
-    csum = mspSerialChecksumBuf(csum, hdr + 3, 2);          // checksum starts from len field
+    serialWriteBuf(msp->port, hdr, hdrLen);
+    csum = mspSerialChecksumBuf(csum, hdr + 3, hdrLen - 3); // checksum starts from len field
     if(len > 0) {
         serialWriteBuf(msp->port, sbufPtr(&packet->buf), len);
         csum = mspSerialChecksumBuf(csum, sbufPtr(&packet->buf), len);
@@ -189,6 +191,35 @@ STATIC_UNIT_TESTED void mspSerialProcessReceivedCommand(mspPort_t *msp)
     msp->c_state = IDLE;
 }
 
+/**
+ * Push packets from the port's stream until it has nothing more to send or the time budget runs out.
+ */
+static void mspSerialProcessStream(mspPort_t *msp)
+{
+    const uint32_t startedAt = micros();
+
+    do {
+        // USB VCP blocks briefly rather than buffering, so it can take a jumbo frame at any time
+        int maxLength = msp->port->identifier == SERIAL_PORT_USB_VCP ? UINT16_MAX : serialTxBytesFree(msp->port) - MSP_JUMBO_FRAME_OVERHEAD;
+
+        mspPacket_t packet = {
+            .cmd = -1,
+            .result = 0,
+        };
+
+        int status = msp->streamFn(&packet, maxLength);
+
+        if (status < 0) {
+            msp->streamFn = NULL;
+        }
+        if (status <= 0) {
+            break;
+        }
+
+        mspSerialEncode(msp, &packet);
+    } while (micros() - startedAt < MSP_STREAM_TIME_BUDGET_US);
+}
+
 #ifdef USE_MSP_CLIENT
 static void mspSerialProcessReceivedReply(mspPort_t *msp)
 {
@@ -302,6 +333,10 @@ void mspSerialProcess(void)
             mspPostProcessFn = NULL;
         }
 
+        if (msp->c_state == IDLE && msp->streamFn) {
+            mspSerialProcessStream(msp);
+        }
+
         // TODO consider extracting this outside the loop and create a new loop in mspClientProcess and rename mspProcess to mspServerProcess
         if (msp->c_state == IDLE && msp->commandSenderFn && !bytesWaiting) {
 
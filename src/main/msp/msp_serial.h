@@ -69,9 +69,21 @@ typedef enum {
 
 typedef bool (*mspCommandSenderFuncPtr)(); // msp command sender function prototype
 
+struct mspPacket_s;
+// Fill the next packet of a stream pushed to the host, with at most maxLength bytes of payload.
+// Return positive when a packet was filled, zero when nothing can be sent yet, negative when the stream has ended.
+typedef int (*mspStreamFuncPtr)(struct mspPacket_s *packet, int maxLength);
+
 #define MSP_PORT_INBUF_SIZE 64
 #define MSP_PORT_OUTBUF_SIZE 256
 
+// Payloads of this size or larger are sent as jumbo frames, with the real size following the command byte
+#define MSP_JUMBO_FRAME_SIZE_LIMIT 255
+#define MSP_JUMBO_FRAME_OVERHEAD 8
+
+// Time a port may spend pushing stream packets on each call to mspSerialProcess()
+#define MSP_STREAM_TIME_BUDGET_US 1000
+
 typedef enum {
     MSP_MODE_SERVER,
     MSP_MODE_CLIENT
@@ -82,6 +94,7 @@ typedef struct mspPort_s {
     mspPortMode_e mode;
 
     mspCommandSenderFuncPtr commandSenderFn;   // NULL when unused.
+    mspStreamFuncPtr streamFn;                 // NULL when unused.
 
     mspState_e c_state;
     uint8_t offset;
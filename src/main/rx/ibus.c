@@ -48,7 +48,9 @@
 #define IBUS_BAUDRATE 115200
 
 static bool ibusFrameDone = false;
+static uint8_t ibusFramePosition;
 static uint32_t ibusChannelData[IBUS_MAX_CHANNEL];
+static serialPort_t *ibusPort;
 
 static void ibusDataReceive(uint16_t c);
 static uint16_t ibusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
@@ -65,19 +67,18 @@ bool ibusInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
         return false;
     }
 
-    serialPort_t *ibusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, ibusDataReceive, IBUS_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
+    ibusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, ibusDataReceive, IBUS_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
 
     return ibusPort != NULL;
 }
 
 static uint8_t ibus[IBUS_BUFFSIZE] = { 0, };
 
-// Receive ISR callback
+// Receive ISR callback, or called from ibusFrameStatus() when the port drains RX DMA
 static void ibusDataReceive(uint16_t c)
 {
     uint32_t ibusTime;
     static uint32_t ibusTimeLast;
-    static uint8_t ibusFramePosition;
 
     ibusTime = micros();
 
@@ -98,12 +99,19 @@ static void ibusDataReceive(uint16_t c)
     }
 }
 
+static void ibusFrameEnd(void)
+{
+    ibusFramePosition = 0;
+}
+
 uint8_t ibusFrameStatus(void)
 {
     uint8_t i, offset;
     uint8_t frameStatus = SERIAL_RX_FRAME_PENDING;
     uint16_t chksum, rxsum;
 
+    serialDrainRx(ibusPort, ibusDataReceive, ibusFrameEnd);
+
     if (!ibusFrameDone) {
         return frameStatus;
     }
@@ -55,6 +55,7 @@ void rxMspFrameReceive(uint16_t *frame, int channelCount)
     }
 
     rxMspFrameDone = true;
+    rxSignalFrameReady();
 }
 
 bool rxMspFrameComplete(void)
@@ -0,0 +1,169 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <platform.h>
+
+#ifdef NRF
+
+#include "common/crc.h"
+
+#include "rx/nrf_packet.h"
+
+#define NRF_PACKET_CHANNEL_BITS     11
+#define NRF_PACKET_CHANNEL_MASK     ((1 << NRF_PACKET_CHANNEL_BITS) - 1)
+#define NRF_PACKET_CHANNEL_OFFSET   4
+#define NRF_PACKET_TRAILER_OFFSET   (NRF_PACKET_CHANNEL_OFFSET + NRF_PACKET_CHANNEL_COUNT * NRF_PACKET_CHANNEL_BITS / 8)
+#define NRF_PACKET_CRC_OFFSET       (NRF_PACKET_SIZE - 2)
+
+// a sequence step further back than this is taken as a controller restart rather than a late packet
+#define NRF_SEQUENCE_MAX_LATE       16
+#define NRF_SEQUENCE_WINDOW         32
+
+static uint16_t nrfPacketCrc(const uint8_t *buf)
+{
+    uint16_t crc = 0;
+
+    for (int i = 0; i < NRF_PACKET_CRC_OFFSET; i++) {
+        crc = crc16_CCITT(crc, buf[i]);
+    }
+    return crc;
+}
+
+void nrfPacketEncode(uint8_t *buf, const nrfPacket_t *packet)
+{
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    uint8_t *dst = buf + NRF_PACKET_CHANNEL_OFFSET;
+
+    buf[0] = NRF_PACKET_VERSION;
+    buf[1] = packet->sequence;
+    buf[2] = packet->cmd & 0xff;
+    buf[3] = packet->cmd >> 8;
+
+    for (int i = 0; i < NRF_PACKET_CHANNEL_COUNT; i++) {
+        bits |= (uint32_t)(packet->channels[i] & NRF_PACKET_CHANNEL_MASK) << bitCount;
+        bitCount += NRF_PACKET_CHANNEL_BITS;
+        while (bitCount >= 8) {
+            *dst++ = bits & 0xff;
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    buf[NRF_PACKET_TRAILER_OFFSET + 0] = packet->led;
+    buf[NRF_PACKET_TRAILER_OFFSET + 1] = packet->ledRgb;
+    buf[NRF_PACKET_TRAILER_OFFSET + 2] = packet->beep;
+    buf[NRF_PACKET_TRAILER_OFFSET + 3] = packet->key;
+
+    const uint16_t crc = nrfPacketCrc(buf);
+    buf[NRF_PACKET_CRC_OFFSET] = crc & 0xff;
+    buf[NRF_PACKET_CRC_OFFSET + 1] = crc >> 8;
+}
+
+nrfPacketStatus_e nrfPacketDecode(const uint8_t *buf, nrfPacket_t *packet)
+{
+    if (buf[0] != NRF_PACKET_VERSION) {
+        return NRF_PACKET_BAD_VERSION;
+    }
+    if (nrfPacketCrc(buf) != (buf[NRF_PACKET_CRC_OFFSET] | (buf[NRF_PACKET_CRC_OFFSET + 1] << 8))) {
+        return NRF_PACKET_BAD_CRC;
+    }
+
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    const uint8_t *src = buf + NRF_PACKET_CHANNEL_OFFSET;
+
+    packet->sequence = buf[1];
+    packet->cmd = buf[2] | (buf[3] << 8);
+
+    for (int i = 0; i < NRF_PACKET_CHANNEL_COUNT; i++) {
+        while (bitCount < NRF_PACKET_CHANNEL_BITS) {
+            bits |= (uint32_t)*src++ << bitCount;
+            bitCount += 8;
+        }
+        packet->channels[i] = bits & NRF_PACKET_CHANNEL_MASK;
+        bits >>= NRF_PACKET_CHANNEL_BITS;
+        bitCount -= NRF_PACKET_CHANNEL_BITS;
+    }
+
+    packet->led = buf[NRF_PACKET_TRAILER_OFFSET + 0];
+    packet->ledRgb = buf[NRF_PACKET_TRAILER_OFFSET + 1];
+    packet->beep = buf[NRF_PACKET_TRAILER_OFFSET + 2];
+    packet->key = buf[NRF_PACKET_TRAILER_OFFSET + 3];
+
+    return NRF_PACKET_OK;
+}
+
+void nrfSequenceReset(nrfSequenceTracker_t *tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+// Classifies a received sequence number, lost is set to the number of packets skipped over
+nrfSequenceResult_e nrfSequenceUpdate(nrfSequenceTracker_t *tracker, uint8_t sequence, uint8_t *lost)
+{
+    const int8_t step = (int8_t)(sequence - tracker->lastSequence);
+
+    *lost = 0;
+
+    if (tracker->synced) {
+        if (step == 0) {
+            return NRF_SEQUENCE_DUPLICATE;
+        }
+        if (step < 0 && step >= -NRF_SEQUENCE_MAX_LATE) {
+            return NRF_SEQUENCE_LATE;
+        }
+    }
+
+    if (tracker->synced && step > 0) {
+        *lost = step - 1;
+        tracker->history = step < NRF_SEQUENCE_WINDOW ? tracker->history << step : 0;
+    } else {
+        tracker->history <<= 1;
+    }
+    tracker->history |= 1;
+    tracker->lastSequence = sequence;
+    tracker->synced = true;
+
+    // A freshly synced tracker starts degraded, the link has to prove itself over half a window first
+    const uint8_t quality = nrfSequenceLinkQuality(tracker);
+    if (quality < NRF_LINK_QUALITY_LOST) {
+        tracker->degraded = true;
+    } else if (quality >= NRF_LINK_QUALITY_REGAINED) {
+        tracker->degraded = false;
+    }
+
+    return NRF_SEQUENCE_ACCEPT;
+}
+
+// Percentage of the last NRF_SEQUENCE_WINDOW sequence numbers that arrived
+uint8_t nrfSequenceLinkQuality(const nrfSequenceTracker_t *tracker)
+{
+    return __builtin_popcount(tracker->history) * 100 / NRF_SEQUENCE_WINDOW;
+}
+
+// True while packets still arrive but too many sequence numbers are missing to fly on them
+bool nrfSequenceLinkDegraded(const nrfSequenceTracker_t *tracker)
+{
+    return tracker->degraded;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Binary NRF24L01 command packet, 32 bytes, multi-byte fields little-endian:
+ *
+ *   0      version, NRF_PACKET_VERSION
+ *   1      sequence, incremented by the controller for every new packet
+ *   2-3    command flags (enum MSP_CMD)
+ *   4-25   16 channels, 11 bits each packed LSB first, in microseconds, 0 = not sent
+ *   26     led
+ *   27     led_rgb
+ *   28     beep
+ *   29     key
+ *   30-31  crc16_CCITT over bytes 0-29, initial value 0
+ *
+ * The version byte is never '$', so legacy "$M<" packets can still be told apart.
+ */
+
+#define NRF_PACKET_VERSION          0xB1
+#define NRF_PACKET_SIZE             32
+#define NRF_PACKET_CHANNEL_COUNT    16
+#define NRF_PACKET_STICK_COUNT      4
+
+typedef struct nrfPacket_s {
+    uint8_t sequence;
+    uint16_t cmd;
+    uint16_t channels[NRF_PACKET_CHANNEL_COUNT];
+    uint8_t led;
+    uint8_t ledRgb;
+    uint8_t beep;
+    uint8_t key;
+} nrfPacket_t;
+
+typedef enum {
+    NRF_PACKET_OK = 0,
+    NRF_PACKET_BAD_VERSION,
+    NRF_PACKET_BAD_CRC,
+} nrfPacketStatus_e;
+
+void nrfPacketEncode(uint8_t *buf, const nrfPacket_t *packet);
+nrfPacketStatus_e nrfPacketDecode(const uint8_t *buf, nrfPacket_t *packet);
+
+typedef enum {
+    NRF_SEQUENCE_ACCEPT = 0,
+    NRF_SEQUENCE_DUPLICATE,
+    NRF_SEQUENCE_LATE,
+} nrfSequenceResult_e;
+
+typedef struct nrfSequenceTracker_s {
+    uint32_t history;           // one bit per sequence number, bit 0 is the newest accepted packet
+    uint8_t lastSequence;
+    bool synced;
+    bool degraded;              // link quality fell below NRF_LINK_QUALITY_LOST and hasn't recovered yet
+} nrfSequenceTracker_t;
+
+// Link quality hysteresis, in percent of the last 32 sequence numbers
+#define NRF_LINK_QUALITY_LOST       25
+#define NRF_LINK_QUALITY_REGAINED   50
+
+void nrfSequenceReset(nrfSequenceTracker_t *tracker);
+nrfSequenceResult_e nrfSequenceUpdate(nrfSequenceTracker_t *tracker, uint8_t sequence, uint8_t *lost);
+uint8_t nrfSequenceLinkQuality(const nrfSequenceTracker_t *tracker);
+bool nrfSequenceLinkDegraded(const nrfSequenceTracker_t *tracker);
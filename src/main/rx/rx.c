@@ -46,7 +46,9 @@
 #include "io/serial.h"
 
 #include "fc/rc_controls.h"
+#include "fc/rc_latency.h"
 #include "fc/config.h"
+#include "fc/fc_tasks.h"
 
 #include "flight/failsafe.h"
 
@@ -67,6 +69,8 @@
 
 #include "rx/rx.h"
 
+#include "scheduler/scheduler.h"
+
 //#define DEBUG_RX_SIGNAL_LOSS
 
 const char rcChannelLetters[] = "AERT12345678abcdefgh";
@@ -81,6 +85,8 @@ static bool rxIsInFailsafeMode = true;
 static bool rxIsInFailsafeModeNotDataDriven = true;
 
 static uint32_t rxUpdateAt = 0;
+static bool rxSignalDriven = false;
+static volatile uint32_t rxSignalledAt = 0;     // time of the last receiver frame signal, 0 = none
 static uint32_t needRxSignalBefore = 0;
 static uint32_t suspendRxSignalUntil = 0;
 static uint8_t  skipRxSamples = 0;
@@ -102,7 +108,7 @@ static uint8_t rcSampleIndex = 0;
 
 rxRuntimeConfig_t rxRuntimeConfig;
 
-PG_REGISTER_WITH_RESET_TEMPLATE(rxConfig_t, rxConfig, PG_RX_CONFIG, 0);
+PG_REGISTER_WITH_RESET_TEMPLATE(rxConfig_t, rxConfig, PG_RX_CONFIG, 2);
 
 PG_REGISTER_ARR_WITH_RESET_FN(rxFailsafeChannelConfig_t, MAX_SUPPORTED_RC_CHANNEL_COUNT, failsafeChannelConfigs, PG_FAILSAFE_CHANNEL_CONFIG, 0);
 PG_REGISTER_ARR_WITH_RESET_FN(rxChannelRangeConfiguration_t, NON_AUX_CHANNEL_COUNT, channelRanges, PG_CHANNEL_RANGE_CONFIG, 0);
@@ -115,6 +121,7 @@ PG_RESET_TEMPLATE(rxConfig_t, rxConfig,
     .rx_min_usec = 885,          // any of first 4 channels below this value will trigger rx loss detection
     .rx_max_usec = 2115,         // any of first 4 channels above this value will trigger rx loss detection
     .rssi_scale = RSSI_SCALE_DEFAULT,
+    .rcSmoothingCutoffPercent = 50,
 );
 
 void pgResetFn_channelRanges(rxChannelRangeConfiguration_t *instance)
@@ -207,6 +214,9 @@ void rxInit(modeActivationCondition_t *modeActivationConditions)
         }
     }
 
+    // Only the active receiver decides whether TASK_RX can stop polling, and only if it signals every frame
+    rxSignalDriven = false;
+
 #ifdef SERIAL_RX
     if (feature(FEATURE_RX_SERIAL)) {
         serialRxInit(rxConfig());
@@ -216,12 +226,27 @@ void rxInit(modeActivationCondition_t *modeActivationConditions)
     if (feature(FEATURE_RX_MSP)) {
         rxRefreshRate = 20000;
         rxMspInit(&rxRuntimeConfig, &rcReadRawFunc);
+        rxSignalDriven = true;
     }
 
     if (feature(FEATURE_RX_PPM) || feature(FEATURE_RX_PARALLEL_PWM)) {
         rxRefreshRate = 20000;
         rxPwmInit(&rxRuntimeConfig, &rcReadRawFunc);
+        if (feature(FEATURE_RX_PPM)) {
+            ppmSetFrameCallback(rxSignalFrameReady);
+            rxSignalDriven = true;
+        }
     }
+
+#ifdef NRF
+    /*
+     * The NRF24L01 is the receiver whichever RX feature is set (the default is PPM), so it overrides the choice above.
+     * Its IRQ only wakes TASK_RX early, the task stays polled on every scheduler pass: nrfTxUpdate() has to catch the
+     * telemetry TX timeout and nrf_rx() counts the RX updates without a packet for the link loss check.
+     */
+    nrfSetIrqCallback(rxSignalFrameReady);
+    rxSignalDriven = false;
+#endif
 }
 
 #ifdef SERIAL_RX
@@ -265,6 +290,13 @@ void serialRxInit(rxConfig_t *rxConfig)
     if (!enabled) {
         featureClear(FEATURE_RX_SERIAL);
         rcReadRawFunc = nullReadRawRC;
+        return;
+    }
+
+    // A UART reports the idle line after each frame, soft serial ports stay polled by the RX task check
+    serialPort_t *serialRxPort = findOpenSerialPort(FUNCTION_RX_SERIAL);
+    if (serialRxPort) {
+        rxSignalDriven = serialSetIdleCallback(serialRxPort, rxSignalFrameReady);
     }
 }
 
@@ -350,12 +382,23 @@ void resumeRxSignal(void)
 
 void updateRx(uint32_t currentTime)
 {
+    // a frame completed by this update ended when the receiver signalled it, not when we polled
+    const uint32_t signalledAt = rxSignalledAt;
+    rxSignalledAt = 0;
+    const uint32_t frameTime = signalledAt ? signalledAt : currentTime;
+
     resetRxSignalReceivedFlagIfNeeded(currentTime);
 
     if (isRxDataDriven()) {
         rxDataReceived = false;
     }
 
+#ifdef NRF
+    nrfTxUpdate(currentTime);
+    if (nrfRxFramePending()) {
+        rxDataReceived = true;
+    }
+#endif
 
 #ifdef SERIAL_RX
     if (feature(FEATURE_RX_SERIAL)) {
@@ -366,6 +409,7 @@ void updateRx(uint32_t currentTime)
             rxIsInFailsafeMode = (frameStatus & SERIAL_RX_FRAME_FAILSAFE) != 0;
             rxSignalReceived = !rxIsInFailsafeMode;
             needRxSignalBefore = currentTime + DELAY_10_HZ;
+            rcLatencyFrameReceived(frameTime);
         }
     }
 #endif
@@ -377,6 +421,7 @@ void updateRx(uint32_t currentTime)
             rxSignalReceived = true;
             rxIsInFailsafeMode = false;
             needRxSignalBefore = currentTime + DELAY_5_HZ;
+            rcLatencyFrameReceived(frameTime);
         }
     }
 
@@ -386,6 +431,7 @@ void updateRx(uint32_t currentTime)
             rxIsInFailsafeModeNotDataDriven = false;
             needRxSignalBefore = currentTime + DELAY_10_HZ;
             resetPPMDataReceivedState();
+            rcLatencyFrameReceived(frameTime);
         }
     }
 
@@ -399,6 +445,27 @@ void updateRx(uint32_t currentTime)
 
 }
 
+/*
+ * Called by a receiver, possibly from interrupt context, when a complete frame is available.
+ * This wakes the RX task directly instead of waiting for the scheduler to poll taskUpdateRxCheck().
+ */
+void rxSignalFrameReady(void)
+{
+    const uint32_t now = micros();
+    rxSignalledAt = now ? now : 1;
+    signalTask(TASK_RX);
+}
+
+bool rxIsSignalDriven(void)
+{
+    return rxSignalDriven;
+}
+
+bool rxIsFrameReceived(void)
+{
+    return rxDataReceived;
+}
+
 bool shouldProcessRx(uint32_t currentTime)
 {
     return rxDataReceived || ((int32_t)(currentTime - rxUpdateAt) >= 0); // data driven or 50Hz
@@ -594,10 +661,19 @@ void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime)
 	static uint8_t tx_flag = 0,b = 0;
 	static uint16_t m;
 
+	if(nrfGetLinkMode() == NRF_LINK_ACK_PAYLOAD)	tx_flag = 0;//telemetry rides on the ACKs, never leave RX mode
 	tx_flag++;
 	if(tx_flag <= 4) {
+		const bool linked = nrf_rx();
+		if(!linked) {
+			// aux channels are not part of the landing logic below, give them their rxfail values
+			for (uint8_t channel = NON_AUX_CHANNEL_COUNT; channel < rxRuntimeConfig.channelCount; channel++) {
+				rcData[channel] = getRxfailValue(channel);
+			}
+		}
+
 		//低电压降落+失控保护——use height
-		if(!nrf_rx() || flag.batt_low) {
+		if(!linked || flag.batt_low) {
 			if(mspData.mspCmd & ONLINE)	
 				mspData.mspCmd &= ~MOTOR;//在线模式控制电机转时遥控断电，电机一直转，无法控制
 			if(!flag.batt_low) {
@@ -646,8 +722,7 @@ void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime)
 	}
 
 	if(tx_flag > 4) {
-		nrf_tx();
-		SetRX_Mode();
+		nrf_tx();//returns to RX mode from nrfTxUpdate() once the IRQ fires
 		tx_flag = 0;
 	}
 	
@@ -668,6 +743,8 @@ void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime)
 
 #endif
 
+    rcLatencyRcDataUpdated();
+
 #if 0	//test i2c read and write
 /*
 	static uint8_t sta;
@@ -783,6 +860,13 @@ void updateRSSIADC(uint32_t currentTime)
 #endif
 }
 
+#ifdef NRF
+static void updateRSSINrf(void)
+{
+    rssi = nrfGetLinkQuality() * 1023 / 100;
+}
+#endif
+
 void updateRSSI(uint32_t currentTime)
 {
 
@@ -791,6 +875,11 @@ void updateRSSI(uint32_t currentTime)
     } else if (feature(FEATURE_RSSI_ADC)) {
         updateRSSIADC(currentTime);
     }
+#ifdef NRF
+    else {
+        updateRSSINrf();
+    }
+#endif
 }
 
 void initRxRefreshRate(uint16_t *rxRefreshRatePtr)
@@ -116,7 +116,9 @@ typedef struct rxConfig_s {
     uint8_t rssi_channel;
     uint8_t rssi_scale;
     uint8_t rssi_ppm_invert;
-    uint8_t rcSmoothing;                    // Enable/Disable RC filtering
+    uint8_t rcSmoothing;                    // RC filtering type, see rcSmoothingType_e
+    uint8_t rcSmoothingCutoffPercent;       // RC filter cutoff as a percentage of the measured RX frame rate
+    uint8_t nrf_link_mode;                  // NRF24L01 telemetry transport, see nrfLinkMode_e
     uint16_t midrc;                         // Some radios have not a neutral point centered on 1500. can be changed here
     uint16_t mincheck;                      // minimum rc end
     uint16_t maxcheck;                      // maximum rc end
@@ -142,6 +144,9 @@ void updateRx(uint32_t currentTime);
 bool rxIsReceivingSignal(void);
 bool rxAreFlightChannelsValid(void);
 bool shouldProcessRx(uint32_t currentTime);
+bool rxIsFrameReceived(void);
+void rxSignalFrameReady(void);
+bool rxIsSignalDriven(void);
 void calculateRxChannelsAndUpdateFailsafe(uint32_t currentTime);
 
 void parseRcChannels(const char *input, rxConfig_t *rxConfig);
@@ -76,6 +76,9 @@ static uint16_t sbusStateFlags = 0;
 #define SBUS_DIGITAL_CHANNEL_MAX 1812
 
 static bool sbusFrameDone = false;
+static uint8_t sbusFramePosition = 0;
+static serialPort_t *sBusPort;
+
 static void sbusDataReceive(uint16_t c);
 static uint16_t sbusReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
@@ -95,7 +98,7 @@ bool sbusInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
         return false;
     }
     portOptions_t options = (rxConfig()->sbus_inversion) ? (SBUS_PORT_OPTIONS | SERIAL_INVERTED) : SBUS_PORT_OPTIONS;
-    serialPort_t *sBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sbusDataReceive, SBUS_BAUDRATE, MODE_RX, options);
+    sBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sbusDataReceive, SBUS_BAUDRATE, MODE_RX, options);
 
     return sBusPort != NULL;
 }
@@ -142,10 +145,9 @@ typedef union {
 
 static sbusFrame_t sbusFrame;
 
-// Receive ISR callback
+// Receive ISR callback, or called from sbusFrameStatus() when the port drains RX DMA
 static void sbusDataReceive(uint16_t c)
 {
-    static uint8_t sbusFramePosition = 0;
     static uint32_t sbusFrameStartAt = 0;
     uint32_t now = micros();
 
@@ -176,8 +178,15 @@ static void sbusDataReceive(uint16_t c)
     }
 }
 
+static void sbusFrameEnd(void)
+{
+    sbusFramePosition = 0;
+}
+
 uint8_t sbusFrameStatus(void)
 {
+    serialDrainRx(sBusPort, sbusDataReceive, sbusFrameEnd);
+
     if (!sbusFrameDone) {
         return SERIAL_RX_FRAME_PENDING;
     }
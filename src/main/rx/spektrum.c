@@ -54,6 +54,8 @@ static uint8_t spek_chan_shift;
 static uint8_t spek_chan_mask;
 static bool rcFrameComplete = false;
 static bool spekHiRes = false;
+static uint8_t spekFramePosition = 0;
+static serialPort_t *spektrumPort;
 
 static volatile uint8_t spekFrame[SPEK_FRAME_SIZE];
 
@@ -91,17 +93,16 @@ bool spektrumInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback
         return false;
     }
 
-    serialPort_t *spektrumPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, spektrumDataReceive, SPEKTRUM_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
+    spektrumPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, spektrumDataReceive, SPEKTRUM_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
 
     return spektrumPort != NULL;
 }
 
-// Receive ISR callback
+// Receive ISR callback, or called from spektrumFrameStatus() when the port drains RX DMA
 static void spektrumDataReceive(uint16_t c)
 {
     uint32_t spekTime, spekTimeInterval;
     static uint32_t spekTimeLast = 0;
-    static uint8_t spekFramePosition = 0;
 
     spekTime = micros();
     spekTimeInterval = spekTime - spekTimeLast;
@@ -123,10 +124,17 @@ static void spektrumDataReceive(uint16_t c)
 
 static uint32_t spekChannelData[SPEKTRUM_MAX_SUPPORTED_CHANNEL_COUNT];
 
+static void spektrumFrameEnd(void)
+{
+    spekFramePosition = 0;
+}
+
 uint8_t spektrumFrameStatus(void)
 {
     uint8_t b;
 
+    serialDrainRx(spektrumPort, spektrumDataReceive, spektrumFrameEnd);
+
     if (!rcFrameComplete) {
         return SERIAL_RX_FRAME_PENDING;
     }
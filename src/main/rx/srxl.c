@@ -76,6 +76,7 @@ static bool srxlDataIncoming = false;
 static uint8_t srxlFramePosition;
 static uint8_t srxlFrameLength;
 static uint8_t srxlChannelCount;
+static serialPort_t *srxlPort;
 
 static void srxlDataReceive(uint16_t c);
 
@@ -104,13 +105,13 @@ bool srxlInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
         return false;
     }
 
-    serialPort_t *srxlPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, srxlDataReceive, baudRate, MODE_RX, SERIAL_NOT_INVERTED);
+    srxlPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, srxlDataReceive, baudRate, MODE_RX, SERIAL_NOT_INVERTED);
 
     return srxlPort != NULL;
 }
 
 
-// Receive ISR callback
+// Receive ISR callback, or called from srxlFrameStatus() when the port drains RX DMA
 static void srxlDataReceive(uint16_t c)
 {
     uint32_t now;
@@ -154,6 +155,12 @@ static void srxlDataReceive(uint16_t c)
     }
 }
 
+static void srxlFrameEnd(void)
+{
+    srxlFramePosition = 0;
+    srxlDataIncoming = false;
+}
+
 // Indicate time to read a frame from the data...
 uint8_t srxlFrameStatus(void)
 {
@@ -162,6 +169,8 @@ uint8_t srxlFrameStatus(void)
     uint8_t frameAddr;
     uint16_t crc_calc = 0;
 
+    serialDrainRx(srxlPort, srxlDataReceive, srxlFrameEnd);
+
     if (!srxlFrameReceived) {
         return SERIAL_RX_FRAME_PENDING;
     }
@@ -48,6 +48,8 @@
 static bool sumdFrameDone = false;
 static uint16_t sumdChannels[SUMD_MAX_CHANNEL];
 static uint16_t crc;
+static uint8_t sumdIndex;
+static serialPort_t *sumdPort;
 
 static void sumdDataReceive(uint16_t c);
 static uint16_t sumdReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
@@ -64,7 +66,7 @@ bool sumdInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
         return false;
     }
 
-    serialPort_t *sumdPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sumdDataReceive, SUMD_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
+    sumdPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, sumdDataReceive, SUMD_BAUDRATE, MODE_RX, SERIAL_NOT_INVERTED);
 
     return sumdPort != NULL;
 }
@@ -88,12 +90,11 @@ static void CRC16(uint8_t value)
 static uint8_t sumd[SUMD_BUFFSIZE] = { 0, };
 static uint8_t sumdChannelCount;
 
-// Receive ISR callback
+// Receive ISR callback, or called from sumdFrameStatus() when the port drains RX DMA
 static void sumdDataReceive(uint16_t c)
 {
     uint32_t sumdTime;
     static uint32_t sumdTimeLast;
-    static uint8_t sumdIndex;
 
     sumdTime = micros();
     if ((sumdTime - sumdTimeLast) > 4000)
@@ -131,12 +132,19 @@ static void sumdDataReceive(uint16_t c)
 #define SUMD_FRAME_STATE_OK 0x01
 #define SUMD_FRAME_STATE_FAILSAFE 0x81
 
+static void sumdFrameEnd(void)
+{
+    sumdIndex = 0;
+}
+
 uint8_t sumdFrameStatus(void)
 {
     uint8_t channelIndex;
 
     uint8_t frameStatus = SERIAL_RX_FRAME_PENDING;
 
+    serialDrainRx(sumdPort, sumdDataReceive, sumdFrameEnd);
+
     if (!sumdFrameDone) {
         return frameStatus;
     }
@@ -57,6 +57,7 @@ static void sumhDataReceive(uint16_t c);
 static uint16_t sumhReadRawRC(rxRuntimeConfig_t *rxRuntimeConfig, uint8_t chan);
 
 static serialPort_t *sumhPort;
+static uint8_t sumhFramePosition;
 
 
 static void sumhDataReceive(uint16_t c);
@@ -83,12 +84,11 @@ bool sumhInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
     return sumhPort != NULL;
 }
 
-// Receive ISR callback
+// Receive ISR callback, or called from sumhFrameStatus() when the port drains RX DMA
 static void sumhDataReceive(uint16_t c)
 {
     uint32_t sumhTime;
     static uint32_t sumhTimeLast, sumhTimeInterval;
-    static uint8_t sumhFramePosition;
 
     sumhTime = micros();
     sumhTimeInterval = sumhTime - sumhTimeLast;
@@ -106,10 +106,17 @@ static void sumhDataReceive(uint16_t c)
     }
 }
 
+static void sumhFrameEnd(void)
+{
+    sumhFramePosition = 0;
+}
+
 uint8_t sumhFrameStatus(void)
 {
     uint8_t channelIndex;
 
+    serialDrainRx(sumhPort, sumhDataReceive, sumhFrameEnd);
+
     if (!sumhFrameDone) {
         return SERIAL_RX_FRAME_PENDING;
     }
@@ -62,6 +62,7 @@ static bool xBusDataIncoming = false;
 static uint8_t xBusFramePosition;
 static uint8_t xBusFrameLength;
 static uint8_t xBusChannelCount;
+static serialPort_t *xBusPort;
 
 
 // Use max values for ram areas
@@ -94,7 +95,7 @@ bool xBusInit(rxRuntimeConfig_t *rxRuntimeConfig, rcReadRawDataPtr *callback)
         return false;
     }
 
-    serialPort_t *xBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, xBusDataReceive, baudRate, MODE_RX, SERIAL_NOT_INVERTED);
+    xBusPort = openSerialPort(portConfig->identifier, FUNCTION_RX_SERIAL, xBusDataReceive, baudRate, MODE_RX, SERIAL_NOT_INVERTED);
 
     return xBusPort != NULL;
 }
@@ -191,7 +192,7 @@ static void xBusUnpackRJ01Frame(void)
     xBusUnpackModeBFrame(XBUS_RJ01_OFFSET_BYTES);
 }
 
-// Receive ISR callback
+// Receive ISR callback, or called from xBusFrameStatus() when the port drains RX DMA
 static void xBusDataReceive(uint16_t c)
 {
     uint32_t now;
@@ -240,9 +241,20 @@ static void xBusDataReceive(uint16_t c)
     }
 }
 
+static void xBusFrameEnd(void)
+{
+    // A complete frame is left in place for xBusFrameStatus(), anything shorter is discarded.
+    if (!xBusFrameReceived) {
+        xBusFramePosition = 0;
+        xBusDataIncoming = false;
+    }
+}
+
 // Indicate time to read a frame from the data...
 uint8_t xBusFrameStatus(void)
 {
+    serialDrainRx(xBusPort, xBusDataReceive, xBusFrameEnd);
+
     if (!xBusFrameReceived) {
         return SERIAL_RX_FRAME_PENDING;
     }
@@ -185,6 +185,25 @@ uint32_t getTaskDeltaTime(const int taskId)
     }
 }
 
+/*
+ * Marks an event driven task as ready, may be called from interrupt context.
+ */
+void signalTask(const int taskId)
+{
+    if (taskId == TASK_SELF || taskId < (int)taskCount) {
+        cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
+        task->signaled = true;
+    }
+}
+
+void setTaskSignalDriven(const int taskId, bool signalDriven)
+{
+    if (taskId == TASK_SELF || taskId < (int)taskCount) {
+        cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
+        task->signalDriven = signalDriven;
+    }
+}
+
 void schedulerInit(void)
 {
     queueClear();
@@ -222,7 +241,11 @@ void scheduler(void)
                 task->taskAgeCycles = 1 + ((currentTime - task->lastSignaledAt) / task->desiredPeriod);
                 task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
                 waitingTasks++;
-            } else if (task->checkFunc(currentTime - task->lastExecutedAt)) {
+            } else if (task->signaled || (
+                        // a signal driven task is only polled as a fallback when its signal is overdue
+                        (!task->signalDriven || (currentTime - task->lastExecutedAt) >= task->desiredPeriod)
+                        && task->checkFunc(currentTime - task->lastExecutedAt))) {
+                task->signaled = false;
                 task->lastSignaledAt = currentTime;
                 task->taskAgeCycles = 1;
                 task->dynamicPriority = 1 + task->staticPriority;
@@ -262,6 +285,7 @@ void scheduler(void)
         selectedTask->taskLatestDeltaTime = currentTime - selectedTask->lastExecutedAt;
         selectedTask->lastExecutedAt = currentTime;
         selectedTask->dynamicPriority = 0;
+        selectedTask->signaled = false;     // signals raised while the task runs are kept for the next pass
 
         // Execute task
         const uint32_t currentTimeBeforeTaskCall = micros();
@@ -54,6 +54,8 @@ typedef struct {
     uint16_t taskAgeCycles;
     uint32_t lastExecutedAt;        // last time of invocation
     uint32_t lastSignaledAt;        // time of invocation event for event-driven tasks
+    volatile bool signaled;         // set by signalTask(), makes the task ready without calling checkFunc
+    bool signalDriven;              // checkFunc is only polled once desiredPeriod has elapsed, signalTask() does the rest
 
     /* Statistics */
     uint32_t averageExecutionTime;  // Moving average over 6 samples, used to calculate guard interval
@@ -76,6 +78,8 @@ void getTaskInfo(const int taskId, cfTaskInfo_t *taskInfo);
 void rescheduleTask(const int taskId, uint32_t newPeriodMicros);
 void setTaskEnabled(const int taskId, bool newEnabledState);
 uint32_t getTaskDeltaTime(const int taskId);
+void signalTask(const int taskId);
+void setTaskSignalDriven(const int taskId, bool signalDriven);
 
 void schedulerInit(void);
 void scheduler(void);
@@ -48,6 +48,7 @@ int32_t BaroAlt = 0;
 PG_REGISTER_PROFILE_WITH_RESET_TEMPLATE(barometerConfig_t, barometerConfig, PG_BAROMETER_CONFIG, 0);
 
 static int32_t baroGroundAltitude = 0;
+static uint32_t baroSampledAt = 0;
 static int32_t baroGroundPressure = 0;
 static uint32_t baroPressureSum = 0;
 
@@ -131,6 +132,12 @@ bool isBaroReady(void) {
 	return baroReady;
 }
 
+// time of the newest pressure sample, micros()
+uint32_t baroGetSampleTime(void)
+{
+    return baroSampledAt;
+}
+
 uint32_t baroUpdate(void)
 {
     static barometerState_e state = BAROMETER_NEEDS_SAMPLES;
@@ -149,6 +156,7 @@ uint32_t baroUpdate(void)
             baro.start_ut();
             baro.calculate(&baroPressure, &baroTemperature);
             baroPressureSum = recalculateBarometerTotal(barometerConfig()->baro_sample_count, baroPressureSum, baroPressure);
+            baroSampledAt = micros();
             state = BAROMETER_NEEDS_SAMPLES;
             return baro.ut_delay;
         break;
@@ -161,7 +169,7 @@ int32_t baroCalculateAltitude(void)
 
     // calculates height from ground via baro readings
     // see: https://github.com/diydrones/ardupilot/blob/master/libraries/AP_Baro/AP_Baro.cpp#L140
-    BaroAlt_tmp = lrintf((1.0f - powf((float)(baroPressureSum / PRESSURE_SAMPLE_COUNT) / 101325.0f, 0.190295f)) * 4433000.0f); // in cm
+    BaroAlt_tmp = lrintf(pressureToAltitude((float)(baroPressureSum / PRESSURE_SAMPLE_COUNT), 101325.0f)); // in cm
     BaroAlt_tmp -= baroGroundAltitude;
     BaroAlt = lrintf((float)BaroAlt * barometerConfig()->baro_noise_lpf + (float)BaroAlt_tmp * (1.0f - barometerConfig()->baro_noise_lpf)); // additional LPF to reduce baro noise
 
@@ -172,7 +180,7 @@ void performBaroCalibrationCycle(void)
 {
     baroGroundPressure -= baroGroundPressure / 8;
     baroGroundPressure += baroPressureSum / PRESSURE_SAMPLE_COUNT;
-    baroGroundAltitude = (1.0f - powf((baroGroundPressure / 8) / 101325.0f, 0.190295f)) * 4433000.0f;
+    baroGroundAltitude = pressureToAltitude(baroGroundPressure / 8, 101325.0f);
 
     calibratingB--;
 }
@@ -46,6 +46,7 @@ bool isBaroCalibrationComplete(void);
 void baroSetCalibrationCycles(uint16_t calibrationCyclesRequired);
 uint32_t baroUpdate(void);
 bool isBaroReady(void);
+uint32_t baroGetSampleTime(void);
 int32_t baroCalculateAltitude(void);
 void performBaroCalibrationCycle(void);
 #endif
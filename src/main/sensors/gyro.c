@@ -47,6 +47,7 @@ gyro_t gyro;                      // gyro access functions
 sensor_align_e gyroAlign = 0;
 
 int32_t gyroADC[XYZ_AXIS_COUNT];
+int32_t gyroADCUnfiltered[XYZ_AXIS_COUNT];  // aligned and zeroed like gyroADC, but before the software LPF
 
 
 static uint16_t calibratingG = 0;
@@ -143,6 +144,7 @@ static void applyGyroZero(void)
 {
     for (int axis = 0; axis < 3; axis++) {
         gyroADC[axis] -= gyroZero[axis];
+        gyroADCUnfiltered[axis] -= gyroZero[axis];
     }
 }
 
@@ -160,6 +162,10 @@ void gyroUpdate(void)
 
     alignSensors(gyroADC, gyroADC, gyroAlign);
 
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroADCUnfiltered[axis] = gyroADC[axis];
+    }
+
     if (gyroConfig()->soft_gyro_lpf_hz) {
         if (!gyroFilterStateIsSet) {
             initGyroFilterCoefficients();
@@ -88,6 +88,10 @@
 #define USE_UART3 // Not connected - 10/RX (PB11) 11/TX (PB10)
 #define SERIAL_PORT_COUNT 4
 
+// serial RX is drained from DMA1 channel 5 (USART1) and channel 6 (USART2), nothing else on this board uses them
+#define USE_UART1_RX_DMA
+#define USE_UART2_RX_DMA
+
 #define UART1_TX_PIN        GPIO_Pin_6 // PB6
 #define UART1_RX_PIN        GPIO_Pin_7 // PB7
 #define UART1_GPIO          GPIOB
@@ -42,12 +42,17 @@
 
 #define USE_FLASHFS
 #define USE_FLASH_M25P16
+#define FLASHFS_WRITE_BUFFER_SIZE 1024 // pipeline whole flash pages
 
 #define USE_UART1
 #define USE_UART2
 #define USE_UART3
 #define SERIAL_PORT_COUNT 3
 
+// serial RX is drained from DMA1 channel 5 (USART1) and channel 6 (USART2), nothing else on this board uses them
+#define USE_UART1_RX_DMA
+#define USE_UART2_RX_DMA
+
 #ifndef UART1_GPIO
 #define UART1_TX_PIN        GPIO_Pin_9  // PA9
 #define UART1_RX_PIN        GPIO_Pin_10 // PA10
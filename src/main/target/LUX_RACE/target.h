@@ -78,6 +78,10 @@
 #define USE_UART3
 #define SERIAL_PORT_COUNT 4
 
+// serial RX is drained from DMA1 channel 5 (USART1) and channel 6 (USART2), nothing else on this board uses them
+#define USE_UART1_RX_DMA
+#define USE_UART2_RX_DMA
+
 #define UART1_TX_PIN        GPIO_Pin_4
 #define UART1_RX_PIN        GPIO_Pin_5
 #define UART1_GPIO          GPIOC
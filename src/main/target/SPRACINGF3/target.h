@@ -30,6 +30,7 @@
 #define ENABLE_BLACKBOX_LOGGING_ON_SPIFLASH_BY_DEFAULT
 #define USE_FLASHFS//spi2 to 18MHz
 #define USE_FLASH_M25P16
+#define FLASHFS_WRITE_BUFFER_SIZE 1024 // pipeline whole flash pages
 #endif
 
 #define LED0_GPIO   GPIOB
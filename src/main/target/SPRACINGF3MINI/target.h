@@ -87,6 +87,9 @@
 #define USE_SOFTSERIAL1
 #define SERIAL_PORT_COUNT 5
 
+// serial RX is drained from DMA1 channel 6 (USART2), channel 5 (USART1 RX) is used by the SD card
+#define USE_UART2_RX_DMA
+
 #ifndef UART1_GPIO
 #define UART1_TX_PIN        GPIO_Pin_9  // PA9
 #define UART1_RX_PIN        GPIO_Pin_10 // PA10
@@ -152,13 +155,16 @@
 // Divide to under 25MHz for normal operation:
 #define SDCARD_SPI_FULL_SPEED_CLOCK_DIVIDER     2
 
-// Note, this is the same DMA channel as USART1_RX. Luckily we don't use DMA for USART Rx.
+// Note, this is the same DMA channel as USART1_RX, so USE_UART1_RX_DMA must stay off.
 #define SDCARD_DMA_CHANNEL_TX               DMA1_Channel5
 #define SDCARD_DMA_CHANNEL_TX_COMPLETE_FLAG DMA1_FLAG_TC5
 
 // Performance logging for SD card operations:
 // #define AFATFS_USE_INTROSPECTIVE_LOGGING
 
+// Cache 16 sectors (8kB) so FAT and directory updates during logging do not evict file data
+#define AFATFS_NUM_CACHE_SECTORS 16
+
 #define USE_ADC
 #define BOARD_HAS_VOLTAGE_DIVIDER
 
@@ -0,0 +1,95 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <platform.h>
+
+#ifdef NRF
+
+#include "common/utils.h"
+#include "common/streambuf.h"
+
+#include "drivers/nrf2401.h"
+
+#include "telemetry/nrf_telemetry.h"
+
+// attitude goes out on every other ACK, the slower changing frames share the rest
+static const uint8_t nrfTelemetrySchedule[] = {
+    NRF_TELEMETRY_ATTITUDE,
+    NRF_TELEMETRY_ALTITUDE,
+    NRF_TELEMETRY_ATTITUDE,
+    NRF_TELEMETRY_BATTERY,
+    NRF_TELEMETRY_ATTITUDE,
+    NRF_TELEMETRY_LINK,
+};
+
+static uint8_t nrfTelemetryScheduleIndex = 0;
+static uint8_t nrfTelemetrySequence = 0;
+
+nrfTelemetryFrame_e nrfTelemetryNextFrame(void)
+{
+    const nrfTelemetryFrame_e frame = nrfTelemetrySchedule[nrfTelemetryScheduleIndex];
+
+    if (++nrfTelemetryScheduleIndex >= ARRAYLEN(nrfTelemetrySchedule)) {
+        nrfTelemetryScheduleIndex = 0;
+    }
+    return frame;
+}
+
+// Serialises one frame into buf, which must hold NRF_TELEMETRY_MAX_FRAME_SIZE bytes. Returns the frame length.
+uint8_t nrfTelemetryBuildFrame(uint8_t *buf, nrfTelemetryFrame_e frame)
+{
+    sbuf_t dst = { .ptr = buf, .end = buf + NRF_TELEMETRY_MAX_FRAME_SIZE };
+    const nrfLinkStats_t *linkStats = nrfGetLinkStats();
+
+    sbufWriteU8(&dst, (frame & 0x0f) | (nrfTelemetrySequence << 4));
+    nrfTelemetrySequence = (nrfTelemetrySequence + 1) & 0x0f;
+
+    switch (frame) {
+        case NRF_TELEMETRY_ATTITUDE:
+            sbufWriteU16(&dst, flag.roll1);
+            sbufWriteU16(&dst, flag.pitch1);
+            sbufWriteU16(&dst, flag.yaw1);
+            sbufWriteU16(&dst, mspData.mspCmd);
+            sbufWriteU8(&dst, mspData.key);
+            break;
+        case NRF_TELEMETRY_ALTITUDE:
+            sbufWriteU32(&dst, (int32_t)flag.height);
+            sbufWriteU8(&dst, flag.alt);
+            break;
+        case NRF_TELEMETRY_BATTERY:
+            sbufWriteU16(&dst, flag.batt);
+            sbufWriteU8(&dst, flag.batt_low);
+            sbufWriteU8(&dst, flag.version);
+            break;
+        case NRF_TELEMETRY_LINK:
+            sbufWriteU16(&dst, linkStats->rxPackets);
+            sbufWriteU16(&dst, linkStats->ackPayloads);
+            sbufWriteU16(&dst, linkStats->ackPending);
+            sbufWriteU16(&dst, linkStats->lost);
+            sbufWriteU8(&dst, nrfGetLinkQuality());
+            break;
+        default:
+            break;
+    }
+
+    return dst.ptr - buf;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Telemetry frames attached to NRF24L01 ACK payloads, see NRF_LINK_ACK_PAYLOAD.
+// Byte 0 carries the frame type in the low nibble and a rolling sequence in the high nibble,
+// the remaining bytes are little-endian and depend on the frame type.
+
+typedef enum {
+    NRF_TELEMETRY_ATTITUDE = 0,     // roll, pitch, yaw (int16, 0.1 deg), mspCmd (uint16), key (uint8)
+    NRF_TELEMETRY_ALTITUDE,         // height (int32, cm), alt (uint8)
+    NRF_TELEMETRY_BATTERY,          // batt (uint16, 0.1V), batt_low (uint8), version (uint8)
+    NRF_TELEMETRY_LINK,             // rx packets, ack payloads loaded, ack payloads still pending on rx, packets lost (uint16), link quality (uint8, %)
+    NRF_TELEMETRY_FRAME_COUNT
+} nrfTelemetryFrame_e;
+
+#define NRF_TELEMETRY_MAX_FRAME_SIZE 12
+
+nrfTelemetryFrame_e nrfTelemetryNextFrame(void);
+uint8_t nrfTelemetryBuildFrame(uint8_t *buf, nrfTelemetryFrame_e frame);
@@ -0,0 +1,341 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of the vertical Kalman filter in flight/altitude_estimator.c.
+ *
+ * Simulated flights, 1kHz accelerometer and 25Hz baro with noise, with a known truth:
+ *   - the accelerometer bias state has to converge to the bias the accelerometer was given, from either side
+ *   - a baro 130ms late, passed with its age, has to give a smaller altitude and velocity error while climbing than
+ *     the same samples passed as if they were fresh
+ *
+ * Blackbox logs: accSmooth[Z] and BaroAlt are fed through the estimator twice, with and without the baro age, and
+ * the estimated bias and the baro innovations are printed. accSmooth[Z] is used as the vertical acceleration, which
+ * holds for a craft near level. make run records the synthetic flight of tools/blackbox_replay/record.c, which
+ * climbs with a 29 cm/s^2 bias on acc Z and a baro 130ms late, and checks the estimate from it.
+ *
+ *   altitude_estimator_test [-d baroDelayMs] [-b expectedBias] [LOG]
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <platform.h>
+
+#include "flight/altitude_estimator.h"
+
+#include "blackbox_decode.h"
+
+// alt_kf_acc_noise and alt_kf_baro_noise defaults, and ALT_KF_BIAS_NOISE from altitudehold.c
+#define ACC_NOISE 50.0f             // cm/s^2
+#define BARO_NOISE 50.0f            // cm
+#define BIAS_NOISE 2.0f             // cm/s^2 per sqrt(s)
+
+#define GRAVITY 980.665f            // cm/s^2
+
+#define SIM_ACC_US 1000
+#define SIM_BARO_US 40000
+#define SIM_ACC_NOISE 20.0f         // cm/s^2 rms
+#define SIM_BARO_NOISE 10.0f        // cm rms
+#define SIM_BARO_DELAY_US 130000    // what the FBM320 filter chain adds
+#define SIM_CLIMB_HEIGHT 300.0f     // cm, climbs and comes back down every SIM_CLIMB_PERIOD
+#define SIM_CLIMB_PERIOD 10.0f      // s
+#define SIM_SECONDS 60
+
+#define BIAS_SETTLE_S 20            // s before the bias has to be within BIAS_ERROR_MAX
+#define BIAS_ERROR_MAX 3.0f         // cm/s^2
+#define DELAYED_ALT_RMS_MAX 4.0f    // cm, with the baro age passed
+#define DELAYED_VEL_RMS_MAX 4.0f    // cm/s
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static float gaussian(void)
+{
+    float sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += (float)rand() / RAND_MAX;
+    }
+    return sum - 6.0f;
+}
+
+static float climbAltitude(float t)
+{
+    return t > 0 ? SIM_CLIMB_HEIGHT / 2 * (1 - cosf(2 * M_PI / SIM_CLIMB_PERIOD * t)) : 0;
+}
+
+static float climbVelocity(float t)
+{
+    const float w = 2 * M_PI / SIM_CLIMB_PERIOD;
+    return t > 0 ? SIM_CLIMB_HEIGHT / 2 * w * sinf(w * t) : 0;
+}
+
+static float climbAcceleration(float t)
+{
+    const float w = 2 * M_PI / SIM_CLIMB_PERIOD;
+    return t > 0 ? SIM_CLIMB_HEIGHT / 2 * w * w * cosf(w * t) : 0;
+}
+
+typedef struct simResult_s {
+    float bias;                 // estimate at the end
+    float biasErrorMax;         // after BIAS_SETTLE_S
+    float altitudeRms;          // cm, after BIAS_SETTLE_S
+    float velocityRms;          // cm/s
+} simResult_t;
+
+// Flies the climb profile, the baro is baroDelayUs late and handed to the estimator with an age of baroAgeUs
+static simResult_t simulate(float accBias, uint32_t baroDelayUs, uint32_t baroAgeUs)
+{
+    altitudeEstimator_t estimator;
+    simResult_t result = { 0 };
+    double altitudeSquares = 0, velocitySquares = 0;
+    int samples = 0;
+
+    altitudeEstimatorInit(&estimator, ACC_NOISE, BIAS_NOISE);
+    altitudeEstimatorReset(&estimator, 0);
+
+    for (uint32_t t = SIM_ACC_US; t <= SIM_SECONDS * 1000000; t += SIM_ACC_US) {
+        const float seconds = t * 1e-6f;
+
+        altitudeEstimatorPredict(&estimator, climbAcceleration(seconds) + accBias + SIM_ACC_NOISE * gaussian(), SIM_ACC_US * 1e-6f);
+
+        if (t % SIM_BARO_US == 0) {
+            const float baro = climbAltitude((t - (float)baroDelayUs) * 1e-6f) + SIM_BARO_NOISE * gaussian();
+            altitudeEstimatorCorrect(&estimator, baro, BARO_NOISE, baroAgeUs * 1e-6f);
+        }
+
+        if (seconds >= BIAS_SETTLE_S) {
+            const float altitudeError = estimator.x[ALT_STATE_ALTITUDE] - climbAltitude(seconds);
+            const float velocityError = estimator.x[ALT_STATE_VELOCITY] - climbVelocity(seconds);
+            altitudeSquares += altitudeError * altitudeError;
+            velocitySquares += velocityError * velocityError;
+            samples++;
+            result.biasErrorMax = fmaxf(result.biasErrorMax, fabsf(estimator.x[ALT_STATE_ACC_BIAS] - accBias));
+        }
+    }
+
+    result.bias = estimator.x[ALT_STATE_ACC_BIAS];
+    result.altitudeRms = sqrt(altitudeSquares / samples);
+    result.velocityRms = sqrt(velocitySquares / samples);
+    return result;
+}
+
+static void testBiasConvergence(void)
+{
+    static const float biases[] = { -80, -30, 0, 30, 80 };
+
+    printf("bias convergence, fresh baro\n");
+    printf("  acc bias  estimate  max error after %d s  altitude rms\n", BIAS_SETTLE_S);
+    for (unsigned i = 0; i < sizeof(biases) / sizeof(biases[0]); i++) {
+        srand(1);
+        const simResult_t result = simulate(biases[i], 0, 0);
+        printf("  %8.1f  %8.2f  %14.2f cm/s^2  %9.2f cm\n", biases[i], result.bias, result.biasErrorMax, result.altitudeRms);
+        check(result.biasErrorMax < BIAS_ERROR_MAX, "the bias estimate didn't converge to the accelerometer bias");
+    }
+}
+
+static void testDelayedBaro(void)
+{
+    srand(2);
+    const simResult_t compensated = simulate(30, SIM_BARO_DELAY_US, SIM_BARO_DELAY_US);
+    srand(2);
+    const simResult_t uncompensated = simulate(30, SIM_BARO_DELAY_US, 0);
+
+    printf("baro %d ms late              altitude rms  velocity rms  max bias error\n", SIM_BARO_DELAY_US / 1000);
+    printf("  passed with its age       %7.2f cm  %7.2f cm/s  %8.2f cm/s^2\n",
+        compensated.altitudeRms, compensated.velocityRms, compensated.biasErrorMax);
+    printf("  passed as fresh           %7.2f cm  %7.2f cm/s  %8.2f cm/s^2\n",
+        uncompensated.altitudeRms, uncompensated.velocityRms, uncompensated.biasErrorMax);
+
+    check(compensated.altitudeRms < DELAYED_ALT_RMS_MAX, "altitude error with the baro age passed is too large");
+    check(compensated.velocityRms < DELAYED_VEL_RMS_MAX, "velocity error with the baro age passed is too large");
+    check(compensated.altitudeRms * 2 < uncompensated.altitudeRms, "the baro age doesn't reduce the altitude lag");
+    check(compensated.biasErrorMax < BIAS_ERROR_MAX, "the bias estimate didn't converge with a late baro");
+}
+
+typedef struct logEstimate_s {
+    altitudeEstimator_t estimator;
+    double innovationSquares;
+    int innovations;
+} logEstimate_t;
+
+static void logCorrect(logEstimate_t *estimate, float altitude, float age)
+{
+    const float *x = estimate->estimator.x;
+    const float innovation = altitude - (x[ALT_STATE_ALTITUDE] - x[ALT_STATE_VELOCITY] * age);
+
+    estimate->innovationSquares += innovation * innovation;
+    estimate->innovations++;
+    altitudeEstimatorCorrect(&estimate->estimator, altitude, BARO_NOISE, age);
+}
+
+static int replayLog(const char *path, float baroDelay, bool checkBias, float expectedBias)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(length);
+    if (!data || fread(data, 1, length, file) != (size_t)length) {
+        fprintf(stderr, "%s: read failed\n", path);
+        return 1;
+    }
+    fclose(file);
+
+    static blackboxLog_t log;
+    if (!blackboxDecodeOpen(&log, data, length)) {
+        fprintf(stderr, "%s: not a blackbox log this decoder understands\n", path);
+        return 1;
+    }
+
+    const int fieldTime = blackboxDecodeFieldIndex(&log.frameDefI, "time");
+    const int fieldAccZ = blackboxDecodeFieldIndex(&log.frameDefI, "accSmooth[2]");
+    const int fieldBaro = blackboxDecodeFieldIndex(&log.frameDefI, "BaroAlt");
+    const char *acc1GHeader = blackboxDecodeHeader(&log, "acc_1G");
+    if (fieldTime < 0 || fieldAccZ < 0 || fieldBaro < 0 || !acc1GHeader || atoi(acc1GHeader) <= 0) {
+        fprintf(stderr, "%s: needs time, accSmooth[2] and BaroAlt fields and an acc_1G header\n", path);
+        return 1;
+    }
+    const float accScale = GRAVITY / atoi(acc1GHeader);
+
+    // [0] passes the baro age, [1] takes every sample as fresh
+    static logEstimate_t estimates[2];
+    blackboxFrame_t frame;
+    bool started = false;
+    uint32_t lastTime = 0, frames = 0, baroSamples = 0;
+    int32_t lastBaro = 0;
+
+    while (blackboxDecodeNext(&log, &frame)) {
+        if (frame.type != BLACKBOX_FRAME_MAIN) {
+            continue;
+        }
+        const uint32_t time = frame.values[fieldTime];
+        const int32_t baro = frame.values[fieldBaro];
+        frames++;
+
+        if (!started) {
+            for (int i = 0; i < 2; i++) {
+                altitudeEstimatorInit(&estimates[i].estimator, ACC_NOISE, BIAS_NOISE);
+                altitudeEstimatorReset(&estimates[i].estimator, baro);
+            }
+            started = true;
+            lastTime = time;
+            lastBaro = baro;
+            continue;
+        }
+
+        const float dT = (time - lastTime) * 1e-6f;
+        const float accZ = frame.values[fieldAccZ] * accScale - GRAVITY;
+        lastTime = time;
+        for (int i = 0; i < 2; i++) {
+            altitudeEstimatorPredict(&estimates[i].estimator, accZ, dT);
+        }
+
+        // BaroAlt is logged every loop, a new sample shows up as a change
+        if (baro != lastBaro) {
+            lastBaro = baro;
+            baroSamples++;
+            logCorrect(&estimates[0], baro, baroDelay);
+            logCorrect(&estimates[1], baro, 0);
+        }
+    }
+
+    printf("%s: %u main frames, %u baro samples, acc_1G %s\n", path, frames, baroSamples, acc1GHeader);
+    if (!baroSamples) {
+        printf("no baro samples, nothing to estimate\n");
+        return 1;
+    }
+    printf("                            acc bias  innovation rms  altitude\n");
+    for (int i = 0; i < 2; i++) {
+        const float *x = estimates[i].estimator.x;
+        printf("  %s %8.2f cm/s^2  %9.2f cm  %7.1f cm\n", i ? "baro taken as fresh     " : "baro age passed         ",
+            x[ALT_STATE_ACC_BIAS], sqrt(estimates[i].innovationSquares / estimates[i].innovations), x[ALT_STATE_ALTITUDE]);
+    }
+
+    if (checkBias) {
+        check(fabsf(estimates[0].estimator.x[ALT_STATE_ACC_BIAS] - expectedBias) < BIAS_ERROR_MAX,
+            "the bias estimated from the log isn't the expected one");
+        if (baroDelay > 0) {
+            check(estimates[0].innovationSquares / estimates[0].innovations < estimates[1].innovationSquares / estimates[1].innovations,
+                "passing the baro age doesn't reduce the innovations");
+        }
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: altitude_estimator_test [-d baroDelayMs] [-b expectedBias] [LOG]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    float baroDelay = 0;
+    float expectedBias = 0;
+    bool checkBias = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:")) != -1) {
+        switch (opt) {
+            case 'd':
+                baroDelay = atof(optarg) * 1e-3f;
+            break;
+            case 'b':
+                expectedBias = atof(optarg);
+                checkBias = true;
+            break;
+            default:
+                usage();
+        }
+    }
+    if (optind < argc - 1) {
+        usage();
+    }
+
+    if (optind == argc - 1) {
+        if (replayLog(argv[optind], baroDelay, checkBias, expectedBias)) {
+            return 1;
+        }
+    } else {
+        testBiasConvergence();
+        testDelayedBaro();
+    }
+
+    if (failures) {
+        printf("FAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
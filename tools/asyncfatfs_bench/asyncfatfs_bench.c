@@ -0,0 +1,627 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Runs the blackbox SD card logging path, blackbox_io.c on top of asyncfatfs, against the emulated card in
+ * sdcard_sim.c and reports what a slow card does to it: the sustained write throughput, how much log data was dropped
+ * and the longest run of loop iterations that couldn't log, and how fragmented the log files ended up in the FAT.
+ * The last log is then read back through afatfs_fread() like an MSP download would, and checked against what the card
+ * accepted. The asyncfatfs cache hits, misses, evictions and read-aheads are reported for the logging and the read back.
+ *
+ *   asyncfatfs_bench [-f sizeMB] [-n logs] [-s seconds] [-r bytesPerSecond] [-l looptime] [-b readBytes] [-a] [-S] IMAGE
+ *
+ * -f formats a fresh card image first, otherwise the logs are added to the ones already on the card. -a opens the logs
+ * in plain append mode "a" instead of the "as" blackbox uses, so that the FAT is extended a cluster at a time while
+ * logging and competes with the log data for the cache. -S emulates a slow card, with longer write busy times and a
+ * 100ms stall every 50 writes.
+ *
+ * Build with -DBENCH_NO_CACHE_STATS against an asyncfatfs.c that predates afatfs_getCacheStats(), see "make cache-rev".
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "config/parameter_group.h"
+
+#include "drivers/serial.h"
+
+#include "io/serial.h"
+#include "io/asyncfatfs/asyncfatfs.h"
+#include "io/asyncfatfs/fat_standard.h"
+
+#include "msp/msp_serial.h"
+
+#include "blackbox/blackbox.h"
+#include "blackbox/blackbox_io.h"
+
+#include "sdcard_sim.h"
+
+#define BENCH_BLOCK_SIZE 512
+#define BENCH_MAX_FRAME_SIZE 4096
+
+// Give up on operations that should have finished long before this, in emulated time
+#define BENCH_TIMEOUT_US (60 * 1000000ULL)
+
+// What blackbox_io.c expects from the rest of the firmware, the serial device is never selected
+
+blackboxConfig_t blackboxConfig_System;
+
+uint32_t targetLooptime;
+
+const uint32_t baudRates[] = {0, 9600, 19200, 38400, 57600, 115200, 230400, 250000};
+
+serialPortConfig_t *findSerialPortConfig(uint16_t mask)
+{
+    UNUSED(mask);
+    return NULL;
+}
+
+portSharing_e determinePortSharing(serialPortConfig_t *portConfig, serialPortFunction_e function)
+{
+    UNUSED(portConfig);
+    UNUSED(function);
+    return PORTSHARING_UNUSED;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudrate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+    UNUSED(callback);
+    UNUSED(baudrate);
+    UNUSED(mode);
+    UNUSED(options);
+    return NULL;
+}
+
+void closeSerialPort(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void serialWrite(serialPort_t *instance, uint8_t ch)
+{
+    UNUSED(instance);
+    UNUSED(ch);
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(count);
+}
+
+uint8_t serialTxBytesFree(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return 0;
+}
+
+bool isSerialTransmitBufferEmpty(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return true;
+}
+
+void mspSerialAllocatePorts(void)
+{
+}
+
+/*
+ * blackboxDeviceWrite() ignores a short afatfs_fwrite(), the firmware just loses that data. The benchmark is linked
+ * with --wrap=afatfs_fwrite so it can see what the card actually took, and keeps a hash of it to check the read back.
+ */
+#define BENCH_HASH_INITIAL 2166136261U
+
+static uint32_t benchAcceptedBytes;
+static uint32_t benchAcceptedHash;
+
+uint32_t __real_afatfs_fwrite(afatfsFilePtr_t file, const uint8_t *buffer, uint32_t len);
+
+static uint32_t benchHash(uint32_t hash, const uint8_t *data, uint32_t length)
+{
+    // FNV-1a
+    for (uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+uint32_t __wrap_afatfs_fwrite(afatfsFilePtr_t file, const uint8_t *buffer, uint32_t len)
+{
+    const uint32_t written = __real_afatfs_fwrite(file, buffer, len);
+
+    benchAcceptedBytes += written;
+    benchAcceptedHash = benchHash(benchAcceptedHash, buffer, written);
+
+    return written;
+}
+
+// blackbox_io.c always creates its logs with "as", the benchmark is linked with --wrap=afatfs_fopen to change that
+static const char *benchLogFileMode;
+
+bool __real_afatfs_fopen(const char *filename, const char *mode, afatfsFileCallback_t complete);
+
+bool __wrap_afatfs_fopen(const char *filename, const char *mode, afatfsFileCallback_t complete)
+{
+    if (benchLogFileMode && strcmp(mode, "as") == 0) {
+        mode = benchLogFileMode;
+    }
+
+    return __real_afatfs_fopen(filename, mode, complete);
+}
+
+#ifdef BENCH_NO_CACHE_STATS
+static const afatfsCacheStats_t benchNoCacheStats;
+
+#define afatfs_getCacheStats() (&benchNoCacheStats)
+#endif
+
+static void benchPrintCacheStats(const afatfsCacheStats_t *before)
+{
+#ifdef BENCH_NO_CACHE_STATS
+    UNUSED(before);
+
+    printf("no cache stats\n");
+#else
+    const afatfsCacheStats_t *cache = afatfs_getCacheStats();
+
+    printf("cache hits %u misses %u evictions %u read-aheads %u\n", cache->hits - before->hits,
+        cache->misses - before->misses, cache->evictions - before->evictions, cache->readAheads - before->readAheads);
+#endif
+}
+
+// Where the FAT structures live on the card image, for the fragmentation report
+typedef struct benchVolume_s {
+    uint32_t fatStart;
+    uint32_t clusterStart;
+    uint32_t sectorsPerCluster;
+    uint32_t rootCluster;
+} benchVolume_t;
+
+typedef struct benchLogFile_s {
+    char name[13];
+    uint32_t size;
+    uint32_t clusters;
+    uint32_t fragments;
+} benchLogFile_t;
+
+static void benchTick(uint32_t micros)
+{
+    sdcardSimMicros += micros;
+    afatfs_poll();
+}
+
+static bool benchReadVolume(benchVolume_t *volume)
+{
+    uint8_t sector[BENCH_BLOCK_SIZE];
+
+    if (!sdcardSimPeekBlock(0, sector)) {
+        return false;
+    }
+
+    const mbrPartitionEntry_t *partition = (const mbrPartitionEntry_t *) &sector[446];
+    const uint32_t partitionStart = partition->lbaBegin;
+
+    if (!sdcardSimPeekBlock(partitionStart, sector)) {
+        return false;
+    }
+
+    const fatVolumeID_t *volumeID = (const fatVolumeID_t *) sector;
+
+    volume->fatStart = partitionStart + volumeID->reservedSectorCount;
+    volume->clusterStart = volume->fatStart + volumeID->numFATs * volumeID->fatDescriptor.fat32.FATSize32;
+    volume->sectorsPerCluster = volumeID->sectorsPerCluster;
+    volume->rootCluster = volumeID->fatDescriptor.fat32.rootCluster;
+
+    return volumeID->sectorsPerCluster > 0;
+}
+
+static uint32_t benchNextCluster(const benchVolume_t *volume, uint32_t cluster)
+{
+    static uint32_t fatSector[BENCH_BLOCK_SIZE / sizeof(uint32_t)];
+    static uint32_t cachedSectorIndex = 0;
+
+    const uint32_t sectorIndex = volume->fatStart + cluster / ARRAYLEN(fatSector);
+
+    if (sectorIndex != cachedSectorIndex) {
+        if (!sdcardSimPeekBlock(sectorIndex, (uint8_t *) fatSector)) {
+            return 0;
+        }
+        cachedSectorIndex = sectorIndex;
+    }
+
+    return fat32_decodeClusterNumber(fatSector[cluster % ARRAYLEN(fatSector)]);
+}
+
+static bool benchIsChainCluster(uint32_t cluster)
+{
+    return cluster >= FAT_SMALLEST_LEGAL_CLUSTER_NUMBER && !fat32_isEndOfChainMarker(cluster);
+}
+
+static uint32_t benchEntryCluster(const fatDirectoryEntry_t *entry)
+{
+    return (uint32_t) entry->firstClusterHigh << 16 | entry->firstClusterLow;
+}
+
+/**
+ * Find the entry in the directory that starts at the given cluster for which match() returns true, or the last one
+ * it matched if it keeps returning true. Returns false if there was no match.
+ */
+static bool benchFindEntry(const benchVolume_t *volume, uint32_t directoryCluster,
+    bool (*match)(const fatDirectoryEntry_t *entry), fatDirectoryEntry_t *found)
+{
+    uint8_t sector[BENCH_BLOCK_SIZE];
+    bool foundAny = false;
+
+    for (uint32_t cluster = directoryCluster; benchIsChainCluster(cluster); cluster = benchNextCluster(volume, cluster)) {
+        for (uint32_t i = 0; i < volume->sectorsPerCluster; i++) {
+            if (!sdcardSimPeekBlock(volume->clusterStart + (cluster - FAT_SMALLEST_LEGAL_CLUSTER_NUMBER) * volume->sectorsPerCluster + i, sector)) {
+                return foundAny;
+            }
+
+            fatDirectoryEntry_t *entries = (fatDirectoryEntry_t *) sector;
+
+            for (uint32_t j = 0; j < BENCH_BLOCK_SIZE / sizeof(fatDirectoryEntry_t); j++) {
+                if (fat_isDirectoryEntryTerminator(&entries[j])) {
+                    return foundAny;
+                }
+                if (!fat_isDirectoryEntryEmpty(&entries[j]) && match(&entries[j])) {
+                    *found = entries[j];
+                    foundAny = true;
+                }
+            }
+        }
+    }
+
+    return foundAny;
+}
+
+static bool benchIsLogDirectory(const fatDirectoryEntry_t *entry)
+{
+    return (entry->attrib & FAT_FILE_ATTRIBUTE_DIRECTORY) && memcmp(entry->filename, "LOGS       ", FAT_FILENAME_LENGTH) == 0;
+}
+
+static bool benchIsLogFile(const fatDirectoryEntry_t *entry)
+{
+    // blackbox_io.c numbers the logs in sequence, so the last one in the directory is the newest
+    return !(entry->attrib & FAT_FILE_ATTRIBUTE_DIRECTORY) && memcmp(entry->filename, "LOG", 3) == 0
+        && memcmp(entry->filename + 8, "TXT", 3) == 0;
+}
+
+/**
+ * Find the newest log on the card and count the runs of consecutive clusters it is stored in.
+ */
+static bool benchInspectNewestLog(benchLogFile_t *log)
+{
+    benchVolume_t volume;
+    fatDirectoryEntry_t entry;
+
+    if (!benchReadVolume(&volume)
+            || !benchFindEntry(&volume, volume.rootCluster, benchIsLogDirectory, &entry)
+            || !benchFindEntry(&volume, benchEntryCluster(&entry), benchIsLogFile, &entry)) {
+        return false;
+    }
+
+    snprintf(log->name, sizeof(log->name), "%.8s.%.3s", entry.filename, entry.filename + 8);
+    log->size = entry.fileSize;
+    log->clusters = 0;
+    log->fragments = 0;
+
+    uint32_t previous = 0;
+
+    for (uint32_t cluster = benchEntryCluster(&entry); benchIsChainCluster(cluster); cluster = benchNextCluster(&volume, cluster)) {
+        if (cluster != previous + 1) {
+            log->fragments++;
+        }
+        log->clusters++;
+        previous = cluster;
+    }
+
+    return true;
+}
+
+static bool benchWaitFor(bool (*condition)(void), uint32_t looptime)
+{
+    const uint64_t giveUpAt = sdcardSimMicros + BENCH_TIMEOUT_US;
+
+    while (!condition()) {
+        if (sdcardSimMicros > giveUpAt) {
+            return false;
+        }
+        benchTick(looptime);
+    }
+
+    return true;
+}
+
+static bool benchFilesystemInitialized(void)
+{
+    return afatfs_getFilesystemState() != AFATFS_FILESYSTEM_STATE_INITIALIZATION;
+}
+
+static bool benchEndLog(void)
+{
+    return blackboxDeviceEndLog(true);
+}
+
+static afatfsFilePtr_t benchReadFile;
+static bool benchReadFileOpened;
+
+static void benchReadFileOpenComplete(afatfsFilePtr_t file)
+{
+    benchReadFile = file;
+    benchReadFileOpened = true;
+}
+
+static bool benchReadFileOpenDone(void)
+{
+    return benchReadFileOpened;
+}
+
+static bool benchCloseReadFile(void)
+{
+    return afatfs_fclose(benchReadFile, NULL);
+}
+
+static bool benchDestroyFilesystem(void)
+{
+    return afatfs_destroy(false);
+}
+
+/**
+ * Log at a steady rate for the given number of loop iterations, the way blackbox.c commits one iteration's frames at
+ * a time. Returns the number of bytes handed to the device, the longest run of iterations that lost data is returned
+ * in worstStallUs.
+ */
+static uint32_t benchLog(uint32_t iterations, uint32_t looptime, uint32_t bytesPerSecond, uint64_t *worstStallUs)
+{
+    const uint32_t startBytes = blackboxBytesWritten;
+    uint64_t credit = 0;
+    uint64_t stallStart = 0;
+    bool stalled = false;
+
+    *worstStallUs = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        benchTick(looptime);
+
+        credit += (uint64_t) bytesPerSecond * looptime;
+
+        const uint32_t frameSize = MIN(credit / 1000000, BENCH_MAX_FRAME_SIZE);
+        const uint32_t acceptedBefore = benchAcceptedBytes;
+
+        credit -= (uint64_t) frameSize * 1000000;
+
+        blackboxBeginFrames();
+        for (uint32_t j = 0; j < frameSize; j++) {
+            blackboxWrite((uint8_t) (blackboxBytesWritten - startBytes));
+        }
+        blackboxCommitFrames();
+
+        blackboxDeviceFlush();
+
+        if (benchAcceptedBytes - acceptedBefore < frameSize) {
+            if (!stalled) {
+                stalled = true;
+                stallStart = sdcardSimMicros - looptime;
+            }
+        } else if (stalled) {
+            stalled = false;
+            *worstStallUs = MAX(*worstStallUs, sdcardSimMicros - looptime - stallStart);
+        }
+    }
+
+    if (stalled) {
+        *worstStallUs = MAX(*worstStallUs, sdcardSimMicros - stallStart);
+    }
+
+    return blackboxBytesWritten - startBytes;
+}
+
+/**
+ * Read the log back in chunks of readBytes per loop iteration and check it holds exactly what the card accepted.
+ */
+static bool benchReadBack(const benchLogFile_t *log, uint32_t looptime, uint32_t readBytes, uint32_t expectedHash)
+{
+    uint8_t buffer[BENCH_MAX_FRAME_SIZE];
+    uint32_t length = 0;
+    uint32_t hash = BENCH_HASH_INITIAL;
+
+    benchReadFile = NULL;
+    benchReadFileOpened = false;
+
+    if (!afatfs_fopen(log->name, "r", benchReadFileOpenComplete) || !benchWaitFor(benchReadFileOpenDone, looptime) || !benchReadFile) {
+        fprintf(stderr, "%s: can't open the log to read it back\n", log->name);
+        return false;
+    }
+
+    const afatfsCacheStats_t cacheBefore = *afatfs_getCacheStats();
+    const uint64_t startUs = sdcardSimMicros;
+
+    while (!afatfs_feof(benchReadFile)) {
+        benchTick(looptime);
+
+        const uint32_t bytesRead = afatfs_fread(benchReadFile, buffer, readBytes);
+
+        hash = benchHash(hash, buffer, bytesRead);
+        length += bytesRead;
+    }
+
+    const double seconds = (sdcardSimMicros - startUs) / 1e6;
+    const bool intact = length == log->size && hash == expectedHash;
+
+    printf("%s: read back %u bytes at %.1fkB/s, %s, ", log->name, length, length / seconds / 1024, intact ? "intact" : "CORRUPT");
+    benchPrintCacheStats(&cacheBefore);
+
+    return benchWaitFor(benchCloseReadFile, looptime) && intact;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: asyncfatfs_bench [-f sizeMB] [-n logs] [-s seconds] [-r bytesPerSecond] [-l looptime] [-b readBytes] [-a] [-S] IMAGE\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t formatSizeMB = 0;
+    uint32_t logs = 1;
+    uint32_t seconds = 20;
+    uint32_t bytesPerSecond = 150 * 1024;
+    uint32_t looptime = 1000;
+    uint32_t readBytes = 512;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:s:r:l:b:aS")) != -1) {
+        switch (opt) {
+            case 'f':
+                formatSizeMB = atoi(optarg);
+            break;
+            case 'n':
+                logs = atoi(optarg);
+            break;
+            case 's':
+                seconds = atoi(optarg);
+            break;
+            case 'r':
+                bytesPerSecond = atoi(optarg);
+            break;
+            case 'l':
+                looptime = atoi(optarg);
+            break;
+            case 'b':
+                readBytes = atoi(optarg);
+            break;
+            case 'a':
+                benchLogFileMode = "a";
+            break;
+            case 'S':
+                sdcardSimConfig.readLatencyUs = 1500;
+                sdcardSimConfig.writeBusyUs = 1500;
+                sdcardSimConfig.slowWriteInterval = 50;
+                sdcardSimConfig.slowWriteBusyUs = 100000;
+            break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1 || looptime == 0 || readBytes == 0 || readBytes > BENCH_MAX_FRAME_SIZE) {
+        usage();
+    }
+
+    const char *image = argv[optind];
+
+    // Eight sectors per cluster, what SD Formatter picks for cards up to 32GB
+    if (formatSizeMB && !sdcardSimFormat(image, formatSizeMB, 8)) {
+        fprintf(stderr, "%s: can't format the card image\n", image);
+        return 1;
+    }
+
+    if (!sdcardSimOpen(image)) {
+        perror(image);
+        return 1;
+    }
+
+    blackboxConfig()->device = BLACKBOX_DEVICE_SDCARD;
+    targetLooptime = looptime;
+
+    afatfs_init();
+
+    if (!benchWaitFor(benchFilesystemInitialized, looptime) || afatfs_getFilesystemState() != AFATFS_FILESYSTEM_STATE_READY) {
+        fprintf(stderr, "%s: mount failed, error %d\n", image, afatfs_getLastError());
+        return 1;
+    }
+
+    printf("%s: mounted in %.1fms, %u kB free, logging %.1fkB/s at %u us in mode \"%s\" with %d cache sectors\n", image,
+        sdcardSimMicros / 1000.0, afatfs_getContiguousFreeSpace() / 1024, bytesPerSecond / 1024.0, looptime,
+        benchLogFileMode ? benchLogFileMode : "as", AFATFS_NUM_CACHE_SECTORS);
+
+    benchLogFile_t log;
+    uint32_t lastLogHash = 0;
+
+    for (uint32_t i = 0; i < logs; i++) {
+        if (!blackboxDeviceOpen()) {
+            fprintf(stderr, "card is full or not ready\n");
+            return 1;
+        }
+
+        const uint64_t openStartUs = sdcardSimMicros;
+
+        if (!benchWaitFor(blackboxDeviceBeginLog, looptime)) {
+            fprintf(stderr, "timed out creating the log\n");
+            return 1;
+        }
+
+        const double openMs = (sdcardSimMicros - openStartUs) / 1000.0;
+        const sdcardSimStats_t cardBefore = sdcardSimStats;
+        const afatfsCacheStats_t cacheBefore = *afatfs_getCacheStats();
+        const uint64_t logStartUs = sdcardSimMicros;
+        uint64_t worstStallUs;
+
+        benchAcceptedBytes = 0;
+        benchAcceptedHash = BENCH_HASH_INITIAL;
+
+        const uint32_t offered = benchLog(seconds * 1000000 / looptime, looptime, bytesPerSecond, &worstStallUs);
+        const double logSeconds = (sdcardSimMicros - logStartUs) / 1e6;
+
+        if (!benchWaitFor(benchEndLog, looptime) || !benchWaitFor(blackboxDeviceFlushForce, looptime)) {
+            fprintf(stderr, "timed out closing the log\n");
+            return 1;
+        }
+        blackboxDeviceClose();
+
+        if (!benchInspectNewestLog(&log)) {
+            fprintf(stderr, "can't find the log on the card\n");
+            return 1;
+        }
+
+        const uint32_t writes = sdcardSimStats.writes - cardBefore.writes;
+
+        printf("%s: opened in %.1fms, written %.1fkB/s, dropped %.2f%%, worst stall %.1fms, "
+            "%u card writes (%u multi-block, %u slow), %u clusters in %u fragments\n",
+            log.name, openMs, benchAcceptedBytes / logSeconds / 1024, 100.0 * (offered - benchAcceptedBytes) / MAX(offered, 1),
+            worstStallUs / 1000.0, writes, sdcardSimStats.multiBlockWrites - cardBefore.multiBlockWrites,
+            sdcardSimStats.slowWrites - cardBefore.slowWrites, log.clusters, log.fragments);
+        printf("%s: ", log.name);
+        benchPrintCacheStats(&cacheBefore);
+
+        lastLogHash = benchAcceptedHash;
+    }
+
+    const bool readBackOk = benchReadBack(&log, looptime, readBytes, lastLogHash);
+
+    if (!benchWaitFor(benchDestroyFilesystem, looptime)) {
+        fprintf(stderr, "timed out unmounting\n");
+        return 1;
+    }
+    sdcardSimClose();
+
+    return readBackOk ? 0 : 1;
+}
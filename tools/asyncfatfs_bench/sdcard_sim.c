@@ -0,0 +1,357 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File-backed emulation of an SD card behind the drivers/sdcard.h API.
+ *
+ * Like the SPI driver, the card handles one operation at a time. A read completes readLatencyUs after it was queued.
+ * A write hands its buffer back after writeTransferUs, then the card stays busy while it programs the block, and every
+ * slowWriteInterval writes it stalls for much longer, which is what makes a slow card drop blackbox data.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <platform.h>
+
+#include "common/utils.h"
+
+#include "drivers/sdcard.h"
+#include "io/asyncfatfs/fat_standard.h"
+
+#include "sdcard_sim.h"
+
+#define SDCARD_SIM_BLOCK_SIZE 512
+
+// Where the formatter starts the partition, aligned to the card's erase blocks like SD Formatter does
+#define SDCARD_SIM_PARTITION_START 8192
+#define SDCARD_SIM_RESERVED_SECTORS 32
+#define SDCARD_SIM_NUM_FATS 2
+
+uint64_t sdcardSimMicros;
+
+sdcardSimConfig_t sdcardSimConfig = {
+    .readLatencyUs = 800,
+    .writeTransferUs = 300,
+    .writeBusyUs = 700,
+    .multiBlockWriteBusyUs = 300,
+    .slowWriteInterval = 100,
+    .slowWriteBusyUs = 25000,
+};
+
+sdcardSimStats_t sdcardSimStats;
+
+static struct {
+    int fd;
+    sdcardMetadata_t metadata;
+
+    // The operation in progress, if any
+    bool active;
+    bool callbackDone;
+    sdcardBlockOperation_e operation;
+    uint32_t blockIndex;
+    uint8_t *buffer;
+    sdcard_operationCompleteCallback_c callback;
+    uint32_t callbackData;
+    uint64_t startedAt;
+    uint64_t callbackAt;
+    uint64_t readyAt;
+
+    // Blocks still to come of the multi-block write announced by sdcard_beginWriteBlocks()
+    uint32_t multiWriteNextBlock;
+    uint32_t multiWriteBlocksRemaining;
+
+    sdcard_profilerCallback_c profiler;
+} sdcardSim = {
+    .fd = -1
+};
+
+bool sdcardSimFormat(const char *path, uint32_t sizeMB, uint8_t sectorsPerCluster)
+{
+    const uint32_t totalSectors = sizeMB * (1024 * 1024 / SDCARD_SIM_BLOCK_SIZE);
+
+    if (totalSectors <= SDCARD_SIM_PARTITION_START || sectorsPerCluster == 0) {
+        return false;
+    }
+
+    const uint32_t partitionSectors = totalSectors - SDCARD_SIM_PARTITION_START;
+
+    // The FAT has to cover the clusters that are left over once the FATs themselves are taken out
+    uint32_t fatSectors = 1;
+    uint32_t numClusters;
+
+    for (;;) {
+        numClusters = (partitionSectors - SDCARD_SIM_RESERVED_SECTORS - SDCARD_SIM_NUM_FATS * fatSectors) / sectorsPerCluster;
+
+        const uint32_t required = ((numClusters + FAT_SMALLEST_LEGAL_CLUSTER_NUMBER) * sizeof(uint32_t) + SDCARD_SIM_BLOCK_SIZE - 1) / SDCARD_SIM_BLOCK_SIZE;
+
+        if (required <= fatSectors) {
+            break;
+        }
+        fatSectors = required;
+    }
+
+    if (numClusters <= FAT16_MAX_CLUSTERS) {
+        fprintf(stderr, "%s: %u clusters is too few for FAT32\n", path, numClusters);
+        return false;
+    }
+
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    uint8_t sector[SDCARD_SIM_BLOCK_SIZE];
+    bool ok = ftruncate(fd, (off_t) totalSectors * SDCARD_SIM_BLOCK_SIZE) == 0;
+
+    // Master boot record with one partition
+    memset(sector, 0, sizeof(sector));
+
+    mbrPartitionEntry_t *partition = (mbrPartitionEntry_t *) &sector[446];
+
+    partition->type = MBR_PARTITION_TYPE_FAT32_LBA;
+    partition->lbaBegin = SDCARD_SIM_PARTITION_START;
+    partition->numSectors = partitionSectors;
+
+    sector[510] = FAT_VOLUME_ID_SIGNATURE_1;
+    sector[511] = FAT_VOLUME_ID_SIGNATURE_2;
+
+    ok = ok && pwrite(fd, sector, sizeof(sector), 0) == sizeof(sector);
+
+    // Volume ID
+    memset(sector, 0, sizeof(sector));
+
+    fatVolumeID_t *volumeID = (fatVolumeID_t *) sector;
+
+    memcpy(volumeID->jmpBoot, "\xEB\x58\x90", sizeof(volumeID->jmpBoot));
+    memcpy(volumeID->oemName, "MSWIN4.1", sizeof(volumeID->oemName));
+    volumeID->bytesPerSector = SDCARD_SIM_BLOCK_SIZE;
+    volumeID->sectorsPerCluster = sectorsPerCluster;
+    volumeID->reservedSectorCount = SDCARD_SIM_RESERVED_SECTORS;
+    volumeID->numFATs = SDCARD_SIM_NUM_FATS;
+    volumeID->media = 0xF8;
+    volumeID->sectorsPerTrack = 63;
+    volumeID->numHeads = 255;
+    volumeID->hiddenSectors = SDCARD_SIM_PARTITION_START;
+    volumeID->totalSectors32 = partitionSectors;
+    volumeID->fatDescriptor.fat32.FATSize32 = fatSectors;
+    volumeID->fatDescriptor.fat32.rootCluster = FAT_SMALLEST_LEGAL_CLUSTER_NUMBER;
+    volumeID->fatDescriptor.fat32.fsInfo = 1;
+    volumeID->fatDescriptor.fat32.backupBootSector = 6;
+    volumeID->fatDescriptor.fat32.driveNumber = 0x80;
+    volumeID->fatDescriptor.fat32.bootSignature = 0x29;
+    volumeID->fatDescriptor.fat32.volumeID = 0x1234;
+    memcpy(volumeID->fatDescriptor.fat32.volumeLabel, "NO NAME    ", sizeof(volumeID->fatDescriptor.fat32.volumeLabel));
+    memcpy(volumeID->fatDescriptor.fat32.fileSystemType, "FAT32   ", sizeof(volumeID->fatDescriptor.fat32.fileSystemType));
+
+    sector[510] = FAT_VOLUME_ID_SIGNATURE_1;
+    sector[511] = FAT_VOLUME_ID_SIGNATURE_2;
+
+    ok = ok && pwrite(fd, sector, sizeof(sector), (off_t) SDCARD_SIM_PARTITION_START * SDCARD_SIM_BLOCK_SIZE) == sizeof(sector);
+
+    // Both FATs start with the media descriptor, a reserved entry and the end of the empty root directory's chain
+    const uint32_t fatStart[3] = {0x0FFFFFF8, 0x0FFFFFFF, 0x0FFFFFFF};
+
+    for (int i = 0; i < SDCARD_SIM_NUM_FATS; i++) {
+        const off_t fatOffset = (off_t) (SDCARD_SIM_PARTITION_START + SDCARD_SIM_RESERVED_SECTORS + i * fatSectors) * SDCARD_SIM_BLOCK_SIZE;
+
+        ok = ok && pwrite(fd, fatStart, sizeof(fatStart), fatOffset) == sizeof(fatStart);
+    }
+
+    return close(fd) == 0 && ok;
+}
+
+bool sdcardSimOpen(const char *path)
+{
+    sdcardSimClose();
+
+    sdcardSim.fd = open(path, O_RDWR);
+
+    if (sdcardSim.fd < 0) {
+        return false;
+    }
+
+    memset(&sdcardSim.metadata, 0, sizeof(sdcardSim.metadata));
+    memcpy(sdcardSim.metadata.productName, "HOST", sizeof(sdcardSim.metadata.productName));
+    sdcardSim.metadata.numBlocks = lseek(sdcardSim.fd, 0, SEEK_END) / SDCARD_SIM_BLOCK_SIZE;
+
+    sdcardSim.active = false;
+    sdcardSim.multiWriteBlocksRemaining = 0;
+
+    memset(&sdcardSimStats, 0, sizeof(sdcardSimStats));
+
+    return true;
+}
+
+void sdcardSimClose(void)
+{
+    if (sdcardSim.fd >= 0) {
+        close(sdcardSim.fd);
+        sdcardSim.fd = -1;
+    }
+}
+
+bool sdcardSimPeekBlock(uint32_t blockIndex, uint8_t *buffer)
+{
+    return pread(sdcardSim.fd, buffer, SDCARD_SIM_BLOCK_SIZE, (off_t) blockIndex * SDCARD_SIM_BLOCK_SIZE) == SDCARD_SIM_BLOCK_SIZE;
+}
+
+static void sdcardSimStartOperation(sdcardBlockOperation_e operation, uint32_t blockIndex, uint8_t *buffer,
+    sdcard_operationCompleteCallback_c callback, uint32_t callbackData, uint32_t transferUs, uint32_t busyUs)
+{
+    sdcardSim.active = true;
+    sdcardSim.callbackDone = false;
+    sdcardSim.operation = operation;
+    sdcardSim.blockIndex = blockIndex;
+    sdcardSim.buffer = buffer;
+    sdcardSim.callback = callback;
+    sdcardSim.callbackData = callbackData;
+    sdcardSim.startedAt = sdcardSimMicros;
+    sdcardSim.callbackAt = sdcardSimMicros + transferUs;
+    sdcardSim.readyAt = sdcardSim.callbackAt + busyUs;
+}
+
+/**
+ * Complete the operation in progress once its time is up. Returns true if the card is ready for a new operation.
+ */
+bool sdcard_poll()
+{
+    if (!sdcardSim.active) {
+        return true;
+    }
+
+    if (!sdcardSim.callbackDone && sdcardSimMicros >= sdcardSim.callbackAt) {
+        sdcardSim.callbackDone = true;
+
+        if (sdcardSim.operation == SDCARD_BLOCK_OPERATION_READ && !sdcardSimPeekBlock(sdcardSim.blockIndex, sdcardSim.buffer)) {
+            perror("sdcard read");
+        }
+
+        if (sdcardSim.profiler) {
+            sdcardSim.profiler(sdcardSim.operation, sdcardSim.blockIndex, sdcardSimMicros - sdcardSim.startedAt);
+        }
+
+        if (sdcardSim.callback) {
+            sdcardSim.callback(sdcardSim.operation, sdcardSim.blockIndex, sdcardSim.buffer, sdcardSim.callbackData);
+        }
+    }
+
+    if (sdcardSim.callbackDone && sdcardSimMicros >= sdcardSim.readyAt) {
+        sdcardSim.active = false;
+        sdcardSimStats.busyUs += sdcardSim.readyAt - sdcardSim.startedAt;
+    }
+
+    return !sdcardSim.active;
+}
+
+bool sdcard_readBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    if (!sdcard_poll() || blockIndex >= sdcardSim.metadata.numBlocks) {
+        return false;
+    }
+
+    // A read ends any multi-block write in progress
+    sdcardSim.multiWriteBlocksRemaining = 0;
+
+    sdcardSimStartOperation(SDCARD_BLOCK_OPERATION_READ, blockIndex, buffer, callback, callbackData, sdcardSimConfig.readLatencyUs, 0);
+    sdcardSimStats.reads++;
+
+    return true;
+}
+
+sdcardOperationStatus_e sdcard_beginWriteBlocks(uint32_t blockIndex, uint32_t blockCount)
+{
+    if (!sdcard_poll()) {
+        return SDCARD_OPERATION_BUSY;
+    }
+
+    sdcardSim.multiWriteNextBlock = blockIndex;
+    sdcardSim.multiWriteBlocksRemaining = blockCount;
+
+    return SDCARD_OPERATION_SUCCESS;
+}
+
+sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    if (!sdcard_poll()) {
+        return SDCARD_OPERATION_BUSY;
+    }
+
+    if (blockIndex >= sdcardSim.metadata.numBlocks
+            || pwrite(sdcardSim.fd, buffer, SDCARD_SIM_BLOCK_SIZE, (off_t) blockIndex * SDCARD_SIM_BLOCK_SIZE) != SDCARD_SIM_BLOCK_SIZE) {
+        return SDCARD_OPERATION_FAILURE;
+    }
+
+    uint32_t busyUs = sdcardSimConfig.writeBusyUs;
+
+    // The card has pre-erased the blocks of a multi-block write, so they program faster
+    if (sdcardSim.multiWriteBlocksRemaining > 0 && blockIndex == sdcardSim.multiWriteNextBlock) {
+        busyUs = sdcardSimConfig.multiBlockWriteBusyUs;
+        sdcardSim.multiWriteNextBlock++;
+        sdcardSim.multiWriteBlocksRemaining--;
+        sdcardSimStats.multiBlockWrites++;
+    } else {
+        sdcardSim.multiWriteBlocksRemaining = 0;
+    }
+
+    sdcardSimStats.writes++;
+
+    if (sdcardSimConfig.slowWriteInterval && sdcardSimStats.writes % sdcardSimConfig.slowWriteInterval == 0) {
+        busyUs = sdcardSimConfig.slowWriteBusyUs;
+        sdcardSimStats.slowWrites++;
+    }
+
+    sdcardSimStartOperation(SDCARD_BLOCK_OPERATION_WRITE, blockIndex, buffer, callback, callbackData, sdcardSimConfig.writeTransferUs, busyUs);
+
+    return SDCARD_OPERATION_IN_PROGRESS;
+}
+
+void sdcard_init(bool useDMA)
+{
+    UNUSED(useDMA);
+}
+
+bool sdcard_isInserted()
+{
+    return sdcardSim.fd >= 0;
+}
+
+bool sdcard_isInitialized()
+{
+    return sdcardSim.fd >= 0;
+}
+
+bool sdcard_isFunctional()
+{
+    return sdcardSim.fd >= 0;
+}
+
+const sdcardMetadata_t* sdcard_getMetadata()
+{
+    return &sdcardSim.metadata;
+}
+
+void sdcard_setProfilerCallback(sdcard_profilerCallback_c callback)
+{
+    sdcardSim.profiler = callback;
+}
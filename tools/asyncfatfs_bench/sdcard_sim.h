@@ -0,0 +1,59 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Host implementation of the drivers/sdcard.h API, backed by a disk image file. Time is virtual: the caller advances
+ * sdcardSimMicros and the card completes operations once enough of it has passed, so a benchmark runs as fast as the
+ * host allows and every run is repeatable.
+ */
+
+typedef struct sdcardSimConfig_s {
+    uint32_t readLatencyUs;             // from sdcard_readBlock() until the data is in the buffer
+    uint32_t writeTransferUs;           // from sdcard_writeBlock() until the buffer has been sent and can be reused
+    uint32_t writeBusyUs;               // card busy programming the block after the transfer
+    uint32_t multiBlockWriteBusyUs;     // replaces writeBusyUs for blocks announced by sdcard_beginWriteBlocks()
+    uint32_t slowWriteInterval;         // every this many writes the card goes busy for slowWriteBusyUs, 0 for never
+    uint32_t slowWriteBusyUs;           // e.g. a flash erase or wear levelling on a slow card
+} sdcardSimConfig_t;
+
+typedef struct sdcardSimStats_s {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t multiBlockWrites;          // blocks written as part of a multi-block write
+    uint32_t slowWrites;
+    uint64_t busyUs;                    // total time the card was unable to accept a new operation
+} sdcardSimStats_t;
+
+extern uint64_t sdcardSimMicros;
+extern sdcardSimConfig_t sdcardSimConfig;
+extern sdcardSimStats_t sdcardSimStats;
+
+// Create a blank card image of the given size, with an MBR and a single empty FAT32 partition
+bool sdcardSimFormat(const char *path, uint32_t sizeMB, uint8_t sectorsPerCluster);
+
+// Insert the card held in an image file, returns false if it can't be opened
+bool sdcardSimOpen(const char *path);
+void sdcardSimClose(void);
+
+// Read a block straight from the image, bypassing the card timing
+bool sdcardSimPeekBlock(uint32_t blockIndex, uint8_t *buffer);
@@ -0,0 +1,173 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Accuracy and speed of the table based pressureToAltitude() in common/maths.c.
+ *
+ * Accuracy: pressure ratios across the whole table, at a few reference pressures, against the formula evaluated
+ * with double pow(). The comment on the table promises less than 2 cm everywhere and less than 0.3 cm for ratios
+ * above 0.5, powf() is measured alongside for comparison. Ratios outside the table must give the powf() result.
+ *
+ * Speed: ns per call for pressureToAltitude(), the same formula with powf() and with double pow(), on this host.
+ * The target has no double precision FPU, so the gap there is larger than here.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+
+#define ACCURACY_SAMPLES 2000000
+#define SPEED_SAMPLES 4096
+#define SPEED_ROUNDS 500
+#define RATIO_MIN 0.25
+#define RATIO_MAX 1.25
+#define TABLE_ERROR_MAX 2.0         // cm, whole table
+#define TABLE_ERROR_MAX_ABOVE_HALF 0.3
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static double altitudeReference(double pressure, double referencePressure)
+{
+    return (1.0 - pow(pressure / referencePressure, 0.190295)) * 4433000.0;
+}
+
+static float altitudePowf(float pressure, float referencePressure)
+{
+    return (1.0f - powf(pressure / referencePressure, 0.190295f)) * 4433000.0f;
+}
+
+static double altitudeDoublePow(double pressure, double referencePressure)
+{
+    return (1.0 - pow(pressure / referencePressure, 1.0 / 5.255)) * 4433000.0;
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void testAccuracy(void)
+{
+    static const float references[] = { 101325.0f, 95000.0f, 84000.0f, 70000.0f };
+
+    printf("  reference  table max  above 0.5  powf max  above 0.5   (cm)\n");
+    for (unsigned r = 0; r < sizeof(references) / sizeof(references[0]); r++) {
+        const float reference = references[r];
+        double tableMax = 0, tableMaxAboveHalf = 0, powfMax = 0, powfMaxAboveHalf = 0;
+        for (int i = 0; i < ACCURACY_SAMPLES; i++) {
+            const float pressure = reference * (RATIO_MIN + (RATIO_MAX - RATIO_MIN) * (i + 0.5) / ACCURACY_SAMPLES);
+            // the reference sees the float inputs the firmware gets
+            const double expected = altitudeReference(pressure, reference);
+            const double tableError = fabs(pressureToAltitude(pressure, reference) - expected);
+            const double powfError = fabs(altitudePowf(pressure, reference) - expected);
+            tableMax = fmax(tableMax, tableError);
+            powfMax = fmax(powfMax, powfError);
+            if (pressure / reference > 0.5f) {
+                tableMaxAboveHalf = fmax(tableMaxAboveHalf, tableError);
+                powfMaxAboveHalf = fmax(powfMaxAboveHalf, powfError);
+            }
+        }
+        printf("  %9.0f  %9.3f  %9.3f  %8.3f  %9.3f\n", reference, tableMax, tableMaxAboveHalf, powfMax, powfMaxAboveHalf);
+        check(tableMax < TABLE_ERROR_MAX, "table error above 2 cm");
+        check(tableMaxAboveHalf < TABLE_ERROR_MAX_ABOVE_HALF, "table error above 0.3 cm for ratios above 0.5");
+    }
+
+    // Outside the table it is the powf() formula
+    int outside = 0, mismatches = 0;
+    for (float ratio = 0.05f; ratio < 2.0f; ratio += 0.001f) {
+        if (ratio >= RATIO_MIN && ratio < RATIO_MAX) {
+            continue;
+        }
+        outside++;
+        mismatches += pressureToAltitude(ratio * 101325.0f, 101325.0f) != altitudePowf(ratio * 101325.0f, 101325.0f);
+    }
+    printf("outside the table: %d ratios, %d differ from powf()\n", outside, mismatches);
+    check(mismatches == 0, "ratios outside the table do not fall back to powf()");
+}
+
+static void testSpeed(void)
+{
+    static float pressures[SPEED_SAMPLES];
+    const float reference = 101325.0f;
+    for (int i = 0; i < SPEED_SAMPLES; i++) {
+        // the flight range, within a few hundred metres of the reference
+        pressures[i] = reference * (0.95f + 0.07f * rand() / RAND_MAX);
+    }
+
+    volatile float sink = 0;
+    double start = nowNs();
+    for (int round = 0; round < SPEED_ROUNDS; round++) {
+        for (int i = 0; i < SPEED_SAMPLES; i++) {
+            sink += pressureToAltitude(pressures[i], reference);
+        }
+    }
+    const double table = (nowNs() - start) / ((double)SPEED_ROUNDS * SPEED_SAMPLES);
+
+    start = nowNs();
+    for (int round = 0; round < SPEED_ROUNDS; round++) {
+        for (int i = 0; i < SPEED_SAMPLES; i++) {
+            sink += altitudePowf(pressures[i], reference);
+        }
+    }
+    const double singlePow = (nowNs() - start) / ((double)SPEED_ROUNDS * SPEED_SAMPLES);
+
+    start = nowNs();
+    for (int round = 0; round < SPEED_ROUNDS; round++) {
+        for (int i = 0; i < SPEED_SAMPLES; i++) {
+            sink += altitudeDoublePow(pressures[i], reference);
+        }
+    }
+    const double doublePow = (nowNs() - start) / ((double)SPEED_ROUNDS * SPEED_SAMPLES);
+    (void)sink;
+
+    printf("\nspeed on this host: pressureToAltitude() %.1f ns, powf() %.1f ns, double pow() %.1f ns per call\n",
+        table, singlePow, doublePow);
+}
+
+int main(void)
+{
+    srand(1);
+
+    testAccuracy();
+    testSpeed();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
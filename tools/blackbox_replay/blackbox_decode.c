@@ -0,0 +1,732 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/maths.h"
+
+#include "blackbox/blackbox_fielddefs.h"
+
+#include "blackbox_decode.h"
+
+// Keep in step with blackbox.c
+#define ADAPTIVE_CANDIDATE_COUNT 3
+#define ADAPTIVE_COST_DECAY_SHIFT 4
+#define ADAPTIVE_MAX_ERROR 4095
+
+#define TAG8_8SVB_MAX_FIELDS 8
+
+static const FlightLogFieldPredictor adaptiveCandidates[ADAPTIVE_CANDIDATE_COUNT] = {
+    FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2,
+    FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE,
+    FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS
+};
+
+static int readByte(blackboxLog_t *log)
+{
+    if (log->pos >= log->end) {
+        log->overrun = true;
+        return 0;
+    }
+    return *log->pos++;
+}
+
+static uint32_t readUnsignedVB(blackboxLog_t *log)
+{
+    uint32_t value = 0;
+
+    for (int shift = 0; shift < 32; shift += 7) {
+        const int c = readByte(log);
+
+        value |= (uint32_t)(c & 0x7F) << shift;
+        if (c < 128) {
+            return value;
+        }
+    }
+
+    // A variable byte number can't be longer than 5 bytes
+    log->overrun = true;
+    return 0;
+}
+
+static int32_t readSignedVB(blackboxLog_t *log)
+{
+    const uint32_t value = readUnsignedVB(log);
+
+    // zigzagEncode() in reverse
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static int32_t signExtend(uint32_t value, int bits)
+{
+    const uint32_t signBit = 1u << (bits - 1);
+
+    value &= (signBit << 1) - 1;
+    return (int32_t)(value ^ signBit) - (int32_t)signBit;
+}
+
+// Reverses blackboxWriteTag2_3S32()
+static void readTag2_3S32(blackboxLog_t *log, int32_t *values)
+{
+    const int lead = readByte(log);
+    int c;
+
+    switch (lead >> 6) {
+        case 0:
+            values[0] = signExtend(lead >> 4, 2);
+            values[1] = signExtend(lead >> 2, 2);
+            values[2] = signExtend(lead, 2);
+        break;
+        case 1:
+            values[0] = signExtend(lead, 4);
+            c = readByte(log);
+            values[1] = signExtend(c >> 4, 4);
+            values[2] = signExtend(c, 4);
+        break;
+        case 2:
+            values[0] = signExtend(lead, 6);
+            values[1] = signExtend(readByte(log), 6);
+            values[2] = signExtend(readByte(log), 6);
+        break;
+        case 3:
+            for (int i = 0, selector = lead; i < 3; i++, selector >>= 2) {
+                uint32_t value = readByte(log);
+                const int bytes = (selector & 0x03) + 1;
+
+                for (int b = 1; b < bytes; b++) {
+                    value |= (uint32_t)readByte(log) << (8 * b);
+                }
+                values[i] = bytes == 4 ? (int32_t)value : signExtend(value, 8 * bytes);
+            }
+        break;
+    }
+}
+
+// Reverses blackboxWriteTag8_4S16(), which packs nibbles high half first
+static void readTag8_4S16(blackboxLog_t *log, int32_t *values)
+{
+    int selector = readByte(log);
+    int buffer = 0;
+    bool haveNibble = false;
+
+    for (int i = 0; i < 4; i++, selector >>= 2) {
+        switch (selector & 0x03) {
+            case 0:
+                values[i] = 0;
+            break;
+            case 1:
+                if (haveNibble) {
+                    values[i] = signExtend(buffer, 4);
+                    haveNibble = false;
+                } else {
+                    buffer = readByte(log);
+                    values[i] = signExtend(buffer >> 4, 4);
+                    haveNibble = true;
+                }
+            break;
+            case 2:
+                if (haveNibble) {
+                    const int c = readByte(log);
+                    values[i] = signExtend(((buffer & 0x0F) << 4) | (c >> 4), 8);
+                    buffer = c;
+                } else {
+                    values[i] = signExtend(readByte(log), 8);
+                }
+            break;
+            case 3:
+                if (haveNibble) {
+                    const int c1 = readByte(log);
+                    const int c2 = readByte(log);
+                    values[i] = signExtend(((buffer & 0x0F) << 12) | (c1 << 4) | (c2 >> 4), 16);
+                    buffer = c2;
+                } else {
+                    const int c1 = readByte(log);
+                    const int c2 = readByte(log);
+                    values[i] = signExtend((c1 << 8) | c2, 16);
+                }
+            break;
+        }
+    }
+}
+
+// Reverses blackboxWriteTag8_8SVB()
+static void readTag8_8SVB(blackboxLog_t *log, int32_t *values, int valueCount)
+{
+    if (valueCount == 1) {
+        values[0] = readSignedVB(log);
+        return;
+    }
+
+    const int header = readByte(log);
+
+    for (int i = 0; i < valueCount; i++) {
+        values[i] = header & (1 << i) ? readSignedVB(log) : 0;
+    }
+}
+
+static int32_t predict(FlightLogFieldPredictor predictor, int32_t prev1, int32_t prev2)
+{
+    switch (predictor) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            return prev1;
+        case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            return (int32_t)(2 * (uint32_t)prev1 - (uint32_t)prev2);
+        case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+        default:
+            return (prev1 + prev2) / 2;
+    }
+}
+
+// The decoding side of blackboxAdaptivePredict(): choose from the costs so far, then charge the decoded value
+static int32_t adaptivePredictionSelect(const uint16_t *cost, int32_t prev1, int32_t prev2)
+{
+    int best = 0;
+
+    for (int i = 1; i < ADAPTIVE_CANDIDATE_COUNT; i++) {
+        if (cost[i] < cost[best]) {
+            best = i;
+        }
+    }
+    return predict(adaptiveCandidates[best], prev1, prev2);
+}
+
+static void adaptivePredictionCharge(uint16_t *cost, int32_t value, int32_t prev1, int32_t prev2)
+{
+    for (int i = 0; i < ADAPTIVE_CANDIDATE_COUNT; i++) {
+        int32_t error = value - predict(adaptiveCandidates[i], prev1, prev2);
+
+        if (error < 0) {
+            error = -error;
+        }
+        if (error > ADAPTIVE_MAX_ERROR) {
+            error = ADAPTIVE_MAX_ERROR;
+        }
+        cost[i] = cost[i] - (cost[i] >> ADAPTIVE_COST_DECAY_SHIFT) + error;
+    }
+}
+
+/*
+ * Decode one frame's fields into current. prev1 and prev2 are the two previous frames of the same stream, or NULL for
+ * a keyframe. iterationStep is what an INC field advances by.
+ */
+static void decodeFields(blackboxLog_t *log, const blackboxFrameDef_t *def, int32_t *current,
+    const int32_t *prev1, const int32_t *prev2, uint16_t (*adaptiveCost)[3], uint32_t iterationStep)
+{
+    int32_t raw[BLACKBOX_DECODE_MAX_FIELDS];
+    int homeCoordIndex = 0;
+
+    for (int i = 0; i < def->fieldCount; i++) {
+        switch (def->encoding[i]) {
+            case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+                raw[i] = readSignedVB(log);
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+                raw[i] = readUnsignedVB(log);
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+                raw[i] = -signExtend(readUnsignedVB(log), 14);
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+                if (i + 3 > def->fieldCount) {
+                    log->overrun = true;
+                    return;
+                }
+                readTag2_3S32(log, &raw[i]);
+                i += 2;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+                if (i + 4 > def->fieldCount) {
+                    log->overrun = true;
+                    return;
+                }
+                readTag8_4S16(log, &raw[i]);
+                i += 3;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB: {
+                // Consecutive fields with this encoding are written together, up to 8 at a time
+                int count = 1;
+
+                while (count < TAG8_8SVB_MAX_FIELDS && i + count < def->fieldCount
+                        && def->encoding[i + count] == FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB) {
+                    count++;
+                }
+                readTag8_8SVB(log, &raw[i], count);
+                i += count - 1;
+            }
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_NULL:
+                raw[i] = 0;
+            break;
+            default:
+                log->overrun = true;
+                return;
+        }
+    }
+
+    // Predictors go in field order, as MOTOR_0 depends on a field decoded earlier in the same frame
+    for (int i = 0; i < def->fieldCount; i++) {
+        const int32_t p1 = prev1 ? prev1[i] : 0;
+        const int32_t p2 = prev2 ? prev2[i] : 0;
+        int32_t value = raw[i];
+
+        switch (def->predictor[i]) {
+            case FLIGHT_LOG_FIELD_PREDICTOR_0:
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+                value = (int32_t)((uint32_t)value + (uint32_t)predict(def->predictor[i], p1, p2));
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+                value += log->minthrottle;
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0:
+                if (log->motor0Index >= 0 && log->motor0Index < i) {
+                    value += current[log->motor0Index];
+                }
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_INC:
+                value = (int32_t)((uint32_t)p1 + iterationStep);
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+                value += log->gpsHome[homeCoordIndex++ & 1];
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+                value += 1500;
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+                value += log->vbatref;
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+                value = (int32_t)((uint32_t)value + log->lastMainTime);
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_ADAPTIVE:
+                if (adaptiveCost) {
+                    value = (int32_t)((uint32_t)value + (uint32_t)adaptivePredictionSelect(adaptiveCost[i], p1, p2));
+                    adaptivePredictionCharge(adaptiveCost[i], value, p1, p2);
+                }
+            break;
+            default:
+                log->overrun = true;
+            break;
+        }
+        current[i] = value;
+    }
+}
+
+static bool isFrameMarker(int c)
+{
+    return strchr("IPSGHERr", c) != NULL && c != '\0';
+}
+
+// The encoder's blackboxShouldLogPFrame()
+static bool shouldHaveLoggedPFrame(const blackboxLog_t *log, uint32_t pFrameIndex)
+{
+    return (pFrameIndex + log->frameIntervalPNum - 1) % log->frameIntervalPDenom < (uint32_t)log->frameIntervalPNum;
+}
+
+// How far loopIteration moves between the last main frame and the P frame which follows it
+static uint32_t mainIterationStep(const blackboxLog_t *log)
+{
+    uint32_t iteration = (uint32_t)log->mainHistory[1][0] + 1;
+    uint32_t step = 1;
+
+    while (iteration % log->frameIntervalI != 0 && !shouldHaveLoggedPFrame(log, iteration % log->frameIntervalI)) {
+        iteration++;
+        step++;
+    }
+    return step;
+}
+
+static void parseFieldHeader(blackboxLog_t *log, char frameType, const char *property, const char *values)
+{
+    blackboxFrameDef_t *def;
+    bool delta = false;
+
+    switch (frameType) {
+        case 'I': def = &log->frameDefI; break;
+        case 'P': def = &log->frameDefP; delta = true; break;
+        case 'S': def = &log->frameDefS; break;
+        case 'G': def = &log->frameDefG; break;
+        case 'H': def = &log->frameDefH; break;
+        case 'R': def = &log->frameDefR; break;
+        case 'r': def = &log->frameDefRDelta; delta = true; break;
+        default:
+            return;
+    }
+
+    int count = 0;
+    char value[BLACKBOX_DECODE_MAX_FIELD_NAME];
+
+    for (const char *p = values; *p && count < BLACKBOX_DECODE_MAX_FIELDS; ) {
+        const char *comma = strchr(p, ',');
+        const size_t length = comma ? (size_t)(comma - p) : strlen(p);
+
+        snprintf(value, sizeof(value), "%.*s", (int)length, p);
+
+        if (strcmp(property, "name") == 0) {
+            strcpy(def->name[count], value);
+        } else if (strcmp(property, "signed") == 0) {
+            def->isSigned[count] = atoi(value);
+        } else if (strcmp(property, "predictor") == 0) {
+            def->predictor[count] = atoi(value);
+        } else if (strcmp(property, "encoding") == 0) {
+            def->encoding[count] = atoi(value);
+        }
+
+        count++;
+        p += length + (comma ? 1 : 0);
+    }
+
+    if (!delta || strcmp(property, "name") == 0) {
+        def->fieldCount = count;
+    }
+}
+
+static void parseHeaderLine(blackboxLog_t *log, const char *line)
+{
+    char frameType;
+    char property[16];
+    int headerLength;
+
+    if (sscanf(line, "Field %c %15[^:]:%n", &frameType, property, &headerLength) == 2) {
+        parseFieldHeader(log, frameType, property, line + headerLength);
+        return;
+    }
+
+    if (log->headerCount < BLACKBOX_DECODE_MAX_HEADERS) {
+        // Longer lines are cut short, none of the ones the replay reads come close
+        const size_t length = MIN(strlen(line), BLACKBOX_DECODE_MAX_HEADER_LENGTH - 1);
+        memcpy(log->header[log->headerCount], line, length);
+        log->header[log->headerCount++][length] = '\0';
+    }
+}
+
+/*
+ * Delta frame definitions only carry predictor and encoding, the field names and signedness come from their keyframe
+ * definition.
+ */
+static void completeDeltaDef(blackboxFrameDef_t *delta, const blackboxFrameDef_t *key)
+{
+    delta->fieldCount = key->fieldCount;
+    memcpy(delta->name, key->name, sizeof(delta->name));
+    memcpy(delta->isSigned, key->isSigned, sizeof(delta->isSigned));
+}
+
+const char *blackboxDecodeHeader(const blackboxLog_t *log, const char *name)
+{
+    const size_t length = strlen(name);
+
+    for (int i = 0; i < log->headerCount; i++) {
+        if (strncmp(log->header[i], name, length) == 0 && log->header[i][length] == ':') {
+            return log->header[i] + length + 1;
+        }
+    }
+    return NULL;
+}
+
+int blackboxDecodeFieldIndex(const blackboxFrameDef_t *def, const char *name)
+{
+    for (int i = 0; i < def->fieldCount; i++) {
+        if (strcmp(def->name[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int headerInt(const blackboxLog_t *log, const char *name, int defaultValue)
+{
+    const char *value = blackboxDecodeHeader(log, name);
+
+    return value ? atoi(value) : defaultValue;
+}
+
+/**
+ * Parse the header of the log starting at data. Returns false if there is no usable main frame definition.
+ */
+bool blackboxDecodeOpen(blackboxLog_t *log, const uint8_t *data, size_t length)
+{
+    memset(log, 0, sizeof(*log));
+
+    log->start = log->pos = data;
+    log->end = data + length;
+
+    char line[512];
+
+    while (log->pos + 2 < log->end && log->pos[0] == 'H' && log->pos[1] == ' ') {
+        const uint8_t *eol = memchr(log->pos, '\n', log->end - log->pos);
+
+        if (!eol) {
+            break;
+        }
+
+        const size_t lineLength = eol - log->pos - 2;
+
+        snprintf(line, sizeof(line), "%.*s", (int)lineLength, (const char *)log->pos + 2);
+        parseHeaderLine(log, line);
+
+        log->pos = eol + 1;
+    }
+
+    completeDeltaDef(&log->frameDefP, &log->frameDefI);
+    completeDeltaDef(&log->frameDefRDelta, &log->frameDefR);
+
+    log->dataVersion = headerInt(log, "Data version", 1);
+    log->frameIntervalI = headerInt(log, "I interval", 32);
+    log->minthrottle = headerInt(log, "minthrottle", 1150);
+    log->vbatref = headerInt(log, "vbatref", 4095);
+    log->motor0Index = blackboxDecodeFieldIndex(&log->frameDefI, "motor[0]");
+
+    log->frameIntervalPNum = 1;
+    log->frameIntervalPDenom = 1;
+    const char *pInterval = blackboxDecodeHeader(log, "P interval");
+    if (pInterval) {
+        sscanf(pInterval, "%d/%d", &log->frameIntervalPNum, &log->frameIntervalPDenom);
+    }
+
+    if (log->frameIntervalI < 1) {
+        log->frameIntervalI = 1;
+    }
+    if (log->frameIntervalPNum < 1 || log->frameIntervalPDenom < log->frameIntervalPNum) {
+        log->frameIntervalPNum = log->frameIntervalPDenom = 1;
+    }
+
+    return log->frameDefI.fieldCount > 0 && log->frameDefI.fieldCount == log->frameDefP.fieldCount
+        && log->dataVersion == 2;
+}
+
+static bool decodeEvent(blackboxLog_t *log, uint8_t event)
+{
+    log->eventValues[0] = log->eventValues[1] = 0;
+
+    switch (event) {
+        case FLIGHT_LOG_EVENT_SYNC_BEEP:
+            log->eventValues[0] = readUnsignedVB(log);
+        break;
+        case FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT: {
+            const int function = readByte(log);
+
+            log->eventValues[0] = function;
+            if (function & FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT_FUNCTION_FLOAT_VALUE_FLAG) {
+                uint32_t value = 0;
+                for (int i = 0; i < 4; i++) {
+                    value |= (uint32_t)readByte(log) << (8 * i);
+                }
+                log->eventValues[1] = value;
+            } else {
+                log->eventValues[1] = readSignedVB(log);
+            }
+        }
+            // blackboxLogEvent() falls through and writes a gtune result after an adjustment too
+        case FLIGHT_LOG_EVENT_GTUNE_RESULT:
+            readByte(log);
+            readSignedVB(log);
+            readByte(log);
+            readByte(log);
+        break;
+        case FLIGHT_LOG_EVENT_LOGGING_RESUME:
+            log->eventValues[0] = readUnsignedVB(log);
+            log->eventValues[1] = readUnsignedVB(log);
+
+            // Logging carries on from an I frame after a pause
+            log->mainValid = false;
+            log->lastMainTime = log->eventValues[1];
+        break;
+        case FLIGHT_LOG_EVENT_LOG_END: {
+            static const char endMessage[] = "End of log";
+
+            for (size_t i = 0; i < sizeof(endMessage); i++) {
+                if (readByte(log) != (uint8_t)endMessage[i]) {
+                    return false;
+                }
+            }
+        }
+        break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the next frame of the log, skipping over corrupt data. A frame only counts as intact when the byte after it
+ * is another frame marker (or the end of the data), otherwise the decoder scans on from the byte after its marker.
+ */
+bool blackboxDecodeNext(blackboxLog_t *log, blackboxFrame_t *frame)
+{
+    int32_t current[BLACKBOX_DECODE_MAX_FIELDS];
+    uint16_t adaptiveCost[BLACKBOX_DECODE_MAX_FIELDS][3];
+
+    while (true) {
+        if (log->pos >= log->end) {
+            frame->type = BLACKBOX_FRAME_END;
+            frame->marker = 0;
+            frame->offset = log->end - log->start;
+            frame->values = NULL;
+            frame->valueCount = 0;
+            return false;
+        }
+
+        const uint8_t *frameStart = log->pos;
+        const char marker = readByte(log);
+        bool usable = true;
+
+        log->overrun = false;
+
+        frame->marker = marker;
+        frame->offset = frameStart - log->start;
+
+        switch (marker) {
+            case 'I':
+                memset(adaptiveCost, 0, sizeof(adaptiveCost));
+                decodeFields(log, &log->frameDefI, current, NULL, NULL, adaptiveCost, 0);
+                frame->type = BLACKBOX_FRAME_MAIN;
+                frame->valueCount = log->frameDefI.fieldCount;
+            break;
+            case 'P':
+                memcpy(adaptiveCost, log->adaptiveCost, sizeof(adaptiveCost));
+                decodeFields(log, &log->frameDefP, current, log->mainHistory[1], log->mainHistory[2], adaptiveCost,
+                    log->mainValid ? mainIterationStep(log) : 1);
+                usable = log->mainValid;
+                frame->type = BLACKBOX_FRAME_MAIN;
+                frame->valueCount = log->frameDefP.fieldCount;
+            break;
+            case 'S':
+                decodeFields(log, &log->frameDefS, current, NULL, NULL, NULL, 0);
+                frame->type = BLACKBOX_FRAME_SLOW;
+                frame->valueCount = log->frameDefS.fieldCount;
+            break;
+            case 'R':
+                decodeFields(log, &log->frameDefR, current, NULL, NULL, NULL, 0);
+                frame->type = BLACKBOX_FRAME_GYRO;
+                frame->valueCount = log->frameDefR.fieldCount;
+            break;
+            case 'r':
+                decodeFields(log, &log->frameDefRDelta, current, log->gyroHistory[1], log->gyroHistory[2], NULL, 1);
+                usable = log->gyroValid;
+                frame->type = BLACKBOX_FRAME_GYRO;
+                frame->valueCount = log->frameDefRDelta.fieldCount;
+            break;
+            case 'G':
+                decodeFields(log, &log->frameDefG, current, NULL, NULL, NULL, 0);
+                frame->type = BLACKBOX_FRAME_GPS;
+                frame->valueCount = log->frameDefG.fieldCount;
+            break;
+            case 'H':
+                decodeFields(log, &log->frameDefH, current, NULL, NULL, NULL, 0);
+                frame->type = BLACKBOX_FRAME_GPS_HOME;
+                frame->valueCount = log->frameDefH.fieldCount;
+            break;
+            case 'E':
+                frame->event = readByte(log);
+                frame->type = BLACKBOX_FRAME_EVENT;
+                frame->valueCount = 2;
+                if (!decodeEvent(log, frame->event)) {
+                    log->overrun = true;
+                }
+            break;
+            default:
+                log->stats.skippedBytes++;
+                continue;
+        }
+
+        const bool intact = !log->overrun && (log->pos == log->end || isFrameMarker(*log->pos));
+
+        if (!intact) {
+            // Rescan from just after this marker, the stream has to restart from keyframes
+            log->stats.corruptFrames++;
+            log->pos = frameStart + 1;
+            log->mainValid = false;
+            log->gyroValid = false;
+            continue;
+        }
+
+        switch (marker) {
+            case 'I':
+                memcpy(log->mainHistory[1], current, sizeof(current));
+                memcpy(log->mainHistory[2], current, sizeof(current));
+                memcpy(log->adaptiveCost, adaptiveCost, sizeof(adaptiveCost));
+                log->mainValid = true;
+                log->stats.intraFrames++;
+            break;
+            case 'P':
+                if (!usable) {
+                    log->stats.skippedPFrames++;
+                    continue;
+                }
+                memcpy(log->mainHistory[2], log->mainHistory[1], sizeof(current));
+                memcpy(log->mainHistory[1], current, sizeof(current));
+                memcpy(log->adaptiveCost, adaptiveCost, sizeof(adaptiveCost));
+            break;
+            case 'R':
+                memcpy(log->gyroHistory[1], current, sizeof(current));
+                memcpy(log->gyroHistory[2], current, sizeof(current));
+                log->gyroValid = true;
+            break;
+            case 'r':
+                if (!usable) {
+                    continue;
+                }
+                memcpy(log->gyroHistory[2], log->gyroHistory[1], sizeof(current));
+                memcpy(log->gyroHistory[1], current, sizeof(current));
+            break;
+        }
+
+        switch (frame->type) {
+            case BLACKBOX_FRAME_MAIN:
+                frame->values = log->mainHistory[1];
+                log->lastMainTime = log->mainHistory[1][1];
+                log->stats.mainFrames++;
+            break;
+            case BLACKBOX_FRAME_GYRO:
+                frame->values = log->gyroHistory[1];
+                log->stats.gyroFrames++;
+            break;
+            case BLACKBOX_FRAME_SLOW:
+                memcpy(log->slowValues, current, sizeof(current));
+                frame->values = log->slowValues;
+                log->stats.slowFrames++;
+            break;
+            case BLACKBOX_FRAME_GPS_HOME:
+                log->gpsHome[0] = current[0];
+                log->gpsHome[1] = current[1];
+                // Fall through
+            case BLACKBOX_FRAME_GPS:
+                memcpy(log->gpsValues, current, sizeof(current));
+                frame->values = log->gpsValues;
+                log->stats.gpsFrames++;
+            break;
+            case BLACKBOX_FRAME_EVENT:
+                frame->values = log->eventValues;
+                log->stats.eventFrames++;
+                if (frame->event == FLIGHT_LOG_EVENT_LOG_END) {
+                    frame->type = BLACKBOX_FRAME_END;
+                    log->pos = log->end;
+                    return false;
+                }
+            break;
+            default:
+            break;
+        }
+        return true;
+    }
+}
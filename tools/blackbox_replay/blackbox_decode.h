@@ -0,0 +1,115 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Decoder for the native blackbox log format. Field layouts, predictors and encodings are all taken from the
+ * "H Field" header lines, so a log from any target decodes without knowing which optional fields it was built with.
+ */
+
+#define BLACKBOX_DECODE_MAX_FIELDS          48
+#define BLACKBOX_DECODE_MAX_FIELD_NAME      24
+#define BLACKBOX_DECODE_MAX_HEADERS         64
+#define BLACKBOX_DECODE_MAX_HEADER_LENGTH   96
+
+typedef struct blackboxFrameDef_s {
+    int fieldCount;
+    char name[BLACKBOX_DECODE_MAX_FIELDS][BLACKBOX_DECODE_MAX_FIELD_NAME];
+    uint8_t isSigned[BLACKBOX_DECODE_MAX_FIELDS];
+    uint8_t predictor[BLACKBOX_DECODE_MAX_FIELDS];
+    uint8_t encoding[BLACKBOX_DECODE_MAX_FIELDS];
+} blackboxFrameDef_t;
+
+typedef enum {
+    BLACKBOX_FRAME_MAIN,        // I or P frame, values are in I field order
+    BLACKBOX_FRAME_SLOW,
+    BLACKBOX_FRAME_GYRO,        // R or r frame, values are in R field order
+    BLACKBOX_FRAME_GPS,
+    BLACKBOX_FRAME_GPS_HOME,
+    BLACKBOX_FRAME_EVENT,
+    BLACKBOX_FRAME_END,         // end of the data, or a log end event
+} blackboxFrameType_e;
+
+typedef struct blackboxFrame_s {
+    blackboxFrameType_e type;
+    char marker;                // frame character as written in the log
+    uint32_t offset;            // of the frame marker from the start of the data
+    const int32_t *values;
+    int valueCount;
+    uint8_t event;              // FlightLogEvent for BLACKBOX_FRAME_EVENT
+} blackboxFrame_t;
+
+typedef struct blackboxDecodeStats_s {
+    uint32_t mainFrames;
+    uint32_t intraFrames;
+    uint32_t slowFrames;
+    uint32_t gyroFrames;
+    uint32_t gpsFrames;
+    uint32_t eventFrames;
+    uint32_t corruptFrames;     // frames dropped because the next byte wasn't a frame marker
+    uint32_t skippedPFrames;    // P frames dropped while waiting for an I frame after a corrupt one
+    uint32_t skippedBytes;      // bytes scanned over while resynchronising
+} blackboxDecodeStats_t;
+
+typedef struct blackboxLog_s {
+    const uint8_t *start;
+    const uint8_t *end;
+    const uint8_t *pos;
+    bool overrun;               // a read went past the end of the data
+
+    int headerCount;
+    char header[BLACKBOX_DECODE_MAX_HEADERS][BLACKBOX_DECODE_MAX_HEADER_LENGTH];
+
+    blackboxFrameDef_t frameDefI, frameDefP;
+    blackboxFrameDef_t frameDefS;
+    blackboxFrameDef_t frameDefG, frameDefH;
+    blackboxFrameDef_t frameDefR, frameDefRDelta;
+
+    int dataVersion;
+    int frameIntervalI;
+    int frameIntervalPNum, frameIntervalPDenom;
+    int minthrottle;
+    int vbatref;
+    int motor0Index;            // I field index of motor[0], or -1
+
+    // Main stream history in I field order, [0] is the frame being decoded
+    int32_t mainHistory[3][BLACKBOX_DECODE_MAX_FIELDS];
+    bool mainValid;             // a P frame can be decoded on top of mainHistory
+    uint16_t adaptiveCost[BLACKBOX_DECODE_MAX_FIELDS][3];
+    uint32_t lastMainTime;
+
+    int32_t gyroHistory[3][BLACKBOX_DECODE_MAX_FIELDS];
+    bool gyroValid;
+
+    int32_t slowValues[BLACKBOX_DECODE_MAX_FIELDS];
+    int32_t gpsValues[BLACKBOX_DECODE_MAX_FIELDS];
+    int32_t gpsHome[2];
+    int32_t eventValues[2];
+
+    blackboxDecodeStats_t stats;
+} blackboxLog_t;
+
+bool blackboxDecodeOpen(blackboxLog_t *log, const uint8_t *data, size_t length);
+bool blackboxDecodeNext(blackboxLog_t *log, blackboxFrame_t *frame);
+
+const char *blackboxDecodeHeader(const blackboxLog_t *log, const char *name);
+int blackboxDecodeFieldIndex(const blackboxFrameDef_t *def, const char *name);
@@ -0,0 +1,54 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the target headers, the flight code is built with the features a replay needs and no hardware
+
+#define TARGET_BOARD_IDENTIFIER "HOST"
+
+#define BLACKBOX
+#define GYRO
+#define ACC
+#define BARO
+
+#define SERIAL_PORT_COUNT 1
+
+typedef enum {
+    DISABLE = 0,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+// Peripheral types named in driver headers the flight code includes
+typedef enum {
+    Mode_TEST = 0x0,
+    Mode_Out_PP = 0x10,
+} GPIO_Mode;
+
+typedef struct {
+    void *test;
+} TIM_TypeDef;
+
+typedef struct {
+    void *test;
+} GPIO_TypeDef;
+
+#define U_ID_0 0
+#define U_ID_1 0
+#define U_ID_2 0
@@ -0,0 +1,337 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flies a synthetic acro flight through the host build of the flight code and logs it with the real blackbox.c to a
+ * file, as if the blackbox serial port was wired to it. Replaying that log has to reproduce the logged PID and motor
+ * outputs exactly, which checks the decoder and the replay harness end to end.
+ *
+ * The craft also climbs and comes back down every 10 seconds. The accelerometer sees that climb with a constant bias
+ * on Z and the baro altitude arrives late and noisy, which gives tools/altitude_estimator_test a log with a known
+ * truth to replay.
+ *
+ * With -t it also times handleBlackbox(), which encodes the iteration's frames into the staging buffer and commits
+ * them to the port, and reports the median and mean cost per logged iteration and the mean per byte. The median
+ * is the figure to compare, the mean picks up whatever else the host was doing. -u takes blackboxBeginFrames() and
+ * blackboxCommitFrames() out, so every byte goes to the port on its own like before frames were staged, and the log
+ * has to come out byte for byte the same. make bench runs both. The port here is stdio, so this measures the
+ * encoder and the per byte dispatch and not a UART or flash chip.
+ *
+ *   record [-p predictor] [-c pidController] [-s seconds] [-l looptime] [-t [-u]] LOG
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "common/axis.h"
+#include "common/maths.h"
+
+#include "config/parameter_group.h"
+#include "config/feature.h"
+
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/gyro_sync.h"
+
+#include "fc/config.h"
+#include "fc/rc_controls.h"
+#include "fc/rate_profile.h"
+#include "fc/runtime_config.h"
+
+#include "rx/rx.h"
+
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "sensors/barometer.h"
+#include "sensors/gyro.h"
+
+#include "flight/imu.h"
+#include "flight/mixer.h"
+#include "flight/pid.h"
+
+#include "blackbox/blackbox.h"
+#include "blackbox/blackbox_io.h"
+
+#include "replay_host.h"
+
+extern float dT;
+extern uint32_t currentTime;
+extern pidControllerFuncPtr pid_controller;
+
+// Sticks stay centred and the gyro still until the log header is out, so nothing the replay can't see builds up
+#define IDLE_SECONDS 2
+#define SHUTDOWN_LOOPS 1000
+
+// The vertical profile, tools/altitude_estimator_test checks its estimate against these
+#define CLIMB_HEIGHT_CM 300.0f
+#define CLIMB_PERIOD_S 10.0f
+#define ACC_Z_BIAS 15                   // acc LSB, 29 cm/s^2 at acc_1G 512
+#define BARO_PERIOD_S 0.04f
+#define BARO_DELAY_S 0.13f              // about what the FBM320 filter chain adds
+#define BARO_NOISE_CM 8
+
+static uint32_t noiseState = 0x12345678;
+
+static bool unstaged = false;
+
+// record is linked with --wrap for these two, -u turns staging off without touching blackbox.c
+void __real_blackboxBeginFrames(void);
+void __real_blackboxCommitFrames(void);
+
+void __wrap_blackboxBeginFrames(void)
+{
+    if (!unstaged) {
+        __real_blackboxBeginFrames();
+    }
+}
+
+void __wrap_blackboxCommitFrames(void)
+{
+    if (!unstaged) {
+        __real_blackboxCommitFrames();
+    }
+}
+
+static int compareUint32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int32_t noise(int32_t amplitude)
+{
+    // xorshift32, so every run logs the same flight
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    return (int32_t)(noiseState % (2 * amplitude + 1)) - amplitude;
+}
+
+// The phase is wrapped, cosf() here is the cos_approx() of common/maths.c which gives up past 32 radians
+static float climbAltitude(float t)
+{
+    return t > 0 ? CLIMB_HEIGHT_CM / 2 * (1 - cosf(2 * M_PIf / CLIMB_PERIOD_S * fmodf(t, CLIMB_PERIOD_S))) : 0;
+}
+
+static float climbAcceleration(float t)
+{
+    const float w = 2 * M_PIf / CLIMB_PERIOD_S;
+    return t > 0 ? CLIMB_HEIGHT_CM / 2 * w * w * cosf(w * fmodf(t, CLIMB_PERIOD_S)) : 0;    // cm/s^2
+}
+
+static void synthesizeBaro(float t, bool flying)
+{
+    static float nextSampleAt;
+
+    if (!flying) {
+        BaroAlt = 0;
+        nextSampleAt = 0;
+        return;
+    }
+    if (t >= nextSampleAt) {
+        BaroAlt = lrintf(climbAltitude(t - BARO_DELAY_S)) + noise(BARO_NOISE_CM);
+        nextSampleAt += BARO_PERIOD_S;
+    }
+}
+
+static void synthesizeInputs(float t, bool flying)
+{
+    static float rate[XYZ_AXIS_COUNT];
+
+    if (!flying) {
+        rcData[ROLL] = rcData[PITCH] = rcData[YAW] = rxConfig()->midrc;
+        rcData[THROTTLE] = PWM_RANGE_MIN;
+
+        hostGyroSample[X] = hostGyroSample[Y] = hostGyroSample[Z] = 0;
+        hostAccSample[X] = hostAccSample[Y] = 0;
+        hostAccSample[Z] = acc.acc_1G + ACC_Z_BIAS;
+        return;
+    }
+
+    // Stick sweeps on every axis, with the throttle dropping below mincheck for a moment every 8 seconds
+    rcData[ROLL] = 1500 + 350 * sinf(2 * M_PIf * 0.7f * t);
+    rcData[PITCH] = 1500 + 300 * sinf(2 * M_PIf * 0.45f * t + 1.0f);
+    rcData[YAW] = 1500 + 200 * sinf(2 * M_PIf * 0.2f * t + 2.0f);
+    rcData[THROTTLE] = fmodf(t, 8.0f) < 0.5f ? 1050 : 1450 + 250 * sinf(2 * M_PIf * 0.3f * t);
+
+    // The craft follows the sticks with some lag, plus sensor noise and motor vibration
+    const float vibration = 6.0f * sinf(2 * M_PIf * 180.0f * t);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float target = (rcData[axis] - 1500) * 1.2f;    // deg/s
+        rate[axis] += (target - rate[axis]) * dT / 0.03f;
+        hostGyroSample[axis] = lrintf(rate[axis] / gyro.scale + vibration) + noise(3);
+    }
+
+    hostAccSample[X] = lrintf(acc.acc_1G * 0.1f * sinf(2 * M_PIf * 0.45f * t)) + noise(8);
+    hostAccSample[Y] = lrintf(acc.acc_1G * 0.1f * sinf(2 * M_PIf * 0.7f * t)) + noise(8);
+    hostAccSample[Z] = acc.acc_1G + ACC_Z_BIAS + lrintf(climbAcceleration(t) * acc.acc_1G / 980.665f) + noise(8);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: record [-p predictor] [-c pidController] [-s seconds] [-l looptime] [-t [-u]] LOG\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int predictor = BLACKBOX_PREDICTOR_AVERAGE;
+    int controller = PID_CONTROLLER_MWREWRITE;
+    int seconds = 10;
+    int looptime = 2000;
+    bool timing = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:s:l:tu")) != -1) {
+        switch (opt) {
+            case 'p':
+                predictor = atoi(optarg);
+            break;
+            case 'c':
+                controller = atoi(optarg);
+            break;
+            case 's':
+                seconds = atoi(optarg);
+            break;
+            case 'l':
+                looptime = atoi(optarg);
+            break;
+            case 't':
+                timing = true;
+            break;
+            case 'u':
+                unstaged = true;
+            break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1 || looptime <= 0 || (unstaged && !timing)) {
+        usage();
+    }
+
+    hostSerialOutput = fopen(argv[optind], "wb");
+    if (!hostSerialOutput) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    hostResetConfig();
+    sensorsSet(SENSOR_BARO);
+
+    featureSet(FEATURE_BLACKBOX);
+    blackboxConfig()->device = BLACKBOX_DEVICE_SERIAL;
+    blackboxConfig()->gyro_logging = 1;
+    blackboxConfig()->predictor = predictor;
+    pidProfile()->pidController = controller;
+    imuConfig()->looptime = looptime;
+
+    targetLooptime = looptime;
+    gyro.scale = 1.0f / 16.4f;
+    acc.acc_1G = 512;
+
+    hostActivateConfig();
+
+    static const rollAndPitchTrims_t trims;
+    const uint32_t flightLoops = (uint32_t)seconds * 1000000 / looptime;
+    const uint32_t idleLoops = IDLE_SECONDS * 1000000 / looptime;
+    hostMicros = 1000000;
+    uint32_t previousTime = hostMicros;
+    uint64_t blackboxNs = 0;
+    uint32_t blackboxIterations = 0;
+    uint32_t *iterationNs = timing ? malloc(flightLoops * sizeof(*iterationNs)) : NULL;
+    long blackboxStart = 0, blackboxEnd = 0;
+
+    ENABLE_ARMING_FLAG(ARMED);
+    initBlackbox();
+    startBlackbox();
+
+    for (uint32_t loop = 0; loop < idleLoops + flightLoops + SHUTDOWN_LOOPS; loop++) {
+        const bool flying = loop >= idleLoops && loop < idleLoops + flightLoops;
+
+        /*
+         * Some scheduling jitter on the loop period, except on the first loop. The PT1 filters latch the dT they are
+         * first called with, and replay has to assume that was exactly one looptime.
+         */
+        hostMicros += looptime + (loop ? noise(looptime / 50) : 0);
+        currentTime = hostMicros;
+        dT = (currentTime - previousTime) * 1e-6f;
+        previousTime = currentTime;
+
+        if (loop == idleLoops + flightLoops) {
+            finishBlackbox();
+            DISABLE_ARMING_FLAG(ARMED);
+        }
+
+        synthesizeInputs((loop - idleLoops) * looptime * 1e-6f, flying);
+        synthesizeBaro((loop - idleLoops) * looptime * 1e-6f, flying);
+
+        // The order of taskUpdateAccelerometer() and taskMainPidLoop()
+        imuUpdateAccelerometer((rollAndPitchTrims_t *)&trims);
+        imuUpdateGyroAndAttitude();
+        hostUpdateRcCommands(true);
+        pid_controller(pidProfile(), currentControlRateProfile, imuConfig()->max_angle_inclination, &trims, rxConfig());
+        mixTable();
+
+        if (timing && flying) {
+            if (!blackboxIterations) {
+                fflush(hostSerialOutput);
+                blackboxStart = ftell(hostSerialOutput);
+            }
+            const uint64_t start = nanoseconds();
+            handleBlackbox();
+            const uint32_t elapsed = nanoseconds() - start;
+            blackboxNs += elapsed;
+            iterationNs[blackboxIterations++] = elapsed;
+            blackboxEnd = ftell(hostSerialOutput);
+        } else {
+            handleBlackbox();
+        }
+    }
+
+    const long length = ftell(hostSerialOutput);
+    fclose(hostSerialOutput);
+
+    printf("%s: %d s at %d us, predictor %d, pid controller %d, %ld bytes\n", argv[optind], seconds, looptime,
+        predictor, controller, length);
+    if (timing) {
+        // Only the flight is timed, the header goes out over the idle loops before it
+        qsort(iterationNs, blackboxIterations, sizeof(*iterationNs), compareUint32);
+        printf("handleBlackbox() %-8s %u iterations, %ld bytes, per iteration %u ns median %.0f ns mean, %.1f ns per byte\n",
+            unstaged ? "unstaged" : "staged", blackboxIterations, blackboxEnd - blackboxStart,
+            iterationNs[blackboxIterations / 2], (double)blackboxNs / blackboxIterations,
+            (double)blackboxNs / (blackboxEnd - blackboxStart));
+    }
+    free(iterationNs);
+
+    return 0;
+}
@@ -0,0 +1,517 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays the gyro, acc and rcCommand inputs recorded in a blackbox log through the host build of imu.c, the PID
+ * controller and mixTable(), configured from the log header. Reports how far the outputs drift from the logged ones
+ * and how long the flight code took per loop.
+ *
+ *   replay [-a] [-t tolerance] [-w warmupLoops] LOG
+ *
+ * What the log doesn't carry has to be assumed:
+ *  - rcData is rebuilt by inverting the rc curves, so TPA and horizon stick scaling are exact only up to the
+ *    resolution of the curves, and the throttle correction added in angle modes isn't taken back out.
+ *  - Air mode is a switch position, pass -a if it was on.
+ *  - The accelerometer trims are taken to be zero.
+ *  - D term history and the attitude start from rest, the I terms are seeded from the first logged frame. Use -w to
+ *    leave the loops out of the comparison that this takes to settle.
+ *  - The PT1 filters keep the dT of their first call for good, which is taken to be exactly one looptime.
+ *  - Each logged frame is run as one loop, so a "P interval" other than 1/1 can't be replayed exactly.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "config/parameter_group.h"
+#include "config/feature.h"
+
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/gyro_sync.h"
+
+#include "fc/rc_controls.h"
+#include "fc/rate_profile.h"
+#include "fc/runtime_config.h"
+
+#include "rx/rx.h"
+
+#include "io/motor_and_servo.h"
+
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "sensors/gyro.h"
+
+#include "flight/imu.h"
+#include "flight/mixer.h"
+#include "flight/pid.h"
+
+#include "blackbox/blackbox_fielddefs.h"
+
+#include "blackbox_decode.h"
+#include "replay_host.h"
+
+extern float dT;
+extern uint32_t currentTime;
+extern uint8_t motorCount;
+extern pidControllerFuncPtr pid_controller;
+extern int32_t lastITerm[3];
+extern float lastITermf[3];
+
+#define MAX_HEADER_VALUES 5
+
+typedef enum {
+    OUTPUT_P,
+    OUTPUT_I,
+    OUTPUT_D,
+    OUTPUT_MOTOR,
+    OUTPUT_GROUP_COUNT
+} outputGroup_e;
+
+static const char * const outputGroupNames[OUTPUT_GROUP_COUNT] = { "axisP", "axisI", "axisD", "motor" };
+
+typedef struct outputStats_s {
+    int fieldIndex;             // in the I frame, -1 when not logged
+    char name[BLACKBOX_DECODE_MAX_FIELD_NAME];
+    int32_t maxError;
+    double sumSquaredError;
+    uint32_t mismatches;
+} outputStats_t;
+
+#define MAX_OUTPUTS (3 * 3 + MAX_SUPPORTED_MOTORS)
+
+static outputStats_t outputs[MAX_OUTPUTS];
+static int outputCount;
+
+static int fieldTime;
+static int fieldLoopIteration;
+static int fieldRcCommand[4];
+static int fieldGyro[XYZ_AXIS_COUNT];
+static int fieldAcc[XYZ_AXIS_COUNT];
+static int fieldAxisI[3];
+
+static int headerValues(const blackboxLog_t *log, const char *name, int *values, int count)
+{
+    const char *text = blackboxDecodeHeader(log, name);
+    int found = 0;
+
+    while (text && found < count) {
+        char *end;
+        values[found] = strtol(text, &end, 0);
+        if (end == text) {
+            break;
+        }
+        found++;
+        text = *end == ',' ? end + 1 : NULL;
+    }
+
+    if (found < count) {
+        fprintf(stderr, "warning: header \"%s\" %s, keeping the default\n", name, text ? "is malformed" : "is missing");
+        return 0;
+    }
+    return found;
+}
+
+static void configureFromHeader(const blackboxLog_t *log)
+{
+    int v[MAX_HEADER_VALUES];
+
+    hostResetConfig();
+
+    if (headerValues(log, "looptime", v, 1)) {
+        imuConfig()->looptime = v[0];
+        targetLooptime = v[0];
+    } else {
+        targetLooptime = imuConfig()->looptime;
+    }
+    if (headerValues(log, "gyro.scale", v, 1)) {
+        union { uint32_t u; float f; } scale = { .u = (uint32_t)v[0] };
+        gyro.scale = scale.f;
+    }
+    if (headerValues(log, "acc_1G", v, 1)) {
+        acc.acc_1G = v[0];
+    }
+    if (headerValues(log, "dcm", v, 2)) {
+        imuConfig()->dcm_kp = v[0];
+        imuConfig()->dcm_ki = v[1];
+    }
+    if (headerValues(log, "angle", v, 2)) {
+        imuConfig()->max_angle_inclination = v[0];
+        imuConfig()->small_angle = v[1];
+    }
+
+    pidProfile_t *pid = pidProfile();
+    static const char * const pidHeaders[] = { "rollPID", "pitchPID", "yawPID", "levelPID" };
+    static const pidIndex_e pidIndexes[] = { PIDROLL, PIDPITCH, PIDYAW, PIDLEVEL };
+    for (unsigned i = 0; i < ARRAYLEN(pidHeaders); i++) {
+        if (headerValues(log, pidHeaders[i], v, 3)) {
+            pid->P8[pidIndexes[i]] = v[0];
+            pid->I8[pidIndexes[i]] = v[1];
+            pid->D8[pidIndexes[i]] = v[2];
+        }
+    }
+    if (headerValues(log, "pidController", v, 1)) {
+        pid->pidController = v[0];
+    }
+    if (headerValues(log, "pidFilters", v, 4)) {
+        pid->dterm_lpf = v[0];
+        pid->yaw_lpf = v[1];
+        pid->yaw_p_limit = v[2];
+        pid->deltaMethod = v[3];
+    }
+
+    controlRateConfig_t *rates = currentControlRateProfile;
+    if (headerValues(log, "rcRate", v, 1)) {
+        rates->rcRate8 = v[0];
+    }
+    if (headerValues(log, "rcExpo", v, 2)) {
+        rates->rcExpo8 = v[0];
+        rates->rcYawExpo8 = v[1];
+    }
+    if (headerValues(log, "rates", v, 3)) {
+        rates->rates[ROLL] = v[0];
+        rates->rates[PITCH] = v[1];
+        rates->rates[YAW] = v[2];
+    }
+    if (headerValues(log, "tpa", v, 2)) {
+        rates->dynThrPID = v[0];
+        rates->tpa_breakpoint = v[1];
+    }
+    if (headerValues(log, "thrCurve", v, 2)) {
+        rates->thrMid8 = v[0];
+        rates->thrExpo8 = v[1];
+    }
+
+    if (headerValues(log, "rc", v, 5)) {
+        rxConfig()->midrc = v[0];
+        rxConfig()->mincheck = v[1];
+        rcControlsConfig()->deadband = v[2];
+        rcControlsConfig()->yaw_deadband = v[3];
+        rcControlsConfig()->yaw_control_direction = v[4];
+    }
+    if (headerValues(log, "features", v, 1)) {
+        featureClearAll();
+        featureSet(v[0]);
+    }
+
+    if (headerValues(log, "minthrottle", v, 1)) {
+        motorAndServoConfig()->minthrottle = v[0];
+    }
+    if (headerValues(log, "maxthrottle", v, 1)) {
+        motorAndServoConfig()->maxthrottle = v[0];
+    }
+    if (headerValues(log, "mincommand", v, 1)) {
+        motorAndServoConfig()->mincommand = v[0];
+    }
+    if (headerValues(log, "mixer", v, 3)) {
+        mixerConfig()->mixerMode = v[0];
+        mixerConfig()->pid_at_min_throttle = v[1];
+        mixerConfig()->yaw_motor_direction = v[2];
+    }
+    if (headerValues(log, "yaw_jump_prevention_limit", v, 1)) {
+        mixerConfig()->yaw_jump_prevention_limit = v[0];
+    }
+
+    hostActivateConfig();
+}
+
+static int requireField(const blackboxLog_t *log, const char *name)
+{
+    const int index = blackboxDecodeFieldIndex(&log->frameDefI, name);
+    if (index < 0) {
+        fprintf(stderr, "log has no %s field, can't replay it\n", name);
+        exit(1);
+    }
+    return index;
+}
+
+static void findFields(const blackboxLog_t *log)
+{
+    char name[BLACKBOX_DECODE_MAX_FIELD_NAME];
+
+    fieldLoopIteration = requireField(log, "loopIteration");
+    fieldTime = requireField(log, "time");
+
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "rcCommand[%d]", i);
+        fieldRcCommand[i] = requireField(log, name);
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        snprintf(name, sizeof(name), "gyroADC[%d]", axis);
+        fieldGyro[axis] = requireField(log, name);
+        snprintf(name, sizeof(name), "accSmooth[%d]", axis);
+        fieldAcc[axis] = requireField(log, name);
+    }
+
+    outputCount = 0;
+    for (int group = 0; group < OUTPUT_GROUP_COUNT; group++) {
+        const int count = group == OUTPUT_MOTOR ? motorCount : 3;
+        for (int i = 0; i < count; i++) {
+            outputStats_t *output = &outputs[outputCount++];
+            snprintf(output->name, sizeof(output->name), "%s[%d]", outputGroupNames[group], i);
+            // axisD[2] is left out of the log when yaw has no D
+            output->fieldIndex = blackboxDecodeFieldIndex(&log->frameDefI, output->name);
+        }
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        fieldAxisI[axis] = outputs[OUTPUT_I * 3 + axis].fieldIndex;
+    }
+}
+
+static int32_t replayedOutput(int index)
+{
+    const int group = index < 3 * 3 ? index / 3 : OUTPUT_MOTOR;
+    const int i = group == OUTPUT_MOTOR ? index - 3 * 3 : index % 3;
+
+    switch (group) {
+        case OUTPUT_P:
+            return axisPID_P[i];
+        case OUTPUT_I:
+            return axisPID_I[i];
+        case OUTPUT_D:
+            return axisPID_D[i];
+        default:
+            return motor[i];
+    }
+}
+
+// Start the integrators where the logged I terms say the flight controller's were
+static void seedIntegrators(const int32_t *values)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        const int32_t iTerm = fieldAxisI[axis] >= 0 ? values[fieldAxisI[axis]] : 0;
+
+        switch (pidProfile()->pidController) {
+            case PID_CONTROLLER_LUX_FLOAT:
+                lastITermf[axis] = iTerm;
+            break;
+            case PID_CONTROLLER_MW23:
+                if (axis == FD_YAW) {
+                    lastITerm[axis] = iTerm << 13;
+                } else if (pidProfile()->I8[axis]) {
+                    lastITerm[axis] = (iTerm << 13) / pidProfile()->I8[axis];
+                }
+            break;
+            default:
+                lastITerm[axis] = iTerm << 13;
+            break;
+        }
+    }
+}
+
+static uint64_t nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: replay [-a] [-t tolerance] [-w warmupLoops] LOG\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bool airMode = false;
+    int tolerance = -1;
+    uint32_t warmupLoops = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "at:w:")) != -1) {
+        switch (opt) {
+            case 'a':
+                airMode = true;
+            break;
+            case 't':
+                tolerance = atoi(optarg);
+            break;
+            case 'w':
+                warmupLoops = atoi(optarg);
+            break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file) {
+        perror(argv[optind]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(length);
+    if (!data || fread(data, 1, length, file) != (size_t)length) {
+        fprintf(stderr, "%s: read failed\n", argv[optind]);
+        return 1;
+    }
+    fclose(file);
+
+    static blackboxLog_t log;
+    if (!blackboxDecodeOpen(&log, data, length)) {
+        fprintf(stderr, "%s: not a blackbox log this decoder understands\n", argv[optind]);
+        return 1;
+    }
+
+    configureFromHeader(&log);
+    findFields(&log);
+
+    if (log.frameIntervalPNum != log.frameIntervalPDenom) {
+        fprintf(stderr, "warning: P interval %d/%d, loops that weren't logged can't be replayed\n",
+            log.frameIntervalPNum, log.frameIntervalPDenom);
+    }
+
+    const int fieldFlightMode = blackboxDecodeFieldIndex(&log.frameDefS, "flightModeFlags");
+    const int fieldStateFlags = blackboxDecodeFieldIndex(&log.frameDefS, "stateFlags");
+
+    static const rollAndPitchTrims_t trims;
+    blackboxFrame_t frame;
+    bool continuous = false;
+    uint32_t lastIteration = 0, lastTime = 0;
+    uint32_t loops = 0, comparedLoops = 0, discontinuities = 0;
+    int64_t firstMismatch = -1;
+    uint64_t flightCodeNs = 0;
+
+    hostRcModeMask = airMode ? 1 << BOXAIRMODE : 0;
+    ENABLE_ARMING_FLAG(ARMED);
+
+    while (blackboxDecodeNext(&log, &frame)) {
+        if (frame.type == BLACKBOX_FRAME_SLOW) {
+            if (fieldFlightMode >= 0) {
+                flightModeFlags = frame.values[fieldFlightMode];
+            }
+            if (fieldStateFlags >= 0) {
+                stateFlags = frame.values[fieldStateFlags];
+            }
+            continue;
+        }
+        if (frame.type == BLACKBOX_FRAME_EVENT && frame.event == FLIGHT_LOG_EVENT_LOGGING_RESUME) {
+            continuous = false;
+            continue;
+        }
+        if (frame.type != BLACKBOX_FRAME_MAIN) {
+            continue;
+        }
+
+        const int32_t *values = frame.values;
+        const uint32_t iteration = values[fieldLoopIteration];
+        const uint32_t time = values[fieldTime];
+
+        // After a gap the flight code carries on from the first frame we have again
+        if (continuous && iteration != lastIteration + 1 && log.frameIntervalPNum == log.frameIntervalPDenom) {
+            continuous = false;
+        }
+        if (!continuous) {
+            if (loops) {
+                discontinuities++;
+            }
+            seedIntegrators(values);
+        }
+
+        hostMicros = currentTime = time;
+        dT = (continuous ? time - lastTime : targetLooptime) * 1e-6f;
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            hostGyroSample[axis] = values[fieldGyro[axis]];
+            hostAccSample[axis] = values[fieldAcc[axis]];
+        }
+        for (int i = 0; i < 4; i++) {
+            rcCommand[i] = values[fieldRcCommand[i]];
+        }
+        hostUpdateRcDataFromCommands();
+        hostUpdateRcCommands(false);
+
+        const uint64_t start = nanoseconds();
+
+        imuUpdateAccelerometer((rollAndPitchTrims_t *)&trims);
+        imuUpdateGyroAndAttitude();
+        pid_controller(pidProfile(), currentControlRateProfile, imuConfig()->max_angle_inclination, &trims, rxConfig());
+        mixTable();
+
+        flightCodeNs += nanoseconds() - start;
+
+        if (loops >= warmupLoops) {
+            for (int i = 0; i < outputCount; i++) {
+                outputStats_t *output = &outputs[i];
+                if (output->fieldIndex < 0) {
+                    continue;
+                }
+                const int32_t error = ABS(replayedOutput(i) - values[output->fieldIndex]);
+                if (error) {
+                    output->mismatches++;
+                    output->maxError = MAX(output->maxError, error);
+                    output->sumSquaredError += (double)error * error;
+                    if (firstMismatch < 0) {
+                        firstMismatch = iteration;
+                    }
+                }
+            }
+            comparedLoops++;
+        }
+
+        loops++;
+        continuous = true;
+        lastIteration = iteration;
+        lastTime = time;
+    }
+
+    const blackboxDecodeStats_t *stats = &log.stats;
+    printf("%s: %u main frames (%u I), %u slow, %u gyro, %u event, %u corrupt, %u P frames skipped\n", argv[optind],
+        stats->mainFrames, stats->intraFrames, stats->slowFrames, stats->gyroFrames, stats->eventFrames,
+        stats->corruptFrames, stats->skippedPFrames);
+    printf("replayed %u loops with pid controller %d and %d motors, %u discontinuities, compared %u\n", loops,
+        pidProfile()->pidController, motorCount, discontinuities, comparedLoops);
+    if (loops) {
+        printf("flight code: %.0f ns per loop\n", (double)flightCodeNs / loops);
+    }
+
+    printf("%-12s %10s %10s %10s\n", "output", "max error", "rms error", "mismatches");
+    int32_t worst = 0;
+    for (int i = 0; i < outputCount; i++) {
+        const outputStats_t *output = &outputs[i];
+        if (output->fieldIndex < 0) {
+            printf("%-12s %10s\n", output->name, "not logged");
+            continue;
+        }
+        printf("%-12s %10d %10.2f %10u\n", output->name, output->maxError,
+            comparedLoops ? sqrt(output->sumSquaredError / comparedLoops) : 0.0, output->mismatches);
+        worst = MAX(worst, output->maxError);
+    }
+    if (firstMismatch >= 0) {
+        printf("first mismatch at loop iteration %lld\n", (long long)firstMismatch);
+    }
+
+    free(data);
+
+    return tolerance >= 0 && worst > tolerance ? 1 : 0;
+}
@@ -0,0 +1,468 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "build/build_config.h"
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "config/parameter_group.h"
+#include "config/parameter_group_ids.h"
+#include "config/config_reset.h"
+#include "config/profile.h"
+#include "config/feature.h"
+
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/compass.h"
+#include "drivers/gyro_sync.h"
+#include "drivers/serial.h"
+#include "drivers/system.h"
+#include "drivers/pwm_output.h"
+
+#include "fc/rc_controls.h"
+#include "fc/rc_curves.h"
+#include "fc/rc_latency.h"
+#include "fc/rate_profile.h"
+#include "fc/runtime_config.h"
+
+#include "rx/rx.h"
+
+#include "io/beeper.h"
+#include "io/motor_and_servo.h"
+#include "io/serial.h"
+
+#include "msp/msp_serial.h"
+
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "sensors/barometer.h"
+#include "sensors/battery.h"
+#include "sensors/compass.h"
+#include "sensors/gyro.h"
+
+#include "flight/altitudehold.h"
+#include "flight/failsafe.h"
+#include "flight/imu.h"
+#include "flight/mixer.h"
+#include "flight/pid.h"
+
+#include "replay_host.h"
+
+uint32_t hostMicros;
+uint32_t hostRcModeMask;
+int32_t hostGyroSample[XYZ_AXIS_COUNT];
+int32_t hostAccSample[XYZ_AXIS_COUNT];
+FILE *hostSerialOutput;
+
+// Flight code globals that live in modules the host build leaves out
+uint32_t currentTime;
+uint32_t targetLooptime;
+float dT;
+
+int16_t rcData[MAX_SUPPORTED_RC_CHANNEL_COUNT];
+int16_t rcCommand[4];
+uint16_t rssi;
+
+gyro_t gyro;
+acc_t acc;
+int32_t gyroADC[XYZ_AXIS_COUNT];
+int32_t gyroADCUnfiltered[XYZ_AXIS_COUNT];
+int32_t accADC[XYZ_AXIS_COUNT];
+int32_t magADC[XYZ_AXIS_COUNT];
+int32_t BaroAlt;
+float magneticDeclination;
+
+uint16_t vbatLatestADC;
+uint16_t amperageLatestADC;
+
+extern uint8_t PIDweight[3];
+extern uint8_t dynP8[3], dynI8[3], dynD8[3];
+
+extern const mixer_t mixers[];
+extern motorMixer_t currentMixer[MAX_SUPPORTED_MOTORS];
+extern uint8_t motorCount;
+
+// The same defaults as the modules that normally register these
+PG_REGISTER_WITH_RESET_TEMPLATE(rxConfig_t, rxConfig, PG_RX_CONFIG, 2);
+PG_REGISTER_WITH_RESET_TEMPLATE(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 0);
+PG_REGISTER_WITH_RESET_TEMPLATE(batteryConfig_t, batteryConfig, PG_BATTERY_CONFIG, 0);
+PG_REGISTER_PROFILE_WITH_RESET_TEMPLATE(rcControlsConfig_t, rcControlsConfig, PG_RC_CONTROLS_CONFIG, 0);
+PG_REGISTER_PROFILE(modeActivationProfile_t, modeActivationProfile, PG_MODE_ACTIVATION_PROFILE, 0);
+
+PG_RESET_TEMPLATE(rxConfig_t, rxConfig,
+    .midrc = 1500,
+    .mincheck = 1100,
+    .maxcheck = 1900,
+);
+
+PG_RESET_TEMPLATE(gyroConfig_t, gyroConfig,
+    .gyro_lpf = 1,
+    .soft_gyro_lpf_hz = 100,
+);
+
+PG_RESET_TEMPLATE(batteryConfig_t, batteryConfig,
+    .vbatscale = VBAT_SCALE_DEFAULT,
+    .vbatmaxcellvoltage = 43,
+    .vbatwarningcellvoltage = 32,
+);
+
+PG_RESET_TEMPLATE(rcControlsConfig_t, rcControlsConfig,
+    .deadband = 5,
+    .yaw_deadband = 20,
+    .yaw_control_direction = 1,
+    .deadband3d_throttle = 50,
+);
+
+void hostResetConfig(void)
+{
+    pgResetAll(MAX_PROFILE_COUNT);
+    pgActivateProfile(0);
+    setControlRateProfile(0);
+
+    sensorsSet(SENSOR_GYRO | SENSOR_ACC);
+}
+
+void hostActivateConfig(void)
+{
+    /*
+     * The logged accSmooth has already been through the acc LPF, so the IMU is handed it unfiltered. The deadbands
+     * and the acc z cutoff only feed the velocity estimate, which nothing here reads.
+     */
+    static imuRuntimeConfig_t imuRuntimeConfig;
+    static accDeadband_t accDeadband = { .xy = 40, .z = 40 };
+
+    imuRuntimeConfig.dcm_kp = imuConfig()->dcm_kp / 10000.0f;
+    imuRuntimeConfig.dcm_ki = imuConfig()->dcm_ki / 10000.0f;
+    imuRuntimeConfig.acc_cut_hz = 0;
+    imuRuntimeConfig.acc_unarmedcal = 1;
+    imuRuntimeConfig.small_angle = imuConfig()->small_angle;
+
+    imuConfigure(&imuRuntimeConfig, &accDeadband, 5.0f, throttleCorrectionConfig()->throttle_correction_angle);
+    imuInit();
+
+    latchActiveFeatures();
+    activateControlRateConfig();
+    pidSetController(pidProfile()->pidController);
+    pidResetITerm();
+
+    const mixer_t *mixer = &mixers[mixerConfig()->mixerMode];
+    mixerLoadMix(mixerConfig()->mixerMode - 1, currentMixer);
+    motorCount = mixer->motorCount;
+    mixerResetDisarmedMotors();
+}
+
+void hostUpdateRcCommands(bool updateCommands)
+{
+    int32_t prop2;
+
+    // Mirrors updateRcCommands() in cleanflight_fc.c, without headfree which rewrites rcCommand after the fact
+    if (rcData[THROTTLE] < currentControlRateProfile->tpa_breakpoint) {
+        prop2 = 100;
+    } else {
+        if (rcData[THROTTLE] < 2000) {
+            prop2 = 100 - (uint16_t)currentControlRateProfile->dynThrPID * (rcData[THROTTLE] - currentControlRateProfile->tpa_breakpoint) / (2000 - currentControlRateProfile->tpa_breakpoint);
+        } else {
+            prop2 = 100 - currentControlRateProfile->dynThrPID;
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        int32_t prop1;
+        int32_t tmp = MIN(ABS(rcData[axis] - rxConfig()->midrc), 500);
+        int16_t command;
+
+        if (axis == ROLL || axis == PITCH) {
+            tmp = applyDeadband(tmp, rcControlsConfig()->deadband);
+            command = rcLookupPitchRoll(tmp);
+            prop1 = 100 - (uint16_t)currentControlRateProfile->rates[axis] * tmp / 500;
+            prop1 = (uint16_t)prop1 * prop2 / 100;
+            PIDweight[axis] = prop2;
+        } else {
+            tmp = applyDeadband(tmp, rcControlsConfig()->yaw_deadband);
+            command = rcLookupYaw(tmp) * -rcControlsConfig()->yaw_control_direction;
+            prop1 = 100 - (uint16_t)currentControlRateProfile->rates[axis] * ABS(tmp) / 500;
+            PIDweight[axis] = 100;
+        }
+
+        dynP8[axis] = (uint16_t)pidProfile()->P8[axis] * prop1 / 100;
+        dynI8[axis] = (uint16_t)pidProfile()->I8[axis] * prop1 / 100;
+        dynD8[axis] = (uint16_t)pidProfile()->D8[axis] * prop1 / 100;
+
+        if (updateCommands) {
+            rcCommand[axis] = rcData[axis] < rxConfig()->midrc ? -command : command;
+        }
+    }
+
+    if (updateCommands) {
+        int32_t tmp = constrain(rcData[THROTTLE], rxConfig()->mincheck, PWM_RANGE_MAX);
+        tmp = (uint32_t)(tmp - rxConfig()->mincheck) * PWM_RANGE_MIN / (PWM_RANGE_MAX - rxConfig()->mincheck);
+        rcCommand[THROTTLE] = rcLookupThrottle(tmp);
+    }
+}
+
+// Smallest curve input whose output is closest to the wanted value, the curves are monotonic
+static int32_t invertCurve(int16_t (*lookup)(int), int32_t wanted, int32_t inputMax)
+{
+    int32_t best = 0;
+    int32_t bestError = ABS(lookup(0) - wanted);
+
+    for (int32_t input = 1; input <= inputMax && bestError; input++) {
+        const int32_t error = ABS(lookup(input) - wanted);
+        if (error < bestError) {
+            best = input;
+            bestError = error;
+        }
+    }
+    return best;
+}
+
+void hostUpdateRcDataFromCommands(void)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        int32_t tmp;
+        bool positive;
+
+        if (axis == ROLL || axis == PITCH) {
+            tmp = invertCurve(rcLookupPitchRoll, ABS(rcCommand[axis]), 500);
+            if (tmp) {
+                tmp += rcControlsConfig()->deadband;
+            }
+            positive = rcCommand[axis] > 0;
+        } else {
+            tmp = invertCurve(rcLookupYaw, ABS(rcCommand[axis]), 500);
+            if (tmp) {
+                tmp += rcControlsConfig()->yaw_deadband;
+            }
+            positive = rcCommand[axis] * -rcControlsConfig()->yaw_control_direction > 0;
+        }
+
+        rcData[axis] = rxConfig()->midrc + (positive ? tmp : -tmp);
+    }
+
+    const int32_t range = PWM_RANGE_MAX - rxConfig()->mincheck;
+    const int32_t tmp = invertCurve(rcLookupThrottle, rcCommand[THROTTLE], PWM_RANGE_MIN);
+
+    // The bottom of the throttle curve is taken to be the stick at idle, below mincheck
+    if (tmp == 0) {
+        rcData[THROTTLE] = rxConfig()->mincheck - 1;
+    } else {
+        rcData[THROTTLE] = rxConfig()->mincheck + (tmp * range + PWM_RANGE_MIN - 1) / PWM_RANGE_MIN;
+    }
+}
+
+// Clock
+
+uint32_t micros(void)
+{
+    return hostMicros;
+}
+
+uint32_t millis(void)
+{
+    return hostMicros / 1000;
+}
+
+void delay(uint32_t ms)
+{
+    hostMicros += ms * 1000;
+}
+
+// Sensors
+
+void gyroUpdate(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroADCUnfiltered[axis] = hostGyroSample[axis];
+        gyroADC[axis] = hostGyroSample[axis];
+    }
+}
+
+void updateAccelerationReadings(rollAndPitchTrims_t *rollAndPitchTrims)
+{
+    UNUSED(rollAndPitchTrims);
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        accADC[axis] = hostAccSample[axis];
+    }
+}
+
+// imu.c hands the altitude estimator its earth-frame acceleration, altitude hold isn't part of the replay
+void altitudeEstimatorUpdateAcc(float accZ, float dT)
+{
+    UNUSED(accZ);
+    UNUSED(dT);
+}
+
+// RC and modes
+
+bool rcModeIsActive(boxId_e modeId)
+{
+    return hostRcModeMask & (1 << modeId);
+}
+
+bool rcModeIsActivationConditionPresent(modeActivationCondition_t *modeActivationConditions, boxId_e modeId)
+{
+    UNUSED(modeActivationConditions);
+    UNUSED(modeId);
+    return false;
+}
+
+int32_t getRcStickDeflection(int32_t axis, uint16_t midrc)
+{
+    return MIN(ABS(rcData[axis] - midrc), 500);
+}
+
+bool rxIsReceivingSignal(void)
+{
+    return true;
+}
+
+bool rxAreFlightChannelsValid(void)
+{
+    return true;
+}
+
+const rcLatencyStats_t *rcLatencyGetStats(void)
+{
+    static const rcLatencyStats_t stats;
+    return &stats;
+}
+
+failsafePhase_e failsafePhase(void)
+{
+    return FAILSAFE_IDLE;
+}
+
+bool failsafeIsActive(void)
+{
+    return false;
+}
+
+uint8_t getCurrentProfile(void)
+{
+    return 0;
+}
+
+// Outputs
+
+void pwmWriteMotor(uint8_t index, uint16_t value)
+{
+    UNUSED(index);
+    UNUSED(value);
+}
+
+void pwmShutdownPulsesForAllMotors(uint8_t motorCount)
+{
+    UNUSED(motorCount);
+}
+
+void pwmCompleteOneshotMotorUpdate(uint8_t motorCount)
+{
+    UNUSED(motorCount);
+}
+
+void beeperConfirmationBeeps(uint8_t beepCount)
+{
+    UNUSED(beepCount);
+}
+
+uint32_t getArmingBeepTimeMicros(void)
+{
+    return 0;
+}
+
+// Blackbox serial port, everything written to it goes to hostSerialOutput
+
+const uint32_t baudRates[] = {0, 9600, 19200, 38400, 57600, 115200, 230400, 250000};
+
+static serialPortConfig_t hostPortConfig = {
+    .functionMask = FUNCTION_BLACKBOX,
+    .baudRates = { 0, 0, 0, 5 },
+};
+
+static serialPort_t hostPort;
+
+serialPortConfig_t *findSerialPortConfig(uint16_t mask)
+{
+    return (hostPortConfig.functionMask & mask) ? &hostPortConfig : NULL;
+}
+
+portSharing_e determinePortSharing(serialPortConfig_t *portConfig, serialPortFunction_e function)
+{
+    UNUSED(portConfig);
+    UNUSED(function);
+    return PORTSHARING_NOT_SHARED;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function,
+    serialReceiveCallbackPtr callback, uint32_t baudrate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(identifier);
+    UNUSED(function);
+    UNUSED(callback);
+
+    hostPort.baudRate = baudrate;
+    hostPort.mode = mode;
+    hostPort.options = options;
+    return &hostPort;
+}
+
+void closeSerialPort(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void mspSerialAllocatePorts(void)
+{
+}
+
+void serialWrite(serialPort_t *instance, uint8_t ch)
+{
+    UNUSED(instance);
+    if (hostSerialOutput) {
+        fputc(ch, hostSerialOutput);
+    }
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+    if (hostSerialOutput) {
+        fwrite(data, 1, count, hostSerialOutput);
+    }
+}
+
+uint8_t serialTxBytesFree(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return 255;
+}
+
+bool isSerialTransmitBufferEmpty(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return true;
+}
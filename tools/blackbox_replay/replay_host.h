@@ -0,0 +1,48 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Host side of the flight code: the globals, configuration and drivers that imu.c, the PID controllers, mixer.c and
+ * blackbox.c expect from the rest of the firmware. Sensor readings and the clock are whatever the caller last loaded.
+ */
+
+extern uint32_t hostMicros;             // returned by micros(), millis() is derived from it
+extern uint32_t hostRcModeMask;         // boxId_e bits reported active by rcModeIsActive()
+extern int32_t hostGyroSample[3];       // loaded into gyroADC by gyroUpdate()
+extern int32_t hostAccSample[3];        // loaded into accADC by updateAccelerationReadings()
+extern FILE *hostSerialOutput;          // receives everything written to the blackbox serial port
+
+// Reset every parameter group to its defaults and select profile 0
+void hostResetConfig(void);
+
+// Apply the configuration to the flight code, call after changing it and before the first loop
+void hostActivateConfig(void);
+
+/*
+ * Derive rcCommand from rcData like the main loop does, setting the TPA and rate scaled PID weights on the way.
+ * When updateCommands is false, rcCommand is left alone and only the weights are set.
+ */
+void hostUpdateRcCommands(bool updateCommands);
+
+// Reconstruct the stick positions that produce the current rcCommand, the inverse of hostUpdateRcCommands()
+void hostUpdateRcDataFromCommands(void);
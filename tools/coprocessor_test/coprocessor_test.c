@@ -0,0 +1,313 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of coprocessor_328p.c against a mocked ATmega328p behind i2cRead()/i2cWrite(). The mock answers each
+ * block read with the frame it was scripted to send, or corrupts it, or fails the transfer, and records the keys the
+ * flight controller hands it.
+ *
+ * Decode: every command with every valid length round-trips and data past the length reads 0, longer lengths are
+ * rejected, and so is every single bit flip and every two bit flip in different bit positions of a frame.
+ *
+ * Frames: taskCoprocessor() polls at 60Hz while RX processing asks for frames at its own rate. It checks that each
+ * frame is returned once, that dst keeps it in between, that corrupt frames and I2C errors are counted and don't
+ * replace it, that it falls back to COPROCESSOR_CMD_NONE COPROCESSOR_FRAME_TIMEOUT_US after the last good frame or
+ * as soon as offline mode ends, and that a key pressed on the controller is only handed over while the 328p is idle.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "drivers/bus_i2c.h"
+#include "drivers/nrf2401.h"
+#include "drivers/coprocessor_328p.h"
+
+#define TASK_PERIOD_US (1000000 / 60)
+#define RX_PERIOD_US 5000
+#define RANDOM_FRAMES 1000000
+#define SEQUENCE_FRAMES 1000
+
+typedef enum {
+    MOCK_SEND,
+    MOCK_CORRUPT,
+    MOCK_I2C_ERROR,
+} mockAction_e;
+
+// The mocked 328p
+static struct {
+    uint8_t frame[COPROCESSOR_FRAME_SIZE];
+    mockAction_e action;
+    uint32_t reads;
+    uint32_t keysWritten;
+    uint8_t lastKey;
+} coprocessor;
+
+static uint32_t microsNow;
+static int failures;
+
+// What coprocessor_328p.c expects from the rest of the firmware
+dataPackage mspData;
+dataPackage t_mspData;
+
+uint32_t micros(void)
+{
+    return microsNow;
+}
+
+bool i2cRead(uint8_t addr_, uint8_t reg, uint8_t len, uint8_t *buf)
+{
+    if (addr_ != COPROCESSOR_I2C_ADDRESS || reg != COPROCESSOR_REG_FRAME || len != COPROCESSOR_FRAME_SIZE) {
+        printf("unexpected read of %d bytes from 0x%02x register 0x%02x\n", len, addr_, reg);
+        failures++;
+        return false;
+    }
+    coprocessor.reads++;
+    if (coprocessor.action == MOCK_I2C_ERROR) {
+        return false;
+    }
+    memcpy(buf, coprocessor.frame, COPROCESSOR_FRAME_SIZE);
+    if (coprocessor.action == MOCK_CORRUPT) {
+        buf[rand() % COPROCESSOR_FRAME_SIZE] ^= 1 << (rand() % 8);
+    }
+    return true;
+}
+
+bool i2cWrite(uint8_t addr_, uint8_t reg, uint8_t data)
+{
+    if (addr_ != COPROCESSOR_I2C_ADDRESS || reg != COPROCESSOR_REG_KEY) {
+        printf("unexpected write to 0x%02x register 0x%02x\n", addr_, reg);
+        failures++;
+        return false;
+    }
+    coprocessor.keysWritten++;
+    coprocessor.lastKey = data;
+    return true;
+}
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static void buildFrame(uint8_t *frame, uint8_t cmd, uint8_t length, const uint8_t *data)
+{
+    memset(frame, 0, COPROCESSOR_FRAME_SIZE);
+    frame[0] = cmd;
+    frame[1] = length;
+    memcpy(&frame[2], data, length > 4 ? 4 : length);
+    frame[COPROCESSOR_FRAME_SIZE - 1] = coprocessorChecksum(frame);
+}
+
+static void testDecode(void)
+{
+    uint8_t frame[COPROCESSOR_FRAME_SIZE], corrupt[COPROCESSOR_FRAME_SIZE];
+    const uint8_t data[4] = { 0x12, 0x34, 0x56, 0x78 };
+    package_328p package;
+    int decoded = 0, rejected = 0, flips = 0, flipsAccepted = 0;
+
+    for (int cmd = 0; cmd < 256; cmd++) {
+        for (int length = 0; length <= 8; length++) {
+            buildFrame(frame, cmd, length, data);
+            memset(&package, 0xee, sizeof(package));
+            const bool ok = coprocessorDecodeFrame(frame, &package);
+            if (length > 4) {
+                check(!ok, "frame longer than the data field accepted");
+                rejected += !ok;
+                continue;
+            }
+            decoded += ok;
+            check(ok && package.cmd == cmd && package.length == length, "valid frame not decoded");
+            for (int i = 0; i < 4; i++) {
+                check(package.data[i] == (i < length ? data[i] : 0), "data byte not copied or not cleared");
+            }
+
+            for (int bit = 0; bit < COPROCESSOR_FRAME_SIZE * 8; bit++) {
+                memcpy(corrupt, frame, sizeof(frame));
+                corrupt[bit / 8] ^= 1 << (bit % 8);
+                flips++;
+                flipsAccepted += coprocessorDecodeFrame(corrupt, &package);
+
+                // A second flip in the same bit of another byte cancels out in the XOR, any other position is caught
+                for (int second = bit + 1; second < COPROCESSOR_FRAME_SIZE * 8; second++) {
+                    if (second % 8 == bit % 8) {
+                        continue;
+                    }
+                    corrupt[second / 8] ^= 1 << (second % 8);
+                    flips++;
+                    flipsAccepted += coprocessorDecodeFrame(corrupt, &package);
+                    corrupt[second / 8] ^= 1 << (second % 8);
+                }
+            }
+        }
+    }
+    check(flipsAccepted == 0, "bit flips accepted");
+
+    // Random bytes on the bus, e.g. a 328p still booting
+    int randomAccepted = 0;
+    for (int i = 0; i < RANDOM_FRAMES; i++) {
+        for (int b = 0; b < COPROCESSOR_FRAME_SIZE; b++) {
+            frame[b] = rand();
+        }
+        randomAccepted += coprocessorDecodeFrame(frame, &package);
+    }
+
+    printf("decode: %d valid frames decoded, %d too long rejected, %d of %d one and two bit flips accepted\n",
+        decoded, rejected, flipsAccepted, flips);
+    printf("random frames accepted: %d of %d (%.3f%%, 5 of 256 lengths times 1 of 256 checksums is %.3f%%)\n",
+        randomAccepted, RANDOM_FRAMES, 100.0 * randomAccepted / RANDOM_FRAMES, 100.0 * 5 / 256 / 256);
+}
+
+// One RX update, returns true if it got a new frame
+static bool rxUpdate(package_328p *rx)
+{
+    const package_328p before = *rx;
+
+    if (coprocessorGetFrame(rx)) {
+        return true;
+    }
+    if (rx->cmd != COPROCESSOR_CMD_NONE) {
+        check(memcmp(&before, rx, sizeof(before)) == 0, "dst changed without a new frame");
+    }
+    return false;
+}
+
+/*
+ * Runs the 60Hz task and the RX side for everything due before time end, and a last RX update after that so a frame
+ * read by the last task run is picked up. Returns how many frames RX processing got.
+ */
+static int runUntil(uint32_t end, package_328p *rx, uint32_t *lastTaskAt, uint32_t *lastRxAt)
+{
+    int received = 0;
+
+    while (true) {
+        const uint32_t nextTask = *lastTaskAt + TASK_PERIOD_US;
+        const uint32_t nextRx = *lastRxAt + RX_PERIOD_US;
+        const uint32_t next = nextTask < nextRx ? nextTask : nextRx;
+        if (next >= end) {
+            break;
+        }
+        microsNow = next;
+        if (microsNow == nextTask) {
+            taskCoprocessor();
+            *lastTaskAt = microsNow;
+        }
+        if (microsNow == nextRx) {
+            received += rxUpdate(rx);
+            *lastRxAt = microsNow;
+        }
+    }
+    return received + rxUpdate(rx);
+}
+
+static void testFrames(void)
+{
+    const uint8_t data[4] = { 50, 60, 70, 80 };
+    package_328p rx = { .cmd = COPROCESSOR_CMD_NONE };
+    uint32_t lastTaskAt = 0, lastRxAt = 0;
+    const coprocessorStats_t *stats = coprocessorGetStats();
+
+    microsNow = 1000000;
+    lastTaskAt = lastRxAt = microsNow;
+
+    // Online: nothing is read from the 328p
+    mspData.mspCmd = ONLINE;
+    buildFrame(coprocessor.frame, MOTOR_P, 4, data);
+    runUntil(microsNow + 200000, &rx, &lastTaskAt, &lastRxAt);
+    check(coprocessor.reads == 0 && rx.cmd == COPROCESSOR_CMD_NONE, "328p read while online");
+
+    // Offline: every poll is a new frame, each is returned once
+    mspData.mspCmd = OFFLINE;
+    coprocessor.action = MOCK_SEND;
+    const uint32_t readsBefore = coprocessor.reads;
+    int received = runUntil(microsNow + 1000000, &rx, &lastTaskAt, &lastRxAt);
+    const uint32_t polls = coprocessor.reads - readsBefore;
+    check(received == (int)polls && stats->frames == polls, "frames not returned exactly once");
+    check(rx.cmd == MOTOR_P && rx.data[3] == 80, "last frame not kept between frames");
+    printf("\noffline 1s: %u polls, %d frames returned to %d RX updates\n", polls, received, 1000000 / RX_PERIOD_US);
+
+    // Corrupt frames and I2C errors keep the last good frame until it expires
+    const uint32_t goodUntil = lastTaskAt + COPROCESSOR_FRAME_TIMEOUT_US;
+    coprocessor.action = MOCK_CORRUPT;
+    received = runUntil(microsNow + COPROCESSOR_FRAME_TIMEOUT_US / 2, &rx, &lastTaskAt, &lastRxAt);
+    check(received == 0 && rx.cmd == MOTOR_P, "corrupt frame returned or the last good one dropped early");
+    coprocessor.action = MOCK_I2C_ERROR;
+    received = runUntil(goodUntil - 1, &rx, &lastTaskAt, &lastRxAt);
+    check(received == 0 && rx.cmd == MOTOR_P, "last good frame dropped before COPROCESSOR_FRAME_TIMEOUT_US");
+    runUntil(goodUntil + RX_PERIOD_US, &rx, &lastTaskAt, &lastRxAt);
+    check(rx.cmd == COPROCESSOR_CMD_NONE && rx.length == 0, "stale frame not expired");
+    check(stats->corrupt > 0 && stats->i2cErrors > 0, "corrupt frames or I2C errors not counted");
+    printf("stale frame expired %u us after it was read, %u corrupt, %u I2C errors\n",
+        COPROCESSOR_FRAME_TIMEOUT_US, stats->corrupt, stats->i2cErrors);
+
+    // Back to good frames, then offline mode ends while a frame is current
+    coprocessor.action = MOCK_SEND;
+    runUntil(microsNow + 100000, &rx, &lastTaskAt, &lastRxAt);
+    check(rx.cmd == MOTOR_P, "frames not picked up again after the errors");
+    mspData.mspCmd = ONLINE;
+    runUntil(lastTaskAt + TASK_PERIOD_US + 1, &rx, &lastTaskAt, &lastRxAt);
+    check(rx.cmd == COPROCESSOR_CMD_NONE, "frame still returned after offline mode ended");
+
+    // Keys go to the 328p only while it has nothing to send
+    mspData.mspCmd = OFFLINE;
+    t_mspData.key = 7;
+    coprocessor.keysWritten = 0;
+    runUntil(microsNow + 100000, &rx, &lastTaskAt, &lastRxAt);
+    check(coprocessor.keysWritten == 0, "key written while the 328p was busy");
+    buildFrame(coprocessor.frame, COPROCESSOR_CMD_NONE, 0, data);
+    runUntil(microsNow + 100000, &rx, &lastTaskAt, &lastRxAt);
+    check(coprocessor.keysWritten > 0 && coprocessor.lastKey == 7, "key not handed to the idle 328p");
+    t_mspData.key = 0;
+
+    // Many frames, so the frame sequence wraps, each still returned exactly once
+    buildFrame(coprocessor.frame, ARM_P, 0, data);
+    const uint32_t framesBefore = stats->frames;
+    received = 0;
+    for (int i = 0; i < SEQUENCE_FRAMES; i++) {
+        microsNow += TASK_PERIOD_US;
+        taskCoprocessor();
+        received += coprocessorGetFrame(&rx);
+        received += coprocessorGetFrame(&rx);
+    }
+    check(received == SEQUENCE_FRAMES && stats->frames - framesBefore == SEQUENCE_FRAMES,
+        "frames lost or repeated across the sequence wrap");
+    printf("%d frames across the sequence wrap, %d returned\n", SEQUENCE_FRAMES, received);
+}
+
+int main(void)
+{
+    srand(1);
+
+    testDecode();
+    testFrames();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host simulation of a dataflash download over MSP, to compare MSP_DATAFLASH_READ (128 bytes per request) with
+ * MSP_DATAFLASH_STREAM, raw and LZ4 encoded, on a UART and on the USB VCP.
+ *
+ * The flight controller side follows msp_serial.c / msp_server_fc.c: commands and the stream are only serviced when
+ * the 100Hz serial task runs, streaming stops after MSP_STREAM_TIME_BUDGET_US, UART frames are sized to the free TX
+ * buffer space and VCP writes block until the data is handed to the USB peripheral 32 bytes at a time. Chunks are
+ * compressed with the firmware's own lz4CompressBlock().
+ *
+ * The downloaded data is synthetic blackbox output (a text header, then I and P frames of variable byte encoded
+ * fields), so the LZ4 ratio is only indicative. Timing constants that aren't taken from the firmware are listed in
+ * linkConfig_t and can be changed on the command line.
+ *
+ * usage: dataflash_link_sim [size_kb] [host_turnaround_us] [lz4_cycles_per_byte] [vcp_packet_us]
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/lz4.h"
+
+// From the firmware
+#define SERIAL_TASK_PERIOD_US 10000     // TASK_SERIAL
+#define MSP_STREAM_TIME_BUDGET_US 1000
+#define MSP_JUMBO_FRAME_SIZE_LIMIT 255
+#define MSP_FRAME_OVERHEAD 6            // $ M > len cmd ... checksum
+#define MSP_JUMBO_FRAME_OVERHEAD 8
+#define UART_TX_BUFFER_SIZE 256
+#define VCP_PACKET_SIZE 32              // CDC_Send_DATA() only loads half of the 64 byte endpoint buffer
+#define DATAFLASH_READ_SIZE 128
+#define DATAFLASH_STREAM_CHUNK_SIZE 512
+#define DATAFLASH_STREAM_HEADER_SIZE 7
+#define DATAFLASH_STREAM_MIN_CHUNK_SIZE 64
+#define DATAFLASH_STREAM_DEFAULT_WINDOW 4096
+
+#define HOST_ACK_EVERY 1024             // host acknowledges the stream after this many bytes
+#define MAX_FRAMES_IN_FLIGHT 256
+
+typedef enum {
+    LINK_UART,
+    LINK_VCP,
+} linkType_e;
+
+typedef enum {
+    METHOD_READ,
+    METHOD_STREAM_RAW,
+    METHOD_STREAM_LZ4,
+} method_e;
+
+typedef struct linkConfig_s {
+    double uartByteUs;          // 115200 8N1
+    double vcpPacketUs;         // time to get one 32 byte IN packet out, USB full speed with one packet in flight
+    double vcpOutLatencyUs;     // host to FC commands wait for the next USB frame
+    double hostTurnaroundUs;    // host application reacting to a complete frame
+    double flashByteUs;         // m25p16 read at an 18MHz SPI clock
+    double flashCommandUs;
+    double commandUs;           // MSP parsing and dispatch per command
+    double lz4CyclesPerByte;    // on a 72MHz Cortex-M4
+} linkConfig_t;
+
+static linkConfig_t config = {
+    .uartByteUs = 1000000.0 / 11520,
+    .vcpPacketUs = 50,
+    .vcpOutLatencyUs = 1000,
+    .hostTurnaroundUs = 1000,
+    .flashByteUs = 8.0 / 18,
+    .flashCommandUs = 5,
+    .commandUs = 30,
+    .lz4CyclesPerByte = 40,
+};
+
+static uint8_t *flashData;
+static uint32_t flashSize;
+
+/*
+ * Synthetic blackbox log: I-frame every 32 frames, P-frames hold small deltas. Field values follow random walks of
+ * roughly the size seen on a hovering quad.
+ */
+#define LOG_FIELD_COUNT 28
+
+static uint32_t rngState = 1;
+
+static uint32_t rng(void)
+{
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+static int gaussish(int spread)
+{
+    // sum of uniforms, close enough to a normal distribution for this purpose
+    int sum = 0;
+    for (int i = 0; i < 4; i++) {
+        sum += (int)(rng() % (2 * spread + 1)) - spread;
+    }
+    return sum / 2;
+}
+
+static uint8_t *writeUnsignedVB(uint8_t *p, uint32_t value)
+{
+    while (value > 127) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static uint8_t *writeSignedVB(uint8_t *p, int32_t value)
+{
+    return writeUnsignedVB(p, (uint32_t)((value << 1) ^ (value >> 31)));
+}
+
+static void generateLog(uint8_t *dst, uint32_t size)
+{
+    // most fields barely move between consecutive frames, so their deltas are mostly zero
+    static const int spread[LOG_FIELD_COUNT] = {
+        0, 1,                   // loopIteration, time (predicted, jitter only)
+        3, 3, 2, 1, 1, 1, 2, 2, // axisP/I/D
+        0, 0, 1, 0,             // rcCommand
+        4, 4, 2,                // gyro
+        6, 6, 6,                // acc
+        2, 2, 2, 2,             // motors
+        0, 0, 0, 0,             // vbat, amperage, baro, rssi
+    };
+    int32_t value[LOG_FIELD_COUNT];
+    uint8_t *p = dst;
+    uint8_t *end = dst + size;
+    uint32_t frame = 0;
+
+    for (int i = 0; i < LOG_FIELD_COUNT; i++) {
+        value[i] = 1000 + (int)(rng() % 500);
+    }
+
+    for (int line = 0; line < 60 && p + 64 < end; line++) {
+        p += sprintf((char *)p, "H Field I name:loopIteration,time,axisP[0],axisP[1],axisP[2],field%d\n", line);
+    }
+
+    while (p + 4 * LOG_FIELD_COUNT + 1 < end) {
+        if (frame % 32 == 0) {
+            *p++ = 'I';
+            for (int i = 0; i < LOG_FIELD_COUNT; i++) {
+                p = writeUnsignedVB(p, value[i]);
+            }
+        } else {
+            *p++ = 'P';
+            for (int i = 0; i < LOG_FIELD_COUNT; i++) {
+                const int delta = gaussish(spread[i]);
+                value[i] += delta;
+                p = writeSignedVB(p, delta);
+            }
+        }
+        value[0]++;
+        frame++;
+    }
+    memset(p, 0xFF, end - p);
+}
+
+/*
+ * Link model. Frames leave the FC in order; a frame is complete at the host once its last byte is through.
+ */
+typedef struct frame_s {
+    double completeAt;
+    uint32_t dataBytes;         // raw dataflash bytes it carries
+    bool end;
+} frame_t;
+
+static frame_t frames[MAX_FRAMES_IN_FLIGHT];
+static int frameHead, frameCount;
+
+static double uartLineFreeAt;   // when the UART will have sent everything queued so far
+
+static linkType_e linkType;
+static method_e method;
+
+static double now;              // FC time during a task run
+static double wireBytes;
+
+static int frameWireSize(int payloadSize)
+{
+    return payloadSize + (payloadSize >= MSP_JUMBO_FRAME_SIZE_LIMIT ? MSP_JUMBO_FRAME_OVERHEAD : MSP_FRAME_OVERHEAD);
+}
+
+static uint32_t uartTxBytesFree(void)
+{
+    // bytes still in the ring buffer at time `now`
+    const double queued = uartLineFreeAt > now ? (uartLineFreeAt - now) / config.uartByteUs : 0;
+    const int used = (int)(queued + 0.999);
+    return UART_TX_BUFFER_SIZE - 1 - (used > UART_TX_BUFFER_SIZE - 1 ? UART_TX_BUFFER_SIZE - 1 : used);
+}
+
+static void fcSendFrame(int payloadSize, uint32_t dataBytes, bool end)
+{
+    const int size = frameWireSize(payloadSize);
+    frame_t *frame = &frames[(frameHead + frameCount++) % MAX_FRAMES_IN_FLIGHT];
+
+    wireBytes += size;
+
+    if (linkType == LINK_UART) {
+        const double startAt = uartLineFreeAt > now ? uartLineFreeAt : now;
+        uartLineFreeAt = startAt + size * config.uartByteUs;
+        now += size * 0.1;      // copying into the ring buffer
+        frame->completeAt = uartLineFreeAt;
+    } else {
+        // usbVcpWriteBuf() spins until every packet has been taken
+        now += ((size + VCP_PACKET_SIZE - 1) / VCP_PACKET_SIZE) * config.vcpPacketUs;
+        frame->completeAt = now;
+    }
+    frame->dataBytes = dataBytes;
+    frame->end = end;
+}
+
+// FC state
+static uint32_t streamAddress, streamEnd, streamAcked;
+static bool streamActive;
+static uint32_t readRequestAddress;
+static bool readRequestPending;
+static uint16_t lz4HashTable[LZ4_HASH_TABLE_SIZE];
+static uint64_t lz4RawBytes, lz4PayloadBytes;
+
+static int flashRead(uint32_t address, uint8_t *buffer, uint32_t size)
+{
+    if (address >= flashSize) {
+        return 0;
+    }
+    if (size > flashSize - address) {
+        size = flashSize - address;
+    }
+    memcpy(buffer, flashData + address, size);
+    now += config.flashCommandUs + size * config.flashByteUs;
+    return size;
+}
+
+static bool fcStreamNext(void)
+{
+    uint8_t chunk[DATAFLASH_STREAM_CHUNK_SIZE];
+    uint8_t payload[DATAFLASH_STREAM_CHUNK_SIZE];
+
+    const int maxLength = linkType == LINK_VCP ? UINT16_MAX : (int)uartTxBytesFree() - MSP_JUMBO_FRAME_OVERHEAD;
+    const uint32_t unacked = streamAddress - streamAcked;
+
+    if (maxLength < DATAFLASH_STREAM_HEADER_SIZE + DATAFLASH_STREAM_MIN_CHUNK_SIZE || unacked >= DATAFLASH_STREAM_DEFAULT_WINDOW) {
+        return false;
+    }
+
+    uint32_t size = DATAFLASH_STREAM_CHUNK_SIZE;
+    if (size > (uint32_t)maxLength - DATAFLASH_STREAM_HEADER_SIZE) {
+        size = maxLength - DATAFLASH_STREAM_HEADER_SIZE;
+    }
+    if (size > DATAFLASH_STREAM_DEFAULT_WINDOW - unacked) {
+        size = DATAFLASH_STREAM_DEFAULT_WINDOW - unacked;
+    }
+    if (size > streamEnd - streamAddress) {
+        size = streamEnd - streamAddress;
+    }
+
+    const int bytesRead = size > 0 ? flashRead(streamAddress, chunk, size) : 0;
+    int payloadSize = bytesRead;
+
+    if (bytesRead > 0 && method == METHOD_STREAM_LZ4) {
+        now += bytesRead * config.lz4CyclesPerByte / 72.0;
+        const int compressed = lz4CompressBlock(chunk, bytesRead, payload, bytesRead - 1, lz4HashTable);
+        if (compressed > 0) {
+            payloadSize = compressed;
+        }
+        lz4RawBytes += bytesRead;
+        lz4PayloadBytes += payloadSize;
+    }
+
+    fcSendFrame(DATAFLASH_STREAM_HEADER_SIZE + payloadSize, bytesRead, bytesRead <= 0);
+
+    if (bytesRead <= 0) {
+        streamActive = false;
+    }
+    streamAddress += bytesRead;
+
+    return streamActive;
+}
+
+// Host to FC commands in flight
+typedef struct command_s {
+    double arriveAt;
+    bool ack;
+    uint32_t address;
+} command_t;
+
+static command_t commands[MAX_FRAMES_IN_FLIGHT];
+static int commandHead, commandCount;
+static double hostLineFreeAt;
+
+static void hostSendCommand(double at, int payloadSize, bool ack, uint32_t address)
+{
+    double arriveAt;
+
+    if (linkType == LINK_UART) {
+        const double startAt = hostLineFreeAt > at ? hostLineFreeAt : at;
+        arriveAt = hostLineFreeAt = startAt + frameWireSize(payloadSize) * config.uartByteUs;
+    } else {
+        arriveAt = at + config.vcpOutLatencyUs;
+    }
+
+    command_t *command = &commands[(commandHead + commandCount++) % MAX_FRAMES_IN_FLIGHT];
+    command->arriveAt = arriveAt;
+    command->ack = ack;
+    command->address = address;
+}
+
+static void fcTaskRun(double startedAt)
+{
+    now = startedAt;
+
+    // commands which have arrived by now
+    while (commandCount > 0 && commands[commandHead].arriveAt <= now) {
+        const command_t *command = &commands[commandHead];
+        commandHead = (commandHead + 1) % MAX_FRAMES_IN_FLIGHT;
+        commandCount--;
+
+        now += config.commandUs;
+        if (command->ack) {
+            if (command->address > streamAcked && command->address <= streamAddress) {
+                streamAcked = command->address;
+            }
+        } else {
+            readRequestAddress = command->address;
+            readRequestPending = true;
+        }
+    }
+
+    if (readRequestPending) {
+        uint8_t buffer[DATAFLASH_READ_SIZE];
+        const int bytesRead = flashRead(readRequestAddress, buffer, DATAFLASH_READ_SIZE);
+        fcSendFrame(4 + bytesRead, bytesRead, bytesRead <= 0);
+        readRequestPending = false;
+    }
+
+    if (streamActive) {
+        const double streamStartedAt = now;
+        while (fcStreamNext() && now - streamStartedAt < MSP_STREAM_TIME_BUDGET_US) {
+        }
+    }
+}
+
+static double simulate(linkType_e link, method_e how)
+{
+    linkType = link;
+    method = how;
+    frameHead = frameCount = 0;
+    commandHead = commandCount = 0;
+    uartLineFreeAt = hostLineFreeAt = 0;
+    wireBytes = 0;
+    lz4RawBytes = lz4PayloadBytes = 0;
+    readRequestPending = false;
+    streamActive = false;
+
+    uint32_t received = 0, acked = 0;
+    bool done = false;
+    double taskAt = 0, finishedAt = 0;
+
+    if (how == METHOD_READ) {
+        hostSendCommand(0, 4, false, 0);
+    } else {
+        // the MSP_DATAFLASH_STREAM request and its reply are a single round trip, counted here as a read request
+        hostSendCommand(0, 11, false, 0);
+        streamAddress = streamAcked = 0;
+        streamEnd = flashSize;
+    }
+
+    while (!done) {
+        const bool hadRequest = commandCount > 0 && commands[commandHead].arriveAt <= taskAt && !commands[commandHead].ack;
+
+        if (how != METHOD_READ && hadRequest) {
+            // start the stream instead of answering a read
+            commandHead = (commandHead + 1) % MAX_FRAMES_IN_FLIGHT;
+            commandCount--;
+            now = taskAt + config.commandUs;
+            fcSendFrame(13, 0, false);
+            streamActive = true;
+            fcTaskRun(now);
+        } else {
+            fcTaskRun(taskAt);
+        }
+
+        // host side, everything which completed before the next task run
+        const double nextTaskAt = taskAt + SERIAL_TASK_PERIOD_US;
+        while (frameCount > 0 && frames[frameHead].completeAt < nextTaskAt) {
+            const frame_t *frame = &frames[frameHead];
+            frameHead = (frameHead + 1) % MAX_FRAMES_IN_FLIGHT;
+            frameCount--;
+
+            received += frame->dataBytes;
+            const double reactAt = frame->completeAt + config.hostTurnaroundUs;
+
+            if (frame->end || received >= flashSize) {
+                if (received >= flashSize) {
+                    done = true;
+                    finishedAt = frame->completeAt;
+                }
+                continue;
+            }
+
+            if (how == METHOD_READ) {
+                hostSendCommand(reactAt, 4, false, received);
+            } else if (received - acked >= HOST_ACK_EVERY) {
+                acked = received;
+                hostSendCommand(reactAt, 4, true, acked);
+            }
+        }
+        taskAt = nextTaskAt;
+    }
+
+    return finishedAt;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t sizeKB = argc > 1 ? atoi(argv[1]) : 512;
+    if (argc > 2) {
+        config.hostTurnaroundUs = atof(argv[2]);
+    }
+    if (argc > 3) {
+        config.lz4CyclesPerByte = atof(argv[3]);
+    }
+    if (argc > 4) {
+        config.vcpPacketUs = atof(argv[4]);
+    }
+
+    flashSize = sizeKB * 1024;
+    flashData = malloc(flashSize);
+    generateLog(flashData, flashSize);
+
+    static const char *linkNames[] = { "UART 115200", "USB VCP" };
+    static const char *methodNames[] = { "READ 128B", "STREAM raw", "STREAM LZ4" };
+
+    printf("%u KB, host turnaround %.0f us, LZ4 %.0f cycles/byte, VCP %.0f us/packet\n",
+        sizeKB, config.hostTurnaroundUs, config.lz4CyclesPerByte, config.vcpPacketUs);
+
+    for (int link = LINK_UART; link <= LINK_VCP; link++) {
+        double readTime = 0;
+        for (int how = METHOD_READ; how <= METHOD_STREAM_LZ4; how++) {
+            const double time = simulate(link, how);
+            if (how == METHOD_READ) {
+                readTime = time;
+            }
+            printf("%-12s %-11s %8.1f s %8.1f KB/s %6.2fx  wire %5.1f%%",
+                linkNames[link], methodNames[how], time / 1e6, flashSize / 1024.0 / (time / 1e6), readTime / time,
+                100.0 * wireBytes / flashSize);
+            if (how == METHOD_STREAM_LZ4) {
+                printf("  lz4 ratio %.2f", (double)lz4PayloadBytes / lz4RawBytes);
+            }
+            printf("\n");
+        }
+    }
+
+    free(flashData);
+    return 0;
+}
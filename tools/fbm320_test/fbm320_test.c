@@ -0,0 +1,359 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of fbm320.c against a mocked FBM320 behind i2cRead()/i2cWrite().
+ *
+ * Coefficients: random C0~C12 packed into the R0~R9 registers the way read_offset() unpacks them must come back
+ * unchanged from fbm320_init().
+ *
+ * Compensation: with all trim coefficients 0 the constants of calculate_real_pressure() put 25.00 C at UT = 0x800000
+ * and 99880 Pa at UP = 0x800000 + (120586 << 4), at 81.255 / 8192 Pa per count. Then random coefficients over the
+ * -40..85 C and 30..110 kPa range must give the same result as the formula evaluated in 64 bit, so no intermediate
+ * overflows int32_t, and pressure must rise with UP.
+ *
+ * Time stamp: taskFbm320() runs at the periods it asks for while the mock sensor climbs at a constant rate.
+ * FB.Altitude goes through a median, a moving average and a low pass, so it is compared against the true altitude at
+ * FB.sampledAt and at the time of the read.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+
+#include "drivers/bus_i2c.h"
+#include "drivers/system.h"
+#include "drivers/fbm320.h"
+
+#define RANDOM_COEFFICIENTS 2000
+#define SWEEP_STEPS 64
+#define REFERENCE_PRESSURE 101325.0
+#define CLIMB_RATE 200.0            // cm/s
+#define CLIMB_START_US 3000000
+#define CLIMB_END_US 8000000
+#define SETTLE_US 500000
+
+typedef struct {
+    uint32_t C0, C1, C2, C3, C4, C5, C6, C7, C8, C9, C10, C11, C12;
+} coefficients_t;
+
+// The mocked sensor
+static struct {
+    uint16_t R[10];
+    uint8_t command;
+    uint32_t convertedAt;
+    uint32_t UT;
+    double altitude;            // cm, what the sensor sees while converting
+    uint32_t pressureReads;
+} sensor;
+
+static uint32_t microsNow;
+static uint32_t taskPeriod;
+static int failures;
+
+void taskFbm320(void);
+
+uint32_t micros(void)
+{
+    return microsNow;
+}
+
+void delay(uint32_t ms)
+{
+    microsNow += ms * 1000;
+}
+
+void rescheduleTask(int taskId, uint32_t newPeriodMicros)
+{
+    (void)taskId;
+    taskPeriod = newPeriodMicros;
+}
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+// calculate_real_pressure() in 64 bit, same shifts, nothing can overflow
+static void referencePressure(const coefficients_t *c, int64_t UP, int64_t UT, int64_t *RP, int64_t *RT)
+{
+    int64_t DT, DT2, X01, X02, X03, X11, X12, X13, X21, X22, X23, X24, X25, X26, X31, X32, CF, PP1, PP2, PP3, PP4;
+
+    DT = ((UT - 8388608) >> 4) + ((int64_t)c->C0 << 4);
+    X01 = ((int64_t)c->C1 + 4459) * DT >> 1;
+    X02 = (((((int64_t)c->C2 - 256) * DT) >> 14) * DT) >> 4;
+    X03 = (((((c->C3 * DT) >> 18) * DT) >> 18) * DT);
+    *RT = ((2500 << 15) - X01 - X02 - X03) >> 15;
+
+    DT2 = (X01 + X02 + X03) >> 12;
+    X11 = (((int64_t)c->C5 - 4443) * DT2);
+    X12 = (((c->C6 * DT2) >> 16) * DT2) >> 2;
+    X13 = ((X11 + X12) >> 10) + (((int64_t)c->C4 + 120586) << 4);
+
+    X21 = (((int64_t)c->C8 + 7180) * DT2) >> 10;
+    X22 = (((c->C9 * DT2) >> 17) * DT2) >> 12;
+    X23 = (X22 >= X21) ? (X22 - X21) : (X21 - X22);
+
+    X24 = (X23 >> 11) * ((int64_t)c->C7 + 166426);
+    X25 = ((X23 & 0x7FF) * ((int64_t)c->C7 + 166426)) >> 11;
+    X26 = (X21 >= X22) ? (((0 - X24 - X25) >> 11) + c->C7 + 166426) : (((X24 + X25) >> 11) + c->C7 + 166426);
+
+    PP1 = ((UP - 8388608) - X13) >> 3;
+    PP2 = (X26 >> 11) * PP1;
+    PP3 = ((X26 & 0x7FF) * PP1) >> 11;
+    PP4 = (PP2 + PP3) >> 10;
+
+    CF = (2097152 + c->C12 * DT2) >> 3;
+    X31 = (((CF * c->C10) >> 17) * PP4) >> 2;
+    X32 = (((((CF * c->C11) >> 15) * PP4) >> 18) * PP4);
+    *RP = ((X31 + X32) >> 15) + PP4 + 99880;
+}
+
+static void setCoefficients(const coefficients_t *c)
+{
+    FB.C0 = c->C0; FB.C1 = c->C1; FB.C2 = c->C2; FB.C3 = c->C3; FB.C4 = c->C4; FB.C5 = c->C5; FB.C6 = c->C6;
+    FB.C7 = c->C7; FB.C8 = c->C8; FB.C9 = c->C9; FB.C10 = c->C10; FB.C11 = c->C11; FB.C12 = c->C12;
+}
+
+static coefficients_t randomCoefficients(void)
+{
+    return (coefficients_t){
+        rand() & 0xfff, rand() & 0x7ff, rand() & 0x1ff, rand() & 0x1fff, rand() & 0x3ffff, rand() & 0x7fff, rand() & 0x1fff,
+        rand() & 0x7ffff, rand() & 0x1fff, rand() & 0x3fff, rand() & 0x3ff, rand() & 0xff, rand() & 0x1f,
+    };
+}
+
+// The inverse of the unpacking in read_offset(), written from the register layout
+static void packRegisters(const coefficients_t *c)
+{
+    uint16_t *R = sensor.R;
+    R[0] = (c->C0 << 4) | (((c->C12 >> 3) & 3) << 2) | (c->C4 & 3);
+    R[1] = ((c->C1 >> 3) << 8) | (c->C2 >> 1);
+    R[2] = (c->C3 << 3) | (c->C1 & 7);
+    R[3] = c->C4 >> 2;
+    R[4] = (c->C5 << 1) | (c->C2 & 1);
+    R[5] = (c->C6 << 3) | (c->C7 & 7);
+    R[6] = c->C7 >> 3;
+    R[7] = (c->C8 << 3) | (c->C12 & 7);
+    R[8] = (c->C9 << 2) | (c->C10 & 3);
+    R[9] = ((c->C10 >> 2) << 8) | c->C11;
+}
+
+// Raw pressure count that compensates to the pressure at the sensor's altitude, the formula rises with UP
+static uint32_t rawPressure(double pressure)
+{
+    uint32_t low = 0, high = 0xffffff;
+    while (low < high) {
+        const uint32_t mid = (low + high) / 2;
+        calculate_real_pressure(mid, sensor.UT);
+        if (FB.RP < pressure) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static double pressureAt(double altitude)
+{
+    return REFERENCE_PRESSURE * pow(1.0 - altitude / 4433000.0, 1.0 / 0.190295);
+}
+
+static double altitudeAt(uint32_t time)
+{
+    if (time < CLIMB_START_US) {
+        return 0;
+    }
+    if (time > CLIMB_END_US) {
+        time = CLIMB_END_US;
+    }
+    return (time - CLIMB_START_US) * 1e-6 * CLIMB_RATE;
+}
+
+bool i2cWrite(uint8_t addr_, uint8_t reg, uint8_t data)
+{
+    check(addr_ == (FMTISensorAdd_I2C) && reg == FBM320_REG_CONFIG, "unexpected register written");
+    sensor.command = data;
+    sensor.convertedAt = microsNow;
+    return true;
+}
+
+bool i2cRead(uint8_t addr_, uint8_t reg, uint8_t len, uint8_t *buf)
+{
+    check(addr_ == (FMTISensorAdd_I2C), "unexpected address read");
+    if (reg == 0x6b) {
+        buf[0] = 0x42;
+    } else if (reg == 0xaa) {
+        check(len == 18, "R0~R8 not read in one burst");
+        for (int i = 0; i < 9; i++) {
+            buf[i * 2] = sensor.R[i] >> 8;
+            buf[i * 2 + 1] = sensor.R[i];
+        }
+    } else if (reg == 0xa4) {
+        buf[0] = sensor.R[9] >> 8;
+    } else if (reg == 0xf1) {
+        buf[0] = sensor.R[9];
+    } else if (reg == FBM320_REG_DATA_MSB) {
+        check(len == 3, "result not read in one burst");
+        const bool temperature = sensor.command == FBM320_CMD_TEMPERATURE;
+        const uint32_t conversion = temperature ? FBM320_TEMPERATURE_CONVERSION_US : FBM320_PRESSURE_CONVERSION_US;
+        check(microsNow - sensor.convertedAt >= conversion, "result read before the conversion finished");
+        uint32_t value = sensor.UT;
+        if (!temperature) {
+            // the conversion averages over its whole time, it sees the altitude in the middle of it
+            value = rawPressure(pressureAt(altitudeAt(sensor.convertedAt + conversion / 2)));
+            sensor.pressureReads++;
+        }
+        buf[0] = value >> 16;
+        buf[1] = value >> 8;
+        buf[2] = value;
+    } else {
+        check(false, "unexpected register read");
+    }
+    return true;
+}
+
+static void testCoefficients(void)
+{
+    int mismatches = 0;
+    for (int i = 0; i < RANDOM_COEFFICIENTS; i++) {
+        const coefficients_t c = randomCoefficients();
+        packRegisters(&c);
+        sensor.UT = 0x800000;
+        check(fbm320_init(), "sensor not detected");
+        mismatches += FB.C0 != c.C0 || FB.C1 != c.C1 || FB.C2 != c.C2 || FB.C3 != c.C3 || FB.C4 != c.C4
+            || FB.C5 != c.C5 || FB.C6 != c.C6 || FB.C7 != c.C7 || FB.C8 != c.C8 || FB.C9 != c.C9
+            || FB.C10 != c.C10 || FB.C11 != c.C11 || FB.C12 != c.C12;
+    }
+    printf("coefficients: %d random sets through R0~R9, %d unpacked wrong\n", RANDOM_COEFFICIENTS, mismatches);
+    check(mismatches == 0, "read_offset() does not unpack C0~C12 from R0~R9");
+}
+
+static void testCompensation(void)
+{
+    const coefficients_t nominal = { 0 };
+    setCoefficients(&nominal);
+    calculate_real_pressure(0x800000 + (120586 << 4), 0x800000);
+    printf("nominal: %d.%02d C and %d Pa at the centre of the formula\n", FB.RT / 100, FB.RT % 100, FB.RP);
+    check(FB.RT == 2500 && FB.RP == 99880, "formula not centred on 25.00 C and 99880 Pa");
+    calculate_real_pressure(0x800000 + (120586 << 4) + 100000, 0x800000);
+    check(abs(FB.RP - (99880 + 100000 * 81.255 / 8192)) <= 1, "nominal pressure sensitivity off");
+
+    // Random trims over the operating range against the 64 bit formula
+    int points = 0, overflows = 0, notMonotonic = 0;
+    int32_t minRT = INT32_MAX, maxRT = INT32_MIN;
+    for (int i = 0; i < RANDOM_COEFFICIENTS; i++) {
+        const coefficients_t c = randomCoefficients();
+        setCoefficients(&c);
+
+        for (int t = 0; t <= SWEEP_STEPS; t++) {
+            // the raw temperatures that compensate to -40..85 C, found on the 64 bit formula
+            const int32_t UT = 0x200000 + 0xc00000 * t / SWEEP_STEPS;
+            int64_t RP, RT;
+            referencePressure(&c, 0x800000, UT, &RP, &RT);
+            if (RT < -4000 || RT > 8500) {
+                continue;
+            }
+            int32_t previousRP = INT32_MIN;
+            for (int p = 0; p <= SWEEP_STEPS; p++) {
+                // 30..110 kPa is within +-8000000 counts of the centre at roughly 0.01 Pa per count
+                const int32_t UP = 0x800000 + (120586 << 4) - 8000000 + 16000000 / SWEEP_STEPS * p;
+                calculate_real_pressure(UP, UT);
+                referencePressure(&c, UP, UT, &RP, &RT);
+                if (RP < 30000 || RP > 110000) {
+                    continue;
+                }
+                points++;
+                overflows += FB.RP != RP || FB.RT != RT;
+                notMonotonic += FB.RP < previousRP;
+                previousRP = FB.RP;
+            }
+            minRT = MIN(minRT, FB.RT);
+            maxRT = MAX(maxRT, FB.RT);
+        }
+    }
+    printf("compensation: %d points, %.2f..%.2f C, %d differ from 64 bit, %d not monotonic\n",
+        points, minRT / 100.0, maxRT / 100.0, overflows, notMonotonic);
+    check(overflows == 0, "calculate_real_pressure() overflows int32_t in the operating range");
+    check(notMonotonic == 0, "pressure does not rise with the raw value");
+}
+
+static void testTimestamp(void)
+{
+    const coefficients_t nominal = { 0 };
+    packRegisters(&nominal);
+    sensor.UT = 0x800000;
+    microsNow = 0;
+    fbm320_init();
+    taskPeriod = 1000000 / 50;      // TASK_FBM320 until its first run reschedules it
+
+    double errorAtStamp = 0, errorAtRead = 0, maxErrorAtStamp = 0;
+    int samples = 0;
+    uint32_t lastReads = 0;
+    while (microsNow < CLIMB_END_US) {
+        microsNow += taskPeriod;
+        taskFbm320();
+        if (sensor.pressureReads == lastReads) {
+            continue;
+        }
+        lastReads = sensor.pressureReads;
+        if (microsNow < CLIMB_START_US + SETTLE_US) {
+            continue;
+        }
+        const double stamped = fabs(FB.Altitude - altitudeAt(FB.sampledAt));
+        errorAtStamp += stamped;
+        maxErrorAtStamp = fmax(maxErrorAtStamp, stamped);
+        errorAtRead += fabs(FB.Altitude - altitudeAt(microsNow));
+        samples++;
+    }
+    errorAtStamp /= samples;
+    errorAtRead /= samples;
+    printf("time stamp: climbing at %.0f cm/s, FB.Altitude is %.1f cm (max %.1f) off the altitude at FB.sampledAt"
+        " and %.1f cm off the altitude at the read, %.0f ms behind it\n",
+        CLIMB_RATE, errorAtStamp, maxErrorAtStamp, errorAtRead, errorAtRead / CLIMB_RATE * 1000);
+    check(errorAtStamp < 6.0, "FB.sampledAt does not account for the filter delay");
+    check(errorAtRead > 20.0, "climb too slow to show the filter delay");
+}
+
+int main(void)
+{
+    srand(1);
+
+    testCoefficients();
+    testCompensation();
+    testTimestamp();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "drivers/flash_m25p16.h"
+#include "drivers/system.h"
+
+#include "flash_sim.h"
+
+static uint8_t flashSimImage[FLASH_SIM_SIZE];
+
+uint8_t *flashSimMemory = flashSimImage;
+uint64_t flashSimMicros;
+flashSimStats_t flashSimStats;
+
+uint64_t flashSimPowerCutAt;
+void (*flashSimPowerCutHandler)(void);
+void (*flashSimEraseHook)(uint32_t address);
+
+static uint64_t busyUntil;
+static uint32_t programAddress;
+static uint32_t programLength;
+
+// The operation the chip is busy with, and what it's overwriting in case the power is cut
+static flashSimOperation_e operation;
+static uint64_t operationStartedAt;
+static uint32_t operationAddress, operationLength;
+static uint8_t operationBefore[FLASH_SIM_SECTOR_SIZE];
+
+static flashGeometry_t geometry = {
+    .sectors = FLASH_SIM_SIZE / FLASH_SIM_SECTOR_SIZE,
+    .pagesPerSector = FLASH_SIM_SECTOR_SIZE / FLASH_SIM_PAGE_SIZE,
+    .pageSize = FLASH_SIM_PAGE_SIZE,
+    .sectorSize = FLASH_SIM_SECTOR_SIZE,
+    .totalSize = FLASH_SIM_SIZE,
+};
+
+// A blank chip at time zero
+void flashSimReset(void)
+{
+    memset(flashSimMemory, 0xFF, FLASH_SIM_SIZE);
+    memset(&flashSimStats, 0, sizeof(flashSimStats));
+    flashSimMicros = 0;
+    busyUntil = 0;
+    operation = FLASH_SIM_IDLE;
+}
+
+bool flashSimIsBusy(void)
+{
+    return flashSimMicros < busyUntil;
+}
+
+flashSimOperation_e flashSimGetOperation(void)
+{
+    return flashSimIsBusy() ? operation : FLASH_SIM_IDLE;
+}
+
+static void flashSimCutPower(void)
+{
+    flashSimMicros = flashSimPowerCutAt;
+
+    if (flashSimGetOperation() == FLASH_SIM_PROGRAMMING) {
+        // Bytes go in in order, the ones the program didn't get to keep what they held
+        const uint32_t page = operationAddress & ~(FLASH_SIM_PAGE_SIZE - 1);
+        const uint32_t done = operationLength * (flashSimMicros - operationStartedAt) / (busyUntil - operationStartedAt);
+
+        for (uint32_t i = done; i < operationLength && i < FLASH_SIM_PAGE_SIZE; i++) {
+            const uint32_t address = page | ((operationAddress + i) & (FLASH_SIM_PAGE_SIZE - 1));
+            flashSimMemory[address] = operationBefore[address - page];
+        }
+    } else if (flashSimGetOperation() == FLASH_SIM_ERASING) {
+        for (uint32_t i = 0; i < FLASH_SIM_SECTOR_SIZE; i++) {
+            flashSimMemory[operationAddress + i] = operationBefore[i] | rand();
+        }
+    }
+
+    flashSimPowerCutHandler();
+}
+
+static void flashSimCheckPowerCut(void)
+{
+    if (flashSimPowerCutAt && flashSimMicros >= flashSimPowerCutAt) {
+        flashSimCutPower();
+    }
+}
+
+void flashSimAdvance(uint32_t us)
+{
+    flashSimMicros += us;
+    flashSimCheckPowerCut();
+}
+
+uint32_t micros(void)
+{
+    return flashSimMicros;
+}
+
+uint32_t millis(void)
+{
+    return flashSimMicros / 1000;
+}
+
+bool m25p16_isReady()
+{
+    return !flashSimIsBusy();
+}
+
+bool m25p16_waitForReady(uint32_t timeoutMillis)
+{
+    (void)timeoutMillis;
+    if (flashSimIsBusy()) {
+        flashSimMicros = busyUntil;
+        flashSimCheckPowerCut();
+    }
+    return true;
+}
+
+void m25p16_eraseSector(uint32_t address)
+{
+    m25p16_waitForReady(0);
+    if (flashSimEraseHook) {
+        flashSimEraseHook(address);
+    }
+
+    operation = FLASH_SIM_ERASING;
+    operationStartedAt = flashSimMicros;
+    operationAddress = address / FLASH_SIM_SECTOR_SIZE * FLASH_SIM_SECTOR_SIZE;
+    memcpy(operationBefore, flashSimMemory + operationAddress, FLASH_SIM_SECTOR_SIZE);
+
+    memset(flashSimMemory + operationAddress, 0xFF, FLASH_SIM_SECTOR_SIZE);
+    busyUntil = flashSimMicros + FLASH_SIM_SECTOR_ERASE_US;
+    flashSimStats.sectorErases++;
+}
+
+void m25p16_eraseCompletely()
+{
+    m25p16_waitForReady(0);
+    memset(flashSimMemory, 0xFF, FLASH_SIM_SIZE);
+    busyUntil = flashSimMicros + FLASH_SIM_CHIP_ERASE_US;
+    operation = FLASH_SIM_IDLE;     // not modelled if the power is cut, formatting is run without cuts
+}
+
+void m25p16_pageProgramBegin(uint32_t address)
+{
+    m25p16_waitForReady(0);
+    programAddress = address;
+    programLength = 0;
+    memcpy(operationBefore, flashSimMemory + (address & ~(FLASH_SIM_PAGE_SIZE - 1)), FLASH_SIM_PAGE_SIZE);
+}
+
+// Like the chip, a program that runs off the end of the page wraps around to its start
+void m25p16_pageProgramContinue(const uint8_t *data, int length)
+{
+    const uint32_t page = programAddress & ~(FLASH_SIM_PAGE_SIZE - 1);
+
+    for (int i = 0; i < length; i++) {
+        uint8_t *cell = &flashSimMemory[page | ((programAddress + programLength + i) & (FLASH_SIM_PAGE_SIZE - 1))];
+        if ((*cell & data[i]) != data[i]) {
+            flashSimStats.violations++;
+        }
+        *cell &= data[i];
+    }
+    programLength += length;
+}
+
+void m25p16_pageProgramFinish()
+{
+    operation = FLASH_SIM_PROGRAMMING;
+    operationStartedAt = flashSimMicros;
+    operationAddress = programAddress;
+    operationLength = programLength;
+
+    busyUntil = flashSimMicros + FLASH_SIM_PAGE_PROGRAM_US(programLength);
+    flashSimStats.programs++;
+}
+
+void m25p16_pageProgram(uint32_t address, const uint8_t *data, int length)
+{
+    m25p16_pageProgramBegin(address);
+    m25p16_pageProgramContinue(data, length);
+    m25p16_pageProgramFinish();
+}
+
+int m25p16_readBytes(uint32_t address, uint8_t *buffer, int length)
+{
+    m25p16_waitForReady(0);
+    memcpy(buffer, flashSimMemory + address, length);
+    return length;
+}
+
+const flashGeometry_t* m25p16_getGeometry()
+{
+    return &geometry;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Host stand-in for an M25P16 behind drivers/flash_m25p16.c, with the chip's timing on a simulated clock. Programming
+ * can only clear bits, a program that would have to set one is counted as a violation. Reads, programs and erases
+ * wait for the previous operation like the driver does, so a busy chip costs the caller time.
+ *
+ * A power cut set with flashSimPowerCutAt stops the clock there. A page program in progress has only programmed its
+ * first bytes, a sector erase in progress leaves the sector with random bits set. Then flashSimPowerCutHandler runs,
+ * which must not return.
+ */
+
+#define FLASH_SIM_SIZE (2 * 1024 * 1024)
+#ifndef FLASH_SIM_SECTOR_SIZE
+#define FLASH_SIM_SECTOR_SIZE (64 * 1024)
+#endif
+#define FLASH_SIM_PAGE_SIZE 256
+
+#define FLASH_SIM_PAGE_PROGRAM_US(bytes) (200 + 3 * (bytes))  // about 1 ms for a whole page
+#ifndef FLASH_SIM_SECTOR_ERASE_US
+#define FLASH_SIM_SECTOR_ERASE_US 700000
+#endif
+#define FLASH_SIM_CHIP_ERASE_US 20000000
+
+typedef enum {
+    FLASH_SIM_IDLE,
+    FLASH_SIM_PROGRAMMING,
+    FLASH_SIM_ERASING,
+} flashSimOperation_e;
+
+typedef struct flashSimStats_s {
+    uint32_t programs;
+    uint32_t sectorErases;
+    uint32_t violations;        // programs that tried to set a bit
+} flashSimStats_t;
+
+extern uint8_t *flashSimMemory;               // FLASH_SIM_SIZE bytes, may be pointed at shared memory
+extern uint64_t flashSimMicros;
+extern flashSimStats_t flashSimStats;
+
+extern uint64_t flashSimPowerCutAt;             // 0 for never
+extern void (*flashSimPowerCutHandler)(void);
+extern void (*flashSimEraseHook)(uint32_t address);    // called as a sector erase starts
+
+void flashSimReset(void);
+void flashSimAdvance(uint32_t us);
+bool flashSimIsBusy(void);
+flashSimOperation_e flashSimGetOperation(void);
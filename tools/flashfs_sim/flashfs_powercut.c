@@ -0,0 +1,431 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Power cuts and ring wraps on flashfs.c over the simulated M25P16 in flash_sim.c.
+ *
+ * Every boot of the flight controller is a forked child working on a flash image in shared memory, so flashfs.c starts
+ * from scratch each time like after a reset. A boot mounts the volume and checks it against what earlier boots wrote,
+ * then runs the FLASHFS task at 100Hz and flies blackbox-like logs of 40 to 72 byte frames every 1 ms. Boots that get
+ * a power cut lose it at a random moment, in the middle of whatever page program or sector erase is running then.
+ *
+ * Every mount checks that:
+ *  - the volume still has its directory
+ *  - every listed log is one that was written, closed logs are complete and a log cut short is only missing what was
+ *    still in the write buffer
+ *  - downloads start no later than the oldest log which is certainly intact, listed or not, and read all of the logs
+ *    after that back correctly
+ *  - nothing has been programmed over bits that weren't erased
+ *
+ * The run formats the volume, then nine boots wrap the ring several times with more short logs than the directory
+ * lists, then boots keep getting cut until the given number of cuts is reached. Every third of those is timed to land
+ * in a directory compaction if one starts.
+ *
+ *   flashfs_powercut [cuts] [seed]
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+
+#include "drivers/flash_m25p16.h"
+#include "io/flashfs.h"
+
+#include "flash_sim.h"
+
+#define DEFAULT_CUTS 119
+#define WRAP_BOOTS 9
+#define COMPACTION_CUT_EVERY 3
+
+#define TASK_US 10000               // TASK_FLASHFS runs at 100Hz
+#define LOOP_US 1000
+#define FRAME_MIN 40
+#define FRAME_STEP 8
+#define FRAME_SIZES 5
+
+// A boot idles for a while and then flies a few logs
+#define IDLE_MS_MAX 3000
+#define WRAP_FLIGHTS 12
+#define WRAP_FLIGHT_MS_MIN 500
+#define WRAP_FLIGHT_MS_MAX 2000
+#define CUT_FLIGHTS_MAX 4
+#define CUT_FLIGHT_MS_MAX 20000
+
+// A compaction erases a directory sector, then programs an entry per task run
+#define COMPACTION_US (FLASH_SIM_SECTOR_ERASE_US + 24 * TASK_US)
+
+// A log cut short loses what was in the write buffer and at most one page that was being programmed
+#define CUT_LOSS_MAX (FLASHFS_WRITE_BUFFER_SIZE + M25P16_PAGESIZE)
+
+#define MAX_WRITTEN_LOGS 4096
+#define EXIT_POWER_CUT 3
+
+typedef struct writtenLog_s {
+    uint32_t start;
+    uint32_t accepted;      // bytes flashfsWrite() took
+    bool closed;            // closed and flushed
+} writtenLog_t;
+
+// Survives the reboots
+typedef struct shared_s {
+    uint8_t image[FLASH_SIM_SIZE];
+    writtenLog_t logs[MAX_WRITTEN_LOGS];
+    int logCount;
+    int failures;
+    uint32_t violations;
+    int mounts;
+    int unlistedMounts;     // mounts with intact logs the directory no longer lists
+    int cutsDuringProgram;
+    int cutsDuringErase;
+    int cutsDuringCompaction;
+} shared_t;
+
+static shared_t *shared;
+
+static uint32_t ringStart, ringSize, eraseBlockSize;
+static bool cutInCompaction;
+static bool compactionRunning;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && shared->failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static uint8_t logByte(uint32_t start, uint32_t offset)
+{
+    return start * 7 + offset * 13 + (offset >> 8);
+}
+
+static void powerCut(void)
+{
+    switch (flashSimGetOperation()) {
+        case FLASH_SIM_PROGRAMMING:
+            shared->cutsDuringProgram++;
+        break;
+        case FLASH_SIM_ERASING:
+            shared->cutsDuringErase++;
+        break;
+        default:
+        break;
+    }
+    if (compactionRunning) {
+        shared->cutsDuringCompaction++;
+    }
+    shared->violations += flashSimStats.violations;
+    fflush(stdout);
+    _exit(EXIT_POWER_CUT);
+}
+
+// A directory sector is only erased to compact the directory into it
+static void eraseStarted(uint32_t address)
+{
+    if (address < ringStart) {
+        compactionRunning = true;
+        if (cutInCompaction) {
+            flashSimPowerCutAt = flashSimMicros + 1 + rand() % COMPACTION_US;
+        }
+    }
+}
+
+static void runTask(uint32_t ms)
+{
+    for (uint32_t elapsed = 0; elapsed < ms * 1000; elapsed += TASK_US) {
+        flashfsProcess();
+        flashSimAdvance(TASK_US);
+    }
+}
+
+static void fly(uint32_t ms)
+{
+    uint8_t frame[FRAME_MIN + FRAME_STEP * (FRAME_SIZES - 1)];
+    flashfsLog_t log;
+
+    flashfsLogBegin();
+    if (!flashfsGetLog(flashfsGetLogCount() - 1, &log)) {
+        return;
+    }
+
+    writtenLog_t *written = &shared->logs[shared->logCount++];
+    written->start = log.start;
+    written->accepted = 0;
+    written->closed = false;
+
+    for (uint32_t loop = 0; loop < ms && !flashfsIsEOF(); loop++) {
+        const unsigned length = FRAME_MIN + (loop % FRAME_SIZES) * FRAME_STEP;
+
+        // The FLASHFS task runs between PID loops, while the last page program is done
+        if (loop % (TASK_US / LOOP_US) == 0) {
+            flashfsProcess();
+        }
+
+        if (length <= flashfsGetWriteBufferFreeSpace()) {
+            for (unsigned i = 0; i < length; i++) {
+                frame[i] = logByte(written->start, written->accepted + i);
+            }
+            flashfsWrite(frame, length, false);
+            written->accepted += length;
+        }
+        flashfsFlushPagesAsync();
+        flashSimAdvance(LOOP_US);
+    }
+
+    flashfsLogEnd();
+    while (!flashfsFlushAsync()) {
+        flashSimAdvance(100);
+    }
+    written->closed = true;
+}
+
+// How many bytes of a written log starting at data read back as written
+static uint32_t matchingBytes(const writtenLog_t *written, const uint8_t *data, uint32_t length)
+{
+    uint32_t offset = 0;
+
+    length = MIN(length, written->accepted);
+    while (offset < length && data[offset] == logByte(written->start, offset)) {
+        offset++;
+    }
+    return offset;
+}
+
+// Newest first, a log cut short before it reached the flash leaves its start to the next one
+static writtenLog_t *findWrittenLog(uint32_t start)
+{
+    for (int i = shared->logCount - 1; i >= 0; i--) {
+        if (shared->logs[i].start == start) {
+            return &shared->logs[i];
+        }
+    }
+    return NULL;
+}
+
+static bool completeEnough(const writtenLog_t *written, uint32_t matching)
+{
+    return written->closed ? matching == written->accepted : matching + CUT_LOSS_MAX >= written->accepted;
+}
+
+static void verifyMount(void)
+{
+    static uint8_t download[FLASH_SIM_SIZE];
+    flashfsLog_t log;
+
+    shared->mounts++;
+    check(flashfsHasDirectory(), "the volume lost its directory");
+    if (!flashfsHasDirectory()) {
+        return;
+    }
+
+    // Downloads see everything from the data start up to the write position
+    const uint32_t end = flashfsGetOffset();
+    const uint32_t used = flashfsGetUsedSize();
+    const uint32_t dataStart = end - used;
+    for (uint32_t address = 0; address < used; ) {
+        const int got = flashfsReadLinear(address, download + address, used - address);
+        if (got <= 0) {
+            break;
+        }
+        address += got;
+    }
+
+    for (int i = 0; flashfsGetLog(i, &log); i++) {
+        const writtenLog_t *written = findWrittenLog(log.start);
+        if (!written) {
+            check(false, "the directory lists a log that was never written");
+        } else if (log.start < dataStart || log.start + log.length > end) {
+            check(false, "a listed log lies outside the download");
+        } else {
+            const uint32_t matching = matchingBytes(written, download + log.start - dataStart, log.length);
+            check(completeEnough(written, matching), "a listed log doesn't read back");
+        }
+    }
+
+    // The block after the erase front may have been erased by an erase that was cut short
+    const uint32_t eraseFront = end + flashfsGetErasedSpace();
+    const uint32_t intactFrom = eraseFront > ringStart + ringSize - eraseBlockSize ? eraseFront - ringSize + eraseBlockSize : ringStart;
+    uint32_t oldestListed = end;
+    bool unlisted = false;
+
+    check(dataStart + ringSize >= eraseFront, "downloads start in data that has been erased");
+    if (flashfsGetLog(0, &log)) {
+        oldestListed = log.start;
+    }
+
+    for (int i = 0; i < shared->logCount; i++) {
+        writtenLog_t *written = &shared->logs[i];
+
+        if (written->start < intactFrom || written->start >= end) {
+            continue;
+        }
+        unlisted |= written->start < oldestListed;
+        if (written->start < dataStart) {
+            check(false, "an intact log is left out of downloads");
+            continue;
+        }
+        const uint32_t matching = matchingBytes(written, download + written->start - dataStart, end - written->start);
+        check(completeEnough(written, matching), "a log doesn't read back in the download");
+
+        // What survived of a log that was cut short must stay as it is
+        if (!written->closed) {
+            written->accepted = matching;
+            written->closed = true;
+        }
+    }
+    if (unlisted) {
+        shared->unlistedMounts++;
+    }
+
+    // Forget a log which was cut short before any of it reached the flash, the next one will start in its place
+    while (shared->logCount > 0 && shared->logs[shared->logCount - 1].start >= end) {
+        shared->logCount--;
+    }
+}
+
+static void boot(unsigned seed, int flights, uint32_t flightMsMin, uint32_t flightMsMax, bool cut)
+{
+    fflush(stdout);
+    const pid_t pid = fork();
+
+    if (pid == 0) {
+        srand(seed);
+        flashSimMemory = shared->image;
+        flashSimPowerCutHandler = powerCut;
+        flashSimEraseHook = eraseStarted;
+        cutInCompaction = cut && seed % COMPACTION_CUT_EVERY == 0;
+
+        flashfsInit();
+        verifyMount();
+
+        const uint32_t idleMs = rand() % IDLE_MS_MAX;
+        uint32_t flightMs[CUT_FLIGHTS_MAX > WRAP_FLIGHTS ? CUT_FLIGHTS_MAX : WRAP_FLIGHTS];
+        uint64_t bootUs = idleMs * 1000;
+        for (int i = 0; i < flights; i++) {
+            flightMs[i] = flightMsMin + rand() % (flightMsMax - flightMsMin + 1);
+            bootUs += (flightMs[i] + idleMs) * 1000;
+        }
+        if (cut) {
+            flashSimPowerCutAt = 1 + (((uint64_t)rand() << 31) | rand()) % bootUs;
+        }
+
+        runTask(idleMs);
+        for (int i = 0; i < flights; i++) {
+            fly(flightMs[i]);
+            runTask(idleMs);
+        }
+
+        shared->violations += flashSimStats.violations;
+        fflush(stdout);
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && (WEXITSTATUS(status) == 0 || WEXITSTATUS(status) == EXIT_POWER_CUT), "a boot crashed");
+}
+
+static void format(void)
+{
+    flashSimMemory = shared->image;
+    flashSimReset();
+
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        flashfsInit();
+        flashfsEraseCompletely();
+        while (!flashfsIsReady()) {
+            runTask(10);
+        }
+        // The directory header is programmed last
+        runTask(100);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv)
+{
+    const int cuts = argc > 1 ? atoi(argv[1]) : DEFAULT_CUTS;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : 1;
+
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    // As flashfsSetDirectoryLayout() lays the volume out
+    eraseBlockSize = MAX(FLASH_SIM_SECTOR_SIZE, FLASHFS_ERASE_BLOCK_SIZE);
+    ringStart = (2 * FLASH_SIM_SECTOR_SIZE + eraseBlockSize - 1) / eraseBlockSize * eraseBlockSize;
+    ringSize = FLASH_SIM_SIZE - ringStart;
+
+    format();
+
+    for (int i = 0; i < WRAP_BOOTS; i++) {
+        boot(seed++, WRAP_FLIGHTS, WRAP_FLIGHT_MS_MIN, WRAP_FLIGHT_MS_MAX, false);
+    }
+    const int wrapLogs = shared->logCount;
+    uint32_t wrapBytes = 0;
+    for (int i = 0; i < wrapLogs; i++) {
+        wrapBytes += shared->logs[i].accepted;
+    }
+    printf("%d boots wrapped the %u KB ring %.1f times with %d logs, %d of %d mounts had intact logs the directory no longer lists\n",
+        WRAP_BOOTS, ringSize / 1024, (double)wrapBytes / ringSize, wrapLogs, shared->unlistedMounts, shared->mounts);
+    check(shared->unlistedMounts > 0, "the directory never ran out of room for the intact logs");
+
+    int cutCount = 0, boots = 0;
+    while (cutCount < cuts && boots < cuts * 4) {
+        boot(seed, 1 + seed % CUT_FLIGHTS_MAX, 1, CUT_FLIGHT_MS_MAX, true);
+        seed++;
+        boots++;
+        cutCount = shared->cutsDuringProgram + shared->cutsDuringErase;
+    }
+
+    // One more mount checks the state the last cut left
+    boot(seed++, 0, 0, 0, false);
+
+    printf("%d power cuts in %d boots: %d during page programs, %d during sector erases, %d in directory compactions\n",
+        cuts, boots, shared->cutsDuringProgram, shared->cutsDuringErase, shared->cutsDuringCompaction);
+    printf("%d mounts, %d logs written, %u bytes programmed over bits that weren't erased\n",
+        shared->mounts, shared->logCount, shared->violations);
+
+    check(cutCount >= cuts, "the power cuts stopped landing");
+    check(shared->violations == 0, "flashfs programmed over bits that weren't erased");
+#if FLASH_SIM_SECTOR_SIZE < 64 * 1024
+    // A 64KB directory sector holds 4096 entries, which this run never fills, smaller ones get compacted
+    check(shared->cutsDuringCompaction > 0, "no power cut landed in a directory compaction");
+#endif
+
+    if (shared->failures) {
+        printf("FAILED, %d checks\n", shared->failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Blackbox-like write load on flashfs.c over the simulated M25P16 in flash_sim.c: every 1 ms loop offers a 40 to 72
+ * byte frame, which is only written if the buffer has room for it (as blackboxDeviceReserveBufferSpace() does), then
+ * flashfsFlushPagesAsync() runs like the blackbox housekeeping. A page program takes about 1 ms here.
+ *
+ * The Makefile builds it with the 128 byte default write buffer and with the 1024 bytes of the F3 flash targets.
+ * Reports bytes per program operation, busy stalls and lost frames, and checks that what reached the chip is exactly
+ * the frames that were accepted. With the larger buffer every program has to be a whole page, without a stall or a
+ * lost frame.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "drivers/flash_m25p16.h"
+#include "io/flashfs.h"
+
+#include "flash_sim.h"
+
+#define LOOP_US 1000
+#define LOOPS 20000
+#define FRAME_MIN 40
+#define FRAME_STEP 8                // frames are 40, 48, ... 72 bytes in turn
+#define FRAME_SIZES 5
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static uint8_t streamByte(uint32_t offset)
+{
+    return offset * 7 + (offset >> 8);
+}
+
+int main(void)
+{
+    uint8_t frame[FRAME_MIN + FRAME_STEP * (FRAME_SIZES - 1)];
+    uint32_t written = 0, framesLost = 0;
+
+    flashSimReset();
+    flashfsInit();
+
+    for (int loop = 0; loop < LOOPS; loop++) {
+        const unsigned length = FRAME_MIN + (loop % FRAME_SIZES) * FRAME_STEP;
+
+        if (length <= flashfsGetWriteBufferFreeSpace()) {
+            for (unsigned i = 0; i < length; i++) {
+                frame[i] = streamByte(written + i);
+            }
+            flashfsWrite(frame, length, false);
+            written += length;
+        } else {
+            framesLost++;
+        }
+        flashfsFlushPagesAsync();
+        flashSimAdvance(LOOP_US);
+    }
+
+    // What the loop above programmed, before the final flush writes out the partial page left in the buffer
+    const flashfsStats_t stats = *flashfsGetStats();
+    flashfsFlushSync();
+
+    uint32_t firstMismatch = written;
+    for (uint32_t offset = 0; offset < written; offset++) {
+        if (flashSimMemory[offset] != streamByte(offset)) {
+            firstMismatch = offset;
+            break;
+        }
+    }
+
+    printf("write buffer %4d bytes: %u bytes per program, %u busy stalls, %u of %d frames lost (%.1f%%), %u bytes dropped\n",
+        FLASHFS_WRITE_BUFFER_SIZE, stats.bytesProgrammed / stats.programOperations, stats.busyStalls,
+        framesLost, LOOPS, 100.0 * framesLost / LOOPS, stats.bytesDropped);
+
+    check(firstMismatch == written, "the flash doesn't hold the frames that were accepted");
+    check(flashfsGetOffset() == written, "the file pointer isn't at the end of the frames");
+    check(flashSimStats.violations == 0, "a program tried to set bits");
+    check(stats.bytesDropped == 0, "flashfsWrite() dropped bytes it had room for");
+#if FLASHFS_WRITE_BUFFER_SIZE >= 2 * M25P16_PAGESIZE
+    check(stats.bytesProgrammed == stats.programOperations * M25P16_PAGESIZE, "the page pipeline programmed a partial page");
+    check(stats.busyStalls == 0, "the page pipeline stalled on a busy chip");
+    check(framesLost == 0, "the page pipeline lost frames");
+#endif
+
+    if (failures) {
+        printf("FAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
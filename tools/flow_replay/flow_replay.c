@@ -0,0 +1,505 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Replays optical flow and IMU data through miniflow.c: flow frames go through the stubbed UART and the parser,
+ * attitude, the earth frame acceleration sum and the estimated altitude are set the way imu.c and altitudehold.c leave
+ * them, and miniflowApplyHold() adds flow_cmd to rcCommand as the PID loop does.
+ *
+ * Without arguments a point mass quad flies in angle mode above a textured floor. It is pushed and then held by a side
+ * wind while the flow position hold runs, once with the hold output applied and once without. The flight is logged,
+ * the log is replayed open loop into a fresh hold and must give the same flow_cmd, and the estimated velocity is
+ * compared with the true one. The stick and lost frame cases check when flow_cmd reaches rcCommand.
+ *
+ *   make run
+ *
+ * A log recorded on the quad (or written with --record) is replayed with
+ *
+ *   ./flow_replay log.csv
+ *
+ * one row per flow frame: time_us, flow_x, flow_y (1e-4 rad integrals), quality, acc_n, acc_e (cm/s^2, earth frame
+ * average since the last frame), roll, pitch, yaw (0.1 deg), altitude (cm), and optionally the true velocity
+ * vel_x, vel_y (cm/s, flow axes).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <platform.h>
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/utils.h"
+#include "config/parameter_group.h"
+#include "build/debug.h"
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/dma.h"
+#include "drivers/system.h"
+#include "drivers/serial.h"
+#include "drivers/serial_uart.h"
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "fc/fc_tasks.h"
+#include "fc/rc_controls.h"
+#include "fc/runtime_config.h"
+#include "flight/imu.h"
+#include "flight/pid.h"
+#include "rx/rx.h"
+#include "drivers/miniflow.h"
+
+#define SIM_STEP_US 1000
+#define SIM_FRAME_US 40000          // flow board at 25Hz
+#define SIM_TIME_US 30000000
+#define SIM_ALTITUDE 100.0f         // cm
+#define SIM_GRAVITY 980.665f        // cm/s^2
+#define SIM_ANGLE_TAU 0.12f         // s, angle loop response
+#define SIM_DRAG 0.3f               // 1/s
+#define SIM_FLOW_NOISE 0.01f        // rad/s on the flow rate
+#define SIM_ACC_NOISE 30.0f         // cm/s^2
+#define SIM_PUSH_FORWARD 60.0f      // cm/s at 1s
+#define SIM_PUSH_RIGHT -40.0f
+#define SIM_WIND_RIGHT 25.0f        // cm/s^2 from 10s to 20s
+#define LOG_MAX (SIM_TIME_US / SIM_FRAME_US + 1)
+#define FRAME_LENGTH (2 + MINIFLOW_PAYLOAD_LENGTH + 1)
+
+typedef struct {
+    uint32_t time;
+    int16_t flowX;
+    int16_t flowY;
+    uint8_t quality;
+    float accN;
+    float accE;
+    int16_t roll;
+    int16_t pitch;
+    int16_t yaw;
+    float altitude;
+    float velX;                 // NAN when the log has no truth
+    float velY;
+    int16_t flowCmd[2];         // what the hold made of the frame
+    float speed[2];
+} logRow_t;
+
+typedef struct {
+    float maxSpeedAfterPush;    // cm/s, 3s after the push until the wind
+    float maxSpeedInWind;       // cm/s, 2s after the wind starts until it stops
+    float maxOffset;            // cm, from where the hold started
+    float velocityRms;          // cm/s, estimate against truth where the estimate is not clamped
+} flightResult_t;
+
+static int failures;
+
+static uint32_t microsNow;
+static float altitudeNow;
+static const uint8_t *rxBytes;
+static int rxLength;
+static int rxPos;
+
+// Globals of miniflow.c that show the state of the hold
+extern float speed_x, speed_y;
+
+// What miniflow.c expects from the rest of the firmware
+USART_TypeDef hostUSART3;
+static serialPort_t hostPort;
+int16_t debug[DEBUG16_VALUE_COUNT];
+uint16_t flightModeFlags;
+int16_t rcData[MAX_SUPPORTED_RC_CHANNEL_COUNT];
+int16_t rcCommand[4];
+attitudeEulerAngles_t attitude;
+int32_t accSum[XYZ_AXIS_COUNT];
+int accSumCount;
+float accVelScale = 1e-6f;
+static pidProfile_t pidProfileStorage = {
+    .P8[PIDPOSR] = 34,
+    .I8[PIDPOSR] = 14,
+    .D8[PIDPOSR] = 53,
+    .P8[PIDNAVR] = 25,
+    .I8[PIDNAVR] = 33,
+    .D8[PIDNAVR] = 83,
+};
+pidProfile_t *pidProfile_ProfileCurrent = &pidProfileStorage;
+
+uint32_t micros(void)
+{
+    return microsNow;
+}
+
+int32_t altitudeHoldGetEstimatedAltitude(void)
+{
+    return lrintf(altitudeNow);
+}
+
+serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(USARTx);
+    UNUSED(callback);
+    UNUSED(baudRate);
+    UNUSED(mode);
+    UNUSED(options);
+    return &hostPort;
+}
+
+uint8_t serialRxBytesWaiting(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return rxLength - rxPos;
+}
+
+uint8_t serialRead(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return rxBytes[rxPos++];
+}
+
+uint8_t serialTxBytesFree(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return 255;
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(count);
+}
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+static float gaussian(void)
+{
+    float sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += (float)rand() / RAND_MAX;
+    }
+    return sum - 6.0f;
+}
+
+// Sets what imu.c and altitudehold.c would show for the row, sends its flow frame and runs the miniflow task
+static void replayRow(logRow_t *row)
+{
+    microsNow = row->time;
+    altitudeNow = row->altitude;
+    attitude.values.roll = row->roll;
+    attitude.values.pitch = row->pitch;
+    attitude.values.yaw = row->yaw;
+    accSumCount = 1;
+    accSum[X] = lrintf(row->accN);
+    accSum[Y] = lrintf(row->accE);
+
+    uint8_t frame[FRAME_LENGTH] = { MINIFLOW_HEADER_1, MINIFLOW_HEADER_2 };
+    uint8_t *payload = &frame[2];
+    payload[0] = row->flowX;
+    payload[1] = row->flowX >> 8;
+    payload[2] = row->flowY;
+    payload[3] = row->flowY >> 8;
+    payload[8] = row->quality;
+    payload[9] = 1;
+    for (int i = 0; i < MINIFLOW_PAYLOAD_LENGTH; i++) {
+        frame[FRAME_LENGTH - 1] ^= payload[i];
+    }
+    rxBytes = frame;
+    rxLength = FRAME_LENGTH;
+    rxPos = 0;
+    if (taskMiniflowCheck(0)) {
+        taskMiniflow();
+    }
+
+    row->flowCmd[0] = flow_cmd[0];
+    row->flowCmd[1] = flow_cmd[1];
+    row->speed[0] = speed_x;
+    row->speed[1] = speed_y;
+}
+
+// Leaves position hold for a frame so that the next one starts from a reset estimator and PID state
+static void restartHold(void)
+{
+    logRow_t row = { .time = microsNow + SIM_FRAME_US, .quality = 0, .altitude = 0 };
+    flightModeFlags = 0;
+    replayRow(&row);
+    flightModeFlags = ANGLE_MODE | BARO_MODE;
+}
+
+/*
+ * Point mass in angle mode. rcCommand is an angle of 0.2 deg per unit, positive pitch tilts forward and positive roll
+ * to the right. The flow board sees the ground move against the quad (forward and right are negative) plus the
+ * attitude change.
+ */
+static flightResult_t fly(bool applyHold, logRow_t *log, int *logRows)
+{
+    float pos[2] = { 0, 0 }, vel[2] = { 0, 0 }, angle[2] = { 0, 0 };   // forward, right
+    float accSumN = 0, accSumE = 0, flowSum[2] = { 0, 0 };
+    int accCount = 0;
+    float lastAngle[2] = { 0, 0 };
+    flightResult_t result = { 0, 0, 0, 0 };
+    float errorSq = 0;
+    int errorCount = 0;
+
+    microsNow = 0;
+    restartHold();
+    *logRows = 0;
+
+    for (uint32_t t = SIM_STEP_US; t <= SIM_TIME_US; t += SIM_STEP_US) {
+        microsNow += SIM_STEP_US;
+        const float dT = SIM_STEP_US * 1e-6f;
+
+        rcCommand[ROLL] = 0;
+        rcCommand[PITCH] = 0;
+        if (applyHold) {
+            miniflowApplyHold();
+        }
+
+        const float target[2] = { rcCommand[PITCH] * 0.2f * RAD, rcCommand[ROLL] * 0.2f * RAD };
+        float acc[2];
+        for (int i = 0; i < 2; i++) {
+            angle[i] += (target[i] - angle[i]) * dT / SIM_ANGLE_TAU;
+            acc[i] = SIM_GRAVITY * tanf(angle[i]) - SIM_DRAG * vel[i];
+        }
+        if (t >= 10000000 && t < 20000000) {
+            acc[1] += SIM_WIND_RIGHT;
+        }
+        if (t == 1000000) {
+            vel[0] += SIM_PUSH_FORWARD;
+            vel[1] += SIM_PUSH_RIGHT;
+        }
+        for (int i = 0; i < 2; i++) {
+            vel[i] += acc[i] * dT;
+            pos[i] += vel[i] * dT;
+            flowSum[i] += (-vel[i] / SIM_ALTITUDE + SIM_FLOW_NOISE * gaussian() * 31.6f) * dT;   // 1kHz white noise
+        }
+        accSumN += acc[0] + SIM_ACC_NOISE * gaussian();
+        accSumE += acc[1] + SIM_ACC_NOISE * gaussian();
+        accCount++;
+
+        if (t % SIM_FRAME_US == 0) {
+            // attitude in 0.1 deg, nose down pitch and right roll positive like the tilt above
+            logRow_t *row = &log[(*logRows)++];
+            const int16_t pitch = lrintf(angle[0] / RAD * 10.0f);
+            const int16_t roll = lrintf(angle[1] / RAD * 10.0f);
+            *row = (logRow_t){
+                .time = t,
+                .flowX = lrintf(flowSum[0] * 10000.0f + (pitch - lastAngle[0]) * 0.1f * RAD * 10000.0f),
+                .flowY = lrintf(flowSum[1] * 10000.0f + (roll - lastAngle[1]) * 0.1f * RAD * 10000.0f),
+                .quality = 200,
+                .accN = accSumN / accCount,
+                .accE = accSumE / accCount,
+                .roll = roll,
+                .pitch = pitch,
+                .yaw = 0,
+                .altitude = SIM_ALTITUDE,
+                .velX = -vel[0],
+                .velY = -vel[1],
+            };
+            lastAngle[0] = pitch;
+            lastAngle[1] = roll;
+            flowSum[0] = flowSum[1] = 0;
+            accSumN = accSumE = 0;
+            accCount = 0;
+
+            replayRow(row);
+            for (int i = 0; i < 2; i++) {
+                const float truth = i ? row->velY : row->velX;
+                if (fabsf(row->speed[i]) < 24.0f && fabsf(truth) < 24.0f) {
+                    errorSq += (row->speed[i] - truth) * (row->speed[i] - truth);
+                    errorCount++;
+                }
+            }
+        }
+
+        const float speed = sqrtf(vel[0] * vel[0] + vel[1] * vel[1]);
+        if (t >= 4000000 && t < 10000000) {
+            result.maxSpeedAfterPush = MAX(result.maxSpeedAfterPush, speed);
+        }
+        if (t >= 12000000 && t < 20000000) {
+            result.maxSpeedInWind = MAX(result.maxSpeedInWind, speed);
+        }
+        result.maxOffset = MAX(result.maxOffset, sqrtf(pos[0] * pos[0] + pos[1] * pos[1]));
+    }
+    result.velocityRms = errorCount ? sqrtf(errorSq / errorCount) : 0;
+    return result;
+}
+
+static void testClosedLoop(void)
+{
+    static logRow_t log[LOG_MAX];
+    int rows;
+
+    srand(1);
+    const flightResult_t drift = fly(false, log, &rows);
+    srand(1);
+    const flightResult_t hold = fly(true, log, &rows);
+
+    printf("                      speed after push  speed in wind  max offset  velocity rms\n");
+    printf("  hold not applied    %10.1f cm/s  %8.1f cm/s  %7.1f cm  %7.1f cm/s\n",
+        drift.maxSpeedAfterPush, drift.maxSpeedInWind, drift.maxOffset, drift.velocityRms);
+    printf("  hold applied        %10.1f cm/s  %8.1f cm/s  %7.1f cm  %7.1f cm/s\n",
+        hold.maxSpeedAfterPush, hold.maxSpeedInWind, hold.maxOffset, hold.velocityRms);
+
+    check(hold.velocityRms < 6.0f, "estimated velocity does not follow the true one");
+    check(hold.maxSpeedAfterPush < 15.0f, "hold did not stop the push");
+    check(hold.maxSpeedInWind < 20.0f, "hold did not stop the wind drift");
+    check(hold.maxOffset < drift.maxOffset / 4, "hold did not keep the quad near where it started");
+
+    // The same log replayed open loop gives the same commands
+    static logRow_t replay[LOG_MAX];
+    memcpy(replay, log, sizeof(replay));
+    restartHold();
+    int mismatches = 0;
+    for (int i = 0; i < rows; i++) {
+        replayRow(&replay[i]);
+        mismatches += replay[i].flowCmd[0] != log[i].flowCmd[0] || replay[i].flowCmd[1] != log[i].flowCmd[1];
+    }
+    printf("replayed %d logged frames open loop, %d flow_cmd mismatches\n", rows, mismatches);
+    check(mismatches == 0, "replay of the flight log does not reproduce flow_cmd");
+}
+
+static void testApplyHold(void)
+{
+    static logRow_t log[LOG_MAX];
+    int rows;
+    srand(2);
+    fly(true, log, &rows);
+
+    // A stick out of the deadband resets the hold, nothing is added
+    logRow_t row = log[rows - 1];
+    rcData[0] = 1600;
+    row.time = microsNow += SIM_FRAME_US;
+    replayRow(&row);
+    rcData[0] = 1500;
+    rcCommand[ROLL] = rcCommand[PITCH] = 0;
+    miniflowApplyHold();
+    check(rcCommand[ROLL] == 0 && rcCommand[PITCH] == 0, "flow_cmd applied while the sticks are moved");
+
+    // Pushed sideways, the hold commands against the drift, and stops once frames are missing
+    restartHold();
+    for (int i = 0; i < 10; i++) {
+        row = (logRow_t){ .time = microsNow + SIM_FRAME_US, .flowY = -40 * SIM_FRAME_US / 10000, .quality = 200, .altitude = SIM_ALTITUDE };
+        replayRow(&row);        // moving right at 0.4 rad/s * 100cm
+    }
+    rcCommand[ROLL] = rcCommand[PITCH] = 0;
+    miniflowApplyHold();
+    check(rcCommand[ROLL] < 0 && rcCommand[PITCH] == 0, "hold does not roll against a drift to the right");
+
+    microsNow += 250000;
+    rcCommand[ROLL] = 0;
+    miniflowApplyHold();
+    check(rcCommand[ROLL] == 0, "flow_cmd still applied after the flow frames stopped");
+
+    flightModeFlags = BARO_MODE;
+    microsNow -= 250000;
+    miniflowApplyHold();
+    check(rcCommand[ROLL] == 0, "flow_cmd applied outside angle mode");
+    flightModeFlags = ANGLE_MODE | BARO_MODE;
+}
+
+static int replayFile(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    restartHold();
+    char line[256];
+    int rows = 0, errorCount = 0;
+    float errorSq = 0;
+    printf("time_us,speed_x,speed_y,flow_cmd_roll,flow_cmd_pitch\n");
+    while (fgets(line, sizeof(line), f)) {
+        unsigned time;
+        int flowX, flowY, quality, roll, pitch, yaw;
+        float accN, accE, altitude, velX = NAN, velY = NAN;
+        const int fields = sscanf(line, "%u,%d,%d,%d,%f,%f,%d,%d,%d,%f,%f,%f",
+            &time, &flowX, &flowY, &quality, &accN, &accE, &roll, &pitch, &yaw, &altitude, &velX, &velY);
+        if (fields < 10) {
+            continue;       // header or comment
+        }
+        logRow_t row = { time, flowX, flowY, quality, accN, accE, roll, pitch, yaw, altitude, velX, velY, { 0, 0 }, { 0, 0 } };
+        replayRow(&row);
+        printf("%u,%.1f,%.1f,%d,%d\n", row.time, row.speed[0], row.speed[1], row.flowCmd[0], row.flowCmd[1]);
+        if (fields == 12) {
+            errorSq += (row.speed[0] - velX) * (row.speed[0] - velX) + (row.speed[1] - velY) * (row.speed[1] - velY);
+            errorCount += 2;
+        }
+        rows++;
+    }
+    fclose(f);
+    fprintf(stderr, "%d frames replayed", rows);
+    if (errorCount) {
+        fprintf(stderr, ", velocity rms against the logged truth %.1f cm/s", sqrtf(errorSq / errorCount));
+    }
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+static int recordFile(const char *path)
+{
+    static logRow_t log[LOG_MAX];
+    int rows;
+    srand(1);
+    fly(true, log, &rows);
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    fprintf(f, "time_us,flow_x,flow_y,quality,acc_n,acc_e,roll,pitch,yaw,altitude,vel_x,vel_y\n");
+    for (int i = 0; i < rows; i++) {
+        const logRow_t *row = &log[i];
+        fprintf(f, "%u,%d,%d,%d,%.1f,%.1f,%d,%d,%d,%.1f,%.1f,%.1f\n", row->time, row->flowX, row->flowY, row->quality,
+            row->accN, row->accE, row->roll, row->pitch, row->yaw, row->altitude, row->velX, row->velY);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    flightModeFlags = ANGLE_MODE | BARO_MODE;
+    for (int i = 0; i < 4; i++) {
+        rcData[i] = 1500;
+    }
+    Miniflow_init();
+
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) {
+        return recordFile(argv[2]);
+    }
+    if (argc == 2) {
+        return replayFile(argv[1]);
+    }
+
+    testClosedLoop();
+    testApplyHold();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the target headers, only the types miniflow.c needs to reach the serial port API
+
+#define TARGET_BOARD_IDENTIFIER "HOST"
+
+#define MINIFLOW
+
+#define SERIAL_PORT_COUNT 1
+
+typedef enum {
+    DMA1_Channel1_IRQn = 11,
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t ISR;
+} DMA_TypeDef;
+
+typedef struct {
+    volatile uint32_t CNDTR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    volatile uint32_t ISR;
+} USART_TypeDef;
+
+extern USART_TypeDef hostUSART3;
+#define USART3 (&hostUSART3)
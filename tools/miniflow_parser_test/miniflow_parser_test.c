@@ -0,0 +1,428 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of miniflow_parser.c and the frame, drop and corrupt counters of miniflow.c. The serial port is stubbed
+ * with a byte stream that miniflowProcessRx() drains, the way the UART RX ring fills between two task runs.
+ *
+ * Clean: a 25Hz stream laid out like the flow board output (flow integrals, timespan, ground distance, quality)
+ * arrives in random chunks. Every frame must come out of miniflowGetFrame() intact, and frames that are overwritten
+ * before they are read must be counted as dropped.
+ *
+ * Damaged: every single bit flip of a frame, every dropped and inserted byte, every truncation, and extra 0xFE bytes in
+ * front of the header. The counters must match what was damaged, the parser must resync on the next header and it
+ * must never hand over a payload that was not sent. A random error run prints the counters for a few byte error
+ * rates.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/utils.h"
+#include "config/parameter_group.h"
+#include "build/debug.h"
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+#include "drivers/dma.h"
+#include "drivers/system.h"
+#include "drivers/serial.h"
+#include "drivers/serial_uart.h"
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "fc/rc_controls.h"
+#include "fc/runtime_config.h"
+#include "flight/imu.h"
+#include "flight/pid.h"
+#include "rx/rx.h"
+#include "drivers/miniflow.h"
+
+#define FRAME_LENGTH (2 + MINIFLOW_PAYLOAD_LENGTH + 1)
+#define CLEAN_FRAMES 5000
+#define RANDOM_FRAMES 100000
+#define STREAM_MAX (RANDOM_FRAMES * (FRAME_LENGTH + 2))
+
+static int failures;
+
+// The UART RX ring as miniflow.c sees it
+static const uint8_t *rxBytes;
+static int rxLength;
+static int rxPos;
+
+// What miniflow.c expects from the rest of the firmware
+USART_TypeDef hostUSART3;
+static serialPort_t hostPort;
+int16_t debug[DEBUG16_VALUE_COUNT];
+uint16_t flightModeFlags;
+int16_t rcData[MAX_SUPPORTED_RC_CHANNEL_COUNT];
+int16_t rcCommand[4];
+attitudeEulerAngles_t attitude;
+int32_t accSum[XYZ_AXIS_COUNT];
+int accSumCount;
+float accVelScale;
+static pidProfile_t pidProfileStorage;
+pidProfile_t *pidProfile_ProfileCurrent = &pidProfileStorage;
+
+uint32_t micros(void)
+{
+    return 0;
+}
+
+int32_t altitudeHoldGetEstimatedAltitude(void)
+{
+    return 0;
+}
+
+serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr callback, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    UNUSED(USARTx);
+    UNUSED(callback);
+    UNUSED(baudRate);
+    UNUSED(mode);
+    UNUSED(options);
+    return &hostPort;
+}
+
+uint8_t serialRxBytesWaiting(serialPort_t *instance)
+{
+    UNUSED(instance);
+    const int waiting = rxLength - rxPos;
+    return waiting > 255 ? 255 : waiting;
+}
+
+uint8_t serialRead(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return rxBytes[rxPos++];
+}
+
+uint8_t serialTxBytesFree(serialPort_t *instance)
+{
+    UNUSED(instance);
+    return 255;
+}
+
+void serialWriteBuf(serialPort_t *instance, uint8_t *data, int count)
+{
+    UNUSED(instance);
+    UNUSED(data);
+    UNUSED(count);
+}
+
+static void check(bool condition, const char *what)
+{
+    if (!condition && failures++ < 20) {
+        printf("%s\n", what);
+    }
+}
+
+// Hands bytes to the stubbed port and lets miniflow.c drain them
+static void receive(const uint8_t *bytes, int length)
+{
+    rxBytes = bytes;
+    rxLength = length;
+    rxPos = 0;
+    miniflowProcessRx();
+    check(rxPos == rxLength, "bytes left in the RX ring");
+}
+
+// Payload of frame n the way the board fills it, the sequence rides in the integration timespan bytes
+static void buildPayload(uint8_t *payload, uint16_t n)
+{
+    const int16_t flowX = (int16_t)((n * 37) % 401) - 200;
+    const int16_t flowY = (int16_t)((n * 53) % 301) - 150;
+    payload[0] = flowX;
+    payload[1] = flowX >> 8;
+    payload[2] = flowY;
+    payload[3] = flowY >> 8;
+    payload[4] = n;
+    payload[5] = n >> 8;
+    payload[6] = 120 + n % 7;
+    payload[7] = 0;
+    payload[8] = 255 - n % 16;
+    payload[9] = 1;
+}
+
+static int buildFrame(uint8_t *frame, uint16_t n)
+{
+    frame[0] = MINIFLOW_HEADER_1;
+    frame[1] = MINIFLOW_HEADER_2;
+    buildPayload(&frame[2], n);
+    frame[FRAME_LENGTH - 1] = 0;
+    for (int i = 0; i < MINIFLOW_PAYLOAD_LENGTH; i++) {
+        frame[FRAME_LENGTH - 1] ^= frame[2 + i];
+    }
+    return FRAME_LENGTH;
+}
+
+static bool payloadIs(const miniflowFrame_t *frame, uint16_t n)
+{
+    uint8_t payload[MINIFLOW_PAYLOAD_LENGTH];
+    buildPayload(payload, n);
+    return memcmp(frame->payload, payload, sizeof(payload)) == 0;
+}
+
+// A frame must be one that was sent, the sequence tells which
+static bool payloadWasSent(const miniflowFrame_t *frame)
+{
+    return payloadIs(frame, frame->payload[4] | (frame->payload[5] << 8));
+}
+
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t corrupt;
+} counters_t;
+
+static counters_t countersSince(const counters_t *before)
+{
+    const miniflowStats_t *stats = miniflowGetStats();
+    return (counters_t){ stats->frames - before->frames, stats->dropped - before->dropped, stats->corrupt - before->corrupt };
+}
+
+static counters_t countersNow(void)
+{
+    const counters_t zero = { 0, 0, 0 };
+    return countersSince(&zero);
+}
+
+static void flushFrame(void)
+{
+    miniflowFrame_t frame;
+    miniflowGetFrame(&frame);
+}
+
+static void testClean(void)
+{
+    static uint8_t stream[CLEAN_FRAMES * FRAME_LENGTH];
+    int length = 0;
+    for (int n = 0; n < CLEAN_FRAMES; n++) {
+        length += buildFrame(&stream[length], n);
+    }
+
+    // Random chunks, read after every drain: a chunk that completes k frames drops k - 1 of them
+    const counters_t before = countersNow();
+    uint32_t expectedDropped = 0, received = 0;
+    int pos = 0;
+    while (pos < length) {
+        int chunk = 1 + rand() % 16;
+        if (chunk > length - pos) {
+            chunk = length - pos;
+        }
+        const int framesBefore = pos / FRAME_LENGTH;
+        receive(&stream[pos], chunk);
+        pos += chunk;
+        const int completed = pos / FRAME_LENGTH - framesBefore;
+
+        miniflowFrame_t frame;
+        const bool ready = miniflowGetFrame(&frame);
+        check(ready == (completed > 0), "frame not ready exactly when one completed");
+        if (ready) {
+            received++;
+            expectedDropped += completed - 1;
+            check(payloadIs(&frame, pos / FRAME_LENGTH - 1), "frame payload is not the newest one sent");
+        }
+        check(!miniflowGetFrame(&frame), "frame returned twice");
+    }
+    const counters_t clean = countersSince(&before);
+    check(clean.frames == CLEAN_FRAMES && clean.corrupt == 0, "clean stream not counted as clean frames");
+    check(clean.dropped == expectedDropped && clean.frames - clean.dropped == received, "dropped frames miscounted");
+    printf("clean: %u frames in random chunks, %u read, %u dropped, %u corrupt\n",
+        clean.frames, received, clean.dropped, clean.corrupt);
+
+    // Ten frames in one drain without a read in between
+    const counters_t burstBefore = countersNow();
+    receive(stream, 10 * FRAME_LENGTH);
+    miniflowFrame_t frame;
+    check(miniflowGetFrame(&frame) && payloadIs(&frame, 9), "newest frame of a burst not returned");
+    check(!miniflowGetFrame(&frame), "burst returned more than one frame");
+    const counters_t burst = countersSince(&burstBefore);
+    check(burst.frames == 10 && burst.dropped == 9 && burst.corrupt == 0, "burst drops miscounted");
+}
+
+// Feeds damaged bytes followed by clean frames n + 1 and n + 2, returns the counters and which clean frame came out last
+static counters_t feedDamaged(const uint8_t *damaged, int length, uint16_t n, bool *wrongPayload, int *lastReceived)
+{
+    uint8_t stream[3 * FRAME_LENGTH + 4];
+    memcpy(stream, damaged, length);
+    length += buildFrame(&stream[length], n + 1);
+    length += buildFrame(&stream[length], n + 2);
+
+    const counters_t before = countersNow();
+    *wrongPayload = false;
+    *lastReceived = -1;
+    for (int i = 0; i < length; i++) {
+        receive(&stream[i], 1);
+        miniflowFrame_t frame;
+        if (miniflowGetFrame(&frame)) {
+            *wrongPayload |= !payloadWasSent(&frame);
+            *lastReceived = frame.payload[4] | (frame.payload[5] << 8);
+        }
+    }
+    return countersSince(&before);
+}
+
+static void testDamaged(void)
+{
+    const uint16_t n = 1000;
+    uint8_t frame[FRAME_LENGTH], damaged[FRAME_LENGTH + 4];
+    buildFrame(frame, n);
+    bool wrong;
+    int last;
+    counters_t c;
+
+    // Any single bit flip of payload or checksum is a corrupt frame, a flipped header loses the frame quietly
+    int flips = 0, flipsCorrupt = 0, flipsLost = 0;
+    for (int bit = 0; bit < FRAME_LENGTH * 8; bit++) {
+        memcpy(damaged, frame, FRAME_LENGTH);
+        damaged[bit / 8] ^= 1 << (bit % 8);
+        c = feedDamaged(damaged, FRAME_LENGTH, n, &wrong, &last);
+        const bool inHeader = bit < 16;
+        flips++;
+        flipsCorrupt += c.corrupt;
+        flipsLost += c.frames != 2;
+        check(!wrong && last == n + 2, "parser did not resync after a bit flip");
+        check(c.frames == 2 && c.corrupt == (inHeader ? 0 : 1), "bit flip miscounted");
+    }
+    printf("bit flips: %d, %d counted corrupt, %d cost a clean frame\n", flips, flipsCorrupt, flipsLost);
+
+    // A byte lost from the payload pulls the next header into the checksum, so the next frame goes too
+    for (int drop = 0; drop < FRAME_LENGTH; drop++) {
+        memcpy(damaged, frame, drop);
+        memcpy(&damaged[drop], &frame[drop + 1], FRAME_LENGTH - drop - 1);
+        c = feedDamaged(damaged, FRAME_LENGTH - 1, n, &wrong, &last);
+        check(!wrong && last == n + 2, "parser did not resync after a dropped byte");
+        if (drop < 2) {
+            check(c.frames == 2 && c.corrupt == 0, "dropped header byte miscounted");
+        } else {
+            check(c.frames == 1 && c.corrupt == 1, "dropped payload byte miscounted");
+        }
+    }
+    printf("dropped bytes: a lost header byte costs 1 frame, a lost payload or checksum byte costs 2 and counts 1 corrupt\n");
+
+    // A stray byte before the header is skipped, between the header bytes it loses the frame, later it corrupts it
+    for (int insert = 0; insert <= FRAME_LENGTH; insert++) {
+        memcpy(damaged, frame, insert);
+        damaged[insert] = 0x55;
+        memcpy(&damaged[insert + 1], &frame[insert], FRAME_LENGTH - insert);
+        c = feedDamaged(damaged, FRAME_LENGTH + 1, n, &wrong, &last);
+        check(!wrong && last == n + 2, "parser did not resync after an inserted byte");
+        if (insert == 0 || insert == FRAME_LENGTH) {
+            check(c.frames == 3 && c.corrupt == 0, "byte outside the frame miscounted");
+        } else if (insert == 1) {
+            check(c.frames == 2 && c.corrupt == 0, "byte inside the header miscounted");
+        } else {
+            check(c.frames == 2 && c.corrupt == 1, "byte inside the payload miscounted");
+        }
+    }
+
+    // A frame cut short never comes out and never lets a wrong payload through
+    int truncatedLost = 0;
+    for (int cut = 1; cut < FRAME_LENGTH; cut++) {
+        c = feedDamaged(frame, cut, n, &wrong, &last);
+        check(!wrong && last == n + 2, "parser did not resync after a truncated frame");
+        check(c.frames + c.corrupt <= 2, "truncated frame counted as more than one frame");
+        truncatedLost += 2 - c.frames;
+    }
+    printf("truncated frames: %d cuts, %d clean frames lost behind them\n", FRAME_LENGTH - 1, truncatedLost);
+
+    // 0xFE noise in front of the header still syncs on the last 0xFE 0x0A
+    for (int noise = 1; noise <= 4; noise++) {
+        memset(damaged, MINIFLOW_HEADER_1, noise);
+        memcpy(&damaged[noise], frame, FRAME_LENGTH);
+        c = feedDamaged(damaged, noise + FRAME_LENGTH, n, &wrong, &last);
+        check(!wrong && c.frames == 3 && c.corrupt == 0, "0xFE in front of the header lost the frame");
+    }
+    flushFrame();
+}
+
+// Random bit flips, dropped and inserted bytes at a given byte error rate
+static void testRandomErrors(void)
+{
+    static uint8_t stream[STREAM_MAX];
+    static const double rates[] = { 1e-4, 1e-3, 1e-2 };
+
+    printf("\n  error rate  frames sent  frames  corrupt  dropped  wrong\n");
+    for (unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        int length = 0;
+        for (int n = 0; n < RANDOM_FRAMES; n++) {
+            uint8_t frame[FRAME_LENGTH];
+            buildFrame(frame, n);
+            for (int i = 0; i < FRAME_LENGTH; i++) {
+                if (rand() < rates[r] * RAND_MAX) {
+                    switch (rand() % 3) {
+                    case 0:
+                        stream[length++] = frame[i] ^ (1 << (rand() % 8));
+                        break;
+                    case 1:
+                        break;
+                    default:
+                        stream[length++] = rand();
+                        stream[length++] = frame[i];
+                        break;
+                    }
+                } else {
+                    stream[length++] = frame[i];
+                }
+            }
+        }
+
+        const counters_t before = countersNow();
+        int wrong = 0, pos = 0;
+        while (pos < length) {
+            const int chunk = pos + FRAME_LENGTH < length ? FRAME_LENGTH : length - pos;
+            receive(&stream[pos], chunk);
+            pos += chunk;
+            miniflowFrame_t frame;
+            if (miniflowGetFrame(&frame)) {
+                wrong += !payloadWasSent(&frame);
+            }
+        }
+        const counters_t c = countersSince(&before);
+        printf("  %10.0e  %11d  %6u  %7u  %7u  %5d\n", rates[r], RANDOM_FRAMES, c.frames, c.corrupt, c.dropped, wrong);
+        check(c.frames <= RANDOM_FRAMES + (uint32_t)wrong, "more frames than were sent");
+        check(c.frames + c.corrupt >= RANDOM_FRAMES * (1 - 3 * rates[r] * FRAME_LENGTH), "frames vanished without a count");
+    }
+    printf("wrong: passed the 8 bit XOR checksum without having been sent\n");
+}
+
+int main(void)
+{
+    srand(1);
+
+    Miniflow_init();
+
+    testClean();
+    testDamaged();
+    testRandomErrors();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of nrf_packet.c, the binary NRF24L01 command packet and the sequence tracker the link quality and link
+ * loss decisions are made from.
+ *
+ * Packets: random packets go through nrfPacketEncode() and nrfPacketDecode() and must come back unchanged, with the
+ * channels masked to 11 bits. Every single bit flip and random bursts of up to 16 bits must be rejected, by the
+ * version byte or the CRC.
+ *
+ * Sequence tracker: a controller sends sequence numbers over a simulated link with independent and bursty loss,
+ * duplicates, swapped packets and a controller restart. It checks the lost, duplicate and late counts against what
+ * the link did, and that nrfSequenceLinkDegraded(), which fails nrf_rx() over to the landing logic, stays clear on a
+ * usable link, is set on a bad one and follows a burst of loss in and out within a window.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "rx/nrf_packet.h"
+
+#define ROUND_TRIP_PACKETS 100000
+#define BIT_FLIP_PACKETS 1000
+#define BURST_PACKETS 100000
+#define LOSS_PACKETS 200000
+#define SEQUENCE_WINDOW 32
+#define SETTLE_PACKETS SEQUENCE_WINDOW
+#define MAX_DEGRADE_LATENCY 64      // packets sent into a bad burst until the link counts as lost, it is only
+                                    // noticed on the next packet that gets through
+#define MAX_RECOVER_LATENCY 40      // packets sent after the burst until it counts as usable again
+
+static int failures;
+
+static void fail(const char *what, long expected, long actual)
+{
+    if (failures++ < 20) {
+        printf("%s: expected %ld got %ld\n", what, expected, actual);
+    }
+}
+
+static double randomUnit(void)
+{
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static void randomPacket(nrfPacket_t *packet)
+{
+    packet->sequence = rand();
+    packet->cmd = rand();
+    for (int i = 0; i < NRF_PACKET_CHANNEL_COUNT; i++) {
+        switch (rand() % 4) {
+        case 0:
+            packet->channels[i] = 0;    // not sent
+            break;
+        case 1:
+            packet->channels[i] = rand() & 0xffff;  // out of range, the encoder keeps 11 bits
+            break;
+        default:
+            packet->channels[i] = 1000 + rand() % 1001;
+            break;
+        }
+    }
+    packet->led = rand();
+    packet->ledRgb = rand();
+    packet->beep = rand();
+    packet->key = rand();
+}
+
+static bool packetsEqual(const nrfPacket_t *a, const nrfPacket_t *b)
+{
+    if (a->sequence != b->sequence || a->cmd != b->cmd || a->led != b->led || a->ledRgb != b->ledRgb ||
+        a->beep != b->beep || a->key != b->key) {
+        return false;
+    }
+    for (int i = 0; i < NRF_PACKET_CHANNEL_COUNT; i++) {
+        if ((a->channels[i] & 0x7ff) != b->channels[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testRoundTrip(void)
+{
+    uint8_t buf[NRF_PACKET_SIZE];
+    nrfPacket_t sent, received;
+    int mismatches = 0;
+
+    for (int i = 0; i < ROUND_TRIP_PACKETS; i++) {
+        randomPacket(&sent);
+        nrfPacketEncode(buf, &sent);
+        if (buf[0] == '$') {
+            fail("version byte collides with legacy \"$M<\" packets", '$' + 1, buf[0]);
+        }
+        if (nrfPacketDecode(buf, &received) != NRF_PACKET_OK || !packetsEqual(&sent, &received)) {
+            mismatches++;
+        }
+    }
+    if (mismatches) {
+        fail("round trip mismatches", 0, mismatches);
+    }
+    printf("round trip: %d packets, %d mismatches\n", ROUND_TRIP_PACKETS, mismatches);
+}
+
+static void testCorruption(void)
+{
+    uint8_t buf[NRF_PACKET_SIZE], corrupt[NRF_PACKET_SIZE];
+    nrfPacket_t sent, received;
+    int flips = 0, flipsAccepted = 0, bursts = 0, burstsAccepted = 0;
+
+    for (int i = 0; i < BIT_FLIP_PACKETS; i++) {
+        randomPacket(&sent);
+        nrfPacketEncode(buf, &sent);
+        for (int bit = 0; bit < NRF_PACKET_SIZE * 8; bit++) {
+            memcpy(corrupt, buf, sizeof(buf));
+            corrupt[bit / 8] ^= 1 << (bit % 8);
+            const nrfPacketStatus_e status = nrfPacketDecode(corrupt, &received);
+            const nrfPacketStatus_e expected = bit < 8 ? NRF_PACKET_BAD_VERSION : NRF_PACKET_BAD_CRC;
+            flips++;
+            if (status != expected) {
+                flipsAccepted++;
+            }
+        }
+    }
+
+    // Error bursts no longer than the CRC, starting and ending on a flipped bit
+    for (int i = 0; i < BURST_PACKETS; i++) {
+        randomPacket(&sent);
+        nrfPacketEncode(buf, &sent);
+        memcpy(corrupt, buf, sizeof(buf));
+        const int length = 1 + rand() % 16;
+        const int start = 8 + rand() % (NRF_PACKET_SIZE * 8 - 8 - length + 1);
+        for (int bit = start; bit < start + length; bit++) {
+            if (bit == start || bit == start + length - 1 || (rand() & 1)) {
+                corrupt[bit / 8] ^= 1 << (bit % 8);
+            }
+        }
+        bursts++;
+        if (nrfPacketDecode(corrupt, &received) == NRF_PACKET_OK) {
+            burstsAccepted++;
+        }
+    }
+
+    if (flipsAccepted) {
+        fail("single bit flips not rejected", 0, flipsAccepted);
+    }
+    if (burstsAccepted) {
+        fail("bursts of up to 16 bits not rejected", 0, burstsAccepted);
+    }
+    printf("corruption: %d single bit flips, %d bursts of 1-16 bits, %d accepted\n",
+        flips, bursts, flipsAccepted + burstsAccepted);
+}
+
+typedef struct {
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t trackerLost;
+    uint32_t duplicates;
+    uint32_t late;
+    uint32_t degradedPackets;       // delivered packets after which the tracker reported the link degraded
+    uint32_t settledPackets;
+} linkRun_t;
+
+static void deliver(nrfSequenceTracker_t *tracker, linkRun_t *run, uint8_t sequence)
+{
+    uint8_t lost;
+
+    switch (nrfSequenceUpdate(tracker, sequence, &lost)) {
+    case NRF_SEQUENCE_DUPLICATE:
+        run->duplicates++;
+        break;
+    case NRF_SEQUENCE_LATE:
+        run->late++;
+        break;
+    default:
+        run->trackerLost += lost;
+        break;
+    }
+    run->delivered++;
+    if (run->sent > SETTLE_PACKETS) {
+        run->settledPackets++;
+        run->degradedPackets += nrfSequenceLinkDegraded(tracker);
+    }
+}
+
+// Independent loss with probability lossRate per packet
+static linkRun_t runIndependentLoss(double lossRate)
+{
+    nrfSequenceTracker_t tracker;
+    linkRun_t run = { 0 };
+
+    nrfSequenceReset(&tracker);
+    for (int i = 0; i < LOSS_PACKETS; i++) {
+        const uint8_t sequence = run.sent++;
+        if (randomUnit() >= lossRate) {
+            deliver(&tracker, &run, sequence);
+        }
+    }
+    return run;
+}
+
+static void testIndependentLoss(void)
+{
+    static const double lossRates[] = { 0.0, 0.05, 0.1, 0.2, 0.3, 0.5, 0.6, 0.7, 0.8, 0.9 };
+
+    printf("\n%10s %10s %10s %12s %10s\n", "loss %", "delivered", "lost", "tracker lost", "degraded %");
+    for (unsigned i = 0; i < sizeof(lossRates) / sizeof(lossRates[0]); i++) {
+        const linkRun_t run = runIndependentLoss(lossRates[i]);
+        const uint32_t lost = run.sent - run.delivered;
+        const double degraded = run.settledPackets ? 100.0 * run.degradedPackets / run.settledPackets : 100.0;
+
+        printf("%10.0f %10u %10u %12u %10.2f\n", lossRates[i] * 100, run.delivered, lost, run.trackerLost, degraded);
+
+        // Trailing losses after the last delivered packet are not seen yet, and gaps of 128 or more look like a restart
+        if (lossRates[i] <= 0.6 && (run.trackerLost > lost || lost - run.trackerLost > 64)) {
+            fail("tracker lost count", lost, run.trackerLost);
+        }
+        if (run.duplicates || run.late) {
+            fail("duplicates or late packets on an in order link", 0, run.duplicates + run.late);
+        }
+        if (lossRates[i] <= 0.3 && run.degradedPackets) {
+            fail("usable link reported degraded, packets", 0, run.degradedPackets);
+        }
+        if (lossRates[i] >= 0.8 && degraded < 99.0) {
+            fail("bad link not reported degraded, percent", 100, (long)degraded);
+        }
+    }
+}
+
+// A clean link with one burst at 90% loss, the degraded flag has to follow it in and out
+static void testBurst(void)
+{
+    nrfSequenceTracker_t tracker;
+    linkRun_t run = { 0 };
+    const int burstStart = 1000, burstLength = 500, burstEnd = burstStart + burstLength;
+    int degradedAt = -1, recoveredAt = -1;
+
+    nrfSequenceReset(&tracker);
+    for (int i = 0; i < burstEnd + 1000; i++) {
+        const bool inBurst = i >= burstStart && i < burstEnd;
+        const uint8_t sequence = run.sent++;
+        if (randomUnit() >= (inBurst ? 0.9 : 0.02)) {
+            deliver(&tracker, &run, sequence);
+            if (i >= burstStart && degradedAt < 0 && nrfSequenceLinkDegraded(&tracker)) {
+                degradedAt = i - burstStart;
+            }
+            if (i >= burstEnd && recoveredAt < 0 && !nrfSequenceLinkDegraded(&tracker)) {
+                recoveredAt = i - burstEnd;
+            }
+        }
+    }
+
+    printf("\nburst of %d packets at 90%% loss: degraded after %d packets, usable %d packets after it ended\n",
+        burstLength, degradedAt, recoveredAt);
+    if (degradedAt < 0 || degradedAt > MAX_DEGRADE_LATENCY) {
+        fail("packets into the burst until degraded", MAX_DEGRADE_LATENCY, degradedAt);
+    }
+    if (recoveredAt < 0 || recoveredAt > MAX_RECOVER_LATENCY) {
+        fail("packets after the burst until usable", MAX_RECOVER_LATENCY, recoveredAt);
+    }
+}
+
+// Duplicated and swapped packets, then the controller restarts its sequence
+static void testReorderAndRestart(void)
+{
+    nrfSequenceTracker_t tracker;
+    linkRun_t run = { 0 };
+    uint32_t duplicated = 0, swapped = 0;
+    uint8_t sequence = 0;
+
+    nrfSequenceReset(&tracker);
+    for (int i = 0; i < LOSS_PACKETS / 2; i++) {
+        const int event = rand() % 100;
+        if (event < 3) {
+            deliver(&tracker, &run, sequence);
+            deliver(&tracker, &run, sequence);
+            duplicated++;
+            sequence++;
+        } else if (event < 6) {
+            // the second one overtakes the first, which arrives late and counted as lost
+            deliver(&tracker, &run, sequence + 1);
+            deliver(&tracker, &run, sequence);
+            swapped++;
+            sequence += 2;
+        } else {
+            deliver(&tracker, &run, sequence);
+            sequence++;
+        }
+        run.sent = i + 1;
+    }
+    if (run.duplicates != duplicated || run.late != swapped || run.trackerLost != swapped) {
+        printf("duplicates %u of %u, late %u of %u, lost %u\n", run.duplicates, duplicated, run.late, swapped, run.trackerLost);
+        fail("duplicate, late and lost counts", 3 * swapped + duplicated, run.duplicates + run.late + run.trackerLost);
+    }
+    if (run.degradedPackets) {
+        fail("reordering reported as a degraded link, packets", 0, run.degradedPackets);
+    }
+
+    // A restart steps the sequence far back, it is accepted rather than taken as late packets
+    uint8_t lost;
+    const nrfSequenceResult_e restart = nrfSequenceUpdate(&tracker, sequence - 100, &lost);
+    if (restart != NRF_SEQUENCE_ACCEPT || lost != 0) {
+        fail("controller restart accepted", NRF_SEQUENCE_ACCEPT, restart);
+    }
+
+    // After a reset, e.g. a link timeout, the link has to prove itself before it is flown on again
+    nrfSequenceReset(&tracker);
+    int packetsUntilUsable = 0;
+    do {
+        nrfSequenceUpdate(&tracker, sequence++, &lost);
+        packetsUntilUsable++;
+    } while (nrfSequenceLinkDegraded(&tracker) && packetsUntilUsable < 100);
+    if (packetsUntilUsable != SEQUENCE_WINDOW * NRF_LINK_QUALITY_REGAINED / 100) {
+        fail("packets after a reset until usable", SEQUENCE_WINDOW * NRF_LINK_QUALITY_REGAINED / 100, packetsUntilUsable);
+    }
+
+    printf("\nreordering: %u duplicated, %u swapped, counted %u duplicates, %u late; usable %d packets after a reset\n",
+        duplicated, swapped, run.duplicates, run.late, packetsUntilUsable);
+}
+
+int main(void)
+{
+    srand(1);
+
+    testRoundTrip();
+    testCorruption();
+    testIndependentLoss();
+    testBurst();
+    testReorderAndRestart();
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of nrf_telemetry.c, the telemetry frames carried on NRF24L01 ACK payloads. The flight controller state the
+ * frames are built from is set by the test, every frame is decoded back and compared. It checks that:
+ *
+ * - every frame fits NRF_TELEMETRY_MAX_FRAME_SIZE, nothing is written past it, and an ACK payload holds the largest
+ * - byte 0 carries the frame type in the low nibble and a sequence that counts up by one per frame and wraps at 16
+ * - the fields decode to the values they were built from, including negative angles and heights and link counters
+ *   truncated to 16 bits
+ * - the slot multiplexer sends attitude in every other slot and every other frame type once per schedule round
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "drivers/nrf2401.h"
+
+#include "telemetry/nrf_telemetry.h"
+
+#define ACK_PAYLOAD_SIZE 32
+#define GUARD_BYTE 0xA5
+#define SCHEDULE_ROUNDS 100
+#define RANDOM_FRAMES 100000
+
+static const char *frameNames[NRF_TELEMETRY_FRAME_COUNT] = { "attitude", "altitude", "battery", "link" };
+
+// Payload sizes after the header byte, as documented in nrf_telemetry.h
+static const uint8_t framePayloadSizes[NRF_TELEMETRY_FRAME_COUNT] = { 9, 5, 4, 9 };
+
+// What nrf_telemetry.c expects from the rest of the firmware
+golbal_flag flag;
+dataPackage mspData;
+static nrfLinkStats_t linkStats;
+static uint8_t linkQuality;
+
+const nrfLinkStats_t *nrfGetLinkStats(void)
+{
+    return &linkStats;
+}
+
+uint8_t nrfGetLinkQuality(void)
+{
+    return linkQuality;
+}
+
+static int failures;
+
+static void fail(const char *frame, const char *what, long expected, long actual)
+{
+    if (failures++ < 20) {
+        printf("%s frame: %s, expected %ld got %ld\n", frame, what, expected, actual);
+    }
+}
+
+static uint16_t readU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#define CHECK_FIELD(expected, actual, what) \
+    do { if ((long)(expected) != (long)(actual)) fail(name, what, (long)(expected), (long)(actual)); } while (0)
+
+// Decodes buf and compares it with the state the frame was built from
+static void checkFrame(const uint8_t *buf, uint8_t length, nrfTelemetryFrame_e frame)
+{
+    const char *name = frameNames[frame];
+    const uint8_t *p = buf + 1;
+
+    CHECK_FIELD(1 + framePayloadSizes[frame], length, "length");
+    CHECK_FIELD(frame, buf[0] & 0x0f, "type");
+
+    switch (frame) {
+    case NRF_TELEMETRY_ATTITUDE:
+        CHECK_FIELD(flag.roll1, (int16_t)readU16(p), "roll");
+        CHECK_FIELD(flag.pitch1, (int16_t)readU16(p + 2), "pitch");
+        CHECK_FIELD(flag.yaw1, (int16_t)readU16(p + 4), "yaw");
+        CHECK_FIELD(mspData.mspCmd, readU16(p + 6), "mspCmd");
+        CHECK_FIELD(mspData.key, p[8], "key");
+        break;
+    case NRF_TELEMETRY_ALTITUDE:
+        CHECK_FIELD((int32_t)flag.height, (int32_t)readU32(p), "height");
+        CHECK_FIELD(flag.alt, p[4], "alt");
+        break;
+    case NRF_TELEMETRY_BATTERY:
+        CHECK_FIELD(flag.batt, readU16(p), "batt");
+        CHECK_FIELD(flag.batt_low, p[2], "batt_low");
+        CHECK_FIELD(flag.version, p[3], "version");
+        break;
+    case NRF_TELEMETRY_LINK:
+        CHECK_FIELD(linkStats.rxPackets & 0xffff, readU16(p), "rx packets");
+        CHECK_FIELD(linkStats.ackPayloads & 0xffff, readU16(p + 2), "ack payloads");
+        CHECK_FIELD(linkStats.ackPending & 0xffff, readU16(p + 4), "ack pending");
+        CHECK_FIELD(linkStats.lost & 0xffff, readU16(p + 6), "lost");
+        CHECK_FIELD(linkQuality, p[8], "link quality");
+        break;
+    default:
+        break;
+    }
+}
+
+static void randomiseState(void)
+{
+    flag.roll1 = rand() % 3601 - 1800;
+    flag.pitch1 = rand() % 3601 - 1800;
+    flag.yaw1 = rand() % 3601 - 1800;
+    flag.height = (rand() % 2000001 - 1000000) / 7.0f;
+    flag.alt = rand() & 1;
+    flag.batt = rand() % 500;
+    flag.batt_low = rand() & 1;
+    flag.version = rand() & 0xff;
+    mspData.mspCmd = rand() & 0xffff;
+    mspData.key = rand() & 0xff;
+    linkStats.rxPackets = ((uint32_t)rand() << 8) ^ rand();
+    linkStats.ackPayloads = ((uint32_t)rand() << 8) ^ rand();
+    linkStats.ackPending = rand() & 0xfffff;
+    linkStats.lost = ((uint32_t)rand() << 8) ^ rand();
+    linkQuality = rand() % 101;
+}
+
+// Builds one frame into an ACK payload sized buffer and checks nothing past NRF_TELEMETRY_MAX_FRAME_SIZE was touched
+static uint8_t buildFrame(uint8_t *buf, nrfTelemetryFrame_e frame)
+{
+    memset(buf, GUARD_BYTE, ACK_PAYLOAD_SIZE);
+    const uint8_t length = nrfTelemetryBuildFrame(buf, frame);
+
+    if (length > NRF_TELEMETRY_MAX_FRAME_SIZE) {
+        fail(frame < NRF_TELEMETRY_FRAME_COUNT ? frameNames[frame] : "invalid", "longer than NRF_TELEMETRY_MAX_FRAME_SIZE",
+            NRF_TELEMETRY_MAX_FRAME_SIZE, length);
+    }
+    for (int i = NRF_TELEMETRY_MAX_FRAME_SIZE; i < ACK_PAYLOAD_SIZE; i++) {
+        if (buf[i] != GUARD_BYTE) {
+            fail(frame < NRF_TELEMETRY_FRAME_COUNT ? frameNames[frame] : "invalid", "written past NRF_TELEMETRY_MAX_FRAME_SIZE",
+                NRF_TELEMETRY_MAX_FRAME_SIZE, i);
+            break;
+        }
+    }
+    return length;
+}
+
+int main(void)
+{
+    uint8_t buf[ACK_PAYLOAD_SIZE];
+    uint32_t slots[NRF_TELEMETRY_FRAME_COUNT] = { 0 };
+    int largestFrame = 0;
+
+    srand(1);
+
+    if (NRF_TELEMETRY_MAX_FRAME_SIZE > ACK_PAYLOAD_SIZE) {
+        fail("any", "NRF_TELEMETRY_MAX_FRAME_SIZE doesn't fit an ACK payload", ACK_PAYLOAD_SIZE, NRF_TELEMETRY_MAX_FRAME_SIZE);
+    }
+
+    // The sequence is shared by all frame types, sync to it with the first frame
+    uint8_t sequence = (buildFrame(buf, NRF_TELEMETRY_ATTITUDE), buf[0] >> 4);
+
+    // Slot multiplexer: attitude every other slot, the others once per round of the schedule
+    int scheduleLength = 0;
+    int lastAttitudeSlot = -1;
+    int maxAttitudeGap = 0;
+    for (int slot = 0; slot < SCHEDULE_ROUNDS * 6; slot++) {
+        const nrfTelemetryFrame_e frame = nrfTelemetryNextFrame();
+        if (frame >= NRF_TELEMETRY_FRAME_COUNT) {
+            fail("scheduled", "frame type out of range", NRF_TELEMETRY_FRAME_COUNT - 1, frame);
+            continue;
+        }
+        slots[frame]++;
+        if (frame == NRF_TELEMETRY_ATTITUDE) {
+            if (lastAttitudeSlot >= 0 && slot - lastAttitudeSlot > maxAttitudeGap) {
+                maxAttitudeGap = slot - lastAttitudeSlot;
+            }
+            lastAttitudeSlot = slot;
+        }
+
+        randomiseState();
+        const uint8_t length = buildFrame(buf, frame);
+        checkFrame(buf, length, frame);
+
+        sequence = (sequence + 1) & 0x0f;
+        if ((buf[0] >> 4) != sequence) {
+            fail(frameNames[frame], "sequence", sequence, buf[0] >> 4);
+        }
+        if (length > largestFrame) {
+            largestFrame = length;
+        }
+    }
+    for (int frame = 1; frame < NRF_TELEMETRY_FRAME_COUNT; frame++) {
+        scheduleLength += slots[frame];
+    }
+    if (slots[NRF_TELEMETRY_ATTITUDE] != (uint32_t)scheduleLength || maxAttitudeGap != 2) {
+        fail("attitude", "not in every other slot", scheduleLength, slots[NRF_TELEMETRY_ATTITUDE]);
+    }
+    for (int frame = 1; frame < NRF_TELEMETRY_FRAME_COUNT; frame++) {
+        if (slots[frame] != SCHEDULE_ROUNDS) {
+            fail(frameNames[frame], "slots per schedule round", SCHEDULE_ROUNDS, slots[frame]);
+        }
+    }
+
+    // Every frame type with random state, including the extremes
+    for (int i = 0; i < RANDOM_FRAMES; i++) {
+        const nrfTelemetryFrame_e frame = rand() % NRF_TELEMETRY_FRAME_COUNT;
+        randomiseState();
+        if (i % 10 == 0) {
+            flag.roll1 = flag.pitch1 = flag.yaw1 = (i & 0x10) ? INT16_MIN : INT16_MAX;
+            flag.height = (i & 0x10) ? -2.0e9f : 2.0e9f;
+            linkStats.rxPackets = linkStats.ackPayloads = linkStats.ackPending = linkStats.lost = UINT32_MAX;
+        }
+        const uint8_t length = buildFrame(buf, frame);
+        checkFrame(buf, length, frame);
+        sequence = (sequence + 1) & 0x0f;
+        if ((buf[0] >> 4) != sequence) {
+            fail(frameNames[frame], "sequence", sequence, buf[0] >> 4);
+        }
+    }
+
+    // An unknown type still gets its header and nothing else
+    const uint8_t length = buildFrame(buf, NRF_TELEMETRY_FRAME_COUNT);
+    if (length != 1 || (buf[0] & 0x0f) != NRF_TELEMETRY_FRAME_COUNT) {
+        fail("invalid", "header only", 1, length);
+    }
+
+    printf("schedule:");
+    for (int frame = 0; frame < NRF_TELEMETRY_FRAME_COUNT; frame++) {
+        printf(" %s %u", frameNames[frame], slots[frame]);
+    }
+    printf(" slots\nlargest frame %d of NRF_TELEMETRY_MAX_FRAME_SIZE %d, ACK payload %d bytes\n",
+        largestFrame, NRF_TELEMETRY_MAX_FRAME_SIZE, ACK_PAYLOAD_SIZE);
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the target headers, the NRF24L01 is reached through the SPI and GPIO calls the test implements
+
+#define TARGET_BOARD_IDENTIFIER "HOST"
+
+#define NRF
+#define VerSion 112
+
+typedef enum {
+    DISABLE = 0,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+typedef enum {
+    Mode_AIN = 0x0,
+    Mode_IN_FLOATING = 0x04,
+    Mode_Out_PP = 0x10,
+} GPIO_Mode;
+
+typedef enum {
+    EXTI_Trigger_Rising = 0x08,
+    EXTI_Trigger_Falling = 0x0C,
+} EXTITrigger_TypeDef;
+
+typedef struct {
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+    volatile uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef struct {
+    void *test;
+} TIM_TypeDef;
+
+typedef struct {
+    void *test;
+} SPI_TypeDef;
+
+typedef struct {
+    void *test;
+} I2C_TypeDef;
+
+extern GPIO_TypeDef hostGPIOB;
+extern GPIO_TypeDef hostGPIOC;
+extern SPI_TypeDef hostSPI2;
+#define GPIOB (&hostGPIOB)
+#define GPIOC (&hostGPIOC)
+#define SPI2 (&hostSPI2)
+
+#define GPIO_Pin_1  0x0002
+#define GPIO_Pin_2  0x0004
+#define GPIO_Pin_3  0x0008
+#define GPIO_Pin_4  0x0010
+#define GPIO_Pin_5  0x0020
+#define GPIO_Pin_12 0x1000
+
+#define RCC_AHBPeriph_GPIOB 0x00040000
+#define RCC_AHBPeriph_GPIOC 0x00080000
+
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t pins);
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t pins);
+
+// Never reached by the test, NRF24L01_INIT() is not called on the host
+static inline void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state) { (void)periph; (void)state; }
+static inline void FLASH_Unlock(void) {}
+static inline void FLASH_Lock(void) {}
+static inline int FLASH_ErasePage(uint32_t address) { (void)address; return 0; }
+static inline int FLASH_ProgramWord(uint32_t address, uint32_t data) { (void)address; (void)data; return 0; }
+
+#define NVIC_PriorityGroup_2 0x500
+
+// nrf2401.c calls these without including their headers
+void mwArm(void);
+void mwDisarm(void);
+void accSetCalibrationCycles(uint16_t calibrationCyclesRequired);
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the target pin list io_def.h includes
+
+#define TARGET_IO_PORTB 0xffff
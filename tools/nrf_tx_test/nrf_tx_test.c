@@ -0,0 +1,442 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of the NRF24L01 telemetry TX state machine in nrf2401.c. The chip is mocked at the SPI command level
+ * behind spiTransferByte()/spiTransfer() and the CSN pin, with its STATUS, FIFO_STATUS and OBSERVE_TX registers, the
+ * TX and RX FIFOs and the active low IRQ line. The test decides what happens on air and fires the EXTI handler
+ * nrf24l01HardwareInit() registered on the falling edge of IRQ, the way the target does.
+ *
+ * It checks that:
+ *
+ * - nrf_tx() loads one payload and puts the radio in PTX, a second call while in flight does nothing
+ * - while in flight nrfTxUpdate() and nrf_rx() leave SPI2 alone and no RX frame is reported pending
+ * - TX_DS counts as sent, MAX_RT as failed with the TX FIFO flushed, both add ARC_CNT to the retransmits
+ * - without an IRQ the transmission times out after NRF_TX_TIMEOUT_US, also across a micros() wrap
+ * - every outcome clears STATUS so IRQ goes high again, and the radio is back in PRX with an empty TX FIFO
+ * - a packet received after the turnaround is reported pending again
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <platform.h>
+
+#include "drivers/gpio.h"
+#include "drivers/io.h"
+#include "drivers/exti.h"
+#include "drivers/nrf2401.h"
+
+#include "io/beeper.h"
+
+#include "telemetry/nrf_telemetry.h"
+
+#define TX_TIMEOUT_US 8000      // NRF_TX_TIMEOUT_US in nrf2401.c
+#define PRIM_RX 0x01
+#define MASK_RX_DR 0x40
+#define MAX_RETRANSMITS 10      // SETUP_RETR 0x1a
+#define FIFO_DEPTH 3
+#define ROUNDS 3
+
+GPIO_TypeDef hostGPIOB;
+GPIO_TypeDef hostGPIOC;
+SPI_TypeDef hostSPI2;
+
+// Defined in nrf2401.c, not exported by its header
+extern uint8_t TXData[TX_PLOAD_WIDTH];
+
+static uint32_t microsNow;
+static int failures;
+
+// The mocked NRF24L01
+static struct {
+    uint8_t regs[32];
+    uint8_t txFifo[FIFO_DEPTH][TX_PLOAD_WIDTH];
+    int txCount;
+    uint8_t rxFifo[FIFO_DEPTH][RX_PLOAD_WIDTH];
+    int rxCount;
+
+    bool selected;
+    int command;
+    int index;
+    uint8_t payload[TX_PLOAD_WIDTH];
+
+    uint32_t transactions;
+    uint32_t txPayloadWrites;
+    uint32_t txFlushes;
+} nrf;
+
+static extiCallbackRec_t *irqHandler;
+
+static uint8_t fifoStatus(void)
+{
+    return (nrf.txCount == 0 ? FIFO_TX_EMPTY : 0) | (nrf.txCount == FIFO_DEPTH ? FIFO_TX_FULL : 0) |
+        (nrf.rxCount == 0 ? FIFO_RX_EMPTY : 0) | (nrf.rxCount == FIFO_DEPTH ? 0x02 : 0);
+}
+
+static uint8_t readRegister(uint8_t reg)
+{
+    switch (reg) {
+    case FIFO_STATUS:
+        return fifoStatus();
+    case NRFRegSTATUS:
+        // RX_P_NO reads 7 when the RX FIFO is empty
+        return (nrf.regs[NRFRegSTATUS] & 0x70) | (nrf.rxCount ? 0 : 0x0e) | (nrf.txCount == FIFO_DEPTH ? 0x01 : 0);
+    default:
+        return nrf.regs[reg];
+    }
+}
+
+static void writeRegister(uint8_t reg, uint8_t value)
+{
+    if (reg == NRFRegSTATUS) {
+        nrf.regs[NRFRegSTATUS] &= ~(value & (RX_OK | TX_OK | MAX_TX));
+    } else {
+        nrf.regs[reg] = value;
+    }
+}
+
+// IRQ is active low, any unmasked interrupt flag pulls it down
+static bool irqLineHigh(void)
+{
+    const uint8_t masked = nrf.regs[NRFRegSTATUS] & ~nrf.regs[CONFIG] & (RX_OK | TX_OK | MAX_TX);
+    return masked == 0;
+}
+
+static uint8_t spiExchange(uint8_t in)
+{
+    if (!nrf.selected) {
+        printf("SPI2 clocked with CSN high\n");
+        failures++;
+        return 0xff;
+    }
+    const int index = nrf.index++;
+    if (index == 0) {
+        nrf.command = in;
+        nrf.transactions++;
+        switch (in) {
+        case FLUSH_TX:
+            nrf.txCount = 0;
+            nrf.txFlushes++;
+            break;
+        case FLUSH_RX:
+            nrf.rxCount = 0;
+            break;
+        }
+        return readRegister(NRFRegSTATUS);
+    }
+
+    const int command = nrf.command;
+    const int data = index - 1;
+    if (command < NRF_WRITE_REG) {
+        return readRegister(command);
+    }
+    if (command < 0x40) {
+        // multi-byte address registers only keep their first byte here, the test doesn't look at addresses
+        if (data == 0) {
+            writeRegister(command & 0x1f, in);
+        }
+        return 0;
+    }
+    if (command == RD_RX_PLOAD && data < RX_PLOAD_WIDTH) {
+        return nrf.rxCount ? nrf.rxFifo[0][data] : 0;
+    }
+    if (command == R_RX_PL_WID) {
+        return RX_PLOAD_WIDTH;
+    }
+    if ((command == WR_TX_PLOAD || (command & 0xf8) == W_ACK_PAYLOAD) && data < TX_PLOAD_WIDTH) {
+        nrf.payload[data] = in;
+    }
+    return 0;
+}
+
+static void spiDeselect(void)
+{
+    const int length = nrf.index - 1;
+    if (nrf.command == RD_RX_PLOAD && nrf.rxCount) {
+        memmove(nrf.rxFifo[0], nrf.rxFifo[1], sizeof(nrf.rxFifo[0]) * (FIFO_DEPTH - 1));
+        nrf.rxCount--;
+    }
+    if ((nrf.command == WR_TX_PLOAD || (nrf.command & 0xf8) == W_ACK_PAYLOAD) && length > 0 && nrf.txCount < FIFO_DEPTH) {
+        memcpy(nrf.txFifo[nrf.txCount++], nrf.payload, TX_PLOAD_WIDTH);
+        nrf.txPayloadWrites++;
+        if (!(nrf.regs[CONFIG] & PRIM_RX)) {
+            // ARC_CNT restarts with every new packet
+            nrf.regs[OBSERVE_TX] &= 0xf0;
+        }
+    }
+    nrf.selected = false;
+}
+
+// What nrf2401.c expects from the rest of the firmware
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t pins)
+{
+    if (GPIOx == GPIOB && (pins & GPIO_Pin_12) && nrf.selected) {
+        spiDeselect();
+    }
+}
+
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t pins)
+{
+    if (GPIOx == GPIOB && (pins & GPIO_Pin_12)) {
+        nrf.selected = true;
+        nrf.index = 0;
+    }
+}
+
+uint8_t spiTransferByte(SPI_TypeDef *instance, uint8_t in)
+{
+    (void)instance;
+    return spiExchange(in);
+}
+
+void spiTransfer(SPI_TypeDef *instance, uint8_t *out, const uint8_t *in, int len)
+{
+    (void)instance;
+    for (int i = 0; i < len; i++) {
+        const uint8_t b = spiExchange(in ? in[i] : 0xff);
+        if (out) {
+            out[i] = b;
+        }
+    }
+}
+
+bool IORead(IO_t io)
+{
+    (void)io;
+    return irqLineHigh();
+}
+
+IO_t IOGetByTag(ioTag_t tag)
+{
+    return (IO_t)(uintptr_t)tag;
+}
+
+void EXTIHandlerInit(extiCallbackRec_t *cb, extiHandlerCallback *fn)
+{
+    cb->fn = fn;
+    irqHandler = cb;
+}
+
+void EXTIConfig(IO_t io, extiCallbackRec_t *cb, int irqPriority, EXTITrigger_TypeDef trigger) { (void)io; (void)cb; (void)irqPriority; (void)trigger; }
+void EXTIEnable(IO_t io, bool enable) { (void)io; (void)enable; }
+void gpioInit(GPIO_TypeDef *gpio, const gpio_config_t *config) { (void)gpio; (void)config; }
+void delay(uint32_t ms) { (void)ms; }
+void delayMicroseconds(uint32_t us) { (void)us; }
+uint32_t micros(void) { return microsNow; }
+void beeper(beeperMode_e mode) { (void)mode; }
+void rcLatencyFrameReceived(uint32_t frameTime) { (void)frameTime; }
+bool coprocessorGetFrame(package_328p *dst) { dst->cmd = 255; return false; }
+void mwArm(void) {}
+void mwDisarm(void) {}
+void accSetCalibrationCycles(uint16_t calibrationCyclesRequired) { (void)calibrationCyclesRequired; }
+
+// The air side: the transmission ends, the chip raises its flags and IRQ falls if they aren't masked
+static void airComplete(uint8_t statusFlag, uint8_t retransmits)
+{
+    const bool wasHigh = irqLineHigh();
+
+    nrf.regs[OBSERVE_TX] = (nrf.regs[OBSERVE_TX] & 0xf0) | retransmits;
+    nrf.regs[NRFRegSTATUS] |= statusFlag;
+    if (statusFlag == TX_OK && nrf.txCount) {
+        memmove(nrf.txFifo[0], nrf.txFifo[1], sizeof(nrf.txFifo[0]) * (FIFO_DEPTH - 1));
+        nrf.txCount--;
+    }
+    if (wasHigh && !irqLineHigh()) {
+        irqHandler->fn(irqHandler);
+    }
+}
+
+static void airReceive(void)
+{
+    const bool wasHigh = irqLineHigh();
+
+    if (nrf.rxCount < FIFO_DEPTH) {
+        memset(nrf.rxFifo[nrf.rxCount], 0, RX_PLOAD_WIDTH);
+        memcpy(nrf.rxFifo[nrf.rxCount], "$M<", 4);
+        nrf.rxCount++;
+    }
+    nrf.regs[NRFRegSTATUS] |= RX_OK;
+    if (wasHigh && !irqLineHigh()) {
+        irqHandler->fn(irqHandler);
+    }
+}
+
+static void check(bool condition, const char *scenario, const char *what)
+{
+    if (!condition) {
+        printf("%s: %s\n", scenario, what);
+        failures++;
+    }
+}
+
+static void startTransmission(const char *scenario)
+{
+    SetTX_Mode();
+    check(!(nrf.regs[CONFIG] & PRIM_RX), scenario, "radio not in PTX after SetTX_Mode()");
+
+    const uint32_t writes = nrf.txPayloadWrites;
+    nrf_tx();
+    check(nrfGetTxState() == NRF_TX_IN_FLIGHT, scenario, "not in flight after nrf_tx()");
+    check(nrf.txPayloadWrites == writes + 1 && nrf.txCount == 1, scenario, "nrf_tx() didn't load exactly one payload");
+    check(memcmp(nrf.txFifo[0], TXData, TX_PLOAD_WIDTH) == 0, scenario, "TX FIFO doesn't hold TXData");
+    check(irqLineHigh(), scenario, "IRQ low after nrf_tx() cleared STATUS");
+
+    nrf_tx();
+    check(nrf.txPayloadWrites == writes + 1, scenario, "nrf_tx() loaded a payload while in flight");
+
+    // Nothing happens on air yet: no SPI traffic from the per loop calls
+    const uint32_t transactions = nrf.transactions;
+    for (int i = 0; i < 10; i++) {
+        microsNow += 125;
+        nrfTxUpdate(microsNow);
+        check(nrf_rx(), scenario, "link reported lost while in flight");
+        check(!nrfRxFramePending(), scenario, "RX frame pending while in flight");
+    }
+    check(nrf.transactions == transactions, scenario, "SPI2 used while waiting for the IRQ");
+    check(nrfGetTxState() == NRF_TX_IN_FLIGHT, scenario, "left flight before the IRQ or the timeout");
+}
+
+static void checkBackInRx(const char *scenario)
+{
+    check(nrfGetTxState() == NRF_TX_IDLE, scenario, "still in flight");
+    check((nrf.regs[NRFRegSTATUS] & (TX_OK | MAX_TX)) == 0, scenario, "TX_DS/MAX_RT not cleared");
+    check(irqLineHigh(), scenario, "IRQ still low, the next falling edge would be missed");
+    check(nrf.regs[CONFIG] & PRIM_RX, scenario, "radio not back in PRX");
+    check(nrf.txCount == 0, scenario, "TX FIFO not empty");
+
+    // The next packet from the controller is seen again
+    airReceive();
+    check(nrfRxFramePending(), scenario, "packet after the turnaround not reported pending");
+    check(nrf_rx(), scenario, "packet after the turnaround not received");
+    check(nrf.rxCount == 0 && irqLineHigh(), scenario, "RX FIFO not drained");
+}
+
+static void testSent(void)
+{
+    const char *scenario = "TX_DS";
+    const nrfLinkStats_t before = *nrfGetLinkStats();
+
+    startTransmission(scenario);
+    airComplete(TX_OK, 2);
+    check(!nrfRxFramePending(), scenario, "TX_DS taken for a received frame");
+    nrfTxUpdate(microsNow);
+
+    const nrfLinkStats_t *stats = nrfGetLinkStats();
+    check(stats->sent == before.sent + 1 && stats->failed == before.failed && stats->timeouts == before.timeouts,
+        scenario, "not counted as sent");
+    check(stats->retransmits == before.retransmits + 2, scenario, "ARC_CNT not added to the retransmits");
+    checkBackInRx(scenario);
+}
+
+static void testMaxRetransmits(void)
+{
+    const char *scenario = "MAX_RT";
+    const nrfLinkStats_t before = *nrfGetLinkStats();
+
+    startTransmission(scenario);
+    const uint32_t flushes = nrf.txFlushes;
+    airComplete(MAX_TX, MAX_RETRANSMITS);
+    nrfTxUpdate(microsNow);
+
+    const nrfLinkStats_t *stats = nrfGetLinkStats();
+    check(stats->failed == before.failed + 1 && stats->sent == before.sent && stats->timeouts == before.timeouts,
+        scenario, "not counted as failed");
+    check(stats->retransmits == before.retransmits + MAX_RETRANSMITS, scenario, "ARC_CNT not added to the retransmits");
+    check(nrf.txFlushes > flushes, scenario, "TX FIFO not flushed, the payload would go out again");
+    checkBackInRx(scenario);
+}
+
+static void testTimeout(const char *scenario, uint32_t startAt)
+{
+    const nrfLinkStats_t before = *nrfGetLinkStats();
+
+    microsNow = startAt;
+    startTransmission(scenario);
+    const uint32_t startedAt = startAt;
+
+    // The IRQ never comes, e.g. the chip browned out or the edge was lost
+    microsNow = startedAt + TX_TIMEOUT_US - 1;
+    nrfTxUpdate(microsNow);
+    check(nrfGetTxState() == NRF_TX_IN_FLIGHT, scenario, "timed out early");
+
+    microsNow = startedAt + TX_TIMEOUT_US;
+    nrfTxUpdate(microsNow);
+
+    const nrfLinkStats_t *stats = nrfGetLinkStats();
+    check(stats->timeouts == before.timeouts + 1 && stats->sent == before.sent && stats->failed == before.failed,
+        scenario, "not counted as a timeout");
+    checkBackInRx(scenario);
+}
+
+// The handler only latches the edge, a late nrfTxUpdate() still sees the flags
+static void testLateUpdate(void)
+{
+    const char *scenario = "TX_DS handled late";
+    const nrfLinkStats_t before = *nrfGetLinkStats();
+
+    startTransmission(scenario);
+    airComplete(TX_OK, 0);
+    microsNow += 3 * TX_TIMEOUT_US;
+    nrfTxUpdate(microsNow);
+
+    const nrfLinkStats_t *stats = nrfGetLinkStats();
+    check(stats->sent == before.sent + 1 && stats->timeouts == before.timeouts, scenario, "late TX_DS counted as a timeout");
+    checkBackInRx(scenario);
+}
+
+int main(void)
+{
+    nrfSetLinkMode(NRF_LINK_TURNAROUND);
+    nrf24l01HardwareInit();
+    SetRX_Mode();
+
+    // A fresh link counts as lost until enough packets arrived in sequence, bring it up first
+    for (int i = 0; i < 32; i++) {
+        airReceive();
+        nrf_rx();
+    }
+    nrfResetLinkStats();
+
+    for (int i = 0; i < ROUNDS; i++) {
+        testSent();
+        testMaxRetransmits();
+        testTimeout("timeout", 1000000);
+        testTimeout("timeout across the micros() wrap", UINT32_MAX - TX_TIMEOUT_US / 2);
+        testLateUpdate();
+    }
+
+    const nrfLinkStats_t *stats = nrfGetLinkStats();
+    if (stats->retransmits != ROUNDS * (2 + MAX_RETRANSMITS)) {
+        printf("timeouts added a stale ARC_CNT to the retransmits\n");
+        failures++;
+    }
+    printf("sent %u, failed %u, timeouts %u, retransmits %u, received %u, SPI transactions %u\n",
+        stats->sent, stats->failed, stats->timeouts, stats->retransmits, stats->rxPackets, nrf.transactions);
+
+    if (failures) {
+        printf("\nFAILED, %d checks\n", failures);
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}
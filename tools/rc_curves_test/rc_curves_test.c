@@ -0,0 +1,196 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Checks the 257 point RC curves in rc_curves.c against the curves they replace, over the whole range of every
+ * expo, rate and throttle mid/expo setting:
+ *
+ * - at the knots of the old 7 point pitch/roll and yaw tables the lookup must return exactly what the old table held
+ * - everywhere it must stay close to the real expo/mid polynomial, which the old linear interpolation between knots
+ *   didn't
+ *
+ * The old throttle table isn't matched at its knots: it truncated expo * tmp^2 / y^2 to an integer before scaling,
+ * so the expo part of the curve was lost near the mid point. Only the distance to the polynomial is checked there.
+ *
+ *   make run
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config/parameter_group.h"
+
+#include "io/motor_and_servo.h"
+
+#include "fc/rate_profile.h"
+#include "fc/rc_curves.h"
+
+/*
+ * Largest allowed difference from the polynomial, in rcCommand units or microseconds. The table entries and the
+ * interpolation between them both truncate, throttle truncates once more when it is scaled to min/maxthrottle.
+ */
+#define MAX_CURVE_ERROR 2.0
+#define MAX_THROTTLE_CURVE_ERROR 3.0
+
+#define OLD_PITCH_LOOKUP_LENGTH 7
+#define OLD_THROTTLE_LOOKUP_LENGTH 12
+
+// What rc_curves.c expects from the rest of the firmware
+static controlRateConfig_t testRateProfile;
+controlRateConfig_t *currentControlRateProfile = &testRateProfile;
+motorAndServoConfig_t motorAndServoConfig_System = {
+    .minthrottle = 1050,
+    .maxthrottle = 1950,
+};
+
+typedef struct curveResult_s {
+    int knotMismatches;
+    double maxError;        // of the new lookup against the polynomial
+    double maxOldError;     // of the old interpolated table against the polynomial
+} curveResult_t;
+
+static void curveCheck(curveResult_t *result, int input, int16_t value, int16_t oldValue, double exact, bool knot)
+{
+    if (knot && value != oldValue) {
+        if (result->knotMismatches++ < 5) {
+            printf("  knot %d: %d, old table %d\n", input, value, oldValue);
+        }
+    }
+    result->maxError = fmax(result->maxError, fabs(value - exact));
+    result->maxOldError = fmax(result->maxOldError, fabs(oldValue - exact));
+}
+
+// The tables and lookups rc_curves.c had before
+static int16_t oldLookup(const int16_t *table, int tmp)
+{
+    const int tmp2 = tmp / 100;
+    return table[tmp2] + (tmp - tmp2 * 100) * (table[tmp2 + 1] - table[tmp2]) / 100;
+}
+
+static void checkPitchRoll(curveResult_t *result, uint8_t expo, uint8_t rate)
+{
+    int16_t oldTable[OLD_PITCH_LOOKUP_LENGTH];
+
+    for (int i = 0; i < OLD_PITCH_LOOKUP_LENGTH; i++) {
+        oldTable[i] = (2500 + expo * (i * i - 25)) * i * (int32_t) rate / 2500;
+    }
+
+    testRateProfile.rcExpo8 = expo;
+    testRateProfile.rcRate8 = rate;
+    generatePitchRollCurve();
+
+    for (int input = 0; input <= 500; input++) {
+        const double i = input / 100.0;
+
+        curveCheck(result, input, rcLookupPitchRoll(input), oldLookup(oldTable, input),
+            (2500 + expo * (i * i - 25)) * i * rate / 2500, input % 100 == 0);
+    }
+}
+
+static void checkYaw(curveResult_t *result, uint8_t expo)
+{
+    int16_t oldTable[OLD_PITCH_LOOKUP_LENGTH];
+
+    for (int i = 0; i < OLD_PITCH_LOOKUP_LENGTH; i++) {
+        oldTable[i] = (2500 + expo * (i * i - 25)) * i / 25;
+    }
+
+    testRateProfile.rcYawExpo8 = expo;
+    generateYawCurve();
+
+    for (int input = 0; input <= 500; input++) {
+        const double i = input / 100.0;
+
+        curveCheck(result, input, rcLookupYaw(input), oldLookup(oldTable, input),
+            (2500 + expo * (i * i - 25)) * i / 25, input % 100 == 0);
+    }
+}
+
+static void checkThrottle(curveResult_t *result, uint8_t mid, uint8_t expo)
+{
+    const int minthrottle = motorAndServoConfig_System.minthrottle;
+    const int maxthrottle = motorAndServoConfig_System.maxthrottle;
+    int16_t oldTable[OLD_THROTTLE_LOOKUP_LENGTH];
+
+    for (int i = 0; i < OLD_THROTTLE_LOOKUP_LENGTH; i++) {
+        const int16_t tmp = 10 * i - mid;
+        uint8_t y = 1;
+        if (tmp > 0)
+            y = 100 - mid;
+        if (tmp < 0)
+            y = mid;
+        oldTable[i] = 10 * mid + tmp * (100 - expo + (int32_t) expo * (tmp * tmp) / (y * y)) / 10;
+        oldTable[i] = minthrottle + (int32_t) (maxthrottle - minthrottle) * oldTable[i] / 1000;
+    }
+
+    testRateProfile.thrMid8 = mid;
+    testRateProfile.thrExpo8 = expo;
+    generateThrottleCurve();
+
+    for (int input = 0; input <= 1000; input++) {
+        const double tmp = input / 10.0 - mid;
+        double y = 1;
+        if (tmp > 0)
+            y = 100 - mid;
+        if (tmp < 0)
+            y = mid;
+        const double curve = 10 * (mid + tmp * (100 - expo + expo * tmp * tmp / (y * y)) / 100);
+
+        curveCheck(result, input, rcLookupThrottle(input), oldLookup(oldTable, input),
+            minthrottle + (maxthrottle - minthrottle) * curve / 1000, false);
+    }
+}
+
+static bool report(const char *name, const curveResult_t *result, double maxError)
+{
+    const bool ok = result->knotMismatches == 0 && result->maxError <= maxError;
+
+    printf("%-10s knot mismatches %d, max error %.2f (old table %.2f) %s\n", name, result->knotMismatches,
+        result->maxError, result->maxOldError, ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+int main(void)
+{
+    curveResult_t pitchRoll = {0}, yaw = {0}, throttle = {0};
+
+    // The CLI ranges: rc_rate 0-250, rc_expo/rc_yaw_expo 0-100, thr_mid 0-100, thr_expo 0-100
+    for (int expo = 0; expo <= 100; expo++) {
+        for (int rate = 0; rate <= 250; rate++) {
+            checkPitchRoll(&pitchRoll, expo, rate);
+        }
+        checkYaw(&yaw, expo);
+    }
+
+    // The old table divides by thr_mid or 100 - thr_mid, so the ends of the range never worked
+    for (int mid = 1; mid < 100; mid++) {
+        for (int expo = 0; expo <= 100; expo++) {
+            checkThrottle(&throttle, mid, expo);
+        }
+    }
+
+    bool ok = report("pitch/roll", &pitchRoll, MAX_CURVE_ERROR);
+    ok = report("yaw", &yaw, MAX_CURVE_ERROR) && ok;
+    ok = report("throttle", &throttle, MAX_THROTTLE_CURVE_ERROR) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Step input test of rc_smoothing.c. A stick step arrives in the RX frame stream and the PID loop filters rcCommand
+ * the way processRx()/taskMainPidLoop() do: rcSmoothingUpdateRxFrameTime() on every new frame, then the raw command is
+ * reloaded and filtered on every loop.
+ *
+ * For each smoothing type and frame rate it reports the measured frame time and cutoff, the delay to half the step,
+ * the 10-90% rise time, the overshoot and the largest change between two loops, and checks that:
+ *
+ * - OFF passes the step straight through
+ * - PT1 doesn't overshoot and BIQUAD overshoots by less than MAX_BIQUAD_OVERSHOOT_PERCENT
+ * - both are past half the step within one frame and have settled after SETTLE_FRAMES frames
+ * - both spread the step over several loops, so no loop sees more than MAX_LOOP_STEP_FRACTION of it
+ * - the frame time is measured to within 2%, the loop quantises frame arrival to 1ms, and the cutoff follows it
+ *
+ *   make run
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <platform.h>
+
+#include "common/maths.h"
+
+#include "config/parameter_group.h"
+
+#include "rx/rx.h"
+
+#include "fc/rc_smoothing.h"
+
+#define LOOPTIME_US 1000
+#define SETTLE_FRAMES 8
+#define STEP_SIZE 400
+#define MAX_BIQUAD_OVERSHOOT_PERCENT 10.0
+#define MAX_LOOP_STEP_FRACTION 0.5
+
+// What rc_smoothing.c expects from the rest of the firmware
+rxConfig_t rxConfig_System;
+uint32_t targetLooptime = LOOPTIME_US;
+
+void initRxRefreshRate(uint16_t *rxRefreshRatePtr)
+{
+    // The per-protocol guess, deliberately wrong so the test sees the measured rate take over
+    *rxRefreshRatePtr = 20000;
+}
+
+typedef struct stepResult_s {
+    uint32_t frameTime;
+    uint16_t cutoffHz;
+    double halfDelayMs;
+    double riseTimeMs;
+    double overshootPercent;
+    int maxLoopStep;
+    int settledError;
+} stepResult_t;
+
+static stepResult_t runStep(rcSmoothingType_e type, uint32_t frameIntervalUs)
+{
+    const uint32_t settleUs = 2000000;
+    const uint32_t endUs = settleUs + SETTLE_FRAMES * frameIntervalUs;
+    stepResult_t result = {0};
+    int16_t rcCommand[4] = {0, 0, 0, 0};
+    int16_t raw = 0;
+    int16_t previous = 0;
+    uint32_t nextFrameAt = LOOPTIME_US;
+    uint32_t stepAt = 0;
+    int32_t peak = 0;
+    double at10 = -1, at50 = -1, at90 = -1;
+
+    rxConfig()->rcSmoothing = type;
+    rcSmoothingInit();
+
+    for (uint32_t now = LOOPTIME_US; now <= endUs; now += LOOPTIME_US) {
+        if (now >= nextFrameAt) {
+            // The first frame after settling carries the step
+            if (now >= settleUs && !stepAt) {
+                raw = STEP_SIZE;
+                stepAt = now;
+            }
+            rcSmoothingUpdateRxFrameTime(now);
+            nextFrameAt += frameIntervalUs;
+        }
+
+        rcCommand[0] = rcCommand[1] = rcCommand[2] = rcCommand[3] = raw;
+        rcSmoothingFilter(rcCommand);
+
+        if (stepAt) {
+            const double sinceStepMs = (now - stepAt) / 1000.0;
+
+            if (at10 < 0 && rcCommand[0] >= STEP_SIZE / 10) {
+                at10 = sinceStepMs;
+            }
+            if (at50 < 0 && rcCommand[0] >= STEP_SIZE / 2) {
+                at50 = sinceStepMs;
+            }
+            if (at90 < 0 && rcCommand[0] >= STEP_SIZE * 9 / 10) {
+                at90 = sinceStepMs;
+            }
+            peak = MAX(peak, rcCommand[0]);
+            result.maxLoopStep = MAX(result.maxLoopStep, abs(rcCommand[0] - previous));
+        }
+        previous = rcCommand[0];
+    }
+
+    result.frameTime = rcSmoothingGetRxFrameTime();
+    result.cutoffHz = rcSmoothingGetCutoffFrequency();
+    result.halfDelayMs = at50;
+    result.riseTimeMs = at90 - at10;
+    result.overshootPercent = 100.0 * (peak - STEP_SIZE) / STEP_SIZE;
+    result.settledError = abs(rcCommand[0] - STEP_SIZE);
+
+    return result;
+}
+
+static bool checkStep(const char *name, rcSmoothingType_e type, uint32_t frameIntervalUs)
+{
+    const stepResult_t result = runStep(type, frameIntervalUs);
+    const double frameMs = frameIntervalUs / 1000.0;
+    bool ok = abs((int32_t)(result.frameTime - frameIntervalUs)) <= (int32_t)frameIntervalUs / 50;
+
+    if (type == RC_SMOOTHING_OFF) {
+        ok = ok && result.maxLoopStep == STEP_SIZE && result.settledError == 0;
+    } else {
+        ok = ok && result.halfDelayMs >= 0 && result.halfDelayMs < frameMs
+            && result.maxLoopStep <= STEP_SIZE * MAX_LOOP_STEP_FRACTION
+            && result.settledError <= 1
+            && result.overshootPercent <= (type == RC_SMOOTHING_PT1 ? 0 : MAX_BIQUAD_OVERSHOOT_PERCENT);
+    }
+
+    printf("%-7s %5.1fms frames: measured %5u us, cutoff %3u Hz, 50%% after %4.1fms, rise %4.1fms, overshoot %4.1f%%, "
+        "max step %3d/loop, settled to %d %s\n", name, frameMs, result.frameTime, result.cutoffHz, result.halfDelayMs,
+        result.riseTimeMs, result.overshootPercent, result.maxLoopStep, result.settledError, ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+int main(void)
+{
+    static const uint32_t frameIntervals[] = {20000, 9000, 6667};     // 50Hz PPM, 111Hz SBUS, 150Hz
+    bool ok = true;
+
+    rxConfig()->rcSmoothingCutoffPercent = 50;
+
+    for (unsigned i = 0; i < sizeof(frameIntervals) / sizeof(frameIntervals[0]); i++) {
+        ok = checkStep("OFF", RC_SMOOTHING_OFF, frameIntervals[i]) && ok;
+        ok = checkStep("PT1", RC_SMOOTHING_PT1, frameIntervals[i]) && ok;
+        ok = checkStep("BIQUAD", RC_SMOOTHING_BIQUAD, frameIntervals[i]) && ok;
+    }
+
+    // The cutoff has to move with the measured frame rate and with the configured percentage
+    const uint16_t slowCutoff = runStep(RC_SMOOTHING_PT1, 20000).cutoffHz;
+    const uint16_t fastCutoff = runStep(RC_SMOOTHING_PT1, 6667).cutoffHz;
+
+    rxConfig()->rcSmoothingCutoffPercent = 100;
+    const uint16_t fullCutoff = runStep(RC_SMOOTHING_PT1, 20000).cutoffHz;
+
+    const bool tracks = fastCutoff > slowCutoff && fullCutoff > slowCutoff;
+    printf("cutoff: %u Hz at 50Hz frames, %u Hz at 150Hz frames, %u Hz at 50Hz frames and 100%% %s\n",
+        slowCutoff, fastCutoff, fullCutoff, tracks ? "ok" : "FAILED");
+
+    return ok && tracks ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the target headers, just enough of the STM32 USART and DMA peripherals for serial_uart.c
+
+#define TARGET_BOARD_IDENTIFIER "HOST"
+
+#define SERIAL_PORT_COUNT 1
+
+typedef enum {
+    DISABLE = 0,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+typedef enum {
+    Mode_TEST = 0x0,
+    Mode_IPU = 0x48,
+    Mode_Out_PP = 0x10,
+} GPIO_Mode;
+
+typedef enum {
+    DMA1_Channel1_IRQn = 11,
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+    volatile uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef struct {
+    void *test;
+} TIM_TypeDef;
+
+typedef struct {
+    volatile uint32_t ISR;
+    volatile uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    volatile uint32_t CCR;
+    volatile uint32_t CNDTR;
+    volatile uint32_t CPAR;
+    volatile uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    volatile uint32_t ISR;
+    volatile uint32_t RDR;
+    volatile uint32_t TDR;
+} USART_TypeDef;
+
+typedef struct {
+    uint32_t USART_BaudRate;
+    uint32_t USART_WordLength;
+    uint32_t USART_StopBits;
+    uint32_t USART_Parity;
+    uint32_t USART_Mode;
+    uint32_t USART_HardwareFlowControl;
+} USART_InitTypeDef;
+
+typedef struct {
+    uint32_t DMA_PeripheralBaseAddr;
+    uint32_t DMA_MemoryBaseAddr;
+    uint32_t DMA_DIR;
+    uint32_t DMA_BufferSize;
+    uint32_t DMA_PeripheralInc;
+    uint32_t DMA_MemoryInc;
+    uint32_t DMA_PeripheralDataSize;
+    uint32_t DMA_MemoryDataSize;
+    uint32_t DMA_Mode;
+    uint32_t DMA_Priority;
+    uint32_t DMA_M2M;
+} DMA_InitTypeDef;
+
+extern USART_TypeDef hostUSART1;
+#define USART1 (&hostUSART1)
+
+#define USART_WordLength_8b             0x0000
+#define USART_StopBits_1                0x0000
+#define USART_StopBits_2                0x2000
+#define USART_Parity_No                 0x0000
+#define USART_Parity_Even               0x0400
+#define USART_Mode_Rx                   0x0004
+#define USART_Mode_Tx                   0x0008
+#define USART_HardwareFlowControl_None  0x0000
+#define USART_IT_RXNE                   0x0525
+#define USART_IT_TXE                    0x0727
+#define USART_IT_IDLE                   0x0424
+#define USART_DMAReq_Rx                 0x0040
+#define USART_DMAReq_Tx                 0x0080
+
+#define DMA_DIR_PeripheralSRC           0x0000
+#define DMA_DIR_PeripheralDST           0x0010
+#define DMA_Mode_Normal                 0x0000
+#define DMA_Mode_Circular               0x0020
+#define DMA_PeripheralInc_Disable       0x0000
+#define DMA_MemoryInc_Enable            0x0080
+#define DMA_PeripheralDataSize_Byte     0x0000
+#define DMA_MemoryDataSize_Byte         0x0000
+#define DMA_Priority_Medium             0x1000
+#define DMA_M2M_Disable                 0x0000
+#define DMA_IT_TC                       0x0002
+
+// The peripherals do nothing on the host, the test moves CNDTR and the idle line queue itself
+static inline void USART_Cmd(USART_TypeDef *USARTx, FunctionalState state) { (void)USARTx; (void)state; }
+static inline void USART_Init(USART_TypeDef *USARTx, USART_InitTypeDef *init) { (void)USARTx; (void)init; }
+static inline void USART_ITConfig(USART_TypeDef *USARTx, uint32_t it, FunctionalState state) { (void)USARTx; (void)it; (void)state; }
+static inline void USART_ClearITPendingBit(USART_TypeDef *USARTx, uint32_t it) { (void)USARTx; (void)it; }
+static inline void USART_DMACmd(USART_TypeDef *USARTx, uint32_t req, FunctionalState state) { (void)USARTx; (void)req; (void)state; }
+static inline void USART_HalfDuplexCmd(USART_TypeDef *USARTx, FunctionalState state) { (void)USARTx; (void)state; }
+
+static inline void DMA_StructInit(DMA_InitTypeDef *init) { *init = (DMA_InitTypeDef){ 0 }; }
+static inline void DMA_DeInit(DMA_Channel_TypeDef *channel) { channel->CCR = 0; channel->CNDTR = 0; }
+static inline void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitTypeDef *init) { channel->CNDTR = init->DMA_BufferSize; }
+static inline void DMA_Cmd(DMA_Channel_TypeDef *channel, FunctionalState state) { if (state) channel->CCR |= 1; else channel->CCR &= ~1; }
+static inline void DMA_ITConfig(DMA_Channel_TypeDef *channel, uint32_t it, FunctionalState state) { (void)channel; (void)it; (void)state; }
+static inline void DMA_SetCurrDataCounter(DMA_Channel_TypeDef *channel, uint16_t count) { channel->CNDTR = count; }
+static inline uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *channel) { return channel->CNDTR; }
@@ -0,0 +1,270 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Host test of the idle line queue in uartDrainRx(). serial_uart.c is built against a stub platform.h, the test plays
+ * the RX DMA channel (writing bytes and counting CNDTR down, circularly) and the idle line interrupt (queueing CNDTR
+ * in rxIdlePos) the way serial_uart_stm32f30x.c does on the target.
+ *
+ * Fuzz: random frame lengths, a random number of idle lines between two drains and a frame still being received at
+ * every drain. It checks that:
+ *
+ * - up to UART_RX_IDLE_QUEUE_SIZE queued frames are all delivered, byte exact and in order, one frame end each
+ * - with more frames queued than that, only the newest is delivered, intact, and the rest are skipped
+ * - bytes of the frame still being received are never delivered
+ *
+ * Throughput: drain cost per byte and per frame for a few frame sizes and drain rates.
+ *
+ *   make run
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "drivers/dma.h"
+#include "drivers/serial.h"
+#include "drivers/serial_uart.h"
+#include "drivers/serial_uart_impl.h"
+
+#define FUZZ_ROUNDS 200000
+#define FUZZ_MAX_FRAME_LENGTH 48
+#define FUZZ_MAX_IDLE_LINES 7
+#define BENCH_BYTES (64 * 1024 * 1024)
+
+USART_TypeDef hostUSART1;
+
+static DMA_Channel_TypeDef rxDMAChannel;
+static volatile uint8_t rxBuffer[UART1_RX_BUFFER_SIZE];
+static volatile uint8_t txBuffer[UART1_TX_BUFFER_SIZE];
+static uartPort_t uartPort1;
+
+uartPort_t *serialUART1(uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    (void)baudRate;
+    (void)mode;
+    (void)options;
+
+    uartPort_t *s = &uartPort1;
+    s->port.vTable = uartVTable;
+    s->port.rxBuffer = rxBuffer;
+    s->port.rxBufferSize = UART1_RX_BUFFER_SIZE;
+    s->port.txBuffer = txBuffer;
+    s->port.txBufferSize = UART1_TX_BUFFER_SIZE;
+    s->rxDMAChannel = &rxDMAChannel;
+    s->txDMAChannel = NULL;
+    s->USARTx = USART1;
+
+    return s;
+}
+
+// The DMA controller, one byte received into the circular buffer
+static void dmaReceive(uint8_t c)
+{
+    rxBuffer[UART1_RX_BUFFER_SIZE - rxDMAChannel.CNDTR] = c;
+    if (--rxDMAChannel.CNDTR == 0) {
+        rxDMAChannel.CNDTR = UART1_RX_BUFFER_SIZE;
+    }
+}
+
+// The USART idle line interrupt, as in serial_uart_stm32f30x.c
+static void idleLine(void)
+{
+    uartPort1.rxIdlePos[uartPort1.rxIdleHead & (UART_RX_IDLE_QUEUE_SIZE - 1)] = rxDMAChannel.CNDTR;
+    uartPort1.rxIdleHead++;
+}
+
+// Frames as the sender produced them, the content of a frame follows from its id
+typedef struct {
+    uint32_t id;
+    int length;
+} frame_t;
+
+static uint8_t frameByte(uint32_t id, int index)
+{
+    return (uint8_t)(id * 31 + index * 7 + (id >> 8));
+}
+
+// What the drain handed over
+static uint8_t received[FUZZ_MAX_IDLE_LINES + 1][UART1_RX_BUFFER_SIZE];
+static int receivedLength[FUZZ_MAX_IDLE_LINES + 1];
+static int receivedFrames;
+static uint64_t receivedBytes;
+
+static void byteCallback(uint16_t c)
+{
+    if (receivedFrames <= FUZZ_MAX_IDLE_LINES && receivedLength[receivedFrames] < UART1_RX_BUFFER_SIZE) {
+        received[receivedFrames][receivedLength[receivedFrames]] = c;
+    }
+    receivedLength[receivedFrames]++;
+    receivedBytes++;
+}
+
+static void frameEndCallback(void)
+{
+    receivedFrames++;
+}
+
+static void resetReceived(void)
+{
+    memset(receivedLength, 0, sizeof(receivedLength));
+    receivedFrames = 0;
+}
+
+static bool checkFrame(const frame_t *frame, int index)
+{
+    if (receivedLength[index] != frame->length) {
+        return false;
+    }
+    for (int i = 0; i < frame->length; i++) {
+        if (received[index][i] != frameByte(frame->id, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int randomBetween(int low, int high)
+{
+    return low + rand() % (high - low + 1);
+}
+
+static bool fuzz(serialPort_t *port)
+{
+    frame_t current = { .id = 0, .length = randomBetween(1, FUZZ_MAX_FRAME_LENGTH) };
+    int currentSent = 0;
+    frame_t completed[FUZZ_MAX_IDLE_LINES];
+    uint32_t idleLinesSeen[FUZZ_MAX_IDLE_LINES + 1] = { 0 };
+    uint32_t framesSkipped = 0;
+    uint32_t framesDelivered = 0;
+    int failures = 0;
+
+    for (int round = 0; round < FUZZ_ROUNDS; round++) {
+        const int idleLines = randomBetween(0, FUZZ_MAX_IDLE_LINES);
+
+        for (int i = 0; i < idleLines; i++) {
+            while (currentSent < current.length) {
+                dmaReceive(frameByte(current.id, currentSent++));
+            }
+            idleLine();
+            completed[i] = current;
+            current.id++;
+            current.length = randomBetween(1, FUZZ_MAX_FRAME_LENGTH);
+            currentSent = 0;
+        }
+        // The next frame is on the wire while the drain runs
+        const int partial = randomBetween(currentSent, current.length - 1);
+        while (currentSent < partial) {
+            dmaReceive(frameByte(current.id, currentSent++));
+        }
+
+        resetReceived();
+        port->vTable->drainRx(port, byteCallback, frameEndCallback);
+        idleLinesSeen[idleLines]++;
+
+        const int first = idleLines > UART_RX_IDLE_QUEUE_SIZE ? idleLines - 1 : 0;
+        bool ok = receivedFrames == idleLines - first && receivedLength[receivedFrames] == 0;
+        for (int i = first; ok && i < idleLines; i++) {
+            ok = checkFrame(&completed[i], i - first);
+        }
+        if (!ok) {
+            if (failures++ < 10) {
+                printf("round %d: %d idle lines, %d frames delivered, %d bytes after the last frame end\n",
+                    round, idleLines, receivedFrames, receivedLength[receivedFrames]);
+            }
+            continue;
+        }
+        framesSkipped += first;
+        framesDelivered += receivedFrames;
+    }
+
+    printf("fuzz: %d drains, %u frames delivered, %u skipped after queue overflow, %d failures\n",
+        FUZZ_ROUNDS, framesDelivered, framesSkipped, failures);
+    printf("idle lines per drain:");
+    for (int i = 0; i <= FUZZ_MAX_IDLE_LINES; i++) {
+        printf(" %d:%u", i, idleLinesSeen[i]);
+    }
+    printf("\n\n");
+
+    return failures == 0 && idleLinesSeen[UART_RX_IDLE_QUEUE_SIZE] > 0 && idleLinesSeen[UART_RX_IDLE_QUEUE_SIZE + 1] > 0;
+}
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void benchByteCallback(uint16_t c)
+{
+    receivedBytes += c;
+}
+
+static void bench(int frameLength, int framesPerDrain)
+{
+    // Reopened so nothing the fuzz left in the buffer is counted
+    serialPort_t *port = uartOpen(USART1, NULL, 115200, MODE_RX, SERIAL_NOT_INVERTED);
+    const int drains = BENCH_BYTES / (frameLength * framesPerDrain);
+    double drainTime = 0;
+
+    receivedBytes = 0;
+    receivedFrames = 0;
+    for (int i = 0; i < drains; i++) {
+        for (int f = 0; f < framesPerDrain; f++) {
+            for (int b = 0; b < frameLength; b++) {
+                dmaReceive(1);
+            }
+            idleLine();
+        }
+        const double start = nowSeconds();
+        port->vTable->drainRx(port, benchByteCallback, frameEndCallback);
+        drainTime += nowSeconds() - start;
+    }
+
+    const double bytes = (double)drains * frameLength * framesPerDrain;
+    printf("%12d %16d %12.2f %14.1f %12.0f%s\n", frameLength, framesPerDrain, drainTime * 1e9 / bytes,
+        drainTime * 1e9 / receivedFrames, bytes / drainTime / 1e6,
+        receivedBytes == bytes && receivedFrames == drains * framesPerDrain ? "" : "  (bytes lost)");
+}
+
+int main(void)
+{
+    srand(1);
+
+    const bool fuzzOk = fuzz(uartOpen(USART1, NULL, 115200, MODE_RX, SERIAL_NOT_INVERTED));
+
+    printf("%12s %16s %12s %14s %12s\n", "frame bytes", "frames per drain", "ns per byte", "ns per frame", "MB/s");
+    bench(16, 1);
+    bench(25, 1);
+    bench(25, UART_RX_IDLE_QUEUE_SIZE);
+    bench(64, 1);
+    bench(64, 3);
+
+    if (!fuzzOk) {
+        printf("\nFAILED\n");
+        return 1;
+    }
+    printf("\nPASSED\n");
+    return 0;
+}